@@ -66,6 +66,15 @@
   Returns YES if the query executed successfully.
 */
 - (BOOL) executeQueryWithBooleanResult:(id)aQuery;
+/*!
+  @method executeQueriesWithBooleanResult:
+  
+  Attempt to execute every query in the queries array as a single atomic batch,
+  submitting them together where the database system allows it.
+  
+  Returns YES if all of the queries executed successfully.
+*/
+- (BOOL) executeQueriesWithBooleanResult:(SBArray*)queries;
 /*!
   @method beginTransaction
   
@@ -10,7 +10,7 @@
 
 #import "SBObject.h"
 
-@class SBString, SBDictionary, SBMutableDictionary, SBArray, SBEnumerator;
+@class SBString, SBDictionary, SBMutableDictionary, SBArray, SBEnumerator, SBObjectCache;
 
 /*!
   @class SBDatabaseObject
@@ -139,6 +139,48 @@
 */
 + (id) databaseObjectWithDatabase:(id)database key:(SBString*)key value:(SBString*)value;
 
+/*!
+  @method databaseObjectsWithDatabase:objectIds:objectCache:
+  @discussion
+    Bulk variant of databaseObjectWithDatabase:objectId:.  All properties for every
+    object identifier in objIds (an array of SBNumber instances) are fetched using a
+    single query of the form
+    
+      SELECT * FROM <table> WHERE <objectIdKey> = ANY($1)
+    
+    If objectCache is not nil, instances already present in it have their committed
+    properties replaced by the fetched row (and are sent didReplaceCommittedProperties
+    if they implement it) and new instances are added to it, all in one pass over the
+    query result.
+    
+    Returns an autoreleased array of the objects that were found, in no particular
+    order, or nil if none were found or the query failed.
+*/
++ (SBArray*) databaseObjectsWithDatabase:(id)database objectIds:(SBArray*)objIds objectCache:(SBObjectCache*)objectCache;
+
+/*!
+  @method databaseObjectsWithDatabase:whereClause:objectCache:
+  @discussion
+    Like databaseObjectsWithDatabase:objectIds:objectCache:, but the objects are selected
+    by an arbitrary SQL predicate (e.g. "provisioned IS NULL") rather than by identifier.
+    A nil whereClause selects every object in the backing table.  This replaces the
+    "SELECT the ids, then load each id" pattern with a single query.
+    
+    The returned array holds the objects in the reverse of the order in which the
+    rows were returned (so an ORDER BY in whereClause is honored, backwards).
+*/
++ (SBArray*) databaseObjectsWithDatabase:(id)database whereClause:(SBString*)whereClause objectCache:(SBObjectCache*)objectCache;
+
+/*!
+  @method classForDatabase:properties:
+  @discussion
+    Used by the bulk loading methods to choose the class that should be instantiated
+    for a row of properties; the default implementation returns the receiver.  A class
+    cluster can override this to pick a subclass given the row's contents.  Returning
+    Nil skips the row.
+*/
++ (Class) classForDatabase:(id)database properties:(SBDictionary*)properties;
+
 /*!
   @method initWithDatabase:objectId:
   @discussion
@@ -155,6 +197,16 @@
 */
 - (id) initWithDatabase:(id)database key:(SBString*)key value:(SBString*)value;
 
+/*!
+  @method initWithDatabase:properties:
+  @discussion
+    Initialize the receiver using an already-fetched dictionary of properties (e.g. a
+    row of a bulk query) rather than loading them from the backing database.  The
+    properties must include the object identifier, or the receiver is released and
+    nil is returned.
+*/
+- (id) initWithDatabase:(id)database properties:(SBDictionary*)properties;
+
 /*!
   @method parentDatabase
   @discussion
@@ -261,4 +313,24 @@
 */
 - (void) didCommitModifications;
 
+/*!
+  @method didLoadPropertiesFromDatabase
+  @discussion
+    This optional method is called by the bulk loading methods after a new instance
+    has been initialized from a row of properties, before it is added to the object
+    cache.  Returning boolean NO discards the instance.
+*/
+- (BOOL) didLoadPropertiesFromDatabase;
+
+/*!
+  @method didReplaceCommittedProperties
+  @discussion
+    This optional method is called by the bulk loading methods after an instance
+    already present in the object cache has had its committed properties replaced
+    with a freshly-fetched row.  Only the row itself is updated, so a class which
+    keeps state beyond its properties (anything its refreshCommittedProperties
+    override would reload or discard) should refresh or drop that state here.
+*/
+- (void) didReplaceCommittedProperties;
+
 @end
@@ -13,7 +13,9 @@
 #import "SBPostgres.h"
 
 #import "SBString.h"
+#import "SBArray.h"
 #import "SBDictionary.h"
+#import "SBObjectCache.h"
 #import "SBValue.h"
 #import "SBNotorization.h"
 
@@ -29,6 +31,9 @@ SBString* SBDatabaseObjectPropertyModificationNotorization = @"modifiedby";
 
 @interface SBDatabaseObject(SBDatabaseObjectPrivate)
 
++ (SBArray*) databaseObjectsWithDatabase:(id)database queryResult:(id)queryResult objectCache:(SBObjectCache*)objectCache;
+
+- (BOOL) setCommittedProperties:(SBDictionary*)properties;
 - (BOOL) loadPropertiesFromDatabaseWithKey:(SBString*)key value:(SBString*)value;
 - (BOOL) loadPropertiesFromDatabase;
 - (id) insertQueryForModifications;
@@ -38,6 +43,91 @@ SBString* SBDatabaseObjectPropertyModificationNotorization = @"modifiedby";
 
 @implementation SBDatabaseObject(SBDatabaseObjectPrivate)
 
+  + (SBArray*) databaseObjectsWithDatabase:(id)database
+    queryResult:(id)queryResult
+    objectCache:(SBObjectCache*)objectCache
+  {
+    SBUInteger        rowCount;
+    
+    if ( queryResult && [queryResult queryWasSuccessful] && (rowCount = [queryResult numberOfRows]) ) {
+      SBString*       idKey = [self objectIdKeyForClass];
+      id*             objects = objc_malloc(rowCount * sizeof(id));
+      SBArray*        result = nil;
+      SBUInteger      index = 0;
+      
+      if ( ! objects )
+        return nil;
+      
+      //
+      // Rows are walked last to first, as the per-id list methods always did, so
+      // callers relying on an ORDER BY see the same ordering as before:
+      //
+      while ( rowCount-- ) {
+        SBDictionary* properties = [queryResult dictionaryForRow:rowCount];
+        id            objId = [properties objectForKey:idKey];
+        id            object = nil;
+        
+        if ( ! objId || ! [objId isKindOf:[SBNumber class]] )
+          continue;
+        
+        if ( objectCache && (object = [objectCache cachedObjectForKey:idKey value:objId]) ) {
+          //
+          // Already cached; the row we have in hand replaces the committed properties,
+          // but any state the class keeps outside of them has to be refreshed by the
+          // class itself:
+          //
+          [object setCommittedProperties:properties];
+          if ( [object respondsTo:@selector(didReplaceCommittedProperties)] )
+            [object didReplaceCommittedProperties];
+        } else {
+          Class       objClass = [self classForDatabase:database properties:properties];
+          
+          if ( objClass && (object = [[objClass alloc] initWithDatabase:database properties:properties]) ) {
+            if ( [object respondsTo:@selector(didLoadPropertiesFromDatabase)] && ! [object didLoadPropertiesFromDatabase] ) {
+              [object release];
+              object = nil;
+            } else {
+              object = [object autorelease];
+              if ( objectCache )
+                [objectCache addObjectToCache:object];
+            }
+          }
+        }
+        if ( object )
+          objects[index++] = object;
+      }
+      if ( index )
+        result = [SBArray arrayWithObjects:objects count:index];
+      objc_free(objects);
+      return result;
+    }
+    return nil;
+  }
+  
+//
+
+  - (BOOL) setCommittedProperties:(SBDictionary*)properties
+  {
+    if ( properties ) {
+      id                      objId;
+      
+      properties = [properties retain];
+      if ( _properties ) [_properties release];
+      _properties = properties;
+      
+      objId = [_properties objectForKey:[self objectIdKeyForClass]];
+      
+      // Attempt to pull the object id:
+      if ( objId && [objId isKindOf:[SBNumber class]] ) {
+        _objectId = [(SBNumber*)objId intValue];
+        return YES;
+      }
+    }
+    return NO;
+  }
+  
+//
+
   - (BOOL) loadPropertiesFromDatabaseWithKey:(SBString*)key
     value:(SBString*)value
   {
@@ -50,25 +140,8 @@ SBString* SBDatabaseObjectPropertyModificationNotorization = @"modifiedby";
                                           ];
         SBPostgresQueryResult*      queryResult = [_database executeQuery:query];
         
-        if ( queryResult && [queryResult queryWasSuccessful] && [queryResult numberOfRows] ) {
-          SBDictionary*     properties = [queryResult dictionaryForRow:0];
-          
-          if ( properties ) {
-            id                      objId;
-            
-            properties = [properties retain];
-            if ( _properties ) [_properties release];
-            _properties = properties;
-            
-            objId = [_properties objectForKey:[self objectIdKeyForClass]];
-            
-            // Attempt to pull the object id:
-            if ( objId && [objId isKindOf:[SBNumber class]] ) {
-              _objectId = [(SBNumber*)objId intValue];
-              return YES;
-            }
-          }
-        }
+        if ( queryResult && [queryResult queryWasSuccessful] && [queryResult numberOfRows] )
+          return [self setCommittedProperties:[queryResult dictionaryForRow:0]];
       }
     }
     return NO;
@@ -87,25 +160,8 @@ SBString* SBDatabaseObjectPropertyModificationNotorization = @"modifiedby";
                                           ];
         SBPostgresQueryResult*      queryResult = [_database executeQuery:query];
         
-        if ( queryResult && [queryResult queryWasSuccessful] && [queryResult numberOfRows] ) {
-          SBDictionary*     properties = [queryResult dictionaryForRow:0];
-          
-          if ( properties ) {
-            id                      objId;
-            
-            properties = [properties retain];
-            if ( _properties ) [_properties release];
-            _properties = properties;
-            
-            objId = [_properties objectForKey:[self objectIdKeyForClass]];
-            
-            // Attempt to pull the object id:
-            if ( objId && [objId isKindOf:[SBNumber class]] ) {
-              _objectId = [(SBNumber*)objId intValue];
-              return YES;
-            }
-          }
-        }
+        if ( queryResult && [queryResult queryWasSuccessful] && [queryResult numberOfRows] )
+          return [self setCommittedProperties:[queryResult dictionaryForRow:0]];
       }
     }
     return NO;
@@ -289,6 +345,77 @@ SBString* SBDatabaseObjectPropertyModificationNotorization = @"modifiedby";
     return nil;
   }
   
+//
+
+  + (SBArray*) databaseObjectsWithDatabase:(id)database
+    objectIds:(SBArray*)objIds
+    objectCache:(SBObjectCache*)objectCache
+  {
+    SBUInteger        i = 0, iMax = [objIds count];
+    SBArray*          result = nil;
+    
+    if ( iMax && [database isKindOf:[SBPostgresDatabase class]] ) {
+      SBMutableString*  idList = [[SBMutableString alloc] initWithString:@"{"];
+      SBString*         queryStr = [[SBString alloc] initWithFormat:"SELECT * FROM %s WHERE %s = ANY($1::int8[])",
+                                                    [[self tableNameForClass] utf8Characters],
+                                                    [[self objectIdKeyForClass] utf8Characters]
+                                                  ];
+      SBPostgresQuery*  query = [[SBPostgresQuery alloc] initWithQueryString:queryStr parameterCount:1];
+      
+      //
+      // The identifiers go over the wire as a single int8[] literal:
+      //
+      while ( i < iMax ) {
+        id              objId = [objIds objectAtIndex:i];
+        
+        if ( [objId isKindOf:[SBNumber class]] )
+          [idList appendFormat:"%s%lld", ( [idList length] > 1 ? "," : "" ), (long long int)[(SBNumber*)objId int64Value]];
+        i++;
+      }
+      [idList appendString:@"}"];
+      
+      if ( query && [query bindObject:idList toParameter:1] )
+        result = [self databaseObjectsWithDatabase:database queryResult:[database executeQuery:query] objectCache:objectCache];
+      
+      if ( query ) [query release];
+      [queryStr release];
+      [idList release];
+    }
+    return result;
+  }
+  
+//
+
+  + (SBArray*) databaseObjectsWithDatabase:(id)database
+    whereClause:(SBString*)whereClause
+    objectCache:(SBObjectCache*)objectCache
+  {
+    SBArray*          result = nil;
+    
+    if ( [database isKindOf:[SBPostgresDatabase class]] ) {
+      SBString*       queryStr;
+      
+      if ( whereClause )
+        queryStr = [[SBString alloc] initWithFormat:"SELECT * FROM %s WHERE %S",
+                                [[self tableNameForClass] utf8Characters],
+                                [whereClause utf16Characters]
+                              ];
+      else
+        queryStr = [[SBString alloc] initWithFormat:"SELECT * FROM %s", [[self tableNameForClass] utf8Characters]];
+      result = [self databaseObjectsWithDatabase:database queryResult:[database executeQuery:queryStr] objectCache:objectCache];
+      [queryStr release];
+    }
+    return result;
+  }
+  
+//
+
+  + (Class) classForDatabase:(id)database
+    properties:(SBDictionary*)properties
+  {
+    return self;
+  }
+
 //
 
   - (id) initWithDatabase:(id)database
@@ -337,6 +464,20 @@ SBString* SBDatabaseObjectPropertyModificationNotorization = @"modifiedby";
     return self;
   }
 
+//
+
+  - (id) initWithDatabase:(id)database
+    properties:(SBDictionary*)properties
+  {
+    if ( self = [self initWithDatabase:database] ) {
+      if ( ! [self setCommittedProperties:properties] ) {
+        [self release];
+        self = nil;
+      }
+    }
+    return self;
+  }
+
 //
 
   - (void) dealloc
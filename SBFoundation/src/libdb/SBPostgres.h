@@ -16,8 +16,14 @@
 #import "SBDatabaseAccess.h"
 
 #include <libpq-fe.h>
+//
+// PG_VERSION_NUM -- which gates single-row mode, PQping() and pipelining below and in the
+// implementation -- comes from pg_config.h; libpq-fe.h doesn't pull it in:
+//
+#include <pg_config.h>
 
-@class SBNotification, SBPostgresQuery, SBPostgresQueryResult, SBRunLoop;
+@class SBNotification, SBPostgresQuery, SBPostgresQueryResult, SBPostgresStreamingQueryResult, SBPostgresCopyIn, SBRunLoop;
+@class SBInputStream, SBOutputStream;
 
 /*!
   @const SBPostgresNotifierPayloadStringKey
@@ -27,6 +33,35 @@
 */
 extern SBString *SBPostgresNotifierPayloadStringKey;
 
+/*!
+  @defined SBPostgresDefaultStatementCacheSize
+  @discussion
+    A reasonable statement cache size (see setStatementCacheSize:) for long-running
+    programs.
+*/
+#define SBPostgresDefaultStatementCacheSize 64
+
+/*
+  Slots of the hash table in which an SBPostgresDatabase records the queries which have
+  been prepared against it.
+*/
+typedef struct {
+  id                    query;
+  unsigned int          statementId;
+} SBPostgresPreparedStatement;
+
+/*!
+  @typedef SBPostgresUTF8Slice
+  @discussion
+    A borrowed reference to a textual value within a query result:  bytes points into
+    the result's own storage and is not nul-terminated.  A NULL value has bytes set to
+    NULL and a length of zero.
+*/
+typedef struct {
+  const char*           bytes;
+  SBUInteger            length;
+} SBPostgresUTF8Slice;
+
 /*!
   @class SBPostgresDatabase
   @discussion
@@ -54,12 +89,20 @@ extern SBString *SBPostgresNotifierPayloadStringKey;
     <li>A query wrapped by a SBPostgresQuery object</li>
     <li>A textual query in an SBString</li>
   </ul>
-  Internally, the SBPostgresDatabase instance maintains an array of prepared SBPostgresQuery
-  objects and looks into that array when executeQuery is handed an SBPostgresQuery object;
-  if that object is present in the array, then it is treated as a prepared statement and handled
+  Internally, the SBPostgresDatabase instance maintains a hash table of prepared SBPostgresQuery
+  objects and looks into that table when executeQuery is handed an SBPostgresQuery object;
+  if that object is present in the table, then it is treated as a prepared statement and handled
   using PQexecPrepared().  If it is not present, then it is executed using PQexecParams().  If
-  handed an SBString, then a UTF8-encoded copy of that string is executed with PQexec().  See
-  Postgres documentation for more info on the three functions mentioned.
+  handed an SBString, then a UTF8-encoded copy of that string is executed with PQexecParams().  See
+  Postgres documentation for more info on the functions mentioned.
+  
+  Optionally, a statement cache can be enabled (see setStatementCacheSize:).  Queries which
+  were not explicitly prepared are then prepared automatically, keyed by their SQL text, the
+  second time that text is executed, and the least-recently-used statements are deallocated
+  when the cache fills.  Integer literals in SBString queries which are compared against (=,
+  <>, <, >, etc.) or appear in VALUES and IN lists are turned into parameters first, so that
+  queries formatted from the same template share a single prepared statement.  SBString
+  queries containing string literals are never cached.
   
   SBPostgresQuery instances can (as already mentioned) be used to create prepared functions within
   the context of the database connection.  After binding data to all parameters of an SBPostgresQuery,
@@ -82,14 +125,24 @@ extern SBString *SBPostgresNotifierPayloadStringKey;
   id                    _runloopNotifier;
   PGconn*               _databaseConnection;
   SBMutableArray*       _searchSchema;
-  SBMutableArray*       _preparedQueries;
+  SBPostgresPreparedStatement* _preparedQueries;
+  SBUInteger            _preparedQueryCount, _preparedQueryCapacity;
+  unsigned int          _statementCounter;
+  SBMutableDictionary*  _statementCache;
+  SBMutableDictionary*  _statementSightings;
+  SBUInteger            _statementCacheSize;
+  SBUInteger            _statementCacheClock;
   SBMutableDictionary*  _typeOids;
   SBMutableArray*       _errorMessageStack;
   SBUInteger            _checkpointIndex;
+  id                    _streamingResult;
+  id                    _copyInProgress;
+  SBMutableArray*       _asyncQueries;
   struct {
     unsigned int    inNotifyRunLoop : 1;
     unsigned int    openingConnection : 1;
     unsigned int    connectionOpen : 1;
+    unsigned int    asyncQueryInFlight : 1;
   } _flags;
 }
 
@@ -229,9 +282,170 @@ extern SBString *SBPostgresNotifierPayloadStringKey;
   object to the executeQuery: method.
 */
 - (BOOL) prepareQuery:(SBPostgresQuery*)aReadyQuery;
+/*!
+  @method statementCacheSize
+  
+  Returns the maximum number of automatically-prepared statements the receiver keeps.
+  Zero (the default) means the statement cache is disabled.
+*/
+- (SBUInteger) statementCacheSize;
+/*!
+  @method setStatementCacheSize:
+  
+  Set the maximum number of automatically-prepared statements the receiver keeps.  If the
+  cache currently holds more than cacheSize statements, the least-recently-used ones are
+  deallocated; a cacheSize of zero disables the cache and deallocates all of them.
+  
+  Since the server keeps a plan for each cached statement, enable the cache for
+  long-running programs which execute the same queries over and over.
+*/
+- (void) setStatementCacheSize:(SBUInteger)cacheSize;
+/*!
+  @method cachedStatementCount
+  
+  Returns the number of statements currently held in the receiver's statement cache.
+*/
+- (SBUInteger) cachedStatementCount;
+/*!
+  @method executeStreamingQuery:
+  
+  Submit aQuery (anything executeQuery: accepts) without waiting for its result and
+  return an SBPostgresStreamingQueryResult from which the rows are read one at a time
+  as the server produces them.  Only the current row is held in memory, so a scan of
+  an entire table runs in bounded memory and the first row is available before the
+  query has finished.
+  
+  The connection is busy until the stream has been read to its end or closed.  Any
+  other query (or transaction change) submitted to the receiver in the meantime closes
+  the stream first, as does a subsequent executeStreamingQuery:.
+  
+  Returns nil if the query could not be sent; the error is pushed onto the receiver's
+  error stack.
+*/
+- (SBPostgresStreamingQueryResult*) executeStreamingQuery:(id)aQuery;
 
 @end
 
+/*!
+  @category SBPostgresDatabase(SBPostgresDatabaseAsync)
+  @discussion
+  This category groups methods of the SBPostgresDatabase class which submit queries without
+  waiting a full network round trip for each one.
+  
+  The executeQueries: method sends an entire batch of queries before reading any of their
+  results back.  With libpq 14 or newer this uses pipeline mode, and the batch costs a single
+  round trip.  Unless a transaction is already open the batch is wrapped in one of its own,
+  so a failing query causes the rest of the batch to be skipped and nothing is committed.
+  With older libpq the queries are executed one at a time, inside that same transaction.
+  
+  The sendQuery:target:selector: method queues a query and returns immediately; when its
+  result arrives, the target is sent the selector, which must have the form
+  
+    - (void) query:(SBPostgresQueryResult*)queryResult didCompleteForQuery:(id)aQuery
+  
+  The queryResult is nil if the query could not be sent.  Results are picked up by the same
+  run loop input source used for NOTIFY delivery, so the receiver must have been scheduled
+  with scheduleNotificationInRunLoop: (or the notificationRunLoop must be running); otherwise
+  send waitForPendingQueries.  Queries are sent one at a time in the order they were queued.
+  Any synchronous query sent to the receiver first waits for (and delivers) all queued
+  queries.  Queued queries are dropped if the receiver is deallocated.
+*/
+@interface SBPostgresDatabase(SBPostgresDatabaseAsync)
+
+/*!
+  @method sendQuery:target:selector:
+  
+  Queue aQuery (anything executeQuery: accepts) for asynchronous execution.  When it
+  completes, aSelector is sent to target with the SBPostgresQueryResult and aQuery as
+  arguments.  The target is retained until then.
+  
+  Returns NO if the connection is not open.
+*/
+- (BOOL) sendQuery:(id)aQuery target:(id)target selector:(SEL)aSelector;
+/*!
+  @method pendingQueryCount
+  
+  Returns the number of queued asynchronous queries whose results have not yet been
+  delivered.
+*/
+- (SBUInteger) pendingQueryCount;
+/*!
+  @method waitForPendingQueries
+  
+  Block until every queued asynchronous query has completed and its result has been
+  delivered.
+*/
+- (void) waitForPendingQueries;
+/*!
+  @method executeQueries:
+  
+  Execute every query in the queries array, pipelined where possible, and return an array
+  of their SBPostgresQueryResult objects in the same order.  SBNull stands in for any query
+  which produced no result at all.  Returns nil if the connection is not open, or if the
+  batch as a whole failed -- it couldn't be sent in full or its transaction couldn't be
+  committed -- in which case none of it took effect.
+*/
+- (SBArray*) executeQueries:(SBArray*)queries;
+/*!
+  @method executeQueriesWithBooleanResult:
+  
+  Execute every query in the queries array as an atomic batch (see executeQueries:) and
+  return YES if all of them succeeded.  Inside an open transaction the batch is wrapped in a
+  savepoint, so a failed batch doesn't abort the enclosing transaction.  Error messages for failed
+  queries are pushed onto the error stack.
+*/
+- (BOOL) executeQueriesWithBooleanResult:(SBArray*)queries;
+
+@end
+
+
+/*!
+  @category SBPostgresDatabase(SBPostgresDatabaseCopy)
+  @discussion
+  This category groups methods of the SBPostgresDatabase class which move bulk data with the
+  COPY command rather than one INSERT (or SELECT) per row.  The copyCommand in each case is
+  the full COPY statement, e.g.
+  
+    COPY collaboration.roleMember (roleId, userId) FROM STDIN
+    COPY (SELECT userId, shortName FROM users.base) TO STDOUT WITH CSV
+  
+  and the data is in whatever format that statement specifies (tab-delimited text by default).
+  
+  While a COPY FROM STDIN is in progress the connection can be used for nothing else; any
+  other query sent to the receiver aborts it first.
+*/
+@interface SBPostgresDatabase(SBPostgresDatabaseCopy)
+
+/*!
+  @method beginCopyInWithCommand:
+  
+  Execute copyCommand (a COPY ... FROM STDIN statement) and return an SBPostgresCopyIn object
+  to which the rows are then written.  Returns nil (with the error on the receiver's error
+  stack) if the server did not enter COPY IN mode.
+*/
+- (SBPostgresCopyIn*) beginCopyInWithCommand:(SBString*)copyCommand;
+/*!
+  @method copyDataFromInputStream:withCommand:
+  
+  Execute copyCommand (a COPY ... FROM STDIN statement) and feed it everything which can be
+  read from inputStream, in chunks, until the stream is at its end.  The stream is opened if
+  it is not already.
+  
+  Returns the number of rows copied, or -1 if the COPY failed (in which case no rows were
+  added).
+*/
+- (SBInteger) copyDataFromInputStream:(SBInputStream*)inputStream withCommand:(SBString*)copyCommand;
+/*!
+  @method copyDataToOutputStream:withCommand:
+  
+  Execute copyCommand (a COPY ... TO STDOUT statement) and write the data it produces to
+  outputStream as it arrives from the server.  The stream is opened if it is not already.
+  
+  Returns the number of rows copied, or -1 if the COPY failed.
+*/
+- (SBInteger) copyDataToOutputStream:(SBOutputStream*)outputStream withCommand:(SBString*)copyCommand;
+
+@end
 
 /*!
   @category SBPostgresDatabase(SBPostgresDatabaseNotification)
@@ -637,4 +851,245 @@ extern SBString *SBPostgresNotifierPayloadStringKey;
 */
 - (BOOL) getOidOfInsertedRow:(Oid*)anOid;
 
+/*!
+  @method getInt64Values:nullFlags:forFieldNum:
+  
+  Decodes every row of an integer (int2, int4, int8, oid) or boolean column directly into
+  values, which must have room for numberOfRows elements.  If nullFlags is not NULL, it
+  must be the same size and each element is set to YES where the column is NULL (the
+  corresponding element of values is set to zero).  No objects are created.
+  
+  Returns NO (and leaves both arrays untouched) if the column is not of a compatible type.
+*/
+- (BOOL) getInt64Values:(int64_t*)values nullFlags:(BOOL*)nullFlags forFieldNum:(SBUInteger)fieldNum;
+/*!
+  @method getDoubleValues:nullFlags:forFieldNum:
+  
+  Like getInt64Values:nullFlags:forFieldNum: but for float4 and float8 columns; integer
+  columns are also accepted and converted.
+*/
+- (BOOL) getDoubleValues:(double*)values nullFlags:(BOOL*)nullFlags forFieldNum:(SBUInteger)fieldNum;
+/*!
+  @method getBoolValues:nullFlags:forFieldNum:
+  
+  Like getInt64Values:nullFlags:forFieldNum: but for boolean columns.  NULL is decoded as
+  NO.
+*/
+- (BOOL) getBoolValues:(BOOL*)values nullFlags:(BOOL*)nullFlags forFieldNum:(SBUInteger)fieldNum;
+/*!
+  @method getUnixTimestampValues:nullFlags:forFieldNum:
+  
+  Like getInt64Values:nullFlags:forFieldNum: but for timestamp and timestamptz columns;
+  each value is converted to a UNIX timestamp (rounded down to the second).  Whether the
+  binary values are integer microseconds or floating-point seconds is taken from the
+  server's integer_datetimes setting.
+*/
+- (BOOL) getUnixTimestampValues:(time_t*)values nullFlags:(BOOL*)nullFlags forFieldNum:(SBUInteger)fieldNum;
+/*!
+  @method getUTF8Slices:forFieldNum:
+  
+  Fills slices (which must have room for numberOfRows elements) with borrowed references
+  to the UTF-8 text of every row of a text, varchar, bpchar or char column.  As
+  with objectForRow:fieldNum: trailing pad characters are trimmed from char values.  The
+  slices are only valid for as long as the receiver is.
+  
+  Returns NO if the column is not textual.
+*/
+- (BOOL) getUTF8Slices:(SBPostgresUTF8Slice*)slices forFieldNum:(SBUInteger)fieldNum;
+/*!
+  @method utf8ValueAtRow:fieldNum:length:
+  
+  Returns a borrowed pointer to the UTF-8 text in the given row and column of a textual
+  column (see getUTF8Slices:forFieldNum:) and sets length to its byte length.  Returns
+  NULL if the value is NULL or the column is not textual.
+*/
+- (const char*) utf8ValueAtRow:(SBUInteger)row fieldNum:(SBUInteger)fieldNum length:(SBUInteger*)length;
+
+@end
+
+/*!
+  @class SBPostgresStreamingQueryResult
+  @discussion
+  Instances of SBPostgresStreamingQueryResult are returned by the executeStreamingQuery:
+  method of SBPostgresDatabase.  Rather than the entire result set, an instance holds
+  just the row most recently read from the server.  Send nextRow to advance to the
+  first (and each subsequent) row; once it returns NO the stream is finished and
+  queryWasSuccessful and queryErrorString report the outcome of the query.
+  
+  The current row can be accessed through the currentRow query result (at the row
+  index given by currentRowIndex) or with the convenience methods below which work
+  on it.  Objects obtained from a row remain valid after the stream advances, but
+  pointers obtained from the currentRow's getValuePointer:atRow:fieldNum: do not.
+  
+  With libpq versions that lack single-row mode (before 9.2) the query is executed in
+  full when the first row is requested and the rows are walked from that result.
+*/
+@interface SBPostgresStreamingQueryResult : SBObject
+{
+  SBPostgresDatabase*     _parentDatabase;
+  SBPostgresQueryResult*  _currentResult;
+  SBUInteger              _currentRowIndex;
+  SBPostgresQueryResult*  _finalResult;
+  SBUInteger              _rowCount;
+  struct {
+    unsigned int  isFinished : 1;
+    unsigned int  wasInterrupted : 1;
+  } _flags;
+}
+
+/*!
+  @method nextRow
+  
+  Advance to the next row of the result, waiting for the server to produce it if
+  necessary.  Returns NO once all rows have been read (or the query failed or the
+  stream was closed).
+*/
+- (BOOL) nextRow;
+/*!
+  @method rowCount
+  
+  Returns the number of rows read from the stream so far.
+*/
+- (SBUInteger) rowCount;
+/*!
+  @method isFinished
+  
+  Returns YES once the stream has been read to its end or closed.
+*/
+- (BOOL) isFinished;
+/*!
+  @method queryWasSuccessful
+  
+  Returns NO if the server reported an error or the stream was closed before it had
+  been read to its end.  While rows are still being read, returns YES.
+*/
+- (BOOL) queryWasSuccessful;
+/*!
+  @method queryErrorString
+  
+  If the query failed, returns a string with the error description.  Otherwise,
+  returns nil.
+*/
+- (SBString*) queryErrorString;
+/*!
+  @method currentRow
+  
+  Returns the query result which holds the current row, or nil if there is no current
+  row.  The current row is at index currentRowIndex within it.
+*/
+- (SBPostgresQueryResult*) currentRow;
+/*!
+  @method currentRowIndex
+  
+  Returns the index of the current row within the currentRow query result.  In
+  single-row mode this is always zero.
+*/
+- (SBUInteger) currentRowIndex;
+/*!
+  @method numberOfFields
+  
+  Returns the number of columns in the current row.
+*/
+- (SBUInteger) numberOfFields;
+/*!
+  @method fieldNumberWithName:
+  
+  Returns the index of the named column, or SBNotFound.
+*/
+- (SBUInteger) fieldNumberWithName:(SBString*)fieldName;
+/*!
+  @method isNullValueAtFieldNum:
+  
+  Returns YES if the given column of the current row is NULL.
+*/
+- (BOOL) isNullValueAtFieldNum:(SBUInteger)fieldNum;
+/*!
+  @method objectForFieldNum:
+  
+  Returns an object wrapping the value in the given column of the current row, exactly
+  as objectForRow:fieldNum: would for a fully-materialized result.
+*/
+- (id) objectForFieldNum:(SBUInteger)fieldNum;
+/*!
+  @method arrayForCurrentRow
+  
+  Returns an array containing the objects for all columns of the current row.
+*/
+- (SBArray*) arrayForCurrentRow;
+/*!
+  @method rowEnumerator
+  
+  Returns an SBEnumerator which advances the receiver and returns the
+  arrayForCurrentRow for each remaining row.
+*/
+- (SBEnumerator*) rowEnumerator;
+/*!
+  @method close
+  
+  Stop reading the result.  If rows remain, the query is cancelled on the server and
+  whatever it had already sent is discarded.  Inside a transaction the remaining rows
+  are read and discarded instead, since a cancelled query would abort the transaction.
+*/
+- (void) close;
+
+@end
+
+/*!
+  @class SBPostgresCopyIn
+  @discussion
+  Instances of SBPostgresCopyIn are returned by the beginCopyInWithCommand: method of
+  SBPostgresDatabase and feed rows to a COPY FROM STDIN which is in progress.  Data is
+  buffered and handed to the server in large chunks.
+  
+  Rows can be appended either as arrays of objects, which are formatted for COPY's default
+  (tab-delimited text) format, or as raw bytes already in whatever format the COPY command
+  specified.  Send finish once all rows have been appended; nothing is added to the table
+  unless the COPY finishes successfully.  An instance which is deallocated before it is
+  finished aborts the COPY.
+*/
+@interface SBPostgresCopyIn : SBObject
+{
+  SBPostgresDatabase*   _parentDatabase;
+  char*                 _buffer;
+  SBUInteger            _length, _capacity;
+  struct {
+    unsigned int  isFinished : 1;
+    unsigned int  hasFailed : 1;
+  } _flags;
+}
+
+/*!
+  @method appendRow:
+  
+  Append a row to the COPY in its default text format.  Each element of values becomes
+  one column:  SBNull is written as a NULL, SBData as a bytea hex string, SBString as-is
+  and any other object which responds to stringValue as that string.  Tabs, newlines and
+  backslashes are escaped.
+  
+  Returns NO if an object could not be formatted or the data could not be sent.
+*/
+- (BOOL) appendRow:(SBArray*)values;
+/*!
+  @method appendBytes:length:
+  
+  Append raw COPY data.  The bytes need not end on a row boundary.
+  
+  Returns NO if the data could not be sent.
+*/
+- (BOOL) appendBytes:(const void*)bytes length:(SBUInteger)length;
+/*!
+  @method finish
+  
+  Send any buffered data and end the COPY.  Returns the number of rows copied, or -1 if the
+  COPY failed (with the error on the database's error stack).
+*/
+- (SBInteger) finish;
+/*!
+  @method abortWithMessage:
+  
+  Abort the COPY; no rows are added.  The reason is reported by the server as the error
+  message for the COPY command.
+*/
+- (void) abortWithMessage:(SBString*)reason;
+
 @end
@@ -28,6 +28,10 @@
 #import "SBPostgresAdditions.h"
 #include "SBPostgresPrivate.h"
 
+#include <ctype.h>
+#include <strings.h>
+#include <math.h>
+
 typedef struct {
 #if defined(HAVE_INT64_TIMESTAMP)
   int64_t       time;
@@ -194,6 +198,313 @@ SBPostgresTimeTZ2DateComponents(
 static SBString* SBPostgresPreparedQueryUnprepare = @"SBPostgres::unprepare";
 static SBString* SBPostgresPreparedQueryReference = @"SBPostgres::queryReference";
 
+//
+// Statement names are built from these prefixes and a per-connection counter:
+//
+#define SBPostgresPreparedStatementPrefix   "SBPostgresPreparedQuery"
+#define SBPostgresCachedStatementPrefix     "SBPostgresCachedQuery"
+#define SBPostgresStatementNameLength       48
+
+//
+// Maximum number of integer literals which will be turned into parameters when an SBString
+// query is put in the statement cache:
+//
+#define SBPostgresMaxAutoParameters         32
+
+//
+// A statement is only prepared the second time its text is seen; texts seen just once are
+// remembered in a set of sightings which is emptied whenever it grows past this multiple of
+// the statement cache size:
+//
+#define SBPostgresStatementSightingsFactor  4
+
+//
+// Size of the buffer COPY data is gathered into before it is handed to libpq:
+//
+#define SBPostgresCopyBufferSize            (64 * 1024)
+
+//
+// Decode a single binary-format integer or boolean value into an int64_t without
+// touching the PGresult's copy of the value (objectForRow:fieldNum: swaps some types
+// in-place):
+//
+static inline int64_t
+__SBPostgresDecodeInteger(
+  Oid               pgType,
+  char*             value
+)
+{
+  switch ( pgType ) {
+  
+    case BOOLOID:
+      return ( *value != 0 );
+      
+    case INT2OID: {
+      int16_t       v;
+      
+      SBByteSwapFromNetwork(value, sizeof(int16_t), &v);
+      return (int64_t)v;
+    }
+    
+    case INT4OID: {
+      int32_t       v;
+      
+      SBByteSwapFromNetwork(value, sizeof(int32_t), &v);
+      return (int64_t)v;
+    }
+    
+    case OIDOID: {
+      uint32_t      v;
+      
+      SBByteSwapFromNetwork(value, sizeof(uint32_t), &v);
+      return (int64_t)v;
+    }
+    
+    case INT8OID: {
+      int64_t       v;
+      
+      SBByteSwapFromNetwork(value, sizeof(int64_t), &v);
+      return v;
+    }
+    
+  }
+  return 0;
+}
+
+static inline void
+__SBPostgresStatementName(
+  char*             buffer,
+  const char*       prefix,
+  unsigned int      statementId
+)
+{
+  snprintf(buffer, SBPostgresStatementNameLength, "%s0x%08X", prefix, statementId);
+}
+
+//
+
+static inline SBUInteger
+__SBPostgresPointerHash(
+  id                object
+)
+{
+  uintptr_t         h = (uintptr_t)object;
+  
+  h ^= (h >> 16);
+  h *= 0x45d9f3b;
+  h ^= (h >> 16);
+  return (SBUInteger)h;
+}
+
+//
+
+#if PG_VERSION_NUM >= 140000
+
+static PGresult*
+__SBPostgresNextPipelineResult(
+  PGconn*           connection
+)
+{
+  PGresult*         pgResult = PQgetResult(connection);
+  
+  if ( pgResult ) {
+    PGresult*       extra;
+    
+    // Each pipelined query's results end with a NULL:
+    while ( (extra = PQgetResult(connection)) )
+      PQclear(extra);
+  }
+  return pgResult;
+}
+
+#endif
+
+//
+
+static inline BOOL
+__SBPostgresIsIdentifierChar(
+  char              c
+)
+{
+  return ( isalnum((unsigned char)c) || (c == '_') || (c & 0x80) );
+}
+
+//
+
+static BOOL
+__SBPostgresIsPreparableStatement(
+  const char*       query
+)
+{
+  static const char*  keywords[] = { "SELECT", "INSERT", "UPDATE", "DELETE", "WITH", "VALUES", NULL };
+  const char*         s = query;
+  size_t              len = 0;
+  int                 i = 0;
+  
+  //
+  // Only these statements can be PREPAREd; anything else (SET, LISTEN, BEGIN...) isn't
+  // worth a slot in the statement cache:
+  //
+  while ( isspace((unsigned char)*s) || (*s == '(') )
+    s++;
+  while ( __SBPostgresIsIdentifierChar(s[len]) )
+    len++;
+  while ( keywords[i] ) {
+    if ( (strlen(keywords[i]) == len) && (strncasecmp(s, keywords[i], len) == 0) )
+      return YES;
+    i++;
+  }
+  return NO;
+}
+
+//
+
+static int
+__SBPostgresParameterizeQuery(
+  const char*       query,
+  char*             outQuery,
+  char*             outValues,
+  const char**      paramValues
+)
+{
+  const char*       s = query;
+  char*             d = outQuery;
+  char*             v = outValues;
+  int               paramCount = 0;
+  int               depth = 0;
+  unsigned int      listDepths = 0;
+  BOOL              afterListKeyword = NO;
+  char              lastSig = '\0', prevSig = '\0';
+  
+  //
+  // Copy the query to outQuery, replacing integer literals which are compared against or
+  // which are elements of a VALUES or IN list with $1, $2, ... and copying the literals
+  // themselves (NUL-terminated) to outValues.  Quoted identifiers and comments are copied
+  // through untouched.  Returns the number of parameters, or -1 if the query should not be
+  // handled this way -- which includes any query containing a string literal:  those
+  // aren't turned into parameters, so a query formatted with one (e.g. "WHERE shortname =
+  // '...'") would otherwise take a cache slot of its own for every distinct value.
+  //
+  // outQuery must have room for strlen(query) + 3 * SBPostgresMaxAutoParameters + 1 bytes,
+  // outValues for strlen(query) + SBPostgresMaxAutoParameters bytes.
+  //
+  if ( ! __SBPostgresIsPreparableStatement(query) )
+    return -1;
+  
+  while ( *s ) {
+    char            c = *s;
+    
+    if ( isspace((unsigned char)c) ) {
+      *d++ = *s++;
+      continue;
+    }
+    
+    if ( c == '\'' )
+      return -1;
+    
+    if ( c == '"' ) {
+      *d++ = *s++;
+      while ( 1 ) {
+        if ( ! *s )
+          return -1;
+        c = *d++ = *s++;
+        if ( c == '"' ) {
+          if ( *s != '"' )
+            break;
+          *d++ = *s++;
+        }
+      }
+      prevSig = lastSig; lastSig = '"';
+      afterListKeyword = NO;
+      continue;
+    }
+    
+    if ( (c == '-') && (s[1] == '-') ) {
+      while ( *s && (*s != '\n') )
+        *d++ = *s++;
+      continue;
+    }
+    if ( (c == '/') && (s[1] == '*') ) {
+      *d++ = *s++;
+      *d++ = *s++;
+      while ( *s && ! ((s[0] == '*') && (s[1] == '/')) )
+        *d++ = *s++;
+      if ( ! *s )
+        return -1;
+      *d++ = *s++;
+      *d++ = *s++;
+      continue;
+    }
+    
+    if ( c == '$' ) {
+      // Existing parameters or dollar-quoting:  leave the query alone.
+      return -1;
+    }
+    
+    if ( isalpha((unsigned char)c) || (c == '_') || (c & 0x80) ) {
+      const char*   word = s;
+      
+      while ( __SBPostgresIsIdentifierChar(*s) || (*s == '$') )
+        *d++ = *s++;
+      afterListKeyword = ( ((s - word == 6) && (strncasecmp(word, "VALUES", 6) == 0)) || ((s - word == 2) && (strncasecmp(word, "IN", 2) == 0)) );
+      prevSig = lastSig; lastSig = s[-1];
+      continue;
+    }
+    
+    if ( isdigit((unsigned char)c) ) {
+      const char*   literal = s;
+      BOOL          isParameter;
+      
+      while ( isdigit((unsigned char)*s) )
+        s++;
+      isParameter = ( (literal == query) || (literal[-1] != '.') ) && (*s != '.') && ! __SBPostgresIsIdentifierChar(*s);
+      if ( isParameter ) {
+        if ( (lastSig == '=') || (lastSig == '<') || ((lastSig == '>') && (prevSig != '-') && (prevSig != '#')) ) {
+          // Comparison operand
+        } else if ( ((lastSig == '(') || (lastSig == ',')) && (depth > 0) && (depth < 32) && (listDepths & (1U << depth)) ) {
+          // VALUES or IN list element
+        } else {
+          isParameter = NO;
+        }
+      }
+      if ( isParameter ) {
+        if ( paramCount == SBPostgresMaxAutoParameters )
+          return -1;
+        paramValues[paramCount++] = v;
+        memcpy(v, literal, s - literal);
+        v += (s - literal);
+        *v++ = '\0';
+        d += sprintf(d, "$%d", paramCount);
+      } else {
+        memcpy(d, literal, s - literal);
+        d += (s - literal);
+      }
+      prevSig = lastSig; lastSig = '0';
+      afterListKeyword = NO;
+      continue;
+    }
+    
+    if ( c == '(' ) {
+      depth++;
+      if ( (depth > 0) && (depth < 32) ) {
+        if ( afterListKeyword )
+          listDepths |= (1U << depth);
+        else
+          listDepths &= ~(1U << depth);
+      }
+    } else if ( c == ')' ) {
+      if ( (depth > 0) && (depth < 32) )
+        listDepths &= ~(1U << depth);
+      depth--;
+    }
+    *d++ = *s++;
+    prevSig = lastSig; lastSig = c;
+    afterListKeyword = NO;
+  }
+  *d = '\0';
+  return paramCount;
+}
+
 //
 #pragma mark -
 //
@@ -229,13 +540,11 @@ static SBString* SBPostgresPreparedQueryReference = @"SBPostgres::queryReference
         SBString*   names[cols];
         int         i = cols;
         
+        // The same handful of column names come back query after query:
         while ( i-- )
-          names[i] = [[SBString alloc] initWithUTF8String:PQfname(_queryResult, i)];
+          names[i] = [SBString internedStringWithUTF8String:PQfname(_queryResult, i)];
         
         _fieldNames = [[SBArray arrayWithObjects:names count:cols] retain];
-        
-        while ( cols-- )
-          [names[cols] release];
       }
     }
     return ( _fieldNames != nil );
@@ -247,15 +556,207 @@ static SBString* SBPostgresPreparedQueryReference = @"SBPostgres::queryReference
 #pragma mark -
 //
 
+@interface SBPostgresStreamingQueryResult(SBPostgresStreamingQueryResultPrivate)
+
+- (id) initWithDatabase:(SBPostgresDatabase*)database;
+- (void) finishStreamByCancelling:(BOOL)shouldCancel;
+
+@end
+
+//
+
+@interface SBPostgresCopyIn(SBPostgresCopyInPrivate)
+
+- (id) initWithDatabase:(SBPostgresDatabase*)database;
+- (BOOL) flushBuffer;
+- (BOOL) ensureBufferSpace:(SBUInteger)length;
+- (void) endCopyWithError:(const char*)errorMsg;
+
+@end
+
+//
+
+@interface SBPostgresStreamingRowEnumerator : SBEnumerator
+{
+  SBPostgresStreamingQueryResult*   _stream;
+}
+
+- (id) initWithStreamingQueryResult:(SBPostgresStreamingQueryResult*)aStream;
+
+@end
+
+@implementation SBPostgresStreamingRowEnumerator
+
+  - (id) initWithStreamingQueryResult:(SBPostgresStreamingQueryResult*)aStream
+  {
+    if ( self = [super init] ) {
+      _stream = [aStream retain];
+    }
+    return self;
+  }
+
+//
+
+  - (void) dealloc
+  {
+    if ( _stream ) [_stream release];
+    [super dealloc];
+  }
+
+//
+
+  - (id) nextObject
+  {
+    if ( _stream ) {
+      if ( [_stream nextRow] )
+        return [_stream arrayForCurrentRow];
+      [_stream release];
+      _stream = nil;
+    }
+    return nil;
+  }
+
+@end
+
+//
+#pragma mark -
+//
+
+@interface SBPostgresCachedStatement : SBObject
+{
+  unsigned int    _statementId;
+  SBUInteger      _lastUsed;
+  BOOL            _isPrepared;
+}
+
+- (id) initWithStatementId:(unsigned int)statementId isPrepared:(BOOL)isPrepared;
+- (unsigned int) statementId;
+- (BOOL) isPrepared;
+- (SBUInteger) lastUsed;
+- (void) setLastUsed:(SBUInteger)lastUsed;
+
+@end
+
+@implementation SBPostgresCachedStatement
+
+  - (id) initWithStatementId:(unsigned int)statementId
+    isPrepared:(BOOL)isPrepared
+  {
+    if ( self = [super init] ) {
+      _statementId = statementId;
+      _isPrepared = isPrepared;
+    }
+    return self;
+  }
+
+//
+
+  - (unsigned int) statementId { return _statementId; }
+  - (BOOL) isPrepared { return _isPrepared; }
+  - (SBUInteger) lastUsed { return _lastUsed; }
+  - (void) setLastUsed:(SBUInteger)lastUsed { _lastUsed = lastUsed; }
+
+@end
+
+//
+#pragma mark -
+//
+
+@interface SBPostgresAsyncQuery : SBObject
+{
+  id              _query;
+  id              _target;
+  SEL             _selector;
+}
+
+- (id) initWithQuery:(id)aQuery target:(id)target selector:(SEL)aSelector;
+- (id) query;
+- (void) deliverResult:(SBPostgresQueryResult*)queryResult fromDatabase:(SBPostgresDatabase*)database;
+
+@end
+
+@implementation SBPostgresAsyncQuery
+
+  - (id) initWithQuery:(id)aQuery
+    target:(id)target
+    selector:(SEL)aSelector
+  {
+    if ( self = [super init] ) {
+      _query = [aQuery retain];
+      _target = ( target ? [target retain] : nil );
+      _selector = aSelector;
+    }
+    return self;
+  }
+
+//
+
+  - (void) dealloc
+  {
+    if ( _query ) [_query release];
+    if ( _target ) [_target release];
+    [super dealloc];
+  }
+
+//
+
+  - (id) query
+  {
+    return _query;
+  }
+
+//
+
+  - (void) deliverResult:(SBPostgresQueryResult*)queryResult
+    fromDatabase:(SBPostgresDatabase*)database
+  {
+    if ( _target && _selector ) {
+      SBAutoreleasePool*    pool = [[SBAutoreleasePool alloc] init];
+      
+      [_target perform:_selector with:queryResult with:_query];
+      [pool release];
+    }
+  }
+
+@end
+
+//
+#pragma mark -
+//
+
 @interface SBPostgresDatabase(SBPostgresDatabasePrivate)
 
 - (BOOL) setPostgresClientProperties;
 - (BOOL) setPostgresSchemaSearchPath;
 - (BOOL) prepareQuery:(SBPostgresQuery*)aQuery statementName:(const char*)statementName;
 - (PGresult*) baseExecuteQuery:(id)aQuery;
+- (BOOL) baseSendQuery:(id)aQuery;
+
+- (void) finishPendingResults;
+- (void) closeStreamingResult;
+- (void) copyInDidFinish:(SBPostgresCopyIn*)aCopyIn;
+- (void) pushErrorMessage:(const char*)errorMsg;
+- (void) streamingResultDidFinish:(SBPostgresStreamingQueryResult*)aStream;
+- (BOOL) isInTransaction;
+- (BOOL) hasIntegerDatetimes;
+
+- (void) resolveTypeOidsForQueries:(SBArray*)queries;
+- (void) sendNextAsyncQuery;
+- (BOOL) completeAsyncQueryByWaiting:(BOOL)shouldWait;
 
 - (void) preparedQueryWasUnprepared:(SBNotification*)aNotify;
 
+- (BOOL) getStatementId:(unsigned int*)statementId forPreparedQuery:(id)aQuery;
+- (void) addPreparedQuery:(id)aQuery statementId:(unsigned int)statementId;
+- (void) removePreparedQuery:(id)aQuery;
+- (void) removeAllPreparedQueries;
+
+- (void) substituteTypeOidsForQuery:(SBPostgresQuery*)aQuery;
+- (PGresult*) executeCachedStatementWithKey:(SBString*)key queryString:(const char*)queryString parameterCount:(int)parameterCount paramOids:(const Oid*)paramOids paramValues:(const char* const*)paramValues paramLengths:(const int*)paramLengths paramFormats:(const int*)paramFormats;
+- (PGresult*) executeCachedStatementForQuery:(SBPostgresQuery*)aQuery;
+- (PGresult*) executeCachedStatementForString:(const char*)queryString;
+- (void) trimStatementCacheToSize:(SBUInteger)cacheSize;
+
 - (void) processPGNotifications;
 
 @end
@@ -283,6 +784,20 @@ static SBString* SBPostgresPreparedQueryReference = @"SBPostgres::queryReference
     return rc;
   }
   
+//
+
+  - (BOOL) hasIntegerDatetimes
+  {
+    const char*   setting = ( _databaseConnection ? PQparameterStatus(_databaseConnection, "integer_datetimes") : NULL );
+    
+    //
+    // Whether binary timestamps are int64 microseconds or double seconds is up to the
+    // server, which reports it when the connection is made; integers have been the
+    // default since 8.4 and the only choice since 10:
+    //
+    return ( setting ? (strcmp(setting, "on") == 0) : YES );
+  }
+  
 //
 
   - (BOOL) setPostgresSchemaSearchPath
@@ -302,6 +817,7 @@ static SBString* SBPostgresPreparedQueryReference = @"SBPostgres::queryReference
         }
       }
       
+      [self finishPendingResults];
       if ( command ) {
         SBSTRING_AS_UTF8_BEGIN(command)
         
@@ -338,22 +854,15 @@ static SBString* SBPostgresPreparedQueryReference = @"SBPostgres::queryReference
   {
     BOOL          result = NO;
     PGresult*     prepResult;
-    Oid*          paramOids = [aQuery paramOids];
-    Class*        paramClasses = [aQuery paramClasses];
-    unsigned int  i = 0, iMax = [aQuery parameterCount];
     
-    // Check for any Oid subs:
-    while ( i < iMax ) {
-      if ( paramClasses[i] == [SBNotorization class] )
-        paramOids[i] = [self typeOidForTypeName:@"notorization"];
-      i++;
-    }
+    [self substituteTypeOidsForQuery:aQuery];
+    [self finishPendingResults];
     prepResult = PQprepare(
                       _databaseConnection,
                       statementName,
                       [aQuery queryString],
-                      iMax,
-                      paramOids
+                      [aQuery parameterCount],
+                      [aQuery paramOids]
                     );
     if ( prepResult ) {
       result = ( PQresultStatus(prepResult) == PGRES_COMMAND_OK );
@@ -367,38 +876,367 @@ static SBString* SBPostgresPreparedQueryReference = @"SBPostgres::queryReference
   - (void) preparedQueryWasUnprepared:(SBNotification*)aNotify
   {
     id              preparedQuery = [[aNotify userInfo] objectForKey:SBPostgresPreparedQueryReference];
-    unsigned int    index = [_preparedQueries indexOfObjectIdenticalTo:preparedQuery];
     
-    if ( index != SBNotFound ) {
-      [_preparedQueries replaceObject:[SBNull null] atIndex:index];
-    }
+    if ( preparedQuery )
+      [self removePreparedQuery:preparedQuery];
   }
+  
+//
 
+  - (BOOL) getStatementId:(unsigned int*)statementId
+    forPreparedQuery:(id)aQuery
+  {
+    if ( _preparedQueryCount ) {
+      SBUInteger    mask = _preparedQueryCapacity - 1;
+      SBUInteger    i = __SBPostgresPointerHash(aQuery) & mask;
+      
+      while ( _preparedQueries[i].query ) {
+        if ( _preparedQueries[i].query == aQuery ) {
+          *statementId = _preparedQueries[i].statementId;
+          return YES;
+        }
+        i = (i + 1) & mask;
+      }
+    }
+    return NO;
+  }
+  
 //
 
-  - (PGresult*) baseExecuteQuery:(id)aQuery
+  - (void) addPreparedQuery:(id)aQuery
+    statementId:(unsigned int)statementId
   {
-    id          queryResult = nil;
-    PGresult*   pgResult = NULL;
+    SBUInteger      mask, i;
     
-    if ( [aQuery isKindOf:[SBPostgresQuery class]] ) {
-      unsigned int      queryIdx = SBNotFound;
+    //
+    // Open addressing with linear probing, kept no more than half full:
+    //
+    if ( 2 * (_preparedQueryCount + 1) > _preparedQueryCapacity ) {
+      SBPostgresPreparedStatement*  oldTable = _preparedQueries;
+      SBUInteger                    oldCapacity = _preparedQueryCapacity;
+      SBUInteger                    newCapacity = ( oldCapacity ? 2 * oldCapacity : 16 );
+      SBPostgresPreparedStatement*  newTable = objc_calloc(newCapacity, sizeof(SBPostgresPreparedStatement));
       
-      //
-      // It's a query object; do we have it on record as having been
-      // handed to PQprepare()?
-      //
-      if ( _preparedQueries && ((queryIdx = [_preparedQueries indexOfObjectIdenticalTo:aQuery]) != SBNotFound) ) {
-        char            statementName[40];
-        
-        snprintf(
-            statementName,
-            40,
-            "SBPostgresPreparedQuery0x08X",
-            queryIdx
-          );
-        pgResult = PQexecPrepared(
-                        _databaseConnection,
+      if ( ! newTable )
+        return;
+      mask = newCapacity - 1;
+      for ( i = 0; i < oldCapacity; i++ ) {
+        if ( oldTable[i].query ) {
+          SBUInteger    j = __SBPostgresPointerHash(oldTable[i].query) & mask;
+          
+          while ( newTable[j].query )
+            j = (j + 1) & mask;
+          newTable[j] = oldTable[i];
+        }
+      }
+      if ( oldTable ) objc_free(oldTable);
+      _preparedQueries = newTable;
+      _preparedQueryCapacity = newCapacity;
+    }
+    mask = _preparedQueryCapacity - 1;
+    i = __SBPostgresPointerHash(aQuery) & mask;
+    while ( _preparedQueries[i].query )
+      i = (i + 1) & mask;
+    _preparedQueries[i].query = [aQuery retain];
+    _preparedQueries[i].statementId = statementId;
+    _preparedQueryCount++;
+  }
+  
+//
+
+  - (void) removePreparedQuery:(id)aQuery
+  {
+    if ( _preparedQueryCount ) {
+      SBUInteger    mask = _preparedQueryCapacity - 1;
+      SBUInteger    i = __SBPostgresPointerHash(aQuery) & mask;
+      
+      while ( _preparedQueries[i].query ) {
+        if ( _preparedQueries[i].query == aQuery ) {
+          SBUInteger  j = i;
+          
+          [_preparedQueries[i].query release];
+          _preparedQueryCount--;
+          //
+          // Shift any following entries of the probe sequence back into the hole
+          // so that lookups don't stop short:
+          //
+          while ( 1 ) {
+            SBUInteger  k;
+            
+            j = (j + 1) & mask;
+            if ( ! _preparedQueries[j].query )
+              break;
+            k = __SBPostgresPointerHash(_preparedQueries[j].query) & mask;
+            if ( (i <= j) ? ((i < k) && (k <= j)) : ((i < k) || (k <= j)) )
+              continue;
+            _preparedQueries[i] = _preparedQueries[j];
+            i = j;
+          }
+          _preparedQueries[i].query = nil;
+          _preparedQueries[i].statementId = 0;
+          return;
+        }
+        i = (i + 1) & mask;
+      }
+    }
+  }
+  
+//
+
+  - (void) removeAllPreparedQueries
+  {
+    if ( _preparedQueries ) {
+      SBUInteger    i = _preparedQueryCapacity;
+      
+      while ( i-- ) {
+        if ( _preparedQueries[i].query )
+          [_preparedQueries[i].query release];
+      }
+      objc_free(_preparedQueries);
+      _preparedQueries = NULL;
+    }
+    _preparedQueryCount = _preparedQueryCapacity = 0;
+    if ( _statementCache )
+      [_statementCache removeAllObjects];
+    if ( _statementSightings )
+      [_statementSightings removeAllObjects];
+  }
+  
+//
+
+  - (void) substituteTypeOidsForQuery:(SBPostgresQuery*)aQuery
+  {
+    Oid*          paramOids = [aQuery paramOids];
+    Class*        paramClasses = [aQuery paramClasses];
+    unsigned int  i = 0, iMax = [aQuery parameterCount];
+    
+    // Check for any Oid subs:
+    while ( i < iMax ) {
+      if ( paramClasses[i] == [SBNotorization class] )
+        paramOids[i] = [self typeOidForTypeName:@"notorization"];
+      i++;
+    }
+  }
+  
+//
+
+  - (PGresult*) executeCachedStatementWithKey:(SBString*)key
+    queryString:(const char*)queryString
+    parameterCount:(int)parameterCount
+    paramOids:(const Oid*)paramOids
+    paramValues:(const char* const*)paramValues
+    paramLengths:(const int*)paramLengths
+    paramFormats:(const int*)paramFormats
+  {
+    SBPostgresCachedStatement*    statement = [_statementCache objectForKey:key];
+    char                          statementName[SBPostgresStatementNameLength];
+    
+    if ( ! statement ) {
+      PGTransactionStatusType     txnStatus = PQtransactionStatus(_databaseConnection);
+      PGresult*                   prepResult;
+      BOOL                        isPrepared;
+      
+      // Nothing can be prepared inside a failed transaction; try again next time:
+      if ( txnStatus == PQTRANS_INERROR )
+        return NULL;
+      
+      //
+      // A one-off statement would cost a PREPARE (and eventually a DEALLOCATE) on top of
+      // its execution and push a statement that is used over and over out of the cache,
+      // so the first sighting of a key just gets noted:
+      //
+      if ( ! [_statementSightings objectForKey:key] ) {
+        if ( ! _statementSightings )
+          _statementSightings = [[SBMutableDictionary alloc] init];
+        else if ( [_statementSightings count] >= SBPostgresStatementSightingsFactor * _statementCacheSize )
+          [_statementSightings removeAllObjects];
+        [_statementSightings setObject:key forKey:key];
+        return NULL;
+      }
+      [_statementSightings removeObjectForKey:key];
+      
+      if ( [_statementCache count] >= _statementCacheSize )
+        [self trimStatementCacheToSize:_statementCacheSize - 1];
+      
+      //
+      // A failed PREPARE inside a transaction would abort it, so it gets a savepoint of
+      // its own (the prepared statement itself is not affected by rolling back):
+      //
+      if ( txnStatus == PQTRANS_INTRANS ) {
+        if ( (prepResult = PQexec(_databaseConnection, "SAVEPOINT \"SBPostgresStatementCache\"")) )
+          PQclear(prepResult);
+      }
+      __SBPostgresStatementName(statementName, SBPostgresCachedStatementPrefix, ++_statementCounter);
+      prepResult = PQprepare(_databaseConnection, statementName, queryString, parameterCount, paramOids);
+      isPrepared = ( prepResult && (PQresultStatus(prepResult) == PGRES_COMMAND_OK) );
+      if ( prepResult ) PQclear(prepResult);
+      if ( txnStatus == PQTRANS_INTRANS ) {
+        if ( (prepResult = PQexec(_databaseConnection, ( isPrepared ? "RELEASE SAVEPOINT \"SBPostgresStatementCache\"" : "ROLLBACK TO SAVEPOINT \"SBPostgresStatementCache\"" ))) )
+          PQclear(prepResult);
+      }
+      
+      //
+      // A statement the server wouldn't prepare is remembered, too, so that it isn't
+      // attempted again:
+      //
+      if ( (statement = [[SBPostgresCachedStatement alloc] initWithStatementId:_statementCounter isPrepared:isPrepared]) ) {
+        [_statementCache setObject:statement forKey:key];
+        [statement release];
+      }
+    }
+    if ( statement ) {
+      [statement setLastUsed:++_statementCacheClock];
+      if ( [statement isPrepared] ) {
+        __SBPostgresStatementName(statementName, SBPostgresCachedStatementPrefix, [statement statementId]);
+        return PQexecPrepared(
+                        _databaseConnection,
+                        statementName,
+                        parameterCount,
+                        paramValues,
+                        paramLengths,
+                        paramFormats,
+                        1
+                      );
+      }
+    }
+    return NULL;
+  }
+  
+//
+
+  - (PGresult*) executeCachedStatementForQuery:(SBPostgresQuery*)aQuery
+  {
+    PGresult*       pgResult = NULL;
+    const char*     queryString = [aQuery queryString];
+    
+    if ( __SBPostgresIsPreparableStatement(queryString) ) {
+      SBUInteger    i = 0, iMax = [aQuery parameterCount];
+      Oid*          paramOids = [aQuery paramOids];
+      size_t        queryLen = strlen(queryString);
+      char*         keyBuffer = objc_malloc(queryLen + 12 * iMax + 2);
+      
+      //
+      // The statement is planned for the parameter types, so they're part of the key
+      // (which also keeps these keys distinct from those of SBString queries):
+      //
+      if ( keyBuffer ) {
+        char*       k = keyBuffer + queryLen;
+        SBString*   key;
+        
+        memcpy(keyBuffer, queryString, queryLen);
+        *k++ = '\x1f';
+        while ( i < iMax )
+          k += sprintf(k, "%u,", (unsigned int)paramOids[i++]);
+        *k = '\0';
+        if ( (key = [[SBString alloc] initWithUTF8String:keyBuffer]) ) {
+          pgResult = [self executeCachedStatementWithKey:key
+                            queryString:queryString
+                            parameterCount:iMax
+                            paramOids:paramOids
+                            paramValues:[aQuery paramValues]
+                            paramLengths:[aQuery paramLengths]
+                            paramFormats:[aQuery paramFormats]
+                          ];
+          [key release];
+        }
+        objc_free(keyBuffer);
+      }
+    }
+    return pgResult;
+  }
+  
+//
+
+  - (PGresult*) executeCachedStatementForString:(const char*)queryString
+  {
+    PGresult*       pgResult = NULL;
+    size_t          queryLen = strlen(queryString);
+    char*           parameterized = objc_malloc(queryLen + 3 * SBPostgresMaxAutoParameters + 1);
+    char*           values = objc_malloc(queryLen + SBPostgresMaxAutoParameters);
+    
+    if ( parameterized && values ) {
+      const char*   paramValues[SBPostgresMaxAutoParameters];
+      int           paramCount = __SBPostgresParameterizeQuery(queryString, parameterized, values, paramValues);
+      
+      if ( paramCount >= 0 ) {
+        SBString*   key = [[SBString alloc] initWithUTF8String:parameterized];
+        
+        //
+        // The literals go over as text with no declared type, leaving the server to
+        // infer the type of each parameter from its context:
+        //
+        if ( key ) {
+          pgResult = [self executeCachedStatementWithKey:key
+                            queryString:parameterized
+                            parameterCount:paramCount
+                            paramOids:NULL
+                            paramValues:paramValues
+                            paramLengths:NULL
+                            paramFormats:NULL
+                          ];
+          [key release];
+        }
+      }
+    }
+    if ( parameterized ) objc_free(parameterized);
+    if ( values ) objc_free(values);
+    return pgResult;
+  }
+  
+//
+
+  - (void) trimStatementCacheToSize:(SBUInteger)cacheSize
+  {
+    while ( [_statementCache count] > cacheSize ) {
+      SBEnumerator*                 eKey = [_statementCache keyEnumerator];
+      SBString*                     key;
+      SBString*                     oldestKey = nil;
+      SBPostgresCachedStatement*    oldest = nil;
+      
+      while ( (key = [eKey nextObject]) ) {
+        SBPostgresCachedStatement*  statement = [_statementCache objectForKey:key];
+        
+        if ( ! oldest || ([statement lastUsed] < [oldest lastUsed]) ) {
+          oldest = statement;
+          oldestKey = key;
+        }
+      }
+      if ( ! oldestKey )
+        break;
+      if ( [oldest isPrepared] && _flags.connectionOpen ) {
+        char          command[SBPostgresStatementNameLength + 16];
+        PGresult*     pgResult;
+        
+        strcpy(command, "DEALLOCATE ");
+        __SBPostgresStatementName(command + 11, SBPostgresCachedStatementPrefix, [oldest statementId]);
+        if ( (pgResult = PQexec(_databaseConnection, command)) )
+          PQclear(pgResult);
+      }
+      [_statementCache removeObjectForKey:oldestKey];
+    }
+  }
+
+//
+
+  - (PGresult*) baseExecuteQuery:(id)aQuery
+  {
+    PGresult*   pgResult = NULL;
+    
+    [self finishPendingResults];
+    
+    if ( [aQuery isKindOf:[SBPostgresQuery class]] ) {
+      unsigned int      statementId;
+      
+      //
+      // It's a query object; do we have it on record as having been
+      // handed to PQprepare()?
+      //
+      if ( [self getStatementId:&statementId forPreparedQuery:aQuery] ) {
+        char            statementName[SBPostgresStatementNameLength];
+        
+        __SBPostgresStatementName(statementName, SBPostgresPreparedStatementPrefix, statementId);
+        pgResult = PQexecPrepared(
+                        _databaseConnection,
                         statementName,
                         [aQuery parameterCount],
                         [aQuery paramValues],
@@ -407,21 +1245,87 @@ static SBString* SBPostgresPreparedQueryReference = @"SBPostgres::queryReference
                         1
                       );
       } else {
-        Oid*          paramOids = [aQuery paramOids];
-        Class*        paramClasses = [aQuery paramClasses];
-        unsigned int  i = 0, iMax = [aQuery parameterCount];
-        
-        // Check for any Oid subs:
-        while ( i < iMax ) {
-          if ( paramClasses[i] == [SBNotorization class] )
-            paramOids[i] = [self typeOidForTypeName:@"notorization"];
-          i++;
+        [self substituteTypeOidsForQuery:aQuery];
+        if ( ! _statementCacheSize || ! (pgResult = [self executeCachedStatementForQuery:aQuery]) ) {
+          pgResult = PQexecParams(
+                          _databaseConnection,
+                          [aQuery queryString],
+                          [aQuery parameterCount],
+                          [aQuery paramOids],
+                          [aQuery paramValues],
+                          [aQuery paramLengths],
+                          [aQuery paramFormats],
+                          1
+                        );
+        }
+      }
+    } else if ( [aQuery isKindOf:[SBString class]] ) {
+      //
+      // PQexecParams() on the UTF8 encoding of the string:
+      //
+      const unsigned char*  queryAsUTF8 = [(SBString*)aQuery utf8Characters];
+      
+      if ( queryAsUTF8 ) {
+        if ( ! _statementCacheSize || ! (pgResult = [self executeCachedStatementForString:(const char*)queryAsUTF8]) ) {
+          pgResult = PQexecParams(
+                          _databaseConnection,
+                          queryAsUTF8,
+                          0,
+                          NULL,
+                          NULL,
+                          NULL,
+                          NULL,
+                          1
+                        );
         }
-        pgResult = PQexecParams(
+      }
+    }
+    if ( ! pgResult ) {
+      // Push the last on-connection error onto the error stack:
+      char*     errorMsg = PQerrorMessage(_databaseConnection);
+      
+      if ( errorMsg && *errorMsg ) {
+        fprintf(stderr, ":: %s\n", errorMsg);
+        [_errorMessageStack addObject:[SBString stringWithUTF8String:errorMsg]];
+      }
+    }
+    return pgResult;
+  }
+  
+//
+
+  - (BOOL) baseSendQuery:(id)aQuery
+  {
+    int         rc = 0;
+    
+    if ( [aQuery isKindOf:[SBPostgresQuery class]] ) {
+      unsigned int      statementId;
+      
+      //
+      // Same choice of prepared versus parameterized execution as baseExecuteQuery:,
+      // but without waiting for the result.  The statement cache is skipped, since
+      // filling it takes a PQprepare() round trip of its own:
+      //
+      if ( [self getStatementId:&statementId forPreparedQuery:aQuery] ) {
+        char            statementName[SBPostgresStatementNameLength];
+        
+        __SBPostgresStatementName(statementName, SBPostgresPreparedStatementPrefix, statementId);
+        rc = PQsendQueryPrepared(
+                        _databaseConnection,
+                        statementName,
+                        [aQuery parameterCount],
+                        [aQuery paramValues],
+                        [aQuery paramLengths],
+                        [aQuery paramFormats],
+                        1
+                      );
+      } else {
+        [self substituteTypeOidsForQuery:aQuery];
+        rc = PQsendQueryParams(
                         _databaseConnection,
                         [aQuery queryString],
-                        iMax,
-                        paramOids,
+                        [aQuery parameterCount],
+                        [aQuery paramOids],
                         [aQuery paramValues],
                         [aQuery paramLengths],
                         [aQuery paramFormats],
@@ -429,13 +1333,10 @@ static SBString* SBPostgresPreparedQueryReference = @"SBPostgres::queryReference
                       );
       }
     } else if ( [aQuery isKindOf:[SBString class]] ) {
-      //
-      // PQexec() on the UTF8 encoding of the string:
-      //
       const unsigned char*  queryAsUTF8 = [(SBString*)aQuery utf8Characters];
       
       if ( queryAsUTF8 ) {
-        pgResult = PQexecParams(
+        rc = PQsendQueryParams(
                         _databaseConnection,
                         queryAsUTF8,
                         0,
@@ -447,7 +1348,7 @@ static SBString* SBPostgresPreparedQueryReference = @"SBPostgres::queryReference
                       );
       }
     }
-    if ( ! pgResult ) {
+    if ( ! rc ) {
       // Push the last on-connection error onto the error stack:
       char*     errorMsg = PQerrorMessage(_databaseConnection);
       
@@ -456,7 +1357,161 @@ static SBString* SBPostgresPreparedQueryReference = @"SBPostgres::queryReference
         [_errorMessageStack addObject:[SBString stringWithUTF8String:errorMsg]];
       }
     }
-    return pgResult;
+    return ( rc != 0 );
+  }
+  
+//
+
+  - (void) finishPendingResults
+  {
+    //
+    // Anything that talks to the server has to wait until a streaming result or
+    // queued asynchronous queries have been taken off the connection:
+    //
+    [self closeStreamingResult];
+    if ( _copyInProgress )
+      [_copyInProgress abortWithMessage:@"COPY interrupted by another query"];
+    while ( [self completeAsyncQueryByWaiting:YES] );
+  }
+  
+//
+
+  - (void) closeStreamingResult
+  {
+    if ( _streamingResult )
+      [_streamingResult close];
+  }
+  
+//
+
+  - (void) copyInDidFinish:(SBPostgresCopyIn*)aCopyIn
+  {
+    if ( _copyInProgress == aCopyIn )
+      _copyInProgress = nil;
+  }
+  
+//
+
+  - (void) pushErrorMessage:(const char*)errorMsg
+  {
+    if ( errorMsg && *errorMsg )
+      [_errorMessageStack addObject:[SBString stringWithUTF8String:errorMsg]];
+  }
+  
+//
+
+  - (void) streamingResultDidFinish:(SBPostgresStreamingQueryResult*)aStream
+  {
+    if ( _streamingResult == aStream )
+      _streamingResult = nil;
+  }
+  
+//
+
+  - (BOOL) isInTransaction
+  {
+    return ( _checkpointIndex > 0 );
+  }
+  
+//
+
+  - (void) resolveTypeOidsForQueries:(SBArray*)queries
+  {
+    SBUInteger      i = 0, iMax = [queries count];
+    
+    //
+    // The notorization type Oid is looked up with a query of its own, which can't be
+    // done once queries have been sent without waiting:
+    //
+    while ( i < iMax ) {
+      id            aQuery = [queries objectAtIndex:i++];
+      
+      if ( [aQuery isKindOf:[SBPostgresQuery class]] ) {
+        Class*      paramClasses = [aQuery paramClasses];
+        SBUInteger  p = 0, pMax = [aQuery parameterCount];
+        
+        while ( p < pMax ) {
+          if ( paramClasses[p++] == [SBNotorization class] ) {
+            [self typeOidForTypeName:@"notorization"];
+            return;
+          }
+        }
+      }
+    }
+  }
+  
+//
+
+  - (void) sendNextAsyncQuery
+  {
+    //
+    // Only one asynchronous query is on the connection at a time; the rest wait
+    // their turn in _asyncQueries:
+    //
+    while ( ! _flags.asyncQueryInFlight && [_asyncQueries count] ) {
+      SBPostgresAsyncQuery*   asyncQuery = [_asyncQueries objectAtIndex:0];
+      
+      if ( _flags.connectionOpen && [self baseSendQuery:[asyncQuery query]] ) {
+        _flags.asyncQueryInFlight = YES;
+      } else {
+        // Couldn't be sent; the error is already on the stack:
+        [asyncQuery retain];
+        [_asyncQueries removeObjectAtIndex:0];
+        [asyncQuery deliverResult:nil fromDatabase:self];
+        [asyncQuery release];
+      }
+    }
+  }
+  
+//
+
+  - (BOOL) completeAsyncQueryByWaiting:(BOOL)shouldWait
+  {
+    SBPostgresAsyncQuery*     asyncQuery;
+    SBPostgresQueryResult*    queryResult = nil;
+    PGresult*                 pgResult;
+    PGresult*                 lastResult = NULL;
+    
+    if ( ! [_asyncQueries count] )
+      return NO;
+    if ( ! _flags.asyncQueryInFlight ) {
+      [self sendNextAsyncQuery];
+      if ( ! _flags.asyncQueryInFlight )
+        return NO;
+    }
+    if ( ! shouldWait ) {
+      PQconsumeInput(_databaseConnection);
+      if ( PQisBusy(_databaseConnection) )
+        return NO;
+    }
+    
+    //
+    // PQsendQueryParams() only accepts a single statement, so there's just the one
+    // result to collect before the NULL that ends the query:
+    //
+    while ( (pgResult = PQgetResult(_databaseConnection)) ) {
+      if ( lastResult ) PQclear(lastResult);
+      lastResult = pgResult;
+    }
+    _flags.asyncQueryInFlight = NO;
+    
+    asyncQuery = [[_asyncQueries objectAtIndex:0] retain];
+    [_asyncQueries removeObjectAtIndex:0];
+    
+    if ( lastResult ) {
+      queryResult = [[SBPostgresQueryResult alloc] initWithDatabase:self queryResult:lastResult];
+    } else {
+      char*     errorMsg = PQerrorMessage(_databaseConnection);
+      
+      if ( errorMsg && *errorMsg )
+        [_errorMessageStack addObject:[SBString stringWithUTF8String:errorMsg]];
+    }
+    [asyncQuery deliverResult:queryResult fromDatabase:self];
+    if ( queryResult ) [queryResult release];
+    [asyncQuery release];
+    
+    [self sendNextAsyncQuery];
+    return YES;
   }
   
 //
@@ -487,6 +1542,10 @@ static SBString* SBPostgresPreparedQueryReference = @"SBPostgres::queryReference
       }
       PQfreemem(notify);
     }
+    //
+    // The same socket activity may have completed an asynchronous query:
+    //
+    while ( _flags.asyncQueryInFlight && [self completeAsyncQueryByWaiting:NO] );
   }
   
 @end
@@ -502,21 +1561,38 @@ SBString *SBPostgresNotifierPayloadStringKey = @"postgresNotificationPayload";
 @interface SBPostgresNotifier : SBObject<SBFileDescriptorStream>
 {
   SBPostgresDatabase*     _parentDatabase;
+  SBRunLoop*              _runLoop;
 }
 
-- (id) initWithParentDatabase:(SBPostgresDatabase*)parentDatabase;
+- (id) initWithParentDatabase:(SBPostgresDatabase*)parentDatabase runLoop:(SBRunLoop*)aRunLoop;
+- (void) connectionWillClose;
 
 @end
 
 @implementation SBPostgresNotifier
 
   - (id) initWithParentDatabase:(SBPostgresDatabase*)parentDatabase
+    runLoop:(SBRunLoop*)aRunLoop
   {
-    if ( (self = [super init]) )
+    if ( (self = [super init]) ) {
       _parentDatabase = parentDatabase;
+      _runLoop = aRunLoop;
+    }
     return self;
   }
 
+//
+
+  - (void) connectionWillClose
+  {
+    //
+    // The reconnected socket usually gets the same descriptor number, so the run loop
+    // has to be told to register it afresh:
+    //
+    if ( _runLoop )
+      [_runLoop invalidateFileDescriptorForSource:self];
+  }
+
 //
 
   - (id) initWithFileDescriptor:(int)fd
@@ -585,10 +1661,12 @@ SBString *SBPostgresNotifierPayloadStringKey = @"postgresNotificationPayload";
       _connectionString = [connStr copy];
       _errorMessageStack = [[SBMutableArray alloc] init];
       
-      if ( [self reconnectWithRetryCount:0] ) {
-        _searchSchema = ( searchSchema ? [[SBMutableArray alloc] initWithArray:searchSchema] : [[SBMutableArray alloc] init] );
-        [self setPostgresSchemaSearchPath];
-      }
+      //
+      // The search schema has to be in place before connecting, since the connection
+      // setup (setPostgresClientProperties) is what issues the SET search_path:
+      //
+      _searchSchema = ( searchSchema ? [[SBMutableArray alloc] initWithArray:searchSchema] : [[SBMutableArray alloc] init] );
+      [self reconnectWithRetryCount:0];
     }
     return self;
   }
@@ -602,9 +1680,12 @@ SBString *SBPostgresNotifierPayloadStringKey = @"postgresNotificationPayload";
     if ( _connectionString ) [_connectionString release];
     if ( _databaseConnection ) PQfinish(_databaseConnection);
     if ( _searchSchema ) [_searchSchema release];
-    if ( _preparedQueries ) [_preparedQueries release];
+    [self removeAllPreparedQueries];
+    if ( _statementCache ) [_statementCache release];
+    if ( _statementSightings ) [_statementSightings release];
     if ( _typeOids ) [_typeOids release];
     if ( _errorMessageStack ) [_errorMessageStack release];
+    if ( _asyncQueries ) [_asyncQueries release];
     
     [super dealloc];
   }
@@ -641,9 +1722,15 @@ SBString *SBPostgresNotifierPayloadStringKey = @"postgresNotificationPayload";
     BOOL      rc = NO;
     
     if ( _databaseConnection ) {
+      [self finishPendingResults];
+      if ( _runloopNotifier )
+        [_runloopNotifier connectionWillClose];
       PQfinish(_databaseConnection);
       _databaseConnection = NULL;
       
+      // Prepared statements went away with the old connection:
+      [self removeAllPreparedQueries];
+      
       _flags.openingConnection = NO;
       _flags.inNotifyRunLoop = NO;
       _flags.connectionOpen = NO;
@@ -677,6 +1764,8 @@ SBString *SBPostgresNotifierPayloadStringKey = @"postgresNotificationPayload";
             break;
           }
         }
+        // Out of retries -- allow a later reconnect to try again:
+        _flags.openingConnection = NO;
       
       SBSTRING_AS_UTF8_END
     }
@@ -840,35 +1929,61 @@ SBString *SBPostgresNotifierPayloadStringKey = @"postgresNotificationPayload";
   - (BOOL) prepareQuery:(SBPostgresQuery*)aReadyQuery
   {
     if ( _flags.connectionOpen ) {
-      if ( ! _preparedQueries ) {
-        _preparedQueries = [[SBMutableArray alloc] init];
-      } else if ( [_preparedQueries containsObjectIdenticalTo:aReadyQuery] ) {
+      unsigned int        statementId;
+      char                statementName[SBPostgresStatementNameLength];
+      
+      if ( [self getStatementId:&statementId forPreparedQuery:aReadyQuery] ) {
         //
         // Already prepared:
         //
         return YES;
       }
-      if ( _preparedQueries ) {
-        unsigned int      idx = [_preparedQueries count];
-        char              statementName[40];
-        
-        snprintf(
-            statementName,
-            40,
-            "SBPostgresPreparedQuery0x08X",
-            idx
-          );
-        if ( [self prepareQuery:aReadyQuery statementName:statementName] ) {
-          [_preparedQueries addObject:aReadyQuery];
-          [aReadyQuery setHasBeenPrepared:YES];
+      
+      //
+      // Statement names come from a counter rather than the query's slot in the table,
+      // so a name is never reused for a different query on the same connection:
+      //
+      statementId = ++_statementCounter;
+      __SBPostgresStatementName(statementName, SBPostgresPreparedStatementPrefix, statementId);
+      if ( [self prepareQuery:aReadyQuery statementName:statementName] ) {
+        if ( _preparedQueryCount == 0 )
           [[SBNotificationCenter defaultNotificationCenter] addObserver:self selector:@selector(preparedQueryWasUnprepared:) identifier:SBPostgresPreparedQueryUnprepare object:nil];
-          return YES;
-        }
+        [self addPreparedQuery:aReadyQuery statementId:statementId];
+        [aReadyQuery setHasBeenPrepared:YES];
+        return YES;
       }
     }
     return NO;
   }
   
+//
+
+  - (SBUInteger) statementCacheSize
+  {
+    return _statementCacheSize;
+  }
+  - (void) setStatementCacheSize:(SBUInteger)cacheSize
+  {
+    if ( cacheSize ) {
+      if ( ! _statementCache )
+        _statementCache = [[SBMutableDictionary alloc] init];
+    }
+    if ( _statementCache ) {
+      [self finishPendingResults];
+      [self trimStatementCacheToSize:cacheSize];
+    }
+    if ( _statementSightings && ! cacheSize )
+      [_statementSightings removeAllObjects];
+    _statementCacheSize = cacheSize;
+  }
+  
+//
+
+  - (SBUInteger) cachedStatementCount
+  {
+    return ( _statementCache ? [_statementCache count] : 0 );
+  }
+
 //
 
   - (id) executeQuery:(id)aQuery
@@ -883,6 +1998,27 @@ SBString *SBPostgresNotifierPayloadStringKey = @"postgresNotificationPayload";
     return queryResult;
   }
 
+//
+
+  - (SBPostgresStreamingQueryResult*) executeStreamingQuery:(id)aQuery
+  {
+    SBPostgresStreamingQueryResult*   streamingResult = nil;
+    
+    [self finishPendingResults];
+    if ( _flags.connectionOpen && [self baseSendQuery:aQuery] ) {
+#if PG_VERSION_NUM >= 90200
+      //
+      // Without single-row mode the whole result arrives as one PGresult; the stream
+      // copes with that, it just isn't bounded in memory:
+      //
+      PQsetSingleRowMode(_databaseConnection);
+#endif
+      streamingResult = [[[SBPostgresStreamingQueryResult alloc] initWithDatabase:self] autorelease];
+      _streamingResult = streamingResult;
+    }
+    return streamingResult;
+  }
+
 //
 
   - (BOOL) executeQueryWithBooleanResult:(id)aQuery
@@ -924,6 +2060,8 @@ SBString *SBPostgresNotifierPayloadStringKey = @"postgresNotificationPayload";
     BOOL        rc = NO;
     
     if ( _flags.connectionOpen ) {
+      [self finishPendingResults];
+      
       PGresult*   pgResult = NULL;
       
       if ( _checkpointIndex == 0 ) {
@@ -966,6 +2104,8 @@ SBString *SBPostgresNotifierPayloadStringKey = @"postgresNotificationPayload";
     BOOL        rc = NO;
     
     if ( _flags.connectionOpen && (_checkpointIndex > 0) ) {
+      [self finishPendingResults];
+      
       PGresult* pgResult = NULL;
       
       if ( _checkpointIndex == 1 ) {
@@ -1008,6 +2148,8 @@ SBString *SBPostgresNotifierPayloadStringKey = @"postgresNotificationPayload";
     BOOL        rc = NO;
     
     if ( _flags.connectionOpen && (_checkpointIndex > 0) ) {
+      [self finishPendingResults];
+      
       PGresult* pgResult = PQexec(_databaseConnection, "ROLLBACK");
       
       if ( pgResult ) {
@@ -1042,6 +2184,8 @@ SBString *SBPostgresNotifierPayloadStringKey = @"postgresNotificationPayload";
     BOOL        rc = NO;
     
     if ( _flags.connectionOpen && (_checkpointIndex > 0) ) {
+      [self finishPendingResults];
+      
       PGresult* pgResult = NULL;
       
       if ( _checkpointIndex == 1 ) {
@@ -1084,6 +2228,8 @@ SBString *SBPostgresNotifierPayloadStringKey = @"postgresNotificationPayload";
     BOOL        rc = NO;
     
     if ( _flags.connectionOpen && (_checkpointIndex > 0) ) {
+      [self finishPendingResults];
+      
       PGresult* pgResult = PQexec(_databaseConnection, "COMMIT");
       
       if ( pgResult ) {
@@ -1148,6 +2294,155 @@ SBString *SBPostgresNotifierPayloadStringKey = @"postgresNotificationPayload";
 #pragma mark -
 //
 
+@implementation SBPostgresDatabase(SBPostgresDatabaseCopy)
+
+  - (SBPostgresCopyIn*) beginCopyInWithCommand:(SBString*)copyCommand
+  {
+    SBPostgresCopyIn*   copyIn = nil;
+    
+    if ( _flags.connectionOpen && copyCommand ) {
+      PGresult*         pgResult;
+      
+      [self finishPendingResults];
+      if ( (pgResult = PQexec(_databaseConnection, (const char*)[copyCommand utf8Characters])) ) {
+        if ( PQresultStatus(pgResult) == PGRES_COPY_IN ) {
+          if ( (copyIn = [[[SBPostgresCopyIn alloc] initWithDatabase:self] autorelease]) )
+            _copyInProgress = copyIn;
+          else
+            PQputCopyEnd(_databaseConnection, "Out of memory");
+        } else {
+          char*         errorMsg = PQresultErrorMessage(pgResult);
+          
+          if ( errorMsg && *errorMsg )
+            [_errorMessageStack addObject:[SBString stringWithUTF8String:errorMsg]];
+        }
+        PQclear(pgResult);
+        if ( ! copyIn ) {
+          // Take the connection out of any COPY state we didn't follow through on:
+          while ( (pgResult = PQgetResult(_databaseConnection)) )
+            PQclear(pgResult);
+        }
+      } else {
+        char*           errorMsg = PQerrorMessage(_databaseConnection);
+        
+        if ( errorMsg && *errorMsg )
+          [_errorMessageStack addObject:[SBString stringWithUTF8String:errorMsg]];
+      }
+    }
+    return copyIn;
+  }
+  
+//
+
+  - (SBInteger) copyDataFromInputStream:(SBInputStream*)inputStream
+    withCommand:(SBString*)copyCommand
+  {
+    SBPostgresCopyIn*   copyIn = [self beginCopyInWithCommand:copyCommand];
+    SBInteger           rc = -1;
+    
+    if ( copyIn ) {
+      char*             buffer = objc_malloc(SBPostgresCopyBufferSize);
+      SBUInteger        count;
+      BOOL              ok = ( buffer != NULL );
+      
+      if ( ok ) {
+        if ( [inputStream streamStatus] == SBStreamStatusNotOpen )
+          [inputStream open];
+        while ( ok && (count = [inputStream read:buffer maxLength:SBPostgresCopyBufferSize]) )
+          ok = [copyIn appendBytes:buffer length:count];
+        if ( [inputStream streamStatus] == SBStreamStatusError )
+          ok = NO;
+        objc_free(buffer);
+      }
+      if ( ok )
+        rc = [copyIn finish];
+      else
+        [copyIn abortWithMessage:@"Error reading COPY data"];
+    }
+    return rc;
+  }
+  
+//
+
+  - (SBInteger) copyDataToOutputStream:(SBOutputStream*)outputStream
+    withCommand:(SBString*)copyCommand
+  {
+    SBInteger           rc = -1;
+    
+    if ( _flags.connectionOpen && copyCommand ) {
+      PGresult*         pgResult;
+      
+      [self finishPendingResults];
+      if ( (pgResult = PQexec(_databaseConnection, (const char*)[copyCommand utf8Characters])) ) {
+        ExecStatusType  status = PQresultStatus(pgResult);
+        
+        if ( status != PGRES_COPY_OUT ) {
+          char*         errorMsg = PQresultErrorMessage(pgResult);
+          
+          if ( errorMsg && *errorMsg )
+            [_errorMessageStack addObject:[SBString stringWithUTF8String:errorMsg]];
+        }
+        PQclear(pgResult);
+        
+        if ( status == PGRES_COPY_OUT ) {
+          char*         row;
+          int           rowLen;
+          BOOL          ok = YES;
+          
+          if ( [outputStream streamStatus] == SBStreamStatusNotOpen )
+            [outputStream open];
+          
+          //
+          // Each PQgetCopyData() hands back one row; if the stream stops taking data
+          // the rest is still read (and dropped) so the connection comes out of COPY:
+          //
+          while ( (rowLen = PQgetCopyData(_databaseConnection, &row, 0)) > 0 ) {
+            SBUInteger  written = 0;
+            
+            while ( ok && (written < rowLen) ) {
+              SBUInteger  count = [outputStream write:row + written length:rowLen - written];
+              
+              if ( count == 0 )
+                ok = NO;
+              written += count;
+            }
+            PQfreemem(row);
+          }
+          if ( rowLen == -2 ) {
+            char*       errorMsg = PQerrorMessage(_databaseConnection);
+            
+            if ( errorMsg && *errorMsg )
+              [_errorMessageStack addObject:[SBString stringWithUTF8String:errorMsg]];
+          }
+          while ( (pgResult = PQgetResult(_databaseConnection)) ) {
+            if ( PQresultStatus(pgResult) == PGRES_COMMAND_OK ) {
+              if ( ok && (rowLen == -1) )
+                rc = strtoll(PQcmdTuples(pgResult), NULL, 10);
+            } else {
+              char*     errorMsg = PQresultErrorMessage(pgResult);
+              
+              if ( errorMsg && *errorMsg )
+                [_errorMessageStack addObject:[SBString stringWithUTF8String:errorMsg]];
+            }
+            PQclear(pgResult);
+          }
+        }
+      } else {
+        char*           errorMsg = PQerrorMessage(_databaseConnection);
+        
+        if ( errorMsg && *errorMsg )
+          [_errorMessageStack addObject:[SBString stringWithUTF8String:errorMsg]];
+      }
+    }
+    return rc;
+  }
+
+@end
+
+//
+#pragma mark -
+//
+
 @implementation SBPostgresDatabase(SBPostgresDatabaseNotification)
 
   - (int) notificationRunLoop
@@ -1210,6 +2505,7 @@ SBString *SBPostgresNotifierPayloadStringKey = @"postgresNotificationPayload";
         //
         // Attempt the query:
         //
+        [self finishPendingResults];
         queryResult = PQexec(_databaseConnection, [registerQuery utf8Characters]);
         if ( queryResult ) {
           if ( PQresultStatus(queryResult) == PGRES_COMMAND_OK ) {
@@ -1243,7 +2539,7 @@ SBString *SBPostgresNotifierPayloadStringKey = @"postgresNotificationPayload";
   - (void) scheduleNotificationInRunLoop:(SBRunLoop*)aRunLoop
   {
     if ( ! _runloopNotifier ) {
-      if ( (_runloopNotifier = [[SBPostgresNotifier alloc] initWithParentDatabase:self]) )
+      if ( (_runloopNotifier = [[SBPostgresNotifier alloc] initWithParentDatabase:self runLoop:aRunLoop]) )
         [aRunLoop addInputSource:_runloopNotifier forMode:SBRunLoopDefaultMode];
     }
   }
@@ -1265,6 +2561,213 @@ SBString *SBPostgresNotifierPayloadStringKey = @"postgresNotificationPayload";
 #pragma mark -
 //
 
+@implementation SBPostgresDatabase(SBPostgresDatabaseAsync)
+
+  - (BOOL) sendQuery:(id)aQuery
+    target:(id)target
+    selector:(SEL)aSelector
+  {
+    SBPostgresAsyncQuery*   asyncQuery;
+    
+    if ( ! _flags.connectionOpen || ! aQuery )
+      return NO;
+    
+    [self resolveTypeOidsForQueries:[SBArray arrayWithObject:aQuery]];
+    [self closeStreamingResult];
+    
+    if ( (asyncQuery = [[SBPostgresAsyncQuery alloc] initWithQuery:aQuery target:target selector:aSelector]) ) {
+      if ( ! _asyncQueries )
+        _asyncQueries = [[SBMutableArray alloc] init];
+      [_asyncQueries addObject:asyncQuery];
+      [asyncQuery release];
+      [self sendNextAsyncQuery];
+      return YES;
+    }
+    return NO;
+  }
+  
+//
+
+  - (SBUInteger) pendingQueryCount
+  {
+    return ( _asyncQueries ? [_asyncQueries count] : 0 );
+  }
+  
+//
+
+  - (void) waitForPendingQueries
+  {
+    while ( [self completeAsyncQueryByWaiting:YES] );
+  }
+  
+//
+
+  - (SBArray*) executeQueries:(SBArray*)queries
+  {
+    SBUInteger        count = [queries count];
+    SBArray*          results = nil;
+    
+    if ( ! _flags.connectionOpen )
+      return nil;
+    if ( count == 0 )
+      return [SBArray array];
+    
+    [self resolveTypeOidsForQueries:queries];
+    [self finishPendingResults];
+    
+    id                resultObjs[count];
+    SBUInteger        i = 0;
+    BOOL              bracketed = ( (count > 1) && (_checkpointIndex == 0) );
+    BOOL              queryFailed = NO;
+    
+#if PG_VERSION_NUM >= 140000
+    if ( PQenterPipelineMode(_databaseConnection) ) {
+      BOOL            sentBegin = NO, sentEnd = NO, synced = NO, committed = NO;
+      SBUInteger      sent = 0;
+      PGresult*       pgResult;
+      
+      //
+      // Everything goes out before anything is read back, followed by a single sync
+      // point.  Outside a transaction the batch is bracketed by BEGIN and COMMIT within the
+      // pipeline, so a batch that can't be sent in full is rolled back instead of being
+      // committed piecemeal at the sync point:
+      //
+      if ( ! bracketed || (sentBegin = [self baseSendQuery:@"BEGIN"]) ) {
+        while ( (sent < count) && [self baseSendQuery:[queries objectAtIndex:sent]] )
+          sent++;
+        if ( sentBegin )
+          sentEnd = [self baseSendQuery:( (sent == count) ? @"COMMIT" : @"ROLLBACK" )];
+      }
+      if ( (synced = PQpipelineSync(_databaseConnection)) ) {
+        if ( sentBegin && (pgResult = __SBPostgresNextPipelineResult(_databaseConnection)) )
+          PQclear(pgResult);
+        while ( i < sent ) {
+          if ( (pgResult = __SBPostgresNextPipelineResult(_databaseConnection)) ) {
+            switch ( PQresultStatus(pgResult) ) {
+              case PGRES_TUPLES_OK:
+              case PGRES_COMMAND_OK:
+                break;
+              default:
+                queryFailed = YES;
+                break;
+            }
+            resultObjs[i] = [[[SBPostgresQueryResult alloc] initWithDatabase:self queryResult:pgResult] autorelease];
+          } else {
+            resultObjs[i] = [SBNull null];
+            queryFailed = YES;
+          }
+          i++;
+        }
+        if ( sentEnd && (pgResult = __SBPostgresNextPipelineResult(_databaseConnection)) ) {
+          if ( ! (committed = (PQresultStatus(pgResult) == PGRES_COMMAND_OK) && (sent == count)) )
+            [self pushErrorMessage:PQresultErrorMessage(pgResult)];
+          PQclear(pgResult);
+        }
+        // ...and the sync point has a result of its own:
+        while ( (pgResult = PQgetResult(_databaseConnection)) ) {
+          ExecStatusType  status = PQresultStatus(pgResult);
+          
+          PQclear(pgResult);
+          if ( status == PGRES_PIPELINE_SYNC )
+            break;
+        }
+      } else {
+        [self pushErrorMessage:PQerrorMessage(_databaseConnection)];
+      }
+      PQexitPipelineMode(_databaseConnection);
+      
+      // A failed query skips the COMMIT and leaves the transaction open (and aborted):
+      if ( bracketed && (PQtransactionStatus(_databaseConnection) != PQTRANS_IDLE) ) {
+        if ( (pgResult = PQexec(_databaseConnection, "ROLLBACK")) )
+          PQclear(pgResult);
+      }
+      
+      //
+      // Never fall back to running the rest a query at a time -- that would happen outside
+      // the batch's transaction.  A batch that wasn't sent in full, or whose COMMIT failed
+      // although each query succeeded, is a failure:
+      //
+      if ( (sent < count) || ! synced || (bracketed && ! committed && ! queryFailed) )
+        return nil;
+      return [SBArray arrayWithObjects:resultObjs count:count];
+    }
+#endif
+    //
+    // Without pipeline mode it's one round trip per query, in a transaction of its own
+    // unless one is already open:
+    //
+    if ( bracketed && ! [self beginTransaction] )
+      return nil;
+    while ( i < count ) {
+      id              queryResult = [self executeQuery:[queries objectAtIndex:i]];
+      
+      if ( ! queryResult || ! [queryResult queryWasSuccessful] )
+        queryFailed = YES;
+      resultObjs[i++] = ( queryResult ? queryResult : [SBNull null] );
+    }
+    if ( bracketed ) {
+      if ( queryFailed )
+        [self discardLastTransaction];
+      else if ( ! [self commitLastTransaction] )
+        return nil;
+    }
+    results = [SBArray arrayWithObjects:resultObjs count:count];
+    return results;
+  }
+  
+//
+
+  - (BOOL) executeQueriesWithBooleanResult:(SBArray*)queries
+  {
+    BOOL              rc = NO;
+    BOOL              transactionStarted = NO;
+    SBArray*          results;
+    
+    if ( ! _flags.connectionOpen )
+      return NO;
+    
+    //
+    // executeQueries: makes the batch atomic on its own outside a transaction.  Inside
+    // one, a savepoint keeps a failed batch from aborting the enclosing transaction:
+    //
+    if ( ([queries count] > 1) && (_checkpointIndex > 0) ) {
+      if ( ! (transactionStarted = [self beginTransaction]) )
+        return NO;
+    }
+    if ( (results = [self executeQueries:queries]) ) {
+      SBUInteger      i = 0, iMax = [results count];
+      
+      rc = YES;
+      while ( i < iMax ) {
+        id            queryResult = [results objectAtIndex:i++];
+        
+        if ( ! [queryResult isKindOf:[SBPostgresQueryResult class]] ) {
+          rc = NO;
+        } else if ( ! [queryResult queryWasSuccessful] ) {
+          SBString*   errorMsg = [queryResult queryErrorString];
+          
+          // Queries after the failed one only report that they were skipped:
+          if ( errorMsg )
+            [_errorMessageStack addObject:errorMsg];
+          rc = NO;
+        }
+      }
+    }
+    if ( transactionStarted ) {
+      if ( rc )
+        rc = [self commitLastTransaction];
+      else
+        [self discardLastTransaction];
+    }
+    return rc;
+  }
+
+@end
+
+//
+#pragma mark -
+//
+
 @implementation SBObject(SBPostgresDatabaseNotification)
 
   - (void) notificationFromDatabase:(SBNotification*)aNotify
@@ -2037,6 +3540,9 @@ SBString *SBPostgresNotifierPayloadStringKey = @"postgresNotificationPayload";
         
           case PGRES_COMMAND_OK:
           case PGRES_TUPLES_OK:
+#if PG_VERSION_NUM >= 90200
+          case PGRES_SINGLE_TUPLE:
+#endif
             _flags.wasSuccessful = YES;
             break;
         
@@ -2246,76 +3752,300 @@ SBString *SBPostgresNotifierPayloadStringKey = @"postgresNotificationPayload";
 
 //
 
-  - (Class) classForFieldNum:(SBUInteger)fieldNum
+  - (BOOL) getInt64Values:(int64_t*)values
+    nullFlags:(BOOL*)nullFlags
+    forFieldNum:(SBUInteger)fieldNum
   {
-    Oid       pgType = InvalidOid;
+    Oid           pgType = InvalidOid;
     
     if ( [self postgresType:&pgType forFieldNum:fieldNum] ) {
       switch ( pgType ) {
-        
-        case OIDOID:
+      
         case BOOLOID:
         case INT2OID:
         case INT4OID:
-        case INT8OID:
-        case FLOAT4OID:
-        case FLOAT8OID:
-          return [SBNumber class];
-        
-        case CHAROID:
-        case BPCHAROID:
-        case VARCHAROID:
-        case TEXTOID:
-          return [SBString class];
-        
-        case UUIDOID:
-          return [SBUUID class];
-        
-        case DATEOID:
-        case TIMEOID:
-        case TIMETZOID:
-          return [SBDateComponents class];
-          
-        case TIMESTAMPOID:
-        case TIMESTAMPTZOID:
-          return [SBDate class];
+        case OIDOID:
+        case INT8OID: {
+          int         row = 0, rowMax = PQntuples(_queryResult);
           
-        case INTERVALOID:
-          return [SBTimeInterval class];
-        
-        case MACADDROID:
-          return [SBMACAddress class];
-        
-        case INETOID:
-        case CIDROID:
-          return [SBInetAddress class];
-        
-        case BYTEAOID:
-        default: {
-          if ( pgType == [_parentDatabase typeOidForTypeName:@"notorization"] ) {
-            return [SBNotorization class];
+          while ( row < rowMax ) {
+            BOOL      isNull = PQgetisnull(_queryResult, row, fieldNum);
+            
+            values[row] = ( isNull ? 0 : __SBPostgresDecodeInteger(pgType, PQgetvalue(_queryResult, row, fieldNum)) );
+            if ( nullFlags )
+              nullFlags[row] = isNull;
+            row++;
           }
-          return [SBData class];
+          return YES;
         }
         
       }
     }
-    return Nil;
+    return NO;
   }
-
+  
 //
 
-  - (id) objectForRow:(SBUInteger)row
-    fieldNum:(SBUInteger)fieldNum
+  - (BOOL) getDoubleValues:(double*)values
+    nullFlags:(BOOL*)nullFlags
+    forFieldNum:(SBUInteger)fieldNum
   {
-    id        rowColObj = nil;
-    Oid       pgType = InvalidOid;
+    Oid           pgType = InvalidOid;
     
     if ( [self postgresType:&pgType forFieldNum:fieldNum] ) {
-      
-      if ( [self isNullValueAtRow:row fieldNum:fieldNum] )
-        return [SBNull null];
-      
+      switch ( pgType ) {
+      
+        case INT2OID:
+        case INT4OID:
+        case OIDOID:
+        case INT8OID:
+        case FLOAT4OID:
+        case FLOAT8OID: {
+          int         row = 0, rowMax = PQntuples(_queryResult);
+          
+          while ( row < rowMax ) {
+            BOOL      isNull = PQgetisnull(_queryResult, row, fieldNum);
+            
+            if ( isNull ) {
+              values[row] = 0.0;
+            } else {
+              char*   value = PQgetvalue(_queryResult, row, fieldNum);
+              
+              if ( pgType == FLOAT8OID ) {
+                SBByteSwapFromNetwork(value, sizeof(double), &values[row]);
+              } else if ( pgType == FLOAT4OID ) {
+                float f;
+                
+                SBByteSwapFromNetwork(value, sizeof(float), &f);
+                values[row] = (double)f;
+              } else {
+                values[row] = (double)__SBPostgresDecodeInteger(pgType, value);
+              }
+            }
+            if ( nullFlags )
+              nullFlags[row] = isNull;
+            row++;
+          }
+          return YES;
+        }
+        
+      }
+    }
+    return NO;
+  }
+  
+//
+
+  - (BOOL) getBoolValues:(BOOL*)values
+    nullFlags:(BOOL*)nullFlags
+    forFieldNum:(SBUInteger)fieldNum
+  {
+    Oid           pgType = InvalidOid;
+    
+    if ( [self postgresType:&pgType forFieldNum:fieldNum] && (pgType == BOOLOID) ) {
+      int         row = 0, rowMax = PQntuples(_queryResult);
+      
+      while ( row < rowMax ) {
+        BOOL      isNull = PQgetisnull(_queryResult, row, fieldNum);
+        
+        values[row] = ( ! isNull && (*PQgetvalue(_queryResult, row, fieldNum) != 0) );
+        if ( nullFlags )
+          nullFlags[row] = isNull;
+        row++;
+      }
+      return YES;
+    }
+    return NO;
+  }
+  
+//
+
+  - (BOOL) getUnixTimestampValues:(time_t*)values
+    nullFlags:(BOOL*)nullFlags
+    forFieldNum:(SBUInteger)fieldNum
+  {
+    Oid           pgType = InvalidOid;
+    
+    if ( [self postgresType:&pgType forFieldNum:fieldNum] && ((pgType == TIMESTAMPOID) || (pgType == TIMESTAMPTZOID)) ) {
+      int         row = 0, rowMax = PQntuples(_queryResult);
+      BOOL        integerDatetimes = [_parentDatabase hasIntegerDatetimes];
+      
+      while ( row < rowMax ) {
+        BOOL      isNull = PQgetisnull(_queryResult, row, fieldNum);
+        
+        //
+        // Both representations are 8 bytes, so the server's integer_datetimes setting
+        // (not pg_config.h, which stopped saying as of libpq 10) picks the decoding:
+        //
+        if ( isNull || (PQgetlength(_queryResult, row, fieldNum) != 8) ) {
+          values[row] = 0;
+        } else if ( integerDatetimes ) {
+          int64_t   pgTimestamp;
+          
+          SBByteSwapFromNetwork(PQgetvalue(_queryResult, row, fieldNum), sizeof(pgTimestamp), &pgTimestamp);
+          // Microseconds, rounded down to the second:
+          pgTimestamp = ( (pgTimestamp >= 0) ? (pgTimestamp / 1000000) : -((999999 - pgTimestamp) / 1000000) );
+          values[row] = (time_t)(pgTimestamp + (int64_t)PostgresEpochShift);
+        } else {
+          double    pgTimestamp;
+          
+          SBByteSwapFromNetwork(PQgetvalue(_queryResult, row, fieldNum), sizeof(pgTimestamp), &pgTimestamp);
+          values[row] = (time_t)((int64_t)floor(pgTimestamp) + (int64_t)PostgresEpochShift);
+        }
+        if ( nullFlags )
+          nullFlags[row] = isNull;
+        row++;
+      }
+      return YES;
+    }
+    return NO;
+  }
+  
+//
+
+  - (BOOL) getUTF8Slices:(SBPostgresUTF8Slice*)slices
+    forFieldNum:(SBUInteger)fieldNum
+  {
+    Oid           pgType = InvalidOid;
+    
+    if ( [self postgresType:&pgType forFieldNum:fieldNum] ) {
+      switch ( pgType ) {
+      
+        case TEXTOID:
+        case CHAROID:
+        case BPCHAROID:
+        case VARCHAROID: {
+          int         row = 0, rowMax = PQntuples(_queryResult);
+          
+          while ( row < rowMax ) {
+            if ( PQgetisnull(_queryResult, row, fieldNum) ) {
+              slices[row].bytes = NULL;
+              slices[row].length = 0;
+            } else {
+              char*   value = PQgetvalue(_queryResult, row, fieldNum);
+              int     length = PQgetlength(_queryResult, row, fieldNum);
+              
+              if ( pgType == CHAROID ) {
+                while ( length && (value[length - 1] == ' ') )
+                  length--;
+              }
+              slices[row].bytes = value;
+              slices[row].length = length;
+            }
+            row++;
+          }
+          return YES;
+        }
+        
+      }
+    }
+    return NO;
+  }
+  
+//
+
+  - (const char*) utf8ValueAtRow:(SBUInteger)row
+    fieldNum:(SBUInteger)fieldNum
+    length:(SBUInteger*)length
+  {
+    Oid           pgType = InvalidOid;
+    
+    if ( [self postgresType:&pgType forFieldNum:fieldNum] && (row < PQntuples(_queryResult)) && ! PQgetisnull(_queryResult, row, fieldNum) ) {
+      switch ( pgType ) {
+      
+        case TEXTOID:
+        case CHAROID:
+        case BPCHAROID:
+        case VARCHAROID: {
+          char*   value = PQgetvalue(_queryResult, row, fieldNum);
+          int     valueLen = PQgetlength(_queryResult, row, fieldNum);
+          
+          if ( pgType == CHAROID ) {
+            while ( valueLen && (value[valueLen - 1] == ' ') )
+              valueLen--;
+          }
+          if ( length )
+            *length = valueLen;
+          return value;
+        }
+        
+      }
+    }
+    return NULL;
+  }
+  
+//
+
+  - (Class) classForFieldNum:(SBUInteger)fieldNum
+  {
+    Oid       pgType = InvalidOid;
+    
+    if ( [self postgresType:&pgType forFieldNum:fieldNum] ) {
+      switch ( pgType ) {
+        
+        case OIDOID:
+        case BOOLOID:
+        case INT2OID:
+        case INT4OID:
+        case INT8OID:
+        case FLOAT4OID:
+        case FLOAT8OID:
+          return [SBNumber class];
+        
+        case CHAROID:
+        case BPCHAROID:
+        case VARCHAROID:
+        case TEXTOID:
+          return [SBString class];
+        
+        case UUIDOID:
+          return [SBUUID class];
+        
+        case DATEOID:
+        case TIMEOID:
+        case TIMETZOID:
+          return [SBDateComponents class];
+          
+        case TIMESTAMPOID:
+        case TIMESTAMPTZOID:
+          return [SBDate class];
+          
+        case INTERVALOID:
+          return [SBTimeInterval class];
+        
+        case MACADDROID:
+          return [SBMACAddress class];
+        
+        case INETOID:
+        case CIDROID:
+          return [SBInetAddress class];
+        
+        case BYTEAOID:
+        default: {
+          if ( pgType == [_parentDatabase typeOidForTypeName:@"notorization"] ) {
+            return [SBNotorization class];
+          }
+          return [SBData class];
+        }
+        
+      }
+    }
+    return Nil;
+  }
+
+//
+
+  - (id) objectForRow:(SBUInteger)row
+    fieldNum:(SBUInteger)fieldNum
+  {
+    id        rowColObj = nil;
+    Oid       pgType = InvalidOid;
+    
+    if ( [self postgresType:&pgType forFieldNum:fieldNum] ) {
+      
+      if ( [self isNullValueAtRow:row fieldNum:fieldNum] )
+        return [SBNull null];
+      
       switch ( pgType ) {
         
         case BOOLOID: {
@@ -2640,3 +4370,508 @@ SBString *SBPostgresNotifierPayloadStringKey = @"postgresNotificationPayload";
   }
 
 @end
+
+//
+#pragma mark -
+//
+
+@implementation SBPostgresStreamingQueryResult(SBPostgresStreamingQueryResultPrivate)
+
+  - (id) initWithDatabase:(SBPostgresDatabase*)database
+  {
+    if ( self = [super init] ) {
+      _parentDatabase = [database retain];
+    }
+    return self;
+  }
+
+//
+
+  - (void) finishStreamByCancelling:(BOOL)shouldCancel
+  {
+    if ( ! _flags.isFinished ) {
+      PGconn*       conn = [_parentDatabase databaseConnection];
+      PGresult*     pgResult;
+      
+      if ( conn ) {
+        if ( shouldCancel ) {
+          PGcancel*   cancel = PQgetCancel(conn);
+          
+          if ( cancel ) {
+            char      errorMsg[256];
+            
+            PQcancel(cancel, errorMsg, sizeof(errorMsg));
+            PQfreeCancel(cancel);
+          }
+        }
+        //
+        // Whatever is left on the connection -- rows we won't be reading, the error
+        // from a cancelled query, or the results of further statements in a multi-
+        // statement query string -- is discarded:
+        //
+        while ( (pgResult = PQgetResult(conn)) )
+          PQclear(pgResult);
+      }
+      _flags.isFinished = YES;
+      [_parentDatabase streamingResultDidFinish:self];
+    }
+  }
+
+@end
+
+//
+#pragma mark -
+//
+
+@implementation SBPostgresStreamingQueryResult
+
+  + (BOOL) accessInstanceVariablesDirectly
+  {
+    return NO;
+  }
+
+//
+
+  - (void) dealloc
+  {
+    [self close];
+    if ( _finalResult ) [_finalResult release];
+    if ( _parentDatabase ) [_parentDatabase release];
+    [super dealloc];
+  }
+
+//
+
+  - (BOOL) nextRow
+  {
+    PGresult*     pgResult;
+    
+    if ( _flags.isFinished )
+      return NO;
+    
+    //
+    // Without single-row mode the final result holds all of the rows:
+    //
+    if ( _currentResult ) {
+      if ( ++_currentRowIndex < [_currentResult numberOfRows] ) {
+        _rowCount++;
+        return YES;
+      }
+      [_currentResult release];
+      _currentResult = nil;
+    }
+    if ( _finalResult ) {
+      [self finishStreamByCancelling:NO];
+      return NO;
+    }
+    
+    if ( (pgResult = PQgetResult([_parentDatabase databaseConnection])) ) {
+      SBPostgresQueryResult*    queryResult = [[SBPostgresQueryResult alloc] initWithDatabase:_parentDatabase queryResult:pgResult];
+      
+      switch ( PQresultStatus(pgResult) ) {
+      
+#if PG_VERSION_NUM >= 90200
+        case PGRES_SINGLE_TUPLE:
+          _currentResult = queryResult;
+          _currentRowIndex = 0;
+          _rowCount++;
+          return YES;
+#endif
+
+        case PGRES_TUPLES_OK:
+          _finalResult = queryResult;
+          if ( PQntuples(pgResult) > 0 ) {
+            _currentResult = [queryResult retain];
+            _currentRowIndex = 0;
+            _rowCount++;
+            return YES;
+          }
+          break;
+        
+        default:
+          _finalResult = queryResult;
+          break;
+          
+      }
+    } else {
+      // The connection gave up before the query produced its final status:
+      _flags.wasInterrupted = YES;
+    }
+    [self finishStreamByCancelling:NO];
+    return NO;
+  }
+  
+//
+
+  - (SBUInteger) rowCount
+  {
+    return _rowCount;
+  }
+  
+//
+
+  - (BOOL) isFinished
+  {
+    return ( _flags.isFinished != 0 );
+  }
+  
+//
+
+  - (BOOL) queryWasSuccessful
+  {
+    if ( _flags.wasInterrupted )
+      return NO;
+    if ( _finalResult )
+      return [_finalResult queryWasSuccessful];
+    return YES;
+  }
+  
+//
+
+  - (SBString*) queryErrorString
+  {
+    if ( _finalResult )
+      return [_finalResult queryErrorString];
+    if ( _flags.wasInterrupted )
+      return @"Streaming query result was closed before all rows were read.";
+    return nil;
+  }
+  
+//
+
+  - (SBPostgresQueryResult*) currentRow
+  {
+    return _currentResult;
+  }
+  - (SBUInteger) currentRowIndex
+  {
+    return _currentRowIndex;
+  }
+  
+//
+
+  - (SBUInteger) numberOfFields
+  {
+    if ( _currentResult )
+      return [_currentResult numberOfFields];
+    return 0;
+  }
+  
+//
+
+  - (SBUInteger) fieldNumberWithName:(SBString*)fieldName
+  {
+    if ( _currentResult )
+      return [_currentResult fieldNumberWithName:fieldName];
+    return SBNotFound;
+  }
+  
+//
+
+  - (BOOL) isNullValueAtFieldNum:(SBUInteger)fieldNum
+  {
+    if ( _currentResult )
+      return [_currentResult isNullValueAtRow:_currentRowIndex fieldNum:fieldNum];
+    return NO;
+  }
+  
+//
+
+  - (id) objectForFieldNum:(SBUInteger)fieldNum
+  {
+    if ( _currentResult )
+      return [_currentResult objectForRow:_currentRowIndex fieldNum:fieldNum];
+    return nil;
+  }
+  
+//
+
+  - (SBArray*) arrayForCurrentRow
+  {
+    if ( _currentResult )
+      return [_currentResult arrayForRow:_currentRowIndex];
+    return nil;
+  }
+  
+//
+
+  - (SBEnumerator*) rowEnumerator
+  {
+    return [[[SBPostgresStreamingRowEnumerator alloc] initWithStreamingQueryResult:self] autorelease];
+  }
+  
+//
+
+  - (void) close
+  {
+    if ( ! _flags.isFinished ) {
+      //
+      // Cancelling inside a transaction block would leave the transaction aborted, so
+      // there the remaining rows are read and thrown away instead:
+      //
+      if ( ! _finalResult ) {
+        _flags.wasInterrupted = YES;
+        [self finishStreamByCancelling:( ! [_parentDatabase isInTransaction] )];
+      } else {
+        [self finishStreamByCancelling:NO];
+      }
+    }
+    if ( _currentResult ) {
+      [_currentResult release];
+      _currentResult = nil;
+    }
+  }
+
+@end
+
+//
+#pragma mark -
+//
+
+@implementation SBPostgresCopyIn(SBPostgresCopyInPrivate)
+
+  - (id) initWithDatabase:(SBPostgresDatabase*)database
+  {
+    if ( self = [super init] ) {
+      if ( (_buffer = objc_malloc(SBPostgresCopyBufferSize)) ) {
+        _capacity = SBPostgresCopyBufferSize;
+        _parentDatabase = [database retain];
+      } else {
+        [self release];
+        self = nil;
+      }
+    }
+    return self;
+  }
+
+//
+
+  - (BOOL) flushBuffer
+  {
+    if ( _length ) {
+      if ( PQputCopyData([_parentDatabase databaseConnection], _buffer, _length) != 1 ) {
+        _flags.hasFailed = YES;
+        return NO;
+      }
+      _length = 0;
+    }
+    return YES;
+  }
+
+//
+
+  - (BOOL) ensureBufferSpace:(SBUInteger)length
+  {
+    if ( _length + length > _capacity ) {
+      if ( ! [self flushBuffer] )
+        return NO;
+      if ( length > _capacity ) {
+        char*       newBuffer = objc_realloc(_buffer, length);
+        
+        if ( ! newBuffer ) {
+          _flags.hasFailed = YES;
+          return NO;
+        }
+        _buffer = newBuffer;
+        _capacity = length;
+      }
+    }
+    return YES;
+  }
+
+//
+
+  - (void) endCopyWithError:(const char*)errorMsg
+  {
+    PGconn*         conn = [_parentDatabase databaseConnection];
+    PGresult*       pgResult;
+    
+    if ( ! _flags.isFinished ) {
+      _flags.isFinished = YES;
+      if ( conn ) {
+        PQputCopyEnd(conn, errorMsg);
+        while ( (pgResult = PQgetResult(conn)) )
+          PQclear(pgResult);
+      }
+      [_parentDatabase copyInDidFinish:self];
+    }
+  }
+
+@end
+
+//
+#pragma mark -
+//
+
+@implementation SBPostgresCopyIn
+
+  + (BOOL) accessInstanceVariablesDirectly
+  {
+    return NO;
+  }
+
+//
+
+  - (void) dealloc
+  {
+    if ( ! _flags.isFinished )
+      [self endCopyWithError:"COPY abandoned by client"];
+    if ( _buffer ) objc_free(_buffer);
+    if ( _parentDatabase ) [_parentDatabase release];
+    [super dealloc];
+  }
+
+//
+
+  - (BOOL) appendRow:(SBArray*)values
+  {
+    SBUInteger      i = 0, iMax = [values count];
+    
+    if ( _flags.isFinished || _flags.hasFailed )
+      return NO;
+    
+    //
+    // Check every value up front; once part of a row is in the buffer it may already have
+    // been sent to the server:
+    //
+    while ( i < iMax ) {
+      id            value = [values objectAtIndex:i++];
+      
+      if ( ! [value isNull] && ! [value isKindOf:[SBData class]] && ! [value isKindOf:[SBString class]] && ! [value respondsTo:@selector(stringValue)] )
+        return NO;
+    }
+    i = 0;
+    while ( i < iMax ) {
+      id            value = [values objectAtIndex:i];
+      
+      if ( i++ ) {
+        if ( ! [self ensureBufferSpace:1] )
+          return NO;
+        _buffer[_length++] = '\t';
+      }
+      if ( [value isNull] ) {
+        if ( ! [self ensureBufferSpace:2] )
+          return NO;
+        _buffer[_length++] = '\\';
+        _buffer[_length++] = 'N';
+      } else if ( [value isKindOf:[SBData class]] ) {
+        static const char     hexDigits[] = "0123456789abcdef";
+        const unsigned char*  bytes = [(SBData*)value bytes];
+        SBUInteger            byteLen = [(SBData*)value length];
+        
+        // A bytea hex string -- whose leading backslash must itself be escaped:
+        if ( ! [self ensureBufferSpace:3 + 2 * byteLen] )
+          return NO;
+        _buffer[_length++] = '\\';
+        _buffer[_length++] = '\\';
+        _buffer[_length++] = 'x';
+        while ( byteLen-- ) {
+          _buffer[_length++] = hexDigits[*bytes >> 4];
+          _buffer[_length++] = hexDigits[*bytes++ & 0xF];
+        }
+      } else {
+        SBString*             string = nil;
+        const unsigned char*  utf8;
+        
+        if ( [value isKindOf:[SBString class]] )
+          string = (SBString*)value;
+        else if ( [value respondsTo:@selector(stringValue)] )
+          string = [value stringValue];
+        if ( ! string || ! (utf8 = [string utf8Characters]) ) {
+          _flags.hasFailed = YES;
+          return NO;
+        }
+        while ( *utf8 ) {
+          char        escaped = '\0';
+          
+          switch ( *utf8 ) {
+            case '\\':  escaped = '\\'; break;
+            case '\t':   escaped = 't'; break;
+            case '\n':   escaped = 'n'; break;
+            case '\r':   escaped = 'r'; break;
+          }
+          if ( ! [self ensureBufferSpace:2] )
+            return NO;
+          if ( escaped ) {
+            _buffer[_length++] = '\\';
+            _buffer[_length++] = escaped;
+          } else {
+            _buffer[_length++] = *utf8;
+          }
+          utf8++;
+        }
+      }
+    }
+    if ( ! [self ensureBufferSpace:1] )
+      return NO;
+    _buffer[_length++] = '\n';
+    return YES;
+  }
+
+//
+
+  - (BOOL) appendBytes:(const void*)bytes
+    length:(SBUInteger)length
+  {
+    if ( _flags.isFinished || _flags.hasFailed )
+      return NO;
+    if ( _length + length > _capacity ) {
+      if ( ! [self flushBuffer] )
+        return NO;
+      // Big enough to go straight to the server:
+      if ( length > _capacity ) {
+        if ( PQputCopyData([_parentDatabase databaseConnection], bytes, length) != 1 ) {
+          _flags.hasFailed = YES;
+          return NO;
+        }
+        return YES;
+      }
+    }
+    memcpy(_buffer + _length, bytes, length);
+    _length += length;
+    return YES;
+  }
+
+//
+
+  - (SBInteger) finish
+  {
+    PGconn*         conn = [_parentDatabase databaseConnection];
+    SBInteger       rc = -1;
+    
+    if ( _flags.isFinished )
+      return -1;
+    if ( _flags.hasFailed || ! [self flushBuffer] ) {
+      [self endCopyWithError:"Unable to send COPY data"];
+      return -1;
+    }
+    _flags.isFinished = YES;
+    if ( PQputCopyEnd(conn, NULL) == 1 ) {
+      PGresult*     pgResult;
+      
+      while ( (pgResult = PQgetResult(conn)) ) {
+        if ( PQresultStatus(pgResult) == PGRES_COMMAND_OK ) {
+          rc = strtoll(PQcmdTuples(pgResult), NULL, 10);
+        } else {
+          char*     errorMsg = PQresultErrorMessage(pgResult);
+          
+          if ( errorMsg && *errorMsg )
+            [_parentDatabase pushErrorMessage:errorMsg];
+        }
+        PQclear(pgResult);
+      }
+    }
+    [_parentDatabase copyInDidFinish:self];
+    return rc;
+  }
+
+//
+
+  - (void) abortWithMessage:(SBString*)reason
+  {
+    const unsigned char*    reasonUTF8 = ( reason ? [reason utf8Characters] : NULL );
+    
+    [self endCopyWithError:( reasonUTF8 ? (const char*)reasonUTF8 : "COPY aborted by client" )];
+  }
+
+@end
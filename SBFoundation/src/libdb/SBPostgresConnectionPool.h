@@ -0,0 +1,197 @@
+//
+// SBDatabaseKit - Database-oriented extensions to SBFoundation
+// SBPostgresConnectionPool.h
+//
+// Pool of open connections to a Postgres database.
+//
+// $Id$
+//
+
+#import "SBPostgres.h"
+
+@class SBConditionLock;
+
+/*!
+  @class SBPostgresConnectionPool
+  @discussion
+  An SBPostgresConnectionPool holds a set of SBPostgresDatabase instances which all connect
+  using the same connection string and search schema.  Rather than each consumer (or each
+  thread) opening its own connection -- and paying for the connect, authentication, and the
+  client encoding and search_path setup every time -- a database is checked out of the pool,
+  used, and checked back in.  The setup happens once per physical connection.
+
+  The pool opens minimumConnections connections when it is initialized and never holds more
+  than maximumConnections, whether idle or checked out.  Once that limit is reached,
+  checkoutDatabase blocks until another thread checks a database back in.  Connections that
+  have been idle for longer than the idle timeout are closed (down to minimumConnections)
+  when reapIdleConnections is sent -- from a timer, or after a burst of work.  Closing a
+  connection deallocates its SBPostgresDatabase, which unregisters it from the default
+  notification center, so the pool never does that on the checking-out or checking-in
+  thread:  connections it gives up on there are set aside and closed by the next
+  reapIdleConnections.  Send reapIdleConnections (and release the pool) only from the thread
+  that owns the default notification center.
+
+  A database that has been idle for longer than the health-check interval is probed with an
+  empty query before it is handed out; a dead one is discarded and replaced.  With libpq 9.2
+  or newer, the server is checked with PQping() before a new connection is opened so that an
+  unreachable server fails the checkout right away instead of cycling through the reconnect
+  retry loop.
+
+  When a database is checked in, any open transaction is rolled back and its error message
+  stack is cleared.  A database whose search schema was altered while checked out is closed
+  rather than handed to the next consumer.
+
+  The pool itself is thread safe; each SBPostgresDatabase it hands out must only be used by
+  one thread at a time.
+*/
+@interface SBPostgresConnectionPool : SBObject
+{
+  SBString*             _connectionString;
+  SBArray*              _searchSchema;
+  SBConditionLock*      _poolLock;
+  SBUInteger            _minimumConnections;
+  SBUInteger            _maximumConnections;
+  SBUInteger            _connectionCount;
+  SBUInteger            _idleCount, _idleCapacity;
+  struct {
+    SBPostgresDatabase* database;
+    time_t              lastUsed;
+  } *_idleConnections;
+  SBUInteger            _idleTimeout;
+  SBUInteger            _healthCheckInterval;
+  SBString*             _threadPropertyKey;
+  SBMutableArray*       _retiredConnections;
+}
+
+/*!
+  @method initWithConnectionString:searchSchema:minimumConnections:maximumConnections:
+  @discussion
+    Initializes a pool whose connections are opened with connStr and have the given search
+    schema stack.  minimumConnections connections are opened immediately.  A
+    maximumConnections of zero is taken to be one.
+*/
+- (id) initWithConnectionString:(SBString*)connStr searchSchema:(SBArray*)searchSchema minimumConnections:(SBUInteger)minimumConnections maximumConnections:(SBUInteger)maximumConnections;
+
+/*!
+  @method initWithDatabase:minimumConnections:maximumConnections:
+  @discussion
+    Convenience initializer that uses the connection string and search schema of an
+    existing database.  The database itself does not become part of the pool.
+*/
+- (id) initWithDatabase:(SBPostgresDatabase*)database minimumConnections:(SBUInteger)minimumConnections maximumConnections:(SBUInteger)maximumConnections;
+
+/*!
+  @method connectionString
+  @discussion
+    Returns the connection string used for all of the receiver's connections.
+*/
+- (SBString*) connectionString;
+/*!
+  @method searchSchema
+  @discussion
+    Returns the search schema stack configured on all of the receiver's connections.
+*/
+- (SBArray*) searchSchema;
+
+/*!
+  @method minimumConnections
+  @discussion
+    Returns the number of connections the receiver keeps open even when they are idle.
+*/
+- (SBUInteger) minimumConnections;
+/*!
+  @method maximumConnections
+  @discussion
+    Returns the maximum number of connections the receiver will have open at once.
+*/
+- (SBUInteger) maximumConnections;
+/*!
+  @method setMaximumConnections:
+  @discussion
+    Lowering the limit does not close connections which are checked out; the pool
+    shrinks as they are checked back in.
+*/
+- (void) setMaximumConnections:(SBUInteger)maximumConnections;
+
+/*!
+  @method idleTimeout
+  @discussion
+    Returns the number of seconds an idle connection is kept before it is closed.  Zero
+    means idle connections are never closed.  The default is 300 seconds.
+*/
+- (SBUInteger) idleTimeout;
+- (void) setIdleTimeout:(SBUInteger)seconds;
+
+/*!
+  @method healthCheckInterval
+  @discussion
+    Returns the number of seconds a connection can sit idle before it is probed on
+    checkout.  The default is 30 seconds.
+*/
+- (SBUInteger) healthCheckInterval;
+- (void) setHealthCheckInterval:(SBUInteger)seconds;
+
+/*!
+  @method connectionCount
+  @discussion
+    Returns the number of connections the receiver has open, idle or checked out.
+*/
+- (SBUInteger) connectionCount;
+/*!
+  @method idleConnectionCount
+  @discussion
+    Returns the number of open connections which are not checked out.
+*/
+- (SBUInteger) idleConnectionCount;
+
+/*!
+  @method checkoutDatabase
+  @discussion
+    Returns a healthy database from the pool, opening a new connection if none is idle and
+    the pool is below its maximum size.  Blocks while all maximumConnections are checked
+    out.  Returns nil if a new connection was needed and could not be opened.
+
+    The caller owns a reference to the returned object and must hand it back with
+    checkinDatabase: rather than releasing it.
+*/
+- (SBPostgresDatabase*) checkoutDatabase;
+/*!
+  @method tryCheckoutDatabase
+  @discussion
+    Like checkoutDatabase, but returns nil rather than blocking when all connections are
+    checked out.
+*/
+- (SBPostgresDatabase*) tryCheckoutDatabase;
+/*!
+  @method checkinDatabase:
+  @discussion
+    Returns a database which was obtained from checkoutDatabase to the pool.
+*/
+- (void) checkinDatabase:(SBPostgresDatabase*)database;
+
+/*!
+  @method databaseForCurrentThread
+  @discussion
+    Returns a database which stays checked out to the calling thread:  the first call on a
+    thread checks one out, subsequent calls return the same one.  It is checked back in
+    when the thread exits or when releaseDatabaseForCurrentThread is sent.  Do not pass it
+    to checkinDatabase:.
+*/
+- (SBPostgresDatabase*) databaseForCurrentThread;
+/*!
+  @method releaseDatabaseForCurrentThread
+  @discussion
+    Checks the calling thread's database (see databaseForCurrentThread) back in.
+*/
+- (void) releaseDatabaseForCurrentThread;
+
+/*!
+  @method reapIdleConnections
+  @discussion
+    Closes connections which have been idle for longer than the idle timeout, keeping at
+    least minimumConnections open, along with any connections the pool has set aside for
+    closing since the last time.  Returns the number of connections closed.
+*/
+- (SBUInteger) reapIdleConnections;
+
+@end
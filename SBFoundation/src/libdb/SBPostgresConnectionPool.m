@@ -0,0 +1,537 @@
+//
+// SBDatabaseKit - Database-oriented extensions to SBFoundation
+// SBPostgresConnectionPool.m
+//
+// Pool of open connections to a Postgres database.
+//
+// $Id$
+//
+
+#import "SBPostgresConnectionPool.h"
+#import "SBLock.h"
+#import "SBThread.h"
+
+//
+// Values of the pool lock's condition variable:
+//
+enum {
+  kSBPostgresConnectionPoolExhausted = 0,
+  kSBPostgresConnectionPoolAvailable = 1
+};
+
+#define SBPostgresConnectionPoolDefaultIdleTimeout            300
+#define SBPostgresConnectionPoolDefaultHealthCheckInterval    30
+
+//
+
+@interface SBPostgresPooledConnection : SBObject
+{
+  SBPostgresConnectionPool*   _pool;
+  SBPostgresDatabase*         _database;
+}
+
+- (id) initWithPool:(SBPostgresConnectionPool*)pool database:(SBPostgresDatabase*)database;
+- (SBPostgresDatabase*) database;
+
+@end
+
+@implementation SBPostgresPooledConnection
+
+  - (id) initWithPool:(SBPostgresConnectionPool*)pool
+    database:(SBPostgresDatabase*)database
+  {
+    if ( self = [super init] ) {
+      _pool = [pool retain];
+      _database = database;
+    }
+    return self;
+  }
+
+//
+
+  - (void) dealloc
+  {
+    //
+    // The thread's property dictionary is going away (or the thread released its
+    // database explicitly), so return the connection:
+    //
+    if ( _database ) [_pool checkinDatabase:_database];
+    if ( _pool ) [_pool release];
+    [super dealloc];
+  }
+
+//
+
+  - (SBPostgresDatabase*) database
+  {
+    return _database;
+  }
+
+@end
+
+//
+#pragma mark -
+//
+
+@interface SBPostgresConnectionPool(SBPostgresConnectionPoolPrivate)
+
+- (SBInteger) availabilityCondition;
+- (SBPostgresDatabase*) openDatabase;
+- (BOOL) isHealthyDatabase:(SBPostgresDatabase*)database idleSince:(time_t)lastUsed;
+- (BOOL) hasPoolSearchSchema:(SBPostgresDatabase*)database;
+- (BOOL) pushIdleDatabase:(SBPostgresDatabase*)database;
+- (void) retireDatabase:(SBPostgresDatabase*)database;
+- (SBPostgresDatabase*) checkoutDatabaseAndWait:(BOOL)shouldWait;
+
+@end
+
+@implementation SBPostgresConnectionPool(SBPostgresConnectionPoolPrivate)
+
+  - (SBInteger) availabilityCondition
+  {
+    return ( (_idleCount > 0) || (_connectionCount < _maximumConnections) ) ? kSBPostgresConnectionPoolAvailable : kSBPostgresConnectionPoolExhausted;
+  }
+
+//
+
+  - (SBPostgresDatabase*) openDatabase
+  {
+    SBPostgresDatabase*   database;
+
+#if PG_VERSION_NUM >= 90200
+    //
+    // Don't get stuck in the connect/retry cycle if the server isn't answering:
+    //
+    BOOL                  serverIsUp = NO;
+
+    SBSTRING_AS_UTF8_BEGIN(_connectionString)
+      serverIsUp = ( PQping((const char*)_connectionString_utf8) == PQPING_OK );
+    SBSTRING_AS_UTF8_END
+    if ( ! serverIsUp )
+      return nil;
+#endif
+
+    //
+    // Initialization establishes the client encoding and search_path:
+    //
+    database = [[SBPostgresDatabase alloc] initWithConnectionString:_connectionString searchSchema:_searchSchema];
+    if ( database && ! [database isConnectionOpen] ) {
+      [self retireDatabase:database];
+      database = nil;
+    }
+    return database;
+  }
+
+//
+
+  - (BOOL) isHealthyDatabase:(SBPostgresDatabase*)database
+    idleSince:(time_t)lastUsed
+  {
+    PGconn*         conn = [database databaseConnection];
+
+    if ( ! conn || (PQstatus(conn) != CONNECTION_OK) )
+      return NO;
+
+    //
+    // A connection that has been sitting around for a while may have been dropped by
+    // the server (or a firewall) without our noticing; an empty query is the cheapest
+    // round trip there is:
+    //
+    if ( _healthCheckInterval && (time(NULL) - lastUsed >= (time_t)_healthCheckInterval) ) {
+      PGresult*     probe = PQexec(conn, "");
+      BOOL          rc = ( probe && (PQresultStatus(probe) == PGRES_EMPTY_QUERY) );
+
+      if ( probe ) PQclear(probe);
+      return rc;
+    }
+    return YES;
+  }
+
+//
+
+  - (BOOL) hasPoolSearchSchema:(SBPostgresDatabase*)database
+  {
+    SBArray*        schema = [database searchSchema];
+    SBUInteger      i, iMax;
+
+    if ( ! schema || ! _searchSchema )
+      return ( schema == _searchSchema );
+    if ( (iMax = [schema count]) != [_searchSchema count] )
+      return NO;
+    for ( i = 0; i < iMax; i++ ) {
+      if ( ! [[schema objectAtIndex:i] isEqual:[_searchSchema objectAtIndex:i]] )
+        return NO;
+    }
+    return YES;
+  }
+
+//
+
+  - (BOOL) pushIdleDatabase:(SBPostgresDatabase*)database
+  {
+    //
+    // Caller holds the pool lock.  The idle list is a stack, so the most recently used
+    // (warmest) connection is handed out first and the oldest sit at the bottom where
+    // the reaper looks:
+    //
+    if ( _idleCount == _idleCapacity ) {
+      SBUInteger      newCapacity = ( _idleCapacity ? 2 * _idleCapacity : 4 );
+      void*           newIdle = objc_realloc(_idleConnections, newCapacity * sizeof(*_idleConnections));
+
+      if ( ! newIdle )
+        return NO;
+      _idleConnections = newIdle;
+      _idleCapacity = newCapacity;
+    }
+    _idleConnections[_idleCount].database = database;
+    _idleConnections[_idleCount].lastUsed = time(NULL);
+    _idleCount++;
+    return YES;
+  }
+
+//
+
+  - (void) retireDatabase:(SBPostgresDatabase*)database
+  {
+    //
+    // Deallocating a database touches the (unlocked) default notification center, so it
+    // mustn't happen on whatever thread we're on; the reaper does the final release:
+    //
+    [_poolLock lock];
+    [_retiredConnections addObject:database];
+    [database release];
+    [_poolLock unlockWithConditionValue:[self availabilityCondition]];
+  }
+
+//
+
+  - (SBPostgresDatabase*) checkoutDatabaseAndWait:(BOOL)shouldWait
+  {
+    SBPostgresDatabase*   database = nil;
+    time_t                lastUsed = 0;
+
+    if ( shouldWait ) {
+      [_poolLock lockOnConditionValue:kSBPostgresConnectionPoolAvailable];
+    } else {
+      [_poolLock lock];
+      if ( [self availabilityCondition] == kSBPostgresConnectionPoolExhausted ) {
+        [_poolLock unlockWithConditionValue:kSBPostgresConnectionPoolExhausted];
+        return nil;
+      }
+    }
+    if ( _idleCount ) {
+      _idleCount--;
+      database = _idleConnections[_idleCount].database;
+      lastUsed = _idleConnections[_idleCount].lastUsed;
+    } else {
+      // Reserve a slot for the connection we're about to open:
+      _connectionCount++;
+    }
+    [_poolLock unlockWithConditionValue:[self availabilityCondition]];
+
+    //
+    // Health checks and connecting happen outside the lock:
+    //
+    if ( database ) {
+      if ( [self isHealthyDatabase:database idleSince:lastUsed] )
+        return database;
+
+      // Dead connection; replace it in the same slot:
+      [self retireDatabase:database];
+    }
+    if ( ! (database = [self openDatabase]) ) {
+      [_poolLock lock];
+      _connectionCount--;
+      [_poolLock unlockWithConditionValue:[self availabilityCondition]];
+    }
+    return database;
+  }
+
+@end
+
+//
+#pragma mark -
+//
+
+@implementation SBPostgresConnectionPool
+
+  - (id) initWithConnectionString:(SBString*)connStr
+    searchSchema:(SBArray*)searchSchema
+    minimumConnections:(SBUInteger)minimumConnections
+    maximumConnections:(SBUInteger)maximumConnections
+  {
+    if ( self = [super init] ) {
+      _connectionString = [connStr copy];
+      if ( searchSchema && [searchSchema count] )
+        _searchSchema = [searchSchema copy];
+      _poolLock = [[SBConditionLock alloc] initWithConditionValue:kSBPostgresConnectionPoolAvailable];
+      _maximumConnections = ( maximumConnections ? maximumConnections : 1 );
+      _minimumConnections = ( minimumConnections > _maximumConnections ? _maximumConnections : minimumConnections );
+      _idleTimeout = SBPostgresConnectionPoolDefaultIdleTimeout;
+      _healthCheckInterval = SBPostgresConnectionPoolDefaultHealthCheckInterval;
+      _threadPropertyKey = [[SBString alloc] initWithFormat:"SBPostgresConnectionPool@%p", self];
+      _retiredConnections = [[SBMutableArray alloc] init];
+
+      //
+      // Warm up the minimum number of connections:
+      //
+      while ( _connectionCount < _minimumConnections ) {
+        SBPostgresDatabase*   database = [self openDatabase];
+
+        if ( ! database )
+          break;
+        if ( ! [self pushIdleDatabase:database] ) {
+          [database release];
+          break;
+        }
+        _connectionCount++;
+      }
+    }
+    return self;
+  }
+
+//
+
+  - (id) initWithDatabase:(SBPostgresDatabase*)database
+    minimumConnections:(SBUInteger)minimumConnections
+    maximumConnections:(SBUInteger)maximumConnections
+  {
+    return [self initWithConnectionString:[database connectionString] searchSchema:[database searchSchema] minimumConnections:minimumConnections maximumConnections:maximumConnections];
+  }
+
+//
+
+  - (void) dealloc
+  {
+    if ( _idleConnections ) {
+      while ( _idleCount-- )
+        [_idleConnections[_idleCount].database release];
+      objc_free(_idleConnections);
+    }
+    if ( _retiredConnections ) [_retiredConnections release];
+    if ( _threadPropertyKey ) [_threadPropertyKey release];
+    if ( _poolLock ) [_poolLock release];
+    if ( _searchSchema ) [_searchSchema release];
+    if ( _connectionString ) [_connectionString release];
+    [super dealloc];
+  }
+
+//
+
+  - (SBString*) connectionString
+  {
+    return _connectionString;
+  }
+
+//
+
+  - (SBArray*) searchSchema
+  {
+    return _searchSchema;
+  }
+
+//
+
+  - (SBUInteger) minimumConnections
+  {
+    return _minimumConnections;
+  }
+
+//
+
+  - (SBUInteger) maximumConnections
+  {
+    return _maximumConnections;
+  }
+  - (void) setMaximumConnections:(SBUInteger)maximumConnections
+  {
+    [_poolLock lock];
+    _maximumConnections = ( maximumConnections ? maximumConnections : 1 );
+    if ( _minimumConnections > _maximumConnections )
+      _minimumConnections = _maximumConnections;
+    [_poolLock unlockWithConditionValue:[self availabilityCondition]];
+  }
+
+//
+
+  - (SBUInteger) idleTimeout
+  {
+    return _idleTimeout;
+  }
+  - (void) setIdleTimeout:(SBUInteger)seconds
+  {
+    _idleTimeout = seconds;
+  }
+
+//
+
+  - (SBUInteger) healthCheckInterval
+  {
+    return _healthCheckInterval;
+  }
+  - (void) setHealthCheckInterval:(SBUInteger)seconds
+  {
+    _healthCheckInterval = seconds;
+  }
+
+//
+
+  - (SBUInteger) connectionCount
+  {
+    return _connectionCount;
+  }
+
+//
+
+  - (SBUInteger) idleConnectionCount
+  {
+    return _idleCount;
+  }
+
+//
+
+  - (SBPostgresDatabase*) checkoutDatabase
+  {
+    return [self checkoutDatabaseAndWait:YES];
+  }
+
+//
+
+  - (SBPostgresDatabase*) tryCheckoutDatabase
+  {
+    return [self checkoutDatabaseAndWait:NO];
+  }
+
+//
+
+  - (void) checkinDatabase:(SBPostgresDatabase*)database
+  {
+    PGconn*         conn;
+    BOOL            keep = NO;
+
+    if ( ! database )
+      return;
+
+    //
+    // Put the connection back the way the next consumer expects to find it:
+    //
+    if ( (conn = [database databaseConnection]) && (PQstatus(conn) == CONNECTION_OK) ) {
+      switch ( PQtransactionStatus(conn) ) {
+
+        case PQTRANS_IDLE:
+          keep = YES;
+          break;
+
+        case PQTRANS_INTRANS:
+        case PQTRANS_INERROR: {
+          if ( ! [database discardAllTransactions] ) {
+            PGresult*   rollback = PQexec(conn, "ROLLBACK");
+
+            if ( rollback ) PQclear(rollback);
+          }
+          keep = ( PQtransactionStatus(conn) == PQTRANS_IDLE );
+          break;
+        }
+
+        default:
+          // A query still in flight (or a broken connection) -- not reusable:
+          break;
+
+      }
+      if ( keep )
+        keep = [self hasPoolSearchSchema:database];
+      [database clearErrorMessageStack];
+    }
+
+    [_poolLock lock];
+    if ( ! keep || (_connectionCount > _maximumConnections) || ! [self pushIdleDatabase:database] ) {
+      // Anything we don't keep is closed later by the reaper:
+      _connectionCount--;
+      [_retiredConnections addObject:database];
+      [database release];
+    }
+    [_poolLock unlockWithConditionValue:[self availabilityCondition]];
+  }
+
+//
+
+  - (SBPostgresDatabase*) databaseForCurrentThread
+  {
+    SBMutableDictionary*          properties = [[SBThread currentThread] properties];
+    SBPostgresPooledConnection*   pooled = [properties objectForKey:_threadPropertyKey];
+
+    if ( ! pooled ) {
+      SBPostgresDatabase*         database = [self checkoutDatabase];
+
+      if ( database ) {
+        if ( (pooled = [[SBPostgresPooledConnection alloc] initWithPool:self database:database]) ) {
+          [properties setObject:pooled forKey:_threadPropertyKey];
+          [pooled release];
+        } else {
+          [self checkinDatabase:database];
+        }
+      }
+    }
+    return [pooled database];
+  }
+
+//
+
+  - (void) releaseDatabaseForCurrentThread
+  {
+    [[[SBThread currentThread] properties] removeObjectForKey:_threadPropertyKey];
+  }
+
+//
+
+  - (SBUInteger) reapIdleConnections
+  {
+    SBPostgresDatabase**    closing = NULL;
+    SBUInteger              count = 0, retiredCount = 0;
+    SBMutableArray*         retired = nil;
+
+    //
+    // Connections set aside by other threads are closed here, on the owning thread:
+    //
+    [_poolLock lock];
+    if ( [_retiredConnections count] ) {
+      retired = _retiredConnections;
+      _retiredConnections = [[SBMutableArray alloc] init];
+    }
+    [_poolLock unlockWithConditionValue:[self availabilityCondition]];
+    if ( retired ) {
+      retiredCount = [retired count];
+      [retired release];
+    }
+
+    if ( _idleTimeout ) {
+      time_t                cutoff = time(NULL) - (time_t)_idleTimeout;
+
+      [_poolLock lock];
+      while ( (count < _idleCount) && (_connectionCount - count > _minimumConnections) && (_idleConnections[count].lastUsed < cutoff) )
+        count++;
+      if ( count && (closing = objc_malloc(count * sizeof(SBPostgresDatabase*))) ) {
+        SBUInteger          i;
+
+        for ( i = 0; i < count; i++ )
+          closing[i] = _idleConnections[i].database;
+        _idleCount -= count;
+        _connectionCount -= count;
+        memmove(_idleConnections, _idleConnections + count, _idleCount * sizeof(*_idleConnections));
+      } else {
+        count = 0;
+      }
+      [_poolLock unlockWithConditionValue:[self availabilityCondition]];
+
+      if ( closing ) {
+        SBUInteger          i;
+
+        for ( i = 0; i < count; i++ )
+          [closing[i] release];
+        objc_free(closing);
+      }
+    }
+    return count + retiredCount;
+  }
+
+@end
@@ -66,6 +66,22 @@
 */
 typedef SBComparisonResult (*SBArraySortComparator)(id obj1, id obj2, void* context);
 
+/*!
+  @typedef SBArraySortOptions
+  @discussion
+  Bit vector of options that modify the behavior of the sortUsingFunction:context:options:
+  and sortUsingSelector:options: methods of SBMutableArray.
+  @constant SBArraySortConcurrent    Very large arrays are split into chunks which are sorted
+                                     and merged by multiple threads.  The comparator must be
+                                     safe to call from threads which have no SBThread or
+                                     SBAutoreleasePool of their own -- i.e. it should do
+                                     nothing but compare the two objects.
+*/
+typedef SBUInteger SBArraySortOptions;
+enum {
+  SBArraySortConcurrent = 1 << 0
+};
+
 /*!
   @class SBArray
   @discussion
@@ -481,9 +497,7 @@ typedef SBComparisonResult (*SBArraySortComparator)(id obj1, id obj2, void* cont
 /*!
   @method exchangeObjectAtIndex:withObjectAtIndex:
   
-  Exchange the position of two objects in the receiver.  Useful for in-situ sorting, for
-  example (indeed the default sortUsingFunction: and sortUsingSelector: implementations
-  make use of this method).
+  Exchange the position of two objects in the receiver.  Useful for in-situ reordering.
 */
 - (void) exchangeObjectAtIndex:(SBUInteger)index1 withObjectAtIndex:(SBUInteger)index2;
 /*!
@@ -578,6 +592,17 @@ typedef SBComparisonResult (*SBArraySortComparator)(id obj1, id obj2, void* cont
   are equal.
 */
 - (void) sortUsingFunction:(SBArraySortComparator)comparator context:(void *)context;
+/*!
+  @method sortUsingFunction:context:options:
+  
+  Sorts the objects in the receiver array in ascending order as defined by the comparison function
+  (comparator); see sortUsingFunction:context: for the semantics of the comparator.
+  
+  The sort is an adaptive merge sort:  it is stable (objects which compare as SBOrderSame retain
+  their relative order), runs in O(n log n) time, and approaches O(n) for arrays which are already
+  or nearly in order.  The options bit vector may include SBArraySortConcurrent.
+*/
+- (void) sortUsingFunction:(SBArraySortComparator)comparator context:(void *)context options:(SBArraySortOptions)options;
 /*!
   @method sortUsingSelector:
   
@@ -590,5 +615,17 @@ typedef SBComparisonResult (*SBArraySortComparator)(id obj1, id obj2, void* cont
   if the receiver and argument are equal.
 */
 - (void) sortUsingSelector:(SEL)comparator;
+/*!
+  @method sortUsingSelector:options:
+  
+  Sorts the objects in the receiver array in ascending order as determined by sending the "comparator"
+  message to the objects; see sortUsingSelector: for the semantics of the comparator.  The method
+  implementation for the comparator is looked-up once per class of receiver object rather than on
+  every comparison.
+  
+  The sort is stable and adaptive, as with sortUsingFunction:context:options:.  The options bit vector
+  may include SBArraySortConcurrent.
+*/
+- (void) sortUsingSelector:(SEL)comparator options:(SBArraySortOptions)options;
 
 @end
@@ -11,6 +11,8 @@
 #import "SBString.h"
 #import "SBValue.h"
 
+#include <pthread.h>
+
 //
 
 @interface SBArray(SBArrayPrivate)
@@ -1086,7 +1088,7 @@ static SBArray* __SBNullArray = nil;
     id*               array = [self concreteStorage];
     
     while ( i < _count ) {
-      if ( [array[i] isEqual:anObject] )
+      if ( (array[i] == anObject) || [array[i] isEqual:anObject] )
         return i;
       i++;
     }
@@ -1103,7 +1105,7 @@ static SBArray* __SBNullArray = nil;
       iMax = _count;
       
     while ( i < iMax ) {
-      if ( [array[i] isEqual:anObject] )
+      if ( (array[i] == anObject) || [array[i] isEqual:anObject] )
         return i;
       i++;
     }
@@ -1434,65 +1436,492 @@ static SBArray* __SBNullArray = nil;
 #pragma mark -
 //
 
+//
+// Sorting is an adaptive, stable merge sort in the style of TimSort.  Natural runs
+// (ascending, or strictly-descending runs which are reversed in place) are extended
+// to a minimum length by binary insertion and then merged under TimSort's run-stack
+// invariants, so already- or nearly-sorted arrays sort in close to linear time.  The
+// engine works on a flat C array of object pointers; each array class gathers its
+// contents into such a buffer and scatters the result back.
+//
+
+#define SBArraySortMinMerge                 32
+#define SBArraySortMaxRuns                  85
+#define SBArrayConcurrentSortThreshold      65536
+#define SBArrayConcurrentSortMaxThreads     8
+
+typedef struct _SBArraySorter {
+  SBArraySortComparator     function;
+  void*                     context;
+  SEL                       selector;
+  Class                     impClass;
+  SBComparisonResult        (*imp)(id, SEL, id);
+  id*                       scratch;
+  SBUInteger                scratchCapacity;
+} SBArraySorter;
+
+//
+
 void
-__SBMutableArray_General_InsertionSortWithFn(
-  SBMutableArray*             array,
-  SBUInteger                  left,
-  SBUInteger                  right,
-  SBArraySortComparator       comparator,
-  void*                       context
+__SBArraySorterInitWithFn(
+  SBArraySorter*            sorter,
+  SBArraySortComparator     comparator,
+  void*                     context
 )
 {
-  SBUInteger        i = left + 1;
-  
-  while ( i <= right ) {
-    id              iTarget = [array objectAtIndex:i];
-    SBUInteger      j = i - 1;
-    
-    while ( j != SBUIntegerMax ) {
-      id            jTarget = [array objectAtIndex:j];
-      
-      if ( comparator(jTarget, iTarget, context) == SBOrderDescending ) {
-        [array exchangeObjectAtIndex:j withObjectAtIndex:(j + 1)];
-        j--;
-      } else {
+  memset(sorter, 0, sizeof(SBArraySorter));
+  sorter->function = comparator;
+  sorter->context = context;
+}
+
+//
+
+void
+__SBArraySorterInitWithSel(
+  SBArraySorter*            sorter,
+  SEL                       comparator
+)
+{
+  memset(sorter, 0, sizeof(SBArraySorter));
+  sorter->selector = comparator;
+}
+
+//
+
+static inline
+SBComparisonResult
+__SBArraySorterCompare(
+  SBArraySorter*            sorter,
+  id                        obj1,
+  id                        obj2
+)
+{
+  if ( sorter->function )
+    return sorter->function(obj1, obj2, sorter->context);
+
+  // Cache the comparator's IMP for the receiver's class; nearly every array we sort
+  // is homogeneous, so this avoids a dispatch lookup per comparison:
+  if ( object_get_class(obj1) != sorter->impClass ) {
+    sorter->impClass = object_get_class(obj1);
+    sorter->imp = (SBComparisonResult(*)(id, SEL, id))objc_msg_lookup(obj1, sorter->selector);
+  }
+  return sorter->imp(obj1, sorter->selector, obj2);
+}
+
+//
+
+BOOL
+__SBArraySorterEnsureScratch(
+  SBArraySorter*            sorter,
+  SBUInteger                count
+)
+{
+  if ( count > sorter->scratchCapacity ) {
+    id*         newScratch = ( sorter->scratch ? objc_realloc(sorter->scratch, count * sizeof(id)) : objc_malloc(count * sizeof(id)) );
+
+    if ( ! newScratch )
+      return NO;
+    sorter->scratch = newScratch;
+    sorter->scratchCapacity = count;
+  }
+  return YES;
+}
+
+//
+
+void
+__SBArraySorterDealloc(
+  SBArraySorter*            sorter
+)
+{
+  if ( sorter->scratch ) {
+    objc_free(sorter->scratch);
+    sorter->scratch = NULL;
+    sorter->scratchCapacity = 0;
+  }
+}
+
+//
+
+void
+__SBArraySortBinaryInsertion(
+  SBArraySorter*            sorter,
+  id*                       objects,
+  SBUInteger                count,
+  SBUInteger                start
+)
+{
+  if ( start == 0 )
+    start++;
+  while ( start < count ) {
+    id              pivot = objects[start];
+    SBUInteger      lo = 0, hi = start;
+
+    // Locate the rightmost position for pivot, so that equal objects keep their order:
+    while ( lo < hi ) {
+      SBUInteger    mid = lo + (hi - lo) / 2;
+
+      if ( __SBArraySorterCompare(sorter, pivot, objects[mid]) == SBOrderAscending )
+        hi = mid;
+      else
+        lo = mid + 1;
+    }
+    if ( lo < start )
+      memmove(objects + lo + 1, objects + lo, (start - lo) * sizeof(id));
+    objects[lo] = pivot;
+    start++;
+  }
+}
+
+//
+
+SBUInteger
+__SBArraySortCountRun(
+  SBArraySorter*            sorter,
+  id*                       objects,
+  SBUInteger                count
+)
+{
+  SBUInteger        runLength = 2;
+
+  if ( count < 2 )
+    return count;
+
+  if ( __SBArraySorterCompare(sorter, objects[1], objects[0]) == SBOrderAscending ) {
+    // Strictly descending; stability means we cannot include equal objects:
+    while ( (runLength < count) && (__SBArraySorterCompare(sorter, objects[runLength], objects[runLength - 1]) == SBOrderAscending) )
+      runLength++;
+
+    SBUInteger      lo = 0, hi = runLength - 1;
+
+    while ( lo < hi ) {
+      id            tmp = objects[lo];
+
+      objects[lo++] = objects[hi];
+      objects[hi--] = tmp;
+    }
+  } else {
+    while ( (runLength < count) && (__SBArraySorterCompare(sorter, objects[runLength], objects[runLength - 1]) != SBOrderAscending) )
+      runLength++;
+  }
+  return runLength;
+}
+
+//
+
+SBUInteger
+__SBArraySortMinRunLength(
+  SBUInteger                count
+)
+{
+  SBUInteger        r = 0;
+
+  while ( count >= SBArraySortMinMerge ) {
+    r |= (count & 1);
+    count >>= 1;
+  }
+  return count + r;
+}
+
+//
+
+void
+__SBArraySortMerge(
+  SBArraySorter*            sorter,
+  id*                       objects,
+  SBUInteger                length1,
+  SBUInteger                length2
+)
+{
+  id*               run1 = objects;
+  id*               run2 = objects + length1;
+  SBUInteger        lo, hi;
+
+  // Objects at the head of run1 which are no greater than run2[0] are already in place:
+  lo = 0; hi = length1;
+  while ( lo < hi ) {
+    SBUInteger      mid = lo + (hi - lo) / 2;
+
+    if ( __SBArraySorterCompare(sorter, run2[0], run1[mid]) == SBOrderAscending )
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  run1 += lo;
+  length1 -= lo;
+  if ( length1 == 0 )
+    return;
+
+  // Objects at the tail of run2 which are no less than the last object of run1 are
+  // also already in place:
+  lo = 0; hi = length2;
+  while ( lo < hi ) {
+    SBUInteger      mid = lo + (hi - lo) / 2;
+
+    if ( __SBArraySorterCompare(sorter, run2[mid], run1[length1 - 1]) == SBOrderAscending )
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  length2 = lo;
+  if ( length2 == 0 )
+    return;
+
+  if ( ! __SBArraySorterEnsureScratch(sorter, ( length1 <= length2 ? length1 : length2 )) ) {
+    // No scratch space; insert run2 into run1 the slow way:
+    __SBArraySortBinaryInsertion(sorter, run1, length1 + length2, length1);
+    return;
+  }
+
+  if ( length1 <= length2 ) {
+    // Merge forward with run1 in scratch space:
+    id*             a = sorter->scratch;
+    id*             aMax = a + length1;
+    id*             b = run2;
+    id*             bMax = run2 + length2;
+    id*             dst = run1;
+
+    memcpy(a, run1, length1 * sizeof(id));
+    while ( (a < aMax) && (b < bMax) ) {
+      if ( __SBArraySorterCompare(sorter, *b, *a) == SBOrderAscending )
+        *dst++ = *b++;
+      else
+        *dst++ = *a++;
+    }
+    if ( a < aMax )
+      memcpy(dst, a, (aMax - a) * sizeof(id));
+  } else {
+    // Merge backward with run2 in scratch space:
+    id*             a = run1 + length1;
+    id*             b = sorter->scratch + length2;
+    id*             dst = run2 + length2;
+
+    memcpy(sorter->scratch, run2, length2 * sizeof(id));
+    while ( (a > run1) && (b > sorter->scratch) ) {
+      if ( __SBArraySorterCompare(sorter, *(b - 1), *(a - 1)) == SBOrderAscending )
+        *--dst = *--a;
+      else
+        *--dst = *--b;
+    }
+    if ( b > sorter->scratch )
+      memcpy(run1, sorter->scratch, (b - sorter->scratch) * sizeof(id));
+  }
+}
+
+//
+
+void
+__SBArraySortObjects(
+  SBArraySorter*            sorter,
+  id*                       objects,
+  SBUInteger                count
+)
+{
+  SBUInteger        runBase[SBArraySortMaxRuns];
+  SBUInteger        runLength[SBArraySortMaxRuns];
+  SBUInteger        runCount = 0;
+  SBUInteger        minRun, lo = 0, remaining = count;
+
+  if ( count < 2 )
+    return;
+
+  if ( count < SBArraySortMinMerge ) {
+    __SBArraySortBinaryInsertion(sorter, objects, count, __SBArraySortCountRun(sorter, objects, count));
+    return;
+  }
+
+  minRun = __SBArraySortMinRunLength(count);
+  while ( remaining ) {
+    SBUInteger      length = __SBArraySortCountRun(sorter, objects + lo, remaining);
+
+    // Extend short runs to minRun:
+    if ( length < minRun ) {
+      SBUInteger    forced = ( remaining <= minRun ? remaining : minRun );
+
+      __SBArraySortBinaryInsertion(sorter, objects + lo, forced, length);
+      length = forced;
+    }
+    runBase[runCount] = lo;
+    runLength[runCount++] = length;
+
+    // Restore the run-stack invariants:
+    while ( runCount > 1 ) {
+      SBUInteger    n = runCount - 2;
+
+      if ( ((n > 0) && (runLength[n - 1] <= runLength[n] + runLength[n + 1])) || ((n > 1) && (runLength[n - 2] <= runLength[n - 1] + runLength[n])) ) {
+        if ( runLength[n - 1] < runLength[n + 1] )
+          n--;
+      } else if ( runLength[n] > runLength[n + 1] ) {
         break;
       }
+      __SBArraySortMerge(sorter, objects + runBase[n], runLength[n], runLength[n + 1]);
+      runLength[n] += runLength[n + 1];
+      if ( n + 2 < runCount ) {
+        runBase[n + 1] = runBase[n + 2];
+        runLength[n + 1] = runLength[n + 2];
+      }
+      runCount--;
     }
-    i++;
+    lo += length;
+    remaining -= length;
+  }
+
+  // Merge whatever remains on the stack:
+  while ( runCount > 1 ) {
+    SBUInteger      n = runCount - 2;
+
+    if ( (n > 0) && (runLength[n - 1] < runLength[n + 1]) )
+      n--;
+    __SBArraySortMerge(sorter, objects + runBase[n], runLength[n], runLength[n + 1]);
+    runLength[n] += runLength[n + 1];
+    if ( n + 2 < runCount ) {
+      runBase[n + 1] = runBase[n + 2];
+      runLength[n + 1] = runLength[n + 2];
+    }
+    runCount--;
   }
 }
 
 //
 
+typedef struct _SBArraySortTask {
+  SBArraySorter             sorter;
+  id*                       objects;
+  SBUInteger                length1;
+  SBUInteger                length2;
+  pthread_t                 thread;
+  BOOL                      isThreaded;
+} SBArraySortTask;
+
+void*
+__SBArraySortTaskMain(
+  void*                     task
+)
+{
+  SBArraySortTask*          theTask = (SBArraySortTask*)task;
+
+  if ( theTask->length2 )
+    __SBArraySortMerge(&theTask->sorter, theTask->objects, theTask->length1, theTask->length2);
+  else
+    __SBArraySortObjects(&theTask->sorter, theTask->objects, theTask->length1);
+  return NULL;
+}
+
+//
+
 void
-__SBMutableArray_General_InsertionSortWithSel(
-  SBMutableArray*             array,
-  SBUInteger                  left,
-  SBUInteger                  right,
-  SEL                         comparator
+__SBArraySortObjectsConcurrently(
+  SBArraySorter*            sorter,
+  id*                       objects,
+  SBUInteger                count
 )
 {
-  SBUInteger        i = left + 1;
-  
-  while ( i <= right ) {
-    id              iTarget = [array objectAtIndex:i];
-    SBUInteger      j = i - 1;
-    
-    while ( j != SBUIntegerMax ) {
-      id            jTarget = [array objectAtIndex:j];
-      
-      if ( ((SBComparisonResult)[jTarget perform:comparator with:iTarget]) == SBOrderDescending ) {
-        [array exchangeObjectAtIndex:j withObjectAtIndex:(j + 1)];
-        j--;
+  long                      cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  SBUInteger                chunks = 1;
+
+  while ( (chunks < SBArrayConcurrentSortMaxThreads) && (2 * chunks <= cpus) )
+    chunks *= 2;
+
+  if ( (count < SBArrayConcurrentSortThreshold) || (chunks < 2) ) {
+    __SBArraySortObjects(sorter, objects, count);
+    return;
+  }
+
+  SBArraySortTask           tasks[SBArrayConcurrentSortMaxThreads];
+  SBUInteger                bounds[SBArrayConcurrentSortMaxThreads + 1];
+  SBUInteger                i, width;
+
+  for ( i = 0; i <= chunks; i++ )
+    bounds[i] = (count * i) / chunks;
+
+  // Each chunk is sorted by its own thread; every thread gets a private copy of the
+  // sorter so that scratch space and the IMP cache are not shared:
+  for ( width = 1; width < 2 * chunks; width *= 2 ) {
+    SBUInteger              taskCount = 0;
+
+    for ( i = 0; i < chunks; i += width ) {
+      SBArraySortTask*      task = &tasks[taskCount++];
+
+      __SBArraySorterInitWithFn(&task->sorter, sorter->function, sorter->context);
+      task->sorter.selector = sorter->selector;
+      task->objects = objects + bounds[i];
+      if ( width == 1 ) {
+        task->length1 = bounds[i + 1] - bounds[i];
+        task->length2 = 0;
       } else {
-        break;
+        task->length1 = bounds[i + width / 2] - bounds[i];
+        task->length2 = bounds[i + width] - bounds[i + width / 2];
+      }
+      task->isThreaded = NO;
+    }
+    for ( i = 1; i < taskCount; i++ )
+      tasks[i].isThreaded = ( pthread_create(&tasks[i].thread, NULL, __SBArraySortTaskMain, &tasks[i]) == 0 );
+    for ( i = 0; i < taskCount; i++ ) {
+      if ( tasks[i].isThreaded )
+        pthread_join(tasks[i].thread, NULL);
+      else
+        __SBArraySortTaskMain(&tasks[i]);
+      __SBArraySorterDealloc(&tasks[i].sorter);
+    }
+    if ( taskCount == 1 )
+      break;
+  }
+}
+
+//
+
+void
+__SBArraySortWithOptions(
+  SBArraySorter*            sorter,
+  id*                       objects,
+  SBUInteger                count,
+  SBArraySortOptions        options
+)
+{
+  if ( options & SBArraySortConcurrent )
+    __SBArraySortObjectsConcurrently(sorter, objects, count);
+  else
+    __SBArraySortObjects(sorter, objects, count);
+  __SBArraySorterDealloc(sorter);
+}
+
+//
+
+void
+__SBMutableArray_General_Sort(
+  SBMutableArray*           array,
+  SBArraySorter*            sorter,
+  SBArraySortOptions        options
+)
+{
+  SBUInteger        count = [array count];
+
+  if ( count > 1 ) {
+    id*             objects = objc_malloc(count * sizeof(id));
+
+    if ( objects ) {
+      SBUInteger    i;
+
+      // Hold a reference to every object while the array is being rewritten:
+      [array getObjects:objects];
+      for ( i = 0; i < count; i++ )
+        [objects[i] retain];
+
+      __SBArraySortWithOptions(sorter, objects, count, options);
+
+      for ( i = 0; i < count; i++ ) {
+        if ( [array objectAtIndex:i] != objects[i] )
+          [array replaceObject:objects[i] atIndex:i];
       }
+      for ( i = 0; i < count; i++ )
+        [objects[i] release];
+      objc_free(objects);
     }
-    i++;
   }
 }
 
+//
+
 @implementation SBMutableArray
 
   + (id) allocWithCapacity:(SBUInteger)capacity
@@ -1827,20 +2256,37 @@ __SBMutableArray_General_InsertionSortWithSel(
   - (void) sortUsingFunction:(SBArraySortComparator)comparator
     context:(void *)context
   {
-    SBUInteger        count = [self count];
+    [self sortUsingFunction:comparator context:context options:0];
+  }
+  
+//
+
+  - (void) sortUsingFunction:(SBArraySortComparator)comparator
+    context:(void *)context
+    options:(SBArraySortOptions)options
+  {
+    SBArraySorter     sorter;
     
-    if ( count > 1 )
-      __SBMutableArray_General_InsertionSortWithFn(self, 0, count - 1, comparator, context);
+    __SBArraySorterInitWithFn(&sorter, comparator, context);
+    __SBMutableArray_General_Sort(self, &sorter, options);
   }
   
 //
 
   - (void) sortUsingSelector:(SEL)comparator
   {
-    SBUInteger        count = [self count];
+    [self sortUsingSelector:comparator options:0];
+  }
+  
+//
+
+  - (void) sortUsingSelector:(SEL)comparator
+    options:(SBArraySortOptions)options
+  {
+    SBArraySorter     sorter;
     
-    if ( count > 1 )
-      __SBMutableArray_General_InsertionSortWithSel(self, 0, count - 1, comparator);
+    __SBArraySorterInitWithSel(&sorter, comparator);
+    __SBMutableArray_General_Sort(self, &sorter, options);
   }
 
 @end
@@ -1905,114 +2351,38 @@ SBArrayBucketFindSlot(
 //
 
 void
-__SBMutableArray_Bucket_InsertionSortWithFn(
-  SBArrayBucket*              buckets,
-  SBUInteger                  left,
-  SBUInteger                  right,
-  SBArraySortComparator       comparator,
-  void*                       context
+__SBMutableArray_Bucket_Sort(
+  SBArrayBucket*            buckets,
+  SBUInteger                count,
+  SBArraySorter*            sorter,
+  SBArraySortOptions        options
 )
 {
-  SBArrayBucket*    bucket = buckets;
-  SBUInteger        i = left + 1;
-  SBUInteger        passes = right - left;
-  
-  // Locate the appropriate bucket:
-  if ( SBArrayBucketFindSlot(buckets, &bucket, &i) ) {
-    SBUInteger      backPasses = 1;
-    
-    while ( passes-- ) {
-      SBArrayBucket*  jBucket = bucket;
-      SBArrayBucket*  jLastBucket = NULL;
-      id              target = bucket->slots[i];
-      SBUInteger      j = backPasses, jIndex = i - 1;
-        
-      while ( j-- ) {
-        if ( jIndex == SBUIntegerMax ) {
-          jLastBucket = jBucket;
-          jBucket = jBucket->pLink;
-          jIndex = jBucket->used - 1;
-          if ( comparator(jBucket->slots[jIndex], target, context) == SBOrderDescending ) {
-            jLastBucket->slots[0] = jBucket->slots[jIndex];
-          } else {
-            break;
-          }
-        } else {
-          if ( comparator(jBucket->slots[jIndex], target, context) == SBOrderDescending ) {
-            jBucket->slots[jIndex + 1] = jBucket->slots[jIndex];
-            jIndex--;
-          } else {
-            break;
-          }
-        }
-      }
-      if ( jLastBucket )
-        jLastBucket->slots[0] = target;
-      else
-        jBucket->slots[jIndex + 1] = target;
-      i++;
-      backPasses++;
-      if ( i >= bucket->used ) {
+  if ( count > 1 ) {
+    id*             objects = objc_malloc(count * sizeof(id));
+
+    if ( objects ) {
+      SBArrayBucket*  bucket = buckets;
+      SBUInteger      i = 0;
+
+      // Gather the bucket slots into a flat array, sort, and scatter them back; the
+      // array's references are simply permuted so no retain/release is necessary:
+      while ( bucket && bucket->used ) {
+        memcpy(objects + i, bucket->slots, bucket->used * sizeof(id));
+        i += bucket->used;
         bucket = bucket->fLink;
-        i = 0;
       }
-    }
-  }
-}
 
-//
+      __SBArraySortWithOptions(sorter, objects, count, options);
 
-void
-__SBMutableArray_Bucket_InsertionSortWithSel(
-  SBArrayBucket*              buckets,
-  SBUInteger                  left,
-  SBUInteger                  right,
-  SEL                         comparator
-)
-{
-  SBArrayBucket*    bucket = buckets;
-  SBUInteger        i = left + 1;
-  SBUInteger        passes = right - left;
-  
-  // Locate the appropriate bucket:
-  if ( SBArrayBucketFindSlot(buckets, &bucket, &i) ) {
-    SBUInteger      backPasses = 1;
-    
-    while ( passes-- ) {
-      SBArrayBucket*  jBucket = bucket;
-      SBArrayBucket*  jLastBucket = NULL;
-      id              target = bucket->slots[i];
-      SBUInteger      j = backPasses, jIndex = i - 1;
-        
-      while ( j-- ) {
-        if ( jIndex == SBUIntegerMax ) {
-          jLastBucket = jBucket;
-          jBucket = jBucket->pLink;
-          jIndex = jBucket->used - 1;
-          if ( ((SBComparisonResult)[jBucket->slots[jIndex] perform:comparator with:target]) == SBOrderDescending ) {
-            jLastBucket->slots[0] = jBucket->slots[jIndex];
-          } else {
-            break;
-          }
-        } else {
-          if ( ((SBComparisonResult)[jBucket->slots[jIndex] perform:comparator with:target]) == SBOrderDescending ) {
-            jBucket->slots[jIndex + 1] = jBucket->slots[jIndex];
-            jIndex--;
-          } else {
-            break;
-          }
-        }
-      }
-      if ( jLastBucket )
-        jLastBucket->slots[0] = target;
-      else
-        jBucket->slots[jIndex + 1] = target;
-      i++;
-      backPasses++;
-      if ( i >= bucket->used ) {
+      bucket = buckets;
+      i = 0;
+      while ( bucket && bucket->used ) {
+        memcpy(bucket->slots, objects + i, bucket->used * sizeof(id));
+        i += bucket->used;
         bucket = bucket->fLink;
-        i = 0;
       }
+      objc_free(objects);
     }
   }
 }
@@ -3034,21 +3404,23 @@ __SBMutableArray_Bucket_InsertionSortWithSel(
 
   - (void) sortUsingFunction:(SBArraySortComparator)comparator
     context:(void *)context
+    options:(SBArraySortOptions)options
   {
-    SBUInteger        count = [self count];
+    SBArraySorter     sorter;
     
-    if ( count > 1 )
-      __SBMutableArray_Bucket_InsertionSortWithFn(_buckets, 0, count - 1, comparator, context);
+    __SBArraySorterInitWithFn(&sorter, comparator, context);
+    __SBMutableArray_Bucket_Sort(_buckets, [self count], &sorter, options);
   }
   
 //
 
   - (void) sortUsingSelector:(SEL)comparator
+    options:(SBArraySortOptions)options
   {
-    SBUInteger        count = [self count];
+    SBArraySorter     sorter;
     
-    if ( count > 1 )
-      __SBMutableArray_Bucket_InsertionSortWithSel(_buckets, 0, count - 1, comparator);
+    __SBArraySorterInitWithSel(&sorter, comparator);
+    __SBMutableArray_Bucket_Sort(_buckets, [self count], &sorter, options);
   }
 
 @end
@@ -27,14 +27,18 @@
     SBAutoreleasePool allocation is per-thread.  If you use SBThread to create and
     execute in a thread, that thread has it's own autorelease state and you must
     create/destroy SBAutoreleasePool instances as necessary within the thread itself.
+    
+    All of a thread's pools share a single stack of autoreleased objects, kept in
+    fixed-size pages.  Creating a pool pushes a boundary marker onto the stack;
+    releasing the pool releases every object above its marker.  Autoreleasing an
+    object just stores it at the top of the thread's current page.
 */
 @interface SBAutoreleasePool : SBObject
 {
-  SBAutoreleasePool*              _parent;
-  SBAutoreleasePool*              _child;
-  struct _SBAutoreleasePoolNode*  _pool;
-  struct _SBAutoreleasePoolNode*  _poolHead;
-  SBUInteger                      _objectCount;
+  SBAutoreleasePool*                _parent;
+  SBAutoreleasePool*                _child;
+  struct _SBAutoreleasePoolStack*   _stack;
+  id*                               _boundary;
 }
 
 /*!
@@ -47,7 +51,8 @@
 /*!
   @method addObject:
   @discussion
-    Add anObject to this autorelease pool.
+    Add anObject to the current thread's current autorelease pool -- which should be
+    the receiver, since objects are always added to the innermost pool.
 */
 - (void) addObject:(id)anObject;
 
@@ -61,3 +66,12 @@
 - (void) drain;
 
 @end
+
+/*!
+  @function SBAutoreleasePoolAddObject
+  @discussion
+    Add anObject to the current thread's current autorelease pool.  This is what
+    SBObject's autorelease method does; it's cheaper than the addObject: class method
+    since there's no message dispatch involved.
+*/
+extern void SBAutoreleasePoolAddObject(id anObject);
@@ -13,53 +13,260 @@
 #import "SBAutoreleasePool.h"
 #import "SBThread.h"
 
-#ifndef INITIAL_AUTORELEASEPOOL_SIZE
-#define INITIAL_AUTORELEASEPOOL_SIZE 512
+#ifndef SBAUTORELEASEPOOL_PAGE_SIZE
+#define SBAUTORELEASEPOOL_PAGE_SIZE 4096
 #endif
 
-typedef struct _SBAutoreleasePoolNode {
-  struct _SBAutoreleasePoolNode*    link;
-  SBUInteger                        capacity;
-  SBUInteger                        count;
+//
+// Autoreleased objects live on a per-thread stack made of fixed-size pages.  Each pool
+// pushes a nil boundary marker and remembers where it went; popping the pool releases
+// everything above the marker.  Pages are chained in both directions, and the page above
+// the hot page is kept around (empty) so that a loop which keeps crossing a page boundary
+// doesn't malloc and free a page every time through.
+//
+typedef struct _SBAutoreleasePoolPage {
+  struct _SBAutoreleasePoolPage*    parent;
+  struct _SBAutoreleasePoolPage*    child;
+  id*                               next;
+  id*                               end;
   id                                objects[0];
-} SBAutoreleasePoolNode;
+} SBAutoreleasePoolPage;
 
+typedef struct _SBAutoreleasePoolStack {
+  SBAutoreleasePoolPage*            hotPage;    // NULL when no pool is in place
+  SBAutoreleasePoolPage*            rootPage;
+  SBUInteger                        depth;      // number of boundary markers on the stack
+  BOOL                              ownerExited;
+} SBAutoreleasePoolStack;
+
+//
+// The thread's stack is found through a thread-local pointer; the pthread key exists to
+// clean up after threads which exit.  Define SBAUTORELEASEPOOL_NO_TLS for compilers without
+// __thread support.
 //
+static pthread_key_t          __SBAutoreleasePoolStackKey;
+static pthread_once_t         __SBAutoreleasePoolStackKeyOnce = PTHREAD_ONCE_INIT;
 
-SBAutoreleasePoolNode*
-__SBAutoreleasePoolNodeAlloc(
-  SBUInteger        capacity
+#ifndef SBAUTORELEASEPOOL_NO_TLS
+static __thread SBAutoreleasePoolStack* __SBAutoreleasePoolTLSStack = NULL;
+#  define SBAutoreleasePoolCurrentStack()   (__SBAutoreleasePoolTLSStack)
+#else
+#  define SBAutoreleasePoolCurrentStack()   ((SBAutoreleasePoolStack*)pthread_getspecific(__SBAutoreleasePoolStackKey))
+#endif
+
+//
+
+SBAutoreleasePoolPage*
+__SBAutoreleasePoolPageAlloc(
+  SBAutoreleasePoolPage*  parent
 )
 {
-  SBAutoreleasePoolNode*    newNode = objc_malloc(sizeof(SBAutoreleasePoolNode) + capacity * sizeof(id));
+  SBAutoreleasePoolPage*  newPage = objc_malloc(SBAUTORELEASEPOOL_PAGE_SIZE);
   
-  if ( newNode ) {
+  if ( newPage ) {
 #ifdef SBAUTORELEASEPOOL_DEBUG
-    fprintf(stderr, "SBAutoreleasePool:  new node %p (%u capacity)\n", newNode, capacity);
+    fprintf(stderr, "SBAutoreleasePool:  new page %p\n", newPage);
 #endif
-    newNode->link = NULL;
-    newNode->capacity = capacity;
-    newNode->count = 0;
+    newPage->parent = parent;
+    newPage->child = NULL;
+    newPage->next = newPage->objects;
+    newPage->end = (id*)((char*)newPage + SBAUTORELEASEPOOL_PAGE_SIZE);
+    if ( parent )
+      parent->child = newPage;
+  } else {
+    exit(ENOMEM);
   }
-  return newNode;
+  return newPage;
 }
 
 //
 
 void
-__SBAutoreleasePoolNodeDrain(
-  SBAutoreleasePoolNode*  aPoolNode
+__SBAutoreleasePoolPageFreeChain(
+  SBAutoreleasePoolPage*  aPage
 )
 {
-  SBUInteger        i = aPoolNode->count;
+  while ( aPage ) {
+    SBAutoreleasePoolPage*  next = aPage->child;
   
 #ifdef SBAUTORELEASEPOOL_DEBUG
-  fprintf(stderr, "SBAutoreleasePool:  draining node %p (%u objects)\n", aPoolNode, i);
+    fprintf(stderr, "SBAutoreleasePool:  free page %p\n", aPage);
 #endif
-  while ( i-- ) {
-    [aPoolNode->objects[i] release];
+    objc_free(aPage);
+    aPage = next;
+  }
+}
+
+//
+
+void
+__SBAutoreleasePoolStackDestroy(
+  void*                   aStack
+)
+{
+  SBAutoreleasePoolStack* stack = (SBAutoreleasePoolStack*)aStack;
+
+  //
+  // A thread that exits with pools still in place leaves them to whoever releases them
+  // (e.g. the SBThread's dealloc), so the stack has to stick around; the pop that takes
+  // it back to zero depth frees it:
+  //
+  if ( stack->depth == 0 ) {
+    __SBAutoreleasePoolPageFreeChain(stack->rootPage);
+    objc_free(stack);
+  } else {
+    stack->ownerExited = YES;
+  }
+}
+
+//
+
+void
+__SBAutoreleasePoolStackKeyInit(void)
+{
+  pthread_key_create(&__SBAutoreleasePoolStackKey, __SBAutoreleasePoolStackDestroy);
+}
+
+//
+
+SBAutoreleasePoolStack*
+__SBAutoreleasePoolStackForCurrentThread(void)
+{
+  SBAutoreleasePoolStack* stack = SBAutoreleasePoolCurrentStack();
+
+  if ( ! stack ) {
+    pthread_once(&__SBAutoreleasePoolStackKeyOnce, __SBAutoreleasePoolStackKeyInit);
+    if ( ! (stack = objc_calloc(1, sizeof(SBAutoreleasePoolStack))) )
+      exit(ENOMEM);
+    pthread_setspecific(__SBAutoreleasePoolStackKey, stack);
+#ifndef SBAUTORELEASEPOOL_NO_TLS
+    __SBAutoreleasePoolTLSStack = stack;
+#endif
+  }
+  return stack;
+}
+
+//
+
+id*
+__SBAutoreleasePoolStackAdd(
+  SBAutoreleasePoolStack* stack,
+  id                      anObject
+)
+{
+  SBAutoreleasePoolPage*  page = stack->hotPage;
+
+  if ( page->next == page->end ) {
+    // Move up to the spare page, or add one:
+    if ( (page = page->child) )
+      page->next = page->objects;
+    else
+      page = __SBAutoreleasePoolPageAlloc(stack->hotPage);
+    stack->hotPage = page;
+  }
+  *page->next = anObject;
+  return page->next++;
+}
+
+//
+
+id*
+__SBAutoreleasePoolStackPush(
+  SBAutoreleasePoolStack* stack
+)
+{
+  if ( ! stack->hotPage ) {
+    if ( ! stack->rootPage )
+      stack->rootPage = __SBAutoreleasePoolPageAlloc(NULL);
+    stack->hotPage = stack->rootPage;
+  }
+  stack->depth++;
+  return __SBAutoreleasePoolStackAdd(stack, nil);
+}
+
+//
+
+BOOL
+__SBAutoreleasePoolStackPop(
+  SBAutoreleasePoolStack* stack,
+  id*                     boundary
+)
+{
+  SBAutoreleasePoolPage*  page;
+
+  //
+  // One slot at a time, re-reading the hot page each time around:  releasing an object
+  // can autorelease others, which land on top of the stack and get released in turn.
+  //
+  while ( (page = stack->hotPage) ) {
+    id*                   slot;
+    id                    anObject;
+
+    if ( page->next == page->objects ) {
+      if ( ! page->parent )
+        break;
+      stack->hotPage = page->parent;
+      continue;
+    }
+    slot = --page->next;
+    anObject = *slot;
+    if ( anObject ) {
+      [anObject release];
+    } else {
+      stack->depth--;
+      if ( slot == boundary )
+        break;
+    }
+  }
+
+  if ( stack->depth == 0 ) {
+    // Last pool of a thread that has already exited:
+    if ( stack->ownerExited ) {
+      __SBAutoreleasePoolPageFreeChain(stack->rootPage);
+      objc_free(stack);
+      return YES;
+    }
+    stack->hotPage = NULL;
+    page = stack->rootPage;
+  } else {
+    page = stack->hotPage;
+  }
+
+  // Keep one spare page above the hot one:
+  if ( page && page->child && page->child->child ) {
+    __SBAutoreleasePoolPageFreeChain(page->child->child);
+    page->child->child = NULL;
+  }
+  return NO;
+}
+
+//
+
+void
+SBAutoreleasePoolAddObject(
+  id                      anObject
+)
+{
+  SBAutoreleasePoolStack* stack = SBAutoreleasePoolCurrentStack();
+  SBAutoreleasePoolPage*  page;
+
+  if ( ! anObject )
+    return;
+
+  // The common case:  room on the hot page:
+  if ( stack && (page = stack->hotPage) && (page->next < page->end) ) {
+    *page->next++ = anObject;
+    return;
+  }
+
+  if ( stack && stack->hotPage ) {
+    __SBAutoreleasePoolStackAdd(stack, anObject);
+  } else {
+    SBAutoreleasePool*    tmpPool = [[SBAutoreleasePool alloc] init];
+
+    [SBException raise:SBAutoreleaseException format:"No autorelease pool in place.  Thread = %p, object = %p.", [SBThread currentThread], (void*)anObject];
+    [tmpPool release];
   }
-  aPoolNode->count = 0;
 }
 
 //
@@ -78,24 +285,9 @@ __SBAutoreleasePoolNodeDrain(
 
   - (void) reallyDealloc
   {
-    SBAutoreleasePoolNode*    next;
-    
 #ifdef SBAUTORELEASEPOOL_DEBUG
     fprintf(stderr, "SBAutoreleasePool:  reallyDealloc %p\n", self);
 #endif
-    
-    //
-    // the "drain" method is invoked prior to calling reallyDealloc, so
-    // _pool is empty:
-    //
-    while ( _poolHead ) {
-      next = _poolHead->link;
-#ifdef SBAUTORELEASEPOOL_DEBUG
-      fprintf(stderr, "SBAutoreleasePool:  reallyDealloc, node %p\n", _poolHead);
-#endif
-      objc_free(_poolHead);
-      _poolHead = next;
-    }
     [super dealloc];
   }
 
@@ -124,7 +316,7 @@ __SBAutoreleasePoolNodeDrain(
       fprintf(stderr, "SBAutoreleasePool:  cached alloc %p\n", newPool);
 #endif
     } else {
-      newPool = class_create_instance(self);
+      newPool = [super alloc];
 #ifdef SBAUTORELEASEPOOL_DEBUG
       fprintf(stderr, "SBAutoreleasePool:  alloc %p\n", newPool);
 #endif
@@ -138,27 +330,23 @@ __SBAutoreleasePoolNodeDrain(
   {
     SBAutoreleaseState*       curThreadState = (&(([SBThread currentThread])->_autoreleaseState));
     
-    if ( ! _poolHead ) {
+    if ( ! _stack ) {
 #ifdef SBAUTORELEASEPOOL_DEBUG
       fprintf(stderr, "SBAutoreleasePool:  init %p\n", self);
 #endif
       if ( ! (self = [super init]) ) {
         return nil;
       }
-      _pool = __SBAutoreleasePoolNodeAlloc(INITIAL_AUTORELEASEPOOL_SIZE);
+      _stack = __SBAutoreleasePoolStackForCurrentThread();
     } else {
-      SBAutoreleasePoolNode*    next = _poolHead->link;
-      
 #ifdef SBAUTORELEASEPOOL_DEBUG
       fprintf(stderr, "SBAutoreleasePool:  cached init %p\n", self);
 #endif
-      _pool = _poolHead;
-      _pool->link = NULL;
-      _pool->count = 0;
-      _poolHead = next;
+      // A pool released on behalf of an exited thread may still point at that thread's
+      // stack (which is freed once its last pool is gone):
+      _stack = __SBAutoreleasePoolStackForCurrentThread();
     }
-    
-    _objectCount = 0;
+    _boundary = __SBAutoreleasePoolStackPush(_stack);
     
     // Setup thread state:
     _child = nil;
@@ -173,52 +361,14 @@ __SBAutoreleasePoolNodeDrain(
 
   + (void) addObject:(id)anObject
   {
-    SBThread*                 curThread = [SBThread currentThread];
-    
-    SBAssert(curThread, "No current thread defined??");
-    
-    SBAutoreleaseState*       curThreadState = (&((curThread)->_autoreleaseState));
-    
-    SBAssert(curThreadState, "No current state for thread???");
-    if ( curThreadState->current ) {
-      [curThreadState->current addObject:anObject];
-    } else {
-      SBAutoreleasePool*      tmpPool = [[SBAutoreleasePool alloc] init];
-      
-      [SBException raise:SBAutoreleaseException format:"No autorelease pool in place.  Thread = %p, object = %p.", [SBThread currentThread], (void*)anObject];
-      [tmpPool release];
-    }
+    SBAutoreleasePoolAddObject(anObject);
   }
   
 //
 
   - (void) addObject:(id)anObject
   {
-    // Have we saturated the current node?
-    if ( _pool->count == _pool->capacity ) {
-      if ( _poolHead ) {
-        SBAutoreleasePoolNode*      next = _poolHead->link;
-        
-#ifdef SBAUTORELEASEPOOL_DEBUG
-        fprintf(stderr, "SBAutoreleasePool:  cached node %p\n", _poolHead);
-#endif
-        _poolHead->link = _pool;
-        _poolHead->count = 0;
-        _pool = _poolHead;
-        _poolHead = next;
-      } else {
-        SBAutoreleasePoolNode*      next = __SBAutoreleasePoolNodeAlloc(_pool->capacity * 2);
-        
-        if ( next ) {
-          next->link = _pool;
-          _pool = next;
-        } else {
-          exit(ENOMEM);
-        }
-      }
-    }
-    _pool->objects[_pool->count++] = anObject;
-    _objectCount++;
+    SBAutoreleasePoolAddObject(anObject);
   }
   
 //
@@ -231,16 +381,12 @@ __SBAutoreleasePoolNodeDrain(
     if ( _child )
       [_child dealloc];
     
-    // Drain each of our pool nodes and attach them to the pool-of-pools chain:
-    while ( _pool ) {
-      SBAutoreleasePoolNode*    next = _pool->link;
-      
-      __SBAutoreleasePoolNodeDrain(_pool);
-      _pool->link = _poolHead;
-      _poolHead = _pool;
-      _pool = next;
+    // Release everything above our boundary marker:
+    if ( _boundary ) {
+      if ( __SBAutoreleasePoolStackPop(_stack, _boundary) )
+        _stack = NULL;
+      _boundary = NULL;
     }
-    _objectCount = 0;
     
     // Set the thread to be using our parent as the current pool and be
     // sure that parent doesn't reference us as a child anymore:
@@ -299,20 +445,20 @@ __SBAutoreleasePoolNodeDrain(
 
   - (void) drain
   {
-    // If we have children, they must be dumped first:
-    if ( _child )
-      [_child drain];
+    SBAutoreleasePool*    pool = self;
     
-    // Drain each of our pool nodes and attach them to the pool-of-pools chain:
-    while ( _pool ) {
-      SBAutoreleasePoolNode*    next = _pool->link;
-      
-      __SBAutoreleasePoolNodeDrain(_pool);
-      _pool->link = _poolHead;
-      _poolHead = _pool;
-      _pool = next;
+    //
+    // Popping to our boundary takes our children's markers with it, so put them all back
+    // (in order) once the objects are gone:
+    //
+    if ( _boundary ) {
+      if ( __SBAutoreleasePoolStackPop(_stack, _boundary) )
+        _stack = __SBAutoreleasePoolStackForCurrentThread();
+      while ( pool ) {
+        pool->_boundary = __SBAutoreleasePoolStackPush(_stack);
+        pool = pool->_child;
+      }
     }
-    _objectCount = 0;
   }
 
 @end
@@ -167,7 +167,7 @@ SBBasicHashTableAddPair(
     // Find the table index to use:
     hash = (hash % aTable->tableCapacity);
     while ( aTable->table[hash].key ) {
-      if ( [aTable->table[hash].key isEqual:key] ) {
+      if ( (aTable->table[hash].key == key) || [aTable->table[hash].key isEqual:key] ) {
         object = [object retain];
         [aTable->table[hash].object release];
         aTable->table[hash].object = object;
@@ -200,7 +200,7 @@ SBBasicHashTableFindPairForKey(
     // Find the table index to start searching from:
     startIdx = ( hash = (hash % aTable->tableCapacity) );
     while ( aTable->table[hash].key ) {
-      if ( [aTable->table[hash].key isEqual:key] )
+      if ( (aTable->table[hash].key == key) || [aTable->table[hash].key isEqual:key] )
         return &aTable->table[hash];
       if ( ++hash == aTable->tableCapacity )
         hash = 0;
@@ -1045,7 +1045,7 @@ SBBasicHashTableFindPairForKey(
 
   - (id) objectForKey:(id)aKey
   {
-    if ( _table.base.keyCount && [_table.key isEqual:aKey] )
+    if ( _table.base.keyCount && ((_table.key == aKey) || [_table.key isEqual:aKey]) )
       return _table.pair.object;
     return nil;
   }
@@ -1253,149 +1253,252 @@ SBBasicHashTableFindPairForKey(
 #pragma mark -
 //
 
-typedef struct _SBMutableHashPair {
-  id                              key;
-  id                              object;
-  struct _SBMutableHashPair*      link;
-} SBMutableHashPair;
+//
+// The mutable dictionary is backed by a flat, open-addressing hash table using
+// Robin Hood linear probing.  Every slot retains the (mixed) hash of its key so
+// that a probe can reject a mismatch without messaging the key, and a parallel
+// array of control words holds each slot's probe distance (zero = empty).  The
+// key-value pairs themselves live in one contiguous block, so a lookup touches
+// a handful of adjacent cache lines rather than chasing a chain of pairs.
+//
+// Growing the table is incremental:  the outgrown table is kept alongside its
+// replacement and a few of its slots are migrated on every subsequent mutation
+// rather than re-hashing every pair at once.
+//
+
+#define SBOpenHashTableMinCapacity        16
+#define SBOpenHashTableMaxDistance        0xFFFF
+#define SBOpenHashTableRehashStep         8
+
+typedef unsigned short SBOpenHashControl;
+
+typedef struct _SBOpenHashSlot {
+  SBUInteger          hash;
+  id                  key;
+  id                  object;
+} SBOpenHashSlot;
+
+typedef struct _SBOpenHashTable {
+  SBUInteger          capacity;
+  SBUInteger          mask;
+  SBUInteger          count;
+  SBUInteger          growThreshold;
+  SBOpenHashSlot*     slots;
+  SBOpenHashControl*  control;
+} SBOpenHashTable;
 
 //
 
-SBMutableHashPair*
-SBMutableHashPairFindKey(
-  SBMutableHashPair*    aPair,
-  id                    key
+static inline
+SBUInteger
+SBOpenHashMix(
+  SBUInteger        hash
 )
 {
-  while ( aPair ) {
-    if ( [aPair->key isEqual:key] )
-      return aPair;
-    aPair = aPair->link;
-  }
-  return NULL;
+  //  Many of our hash functions (e.g. SBNumber's) cluster in the low-order
+  //  bits; scramble them so a power-of-two mask spreads keys evenly:
+#if SB64BitIntegers
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdUL;
+  hash ^= hash >> 33;
+#else
+  hash ^= hash >> 16;
+  hash *= 0x85ebca6bU;
+  hash ^= hash >> 13;
+#endif
+  return hash;
+}
+
+//
+
+SBUInteger
+SBOpenHashTableCapacityForCount(
+  SBUInteger        count
+)
+{
+  SBUInteger        capacity = SBOpenHashTableMinCapacity;
+
+  //  Keep the load factor at or below 80%:
+  while ( (capacity - capacity / 5) < count )
+    capacity <<= 1;
+  return capacity;
 }
 
 //
 
-SBMutableHashPair*
-SBMutableHashPairFindObject(
-  SBMutableHashPair*    aPair,
-  id                    object
+SBOpenHashTable*
+SBOpenHashTableCreate(
+  SBUInteger        capacity
 )
 {
-  while ( aPair ) {
-    if ( [aPair->object isEqual:object] )
-      return aPair;
-    aPair = aPair->link;
+  SBOpenHashTable*  newTable = NULL;
+  SBUInteger        byteSize = sizeof(SBOpenHashTable) + capacity * (sizeof(SBOpenHashSlot) + sizeof(SBOpenHashControl));
+
+  if ( (newTable = (SBOpenHashTable*)objc_calloc(1, byteSize)) ) {
+    newTable->capacity = capacity;
+    newTable->mask = capacity - 1;
+    newTable->growThreshold = capacity - capacity / 5;
+    newTable->slots = (SBOpenHashSlot*)(((void*)newTable) + sizeof(SBOpenHashTable));
+    newTable->control = (SBOpenHashControl*)(newTable->slots + capacity);
   }
-  return NULL;
+  return newTable;
 }
 
 //
 
-typedef struct _SBMutableHashPairPool {
-  SBUInteger                      pairCapacity;
-  SBMutableHashPair*              pairs;
-  SBUInteger                      tableCapacity;
-  SBMutableHashPair**             table;
-  struct _SBMutableHashPairPool*  link;
-} SBMutableHashPairPool;
+static inline
+SBOpenHashSlot*
+SBOpenHashTableFind(
+  SBOpenHashTable*  table,
+  SBUInteger        hash,
+  id                key
+)
+{
+  SBUInteger        index = hash & table->mask;
+  SBUInteger        distance = 1;
+
+  //  Robin Hood invariant:  once we reach a slot whose occupant is closer to its
+  //  home than we would be, the key cannot be further along:
+  while ( table->control[index] >= distance ) {
+    SBOpenHashSlot* slot = table->slots + index;
+
+    if ( (slot->hash == hash) && slot->key && ((slot->key == key) || [slot->key isEqual:key]) )
+      return slot;
+    index = (index + 1) & table->mask;
+    distance++;
+  }
+  return NULL;
+}
 
 //
 
 BOOL
-SBMutableHashPairPoolAlloc(
-  SBMutableHashPairPool**   topPool,
-  SBUInteger                pairCapacity
+SBOpenHashTableInsert(
+  SBOpenHashTable*  table,
+  SBUInteger        hash,
+  id                key,
+  id                object
 )
 {
-  SBMutableHashPairPool*    newPool = NULL;
-  SBInteger                 bytes = sizeof(SBMutableHashPairPool);
-  SBUInteger                tableCapacity = SBHashTableMultiplier * pairCapacity;
-  
-  //  Account for the number of pairs we're looking to create:
-  bytes += pairCapacity * sizeof(SBMutableHashPair);
-  
-  //  Account for the added table space:
-  bytes += tableCapacity * sizeof(SBMutableHashPair*);
-  
-  //  Allocate the pool:
-  newPool = (SBMutableHashPairPool*)objc_calloc(1, bytes);
-  
-  if ( newPool ) {
-    SBMutableHashPair*      pairs = (SBMutableHashPair*)(((void*)newPool) + sizeof(SBMutableHashPairPool));
-    SBMutableHashPair**     table = (SBMutableHashPair**)(pairs + pairCapacity);
-    
-    newPool->pairCapacity = pairCapacity;
-    newPool->pairs = pairs;
-    newPool->tableCapacity = tableCapacity;
-    newPool->table = table;
-    
-    if ( *topPool )
-      (*topPool)->link = newPool;
-    *topPool = newPool;
-      
-    
-    // Initialize the buckets:
-    while ( --pairCapacity > 0 ) {
-      pairs->link = pairs + 1;
-      pairs++;
-    }
-    return YES;
+  SBUInteger        index = hash & table->mask;
+  SBUInteger        distance = 1;
+  SBUInteger        end;
+
+  //  Locate the insertion point:  the first slot whose occupant is closer to its
+  //  home than the new pair would be:
+  while ( table->control[index] >= distance ) {
+    index = (index + 1) & table->mask;
+    distance++;
   }
-  return NO;
+  if ( distance > SBOpenHashTableMaxDistance )
+    return NO;
+
+  //  Locate the end of the cluster; everything from the insertion point up to it
+  //  moves one slot further from home:
+  end = index;
+  while ( table->control[end] ) {
+    if ( table->control[end] == SBOpenHashTableMaxDistance )
+      return NO;
+    end = (end + 1) & table->mask;
+  }
+  while ( end != index ) {
+    SBUInteger      prev = (end - 1) & table->mask;
+
+    table->slots[end] = table->slots[prev];
+    table->control[end] = table->control[prev] + 1;
+    end = prev;
+  }
+  table->slots[index].hash = hash;
+  table->slots[index].key = key;
+  table->slots[index].object = object;
+  table->control[index] = distance;
+  table->count++;
+  return YES;
 }
 
 //
 
-SBMutableHashPair*
-SBMutableHashPairPoolAllocPair(
-  SBMutableHashPairPool*    topPool
+void
+SBOpenHashTableRemoveSlot(
+  SBOpenHashTable*  table,
+  SBOpenHashSlot*   slot
 )
 {
-  SBMutableHashPair*        pair = topPool->pairs;
-  
-  if ( pair ) {
-    topPool->pairs = pair->link;
-    pair->link = NULL;
-  }
-  return pair;
+  SBUInteger        index = slot - table->slots;
+  SBUInteger        next = (index + 1) & table->mask;
+
+  //  Backward-shift deletion:  pull displaced neighbors one slot closer to home
+  //  so that no tombstones are left behind:
+  while ( table->control[next] > 1 ) {
+    table->slots[index] = table->slots[next];
+    table->control[index] = table->control[next] - 1;
+    index = next;
+    next = (next + 1) & table->mask;
+  }
+  table->slots[index].hash = 0;
+  table->slots[index].key = nil;
+  table->slots[index].object = nil;
+  table->control[index] = 0;
+  table->count--;
 }
 
 //
 
 void
-SBMutableHashPairPoolDeallocPair(
-  SBMutableHashPairPool*    topPool,
-  SBMutableHashPair*        pair
+SBOpenHashTableVacateSlot(
+  SBOpenHashTable*  table,
+  SBOpenHashSlot*   slot
 )
 {
-  if ( pair->key ) {
-    [pair->key release];
-    pair->key = nil;
-  }
-  if ( pair->object ) {
-    [pair->object release];
-    pair->object = nil;
-  }
-  pair->link = topPool->pairs;
-  topPool->pairs = pair;
+  //  Used on a table that is being rehashed:  the slot's control word is left
+  //  intact so probes continue past it and migration never sees a pair move
+  //  behind its cursor:
+  slot->key = nil;
+  slot->object = nil;
+  table->count--;
 }
 
 //
 
+typedef struct _SBOpenHashIterator {
+  SBOpenHashTable*  tables[2];
+  unsigned int      which;
+  SBUInteger        index;
+} SBOpenHashIterator;
+
+static inline
+void
+SBOpenHashIteratorInit(
+  SBOpenHashIterator*   iterator,
+  SBOpenHashTable*      table,
+  SBOpenHashTable*      oldTable
+)
+{
+  iterator->tables[0] = oldTable;
+  iterator->tables[1] = table;
+  iterator->which = 0;
+  iterator->index = 0;
+}
+
 static inline
-SBMutableHashPair**
-SBMutableHashPairPoolFindTableIndex(
-  SBMutableHashPairPool*    pools,
-  SBUInteger                index
+SBOpenHashSlot*
+SBOpenHashIteratorNext(
+  SBOpenHashIterator*   iterator
 )
 {
-  while ( pools ) {
-    if ( index < pools->tableCapacity )
-      return (pools->table + index);
-    index -= pools->tableCapacity;
-    pools = pools->link;
+  while ( iterator->which < 2 ) {
+    SBOpenHashTable*    table = iterator->tables[iterator->which];
+
+    if ( table ) {
+      while ( iterator->index < table->capacity ) {
+        SBOpenHashSlot* slot = table->slots + iterator->index++;
+
+        if ( slot->key )
+          return slot;
+      }
+    }
+    iterator->which++;
+    iterator->index = 0;
   }
   return NULL;
 }
@@ -1406,25 +1509,22 @@ SBMutableHashPairPoolFindTableIndex(
 
 @interface SBConcreteMutableDictionaryEnumerator : SBEnumerator
 {
-  SBMutableHashPairPool*        _pool;
-  SBMutableHashPair*            _pair;
-  SBUInteger                    _i, _iMax;
+  SBOpenHashIterator            _iterator;
   BOOL                          _doKeys;
 }
 
-- (id) initWithBasePool:(SBMutableHashPairPool*)pool doKeys:(BOOL)doKeys;
+- (id) initWithTable:(SBOpenHashTable*)table oldTable:(SBOpenHashTable*)oldTable doKeys:(BOOL)doKeys;
 
 @end
 
 @implementation SBConcreteMutableDictionaryEnumerator
 
-  - (id) initWithBasePool:(SBMutableHashPairPool*)pool
+  - (id) initWithTable:(SBOpenHashTable*)table
+    oldTable:(SBOpenHashTable*)oldTable
     doKeys:(BOOL)doKeys
   {
     if ( self = [super init] ) {
-      _pool = pool;
-      _i = 0;
-      _iMax = ( pool ? pool->tableCapacity : 0 );
+      SBOpenHashIteratorInit(&_iterator, table, oldTable);
       _doKeys = doKeys;
     }
     return self;
@@ -1434,32 +1534,11 @@ SBMutableHashPairPoolFindTableIndex(
 
   - (id) nextObject
   {
-    id      result = nil;
-    
-    while ( _pool ) {
-      if ( ! _pair ) {
-        while ( _i < _iMax ) {
-          if ( _pool->table[_i] ) {
-            _pair = _pool->table[_i];
-            break;
-          }
-          _i++;
-        }
-        if ( ! _pair ) {
-          _pool = _pool->link;
-          _i = 0;
-          _iMax = ( _pool ? _pool->tableCapacity : 0 );
-          continue;
-        }
-      }
-      result = ( _doKeys ? _pair->key : _pair->object );
-      _pair = _pair->link;
-      if ( ! _pair ) {
-        _i++;
-      }
-      break;
-    }
-    return result;
+    SBOpenHashSlot*     slot = SBOpenHashIteratorNext(&_iterator);
+
+    if ( slot )
+      return ( _doKeys ? slot->key : slot->object );
+    return nil;
   }
 
 @end
@@ -1470,50 +1549,28 @@ SBMutableHashPairPoolFindTableIndex(
 
 @interface SBConcreteMutableDictionary : SBMutableDictionary
 {
-  SBMutableHashPairPool*        _pools;
-  SBMutableHashPairPool*        _topPool;
-  SBUInteger                    _count;
-  SBUInteger                    _pairCapacity;
-  SBUInteger                    _tableCapacity;
-  SBUInteger                    _hash;
-  struct {
-    short unsigned int  collisions;
-    short unsigned int  nonCollisions;
-  } _stats;
+  SBOpenHashTable*              _table;
+  SBOpenHashTable*              _oldTable;
+  SBUInteger                    _rehashIndex;
+  SBUInteger                    _fixedCapacity;
   struct {
-    unsigned int        countIsCached : 1;
-    unsigned int        capacityIsCached : 1;
-    unsigned int        hashIsCached : 1;
     unsigned int        fixedCapacity : 1;
   } _flags;
 }
 
-- (void) calculateCapacities;
-- (SBUInteger) pairCapacity;
 - (SBUInteger) tableCapacity;
 - (BOOL) increaseCapacity;
+- (void) continueRehash:(SBUInteger)slotCount;
+- (SBOpenHashSlot*) slotForKey:(id)aKey hash:(SBUInteger)hash inTable:(SBOpenHashTable**)table;
 
 @end
 
 @implementation SBConcreteMutableDictionary
 
-  - (id) init
-  {
-    if ( self = [super init] ) {
-      _flags.countIsCached = _flags.capacityIsCached = YES;
-    }
-    return self;
-  }
-
-//
-
   - (id) initWithCapacity:(SBUInteger)capacity
   {
     if ( self = [self init] ) {
-      if ( SBMutableHashPairPoolAlloc(&_topPool, capacity) ) {
-        _pools = _topPool;
-        _flags.capacityIsCached = NO;
-      } else {
+      if ( ! (_table = SBOpenHashTableCreate(SBOpenHashTableCapacityForCount(capacity))) ) {
         [self release];
         self = nil;
       }
@@ -1526,6 +1583,7 @@ SBMutableHashPairPoolFindTableIndex(
   - (id) initWithFixedCapacity:(SBUInteger)maxItems
   {
     if ( self = [self initWithCapacity:maxItems] ) {
+      _fixedCapacity = maxItems;
       _flags.fixedCapacity = YES;
     }
     return self;
@@ -1537,10 +1595,10 @@ SBMutableHashPairPoolFindTableIndex(
     forKeys:(SBArray*)keys
   {
     SBUInteger        i = 0, iMax = [objects count];
-    
+
     if ( iMax > [keys count] )
       iMax = [keys count];
-    
+
     if ( self = [self initWithCapacity:iMax + 8] ) {
       while ( i < iMax ) {
         [self setObject:[objects objectAtIndex:i] forKey:[keys objectAtIndex:i]];
@@ -1549,7 +1607,7 @@ SBMutableHashPairPoolFindTableIndex(
     }
     return self;
   }
-  
+
 //
 
   - (id) initWithObjects:(id *)objects
@@ -1557,7 +1615,7 @@ SBMutableHashPairPoolFindTableIndex(
     count:(unsigned)count
   {
     SBUInteger        i = 0;
-    
+
     if ( self = [self initWithCapacity:count + 8] ) {
       while ( i < count ) {
         [self setObject:objects[i] forKey:keys[i]];
@@ -1575,7 +1633,7 @@ SBMutableHashPairPoolFindTableIndex(
     va_list       argCopy;
     id            obj = firstObject;
     SBUInteger    count = 0;
-    
+
     //  Count the pairs:
     va_copy(argCopy, arguments);
     while ( obj ) {
@@ -1585,10 +1643,10 @@ SBMutableHashPairPoolFindTableIndex(
         obj = va_arg(argCopy, id);
       }
     }
-    
+
     if ( self = [self initWithCapacity:count + 8] ) {
       id          key;
-      
+
       obj = firstObject;
       while ( obj ) {
         key = va_arg(arguments, id);
@@ -1600,7 +1658,7 @@ SBMutableHashPairPoolFindTableIndex(
     }
     return self;
   }
-  
+
 //
 
   - (id) initWithDictionary:(SBDictionary*)otherDictionary
@@ -1608,40 +1666,28 @@ SBMutableHashPairPoolFindTableIndex(
     if ( self = [self initWithCapacity:[otherDictionary count] + 8] ) {
       SBEnumerator*     eKey = [otherDictionary keyEnumerator];
       id                key;
-      
+
       while ( key = [eKey nextObject] )
         [self setObject:[otherDictionary objectForKey:key] forKey:key];
     }
     return self;
   }
-  
+
 //
 
   - (void) dealloc
   {
-    // Walk each pool's table, releasing any key-value pairs then scrubbing
-    // the pool itself:
-    while ( _pools ) {
-      SBUInteger        i = 0, iMax = _pools->tableCapacity;
-      
-      while ( i < iMax ) {
-        if ( _pools->table[i] ) {
-          SBMutableHashPair*    pair = _pools->table[i];
-          
-          while ( pair ) {
-            [pair->key release];
-            [pair->object release];
-            pair = pair->link;
-          }
-        }
-        i++;
-      }
-      
-      SBMutableHashPairPool*    nextPool = _pools->link;
-      
-      objc_free(_pools);
-      _pools = nextPool;
+    SBOpenHashIterator    iterator;
+    SBOpenHashSlot*       slot;
+
+    // Release all key-value pairs then scrub the tables themselves:
+    SBOpenHashIteratorInit(&iterator, _table, _oldTable);
+    while ( (slot = SBOpenHashIteratorNext(&iterator)) ) {
+      [slot->key release];
+      [slot->object release];
     }
+    if ( _oldTable ) objc_free(_oldTable);
+    if ( _table ) objc_free(_table);
     [super dealloc];
   }
 
@@ -1649,441 +1695,292 @@ SBMutableHashPairPoolFindTableIndex(
 
   - (void) summarizeToStream:(FILE*)stream
   {
-    SBMutableHashPairPool*      pool = _pools;
-    SBUInteger                  additions = _stats.collisions + _stats.nonCollisions;
-    
+    SBOpenHashIterator    iterator;
+    SBOpenHashSlot*       slot;
+    SBUInteger            probes = 0, maxProbe = 0;
+
+    if ( _table ) {
+      SBUInteger          i = 0, iMax = _table->capacity;
+
+      while ( i < iMax ) {
+        SBUInteger        distance = _table->control[i++];
+
+        probes += distance;
+        if ( distance > maxProbe )
+          maxProbe = distance;
+      }
+    }
+
     [super summarizeToStream:stream];
     fprintf(
         stream,
         " (\n"
         "  count: " SBUIntegerFormat "\n"
         "  capacity:\n"
-        "    keys = " SBUIntegerFormat "\n"
         "    table = " SBUIntegerFormat "\n"
+        "    rehashing = %s\n"
         "  stats:\n"
-        "    collisions = %hu\n"
-        "    rate = %0.1lf%%\n"
+        "    mean probe = %0.2lf\n"
+        "    max probe = " SBUIntegerFormat "\n"
         ") {\n",
         [self count],
-        [self pairCapacity],
         [self tableCapacity],
-        _stats.collisions,
-        ( additions ? (100.0 * (float)_stats.collisions / (float)additions) : 0.0 )
+        ( _oldTable ? "yes" : "no" ),
+        ( (_table && _table->count) ? ((double)probes / (double)_table->count) : 0.0 ),
+        maxProbe
       );
-    while ( pool ) {
-      SBUInteger      i = 0, iMax = pool->tableCapacity;
-      
-      while ( i < iMax ) {
-        if ( pool->table[i] ) {
-          SBMutableHashPair*    pair = pool->table[i];
-          
-          while ( pair ) {
-            if ( (pair->key) ) {
-              if ( [pair->key isKindOf:[SBString class]] ) {
-                fprintf(stream, "    \'");
-                [(SBString*)pair->key writeToStream:stream];
-                fprintf(stream, "\' = ");
-              } else if ( [pair->key isKindOf:[SBNumber class]] ) {
-                fprintf(stream, "    ");
-                [(SBNumber*)pair->key writeToStream:stream];
-                fprintf(stream, " = ");
-              } else {
-                fprintf(stream, "    %s@%p[" SBUIntegerFormat "] = ", [pair->key name], pair->key, [pair->key referenceCount]);
-              }
-              
-              if ( [pair->object isKindOf:[SBString class]] ) {
-                fprintf(stream, "\'");
-                [(SBString*)pair->object writeToStream:stream];
-                fprintf(stream, "\'\n");
-              } else if ( [pair->object isKindOf:[SBNumber class]] ) {
-                [(SBNumber*)pair->object writeToStream:stream];
-                fputc('\n', stream);
-              } else if ( [pair->object isKindOf:[SBArray class]] ) {
-                [(SBArray*)pair->object writeToStream:stream];
-                fputc('\n', stream);
-              } else {
-                fprintf(stream, "%s@%p[" SBUIntegerFormat "]\n", [pair->object name], pair->object, [pair->object referenceCount]);
-              }
-            }
-            pair = pair->link;
-          }
-        }
-        i++;
+    SBOpenHashIteratorInit(&iterator, _table, _oldTable);
+    while ( (slot = SBOpenHashIteratorNext(&iterator)) ) {
+      if ( [slot->key isKindOf:[SBString class]] ) {
+        fprintf(stream, "    \'");
+        [(SBString*)slot->key writeToStream:stream];
+        fprintf(stream, "\' = ");
+      } else if ( [slot->key isKindOf:[SBNumber class]] ) {
+        fprintf(stream, "    ");
+        [(SBNumber*)slot->key writeToStream:stream];
+        fprintf(stream, " = ");
+      } else {
+        fprintf(stream, "    %s@%p[" SBUIntegerFormat "] = ", [slot->key name], slot->key, [slot->key referenceCount]);
+      }
+
+      if ( [slot->object isKindOf:[SBString class]] ) {
+        fprintf(stream, "\'");
+        [(SBString*)slot->object writeToStream:stream];
+        fprintf(stream, "\'\n");
+      } else if ( [slot->object isKindOf:[SBNumber class]] ) {
+        [(SBNumber*)slot->object writeToStream:stream];
+        fputc('\n', stream);
+      } else if ( [slot->object isKindOf:[SBArray class]] ) {
+        [(SBArray*)slot->object writeToStream:stream];
+        fputc('\n', stream);
+      } else {
+        fprintf(stream, "%s@%p[" SBUIntegerFormat "]\n", [slot->object name], slot->object, [slot->object referenceCount]);
       }
-      pool = pool->link;
     }
     fprintf(stream, "}\n");
   }
 
 //
 
-  - (void) calculateCapacities
-  {
-    SBMutableHashPairPool*      pool = _pools;
-    
-    _pairCapacity = _tableCapacity = 0;
-    while ( pool ) {
-      _pairCapacity += pool->pairCapacity;
-      _tableCapacity += pool->tableCapacity;
-      pool = pool->link;
-    }
-    _flags.capacityIsCached = YES;
-  }
-  
-//
-
-  - (SBUInteger) pairCapacity
-  {
-    if ( ! _flags.capacityIsCached )
-      [self calculateCapacities];
-    return _pairCapacity;
-  }
   - (SBUInteger) tableCapacity
   {
-    if ( ! _flags.capacityIsCached )
-      [self calculateCapacities];
-    return _tableCapacity;
+    return ( _table ? _table->capacity : 0 );
   }
 
 //
 
   - (BOOL) increaseCapacity
   {
-    SBUInteger      delta = [self count];
-    
-    if ( _flags.fixedCapacity )
+    SBOpenHashTable*    newTable;
+
+    if ( _flags.fixedCapacity && _table )
       return NO;
-    
-    if ( SBMutableHashPairPoolAlloc(&_topPool, ( delta ? delta : 32 ) ) ) {
-      if ( ! _pools ) {
-        // Fresh start:
-        _pools = _topPool;
-        _pairCapacity += _topPool->pairCapacity;
-        _tableCapacity += _topPool->tableCapacity;
-        _flags.countIsCached = _flags.capacityIsCached = YES;
-        return YES;
-      }
-      if ( _flags.capacityIsCached ) {
-        _pairCapacity += _topPool->pairCapacity;
-        _tableCapacity += _topPool->tableCapacity;
-      }
-      
-      // We need to pull all key-value pairs out of the table and reindex them now:
-      SBMutableHashPair*        basePair = NULL;
-      SBMutableHashPair*        lastPair = NULL;
-      SBMutableHashPairPool*    pool = _pools;
-      
-      // Re-link all pairs in the old table into a single chain:
-      while ( pool != _topPool ) {
-        SBUInteger              i = 0, iMax = pool->tableCapacity;
-        
-        while ( i < iMax ) {
-          if ( pool->table[i] ) {
-            if ( basePair == NULL )
-              basePair = pool->table[i];
-            else
-              lastPair->link = pool->table[i];
-              
-            lastPair = pool->table[i];
-            while ( lastPair && lastPair->link )
-              lastPair = lastPair->link;
-              
-            pool->table[i] = NULL;
-          }
-          i++;
-        }
-        pool = pool->link;
-      }
-      
-      // Now that "basePair" points to the chain of key-value pairs, just re-add them
-      // using the new table capacity:
-      SBUInteger                newCapacity = [self tableCapacity];
-      
-      _stats.collisions = _stats.nonCollisions = 0;
-      
-      while ( basePair ) {
-        SBUInteger              index = [basePair->key hash] % newCapacity;
-        SBMutableHashPair**     tableSlot = SBMutableHashPairPoolFindTableIndex(_pools, index);
-        
-        if ( tableSlot ) {
-          if ( *tableSlot ) {
-            SBMutableHashPair*  pair = *tableSlot;
-            
-            // Find the end of this index's chain:
-            while ( pair && pair->link )
-              pair = pair->link;
-            
-            // Append the pair:
-            pair->link = basePair;
-            basePair = basePair->link;
-            pair->link->link = NULL;
-            
-            _stats.collisions++;
-          } else {
-            // First item at this index:
-            *tableSlot = basePair;
-            basePair = basePair->link;
-            (*tableSlot)->link = NULL;
-            
-            _stats.nonCollisions++;
-          }
+
+    // Only one rehash may be underway at a time; finish off any prior one:
+    if ( _oldTable )
+      [self continueRehash:_oldTable->capacity];
+
+    if ( (newTable = SBOpenHashTableCreate( _table ? 2 * _table->capacity : SBOpenHashTableMinCapacity )) ) {
+      if ( _table ) {
+        if ( _table->count ) {
+          // The outgrown table's pairs will be migrated a few at a time:
+          _oldTable = _table;
+          _rehashIndex = 0;
         } else {
-          // Should NEVER get here:
-          exit(1);
+          objc_free(_table);
         }
       }
-      
+      _table = newTable;
       return YES;
     }
     return NO;
   }
 
-//
-#pragma mark SBDictionary methods
 //
 
-  - (SBUInteger) count
+  - (void) continueRehash:(SBUInteger)slotCount
   {
-    if ( ! _flags.countIsCached ) {
-      SBMutableHashPairPool*    pool = _pools;
-      
-      _count = 0;
-      while ( pool ) {
-        SBMutableHashPair*    pair = pool->pairs;
-        
-        while ( pair ) {
-          if ( pair->key )
-            _count++;
-          pair = pair->link;
+    if ( _oldTable ) {
+      SBUInteger        i = _rehashIndex, iMax = _oldTable->capacity;
+
+      while ( slotCount && (i < iMax) && _oldTable->count ) {
+        SBOpenHashSlot* slot = _oldTable->slots + i++;
+
+        if ( slot->key ) {
+          if ( ! SBOpenHashTableInsert(_table, slot->hash, slot->key, slot->object) ) {
+            // Should NEVER get here:
+            exit(1);
+          }
+          SBOpenHashTableVacateSlot(_oldTable, slot);
         }
-        pool = pool->link;
+        slotCount--;
+      }
+      if ( (i >= iMax) || (_oldTable->count == 0) ) {
+        objc_free(_oldTable);
+        _oldTable = NULL;
+        _rehashIndex = 0;
+      } else {
+        _rehashIndex = i;
       }
     }
-    return _count;
   }
-  
+
 //
 
-  - (id) objectForKey:(id)aKey
+  - (SBOpenHashSlot*) slotForKey:(id)aKey
+    hash:(SBUInteger)hash
+    inTable:(SBOpenHashTable**)table
   {
-    if ( _pools ) {
-      SBUInteger            index = [aKey hash] % [self tableCapacity];
-      SBMutableHashPair**   tableSlot = SBMutableHashPairPoolFindTableIndex(_pools, index);
-      
-      if ( tableSlot && *tableSlot ) {
-        SBMutableHashPair*  pair = *tableSlot;
-        
-        do {
-          if ( [pair->key isEqual:aKey] )
-            return pair->object;
-          pair = pair->link;
-        } while ( pair );
-      }
+    SBOpenHashSlot*     slot = NULL;
+
+    if ( _table && (slot = SBOpenHashTableFind(_table, hash, aKey)) ) {
+      if ( table ) *table = _table;
+    } else if ( _oldTable && (slot = SBOpenHashTableFind(_oldTable, hash, aKey)) ) {
+      if ( table ) *table = _oldTable;
     }
-    return nil;
+    return slot;
   }
-  
+
+//
+#pragma mark SBDictionary methods
+//
+
+  - (SBUInteger) count
+  {
+    return ( _table ? _table->count : 0 ) + ( _oldTable ? _oldTable->count : 0 );
+  }
+
+//
+
+  - (id) objectForKey:(id)aKey
+  {
+    SBOpenHashSlot*     slot = [self slotForKey:aKey hash:SBOpenHashMix([aKey hash]) inTable:NULL];
+
+    return ( slot ? slot->object : nil );
+  }
+
 //
 
   - (SBEnumerator*) keyEnumerator
   {
-    return [[[SBConcreteMutableDictionaryEnumerator alloc] initWithBasePool:_pools doKeys:YES] autorelease];
+    return [[[SBConcreteMutableDictionaryEnumerator alloc] initWithTable:_table oldTable:_oldTable doKeys:YES] autorelease];
   }
-  
+
 //
 #pragma mark SBExtendedDictionary methods
 //
 
   - (BOOL) containsKey:(id)aKey
   {
-    if ( _pools ) {
-      SBUInteger            index = [aKey hash] % [self tableCapacity];
-      SBMutableHashPair**   tableSlot = SBMutableHashPairPoolFindTableIndex(_pools, index);
-      
-      if ( tableSlot && *tableSlot ) {
-        SBMutableHashPair*  pair = *tableSlot;
-        
-        while ( pair ) {
-          if ( [pair->key isEqual:aKey] )
-            return YES;
-          pair = pair->link;
-        }
-      }
-    }
-    return NO;
+    return ( [self slotForKey:aKey hash:SBOpenHashMix([aKey hash]) inTable:NULL] != NULL );
   }
-  
+
 //
 
   - (BOOL) containsObject:(id)object
   {
-    SBMutableHashPairPool*    pool = _pools;
-    
-    while ( pool ) {
-      SBUInteger        i = 0, iMax = pool->tableCapacity;
-      
-      while ( i < iMax ) {
-        if ( pool->table[i] ) {
-          SBMutableHashPair*  pair = pool->table[i];
-          
-          while ( pair ) {
-            if ( [pair->object isEqual:object] )
-              return YES;
-            pair = pair->link;
-          }
-        }
-        i++;
-      }
-      pool = pool->link;
+    SBOpenHashIterator    iterator;
+    SBOpenHashSlot*       slot;
+
+    SBOpenHashIteratorInit(&iterator, _table, _oldTable);
+    while ( (slot = SBOpenHashIteratorNext(&iterator)) ) {
+      if ( [slot->object isEqual:object] )
+        return YES;
     }
     return NO;
   }
-  
+
 //
 
   - (SBArray*) allKeys
   {
     SBArray*         aKeys = nil;
     SBUInteger       count = [self count];
-    
+
     if ( count ) {
-      SBMutableHashPairPool*    pool = _pools;
-      id                        keys[count];
-      SBUInteger                k = 0;
-      
-      while ( pool ) {
-        SBUInteger        i = 0, iMax = pool->tableCapacity;
-        
-        while ( i < iMax ) {
-          if ( pool->table[i] ) {
-            SBMutableHashPair*  pair = pool->table[i];
-            
-            while ( pair ) {
-              keys[k++] = pair->key;
-              pair = pair->link;
-            }
-          }
-          i++;
-        }
-        pool = pool->link;
-      }
+      SBOpenHashIterator    iterator;
+      SBOpenHashSlot*       slot;
+      id                    keys[count];
+      SBUInteger            k = 0;
+
+      SBOpenHashIteratorInit(&iterator, _table, _oldTable);
+      while ( (slot = SBOpenHashIteratorNext(&iterator)) )
+        keys[k++] = slot->key;
       if ( k )
         aKeys = [SBArray arrayWithObjects:keys count:k];
     }
     return aKeys;
   }
-  
+
 //
 
   - (SBArray*) allKeysForObject:(id)anObject
   {
     SBArray*         aKeys = nil;
     SBUInteger       count = [self count];
-    
+
     if ( count ) {
-      SBMutableHashPairPool*    pool = _pools;
-      id                        keys[count];
-      SBUInteger                k = 0;
-      
-      while ( pool ) {
-        SBUInteger        i = 0, iMax = pool->tableCapacity;
-        
-        while ( i < iMax ) {
-          if ( pool->table[i] ) {
-            SBMutableHashPair*  pair = pool->table[i];
-            
-            while ( pair ) {
-              if ( [pair->object isEqual:anObject] )
-                keys[k++] = pair->key;
-              pair = pair->link;
-            }
-          }
-          i++;
-        }
-        pool = pool->link;
+      SBOpenHashIterator    iterator;
+      SBOpenHashSlot*       slot;
+      id                    keys[count];
+      SBUInteger            k = 0;
+
+      SBOpenHashIteratorInit(&iterator, _table, _oldTable);
+      while ( (slot = SBOpenHashIteratorNext(&iterator)) ) {
+        if ( [slot->object isEqual:anObject] )
+          keys[k++] = slot->key;
       }
-      
       if ( k )
         aKeys = [SBArray arrayWithObjects:keys count:k];
     }
     return aKeys;
   }
-  
+
 //
 
   - (SBArray*) allValues
   {
     SBArray*         aValues = nil;
     SBUInteger       count = [self count];
-    
+
     if ( count ) {
-      SBMutableHashPairPool*    pool = _pools;
-      id                        values[count];
-      SBUInteger                k = 0;
-      
-      while ( pool ) {
-        SBUInteger        i = 0, iMax = pool->tableCapacity;
-        
-        while ( i < iMax ) {
-          if ( pool->table[i] ) {
-            SBMutableHashPair*  pair = pool->table[i];
-            
-            while ( pair ) {
-              values[k++] = pair->object;
-              pair = pair->link;
-            }
-          }
-          i++;
-        }
-        pool = pool->link;
-      }
-      
+      SBOpenHashIterator    iterator;
+      SBOpenHashSlot*       slot;
+      id                    values[count];
+      SBUInteger            k = 0;
+
+      SBOpenHashIteratorInit(&iterator, _table, _oldTable);
+      while ( (slot = SBOpenHashIteratorNext(&iterator)) )
+        values[k++] = slot->object;
       if ( k )
         aValues = [SBArray arrayWithObjects:values count:k];
     }
     return aValues;
   }
-  
+
 //
 
   - (BOOL) isEqualToDictionary:(SBDictionary*)otherDictionary
   {
     if ( [self count] == [otherDictionary count] ) {
-      if ( [self count] == 0 ) {
-        // Both are empty:
-        return YES;
-      }
-      if ( _pools ) {
-        SBMutableHashPairPool*    pool = _pools;
-        
-        while ( pool ) {
-          SBUInteger              i = 0, iMax = pool->tableCapacity;
-          
-          while ( i < iMax ) {
-            if ( pool->table[i] ) {
-              SBMutableHashPair*  pair = pool->table[i];
-              
-              while ( pair ) {
-                if ( ! [pair->object isEqual:[otherDictionary objectForKey:pair->key]] )
-                  return NO;
-                pair = pair->link;
-              }
-            }
-            i++;
-          }
-          pool = pool->link;
-        }
-        return YES;
+      SBOpenHashIterator    iterator;
+      SBOpenHashSlot*       slot;
+
+      SBOpenHashIteratorInit(&iterator, _table, _oldTable);
+      while ( (slot = SBOpenHashIteratorNext(&iterator)) ) {
+        if ( ! [slot->object isEqual:[otherDictionary objectForKey:slot->key]] )
+          return NO;
       }
+      return YES;
     }
     return NO;
   }
-  
+
 //
 
   - (SBEnumerator*) objectEnumerator
   {
-    return [[[SBConcreteMutableDictionaryEnumerator alloc] initWithBasePool:_pools doKeys:NO] autorelease];
+    return [[[SBConcreteMutableDictionaryEnumerator alloc] initWithTable:_table oldTable:_oldTable doKeys:NO] autorelease];
   }
 
 //
@@ -2093,36 +1990,17 @@ SBMutableHashPairPoolFindTableIndex(
   {
     SBArray*          aValues = nil;
     SBUInteger        count = [keys count];
-    
-    if ( count && _pools ) {
-      SBMutableHashPairPool*    pool = _pools;
-      id                        values[count];
-      SBUInteger                i = 0;
-      
-      // Initialize to all slots "not found":
-      while ( i < count )
-        values[i++] = marker;
-      
-      // Walk the table:
-      while ( pool ) {
-        SBUInteger              iMax = pool->tableCapacity;
-        
-        i = 0;
-        while ( i < iMax ) {
-          if ( pool->table[i] ) {
-            SBMutableHashPair*  pair = pool->table[i];
-            
-            while ( pair ) {
-              SBUInteger        j = [keys indexOfObject:pair->key];
-              
-              if ( j != SBNotFound )
-                values[j] = pair->object;
-              pair = pair->link;
-            }
-          }
-          i++;
-        }
-        pool = pool->link;
+
+    if ( count && _table ) {
+      id                values[count];
+      SBUInteger        i = 0;
+
+      // Direct lookups are cheap now, so probe for each key in turn:
+      while ( i < count ) {
+        id              key = [keys objectAtIndex:i];
+        SBOpenHashSlot* slot = [self slotForKey:key hash:SBOpenHashMix([key hash]) inTable:NULL];
+
+        values[i++] = ( slot ? slot->object : marker );
       }
       aValues = [SBArray arrayWithObjects:values count:count];
     }
@@ -2135,99 +2013,64 @@ SBMutableHashPairPoolFindTableIndex(
   {
     SBArray*         aKeys = nil;
     SBUInteger       count = [self count];
-    
+
     if ( count ) {
-      SBMutableHashPairPool*    pool = _pools;
-      id                        keys[count];
-      SBUInteger                k = 0;
-      
-      while ( pool ) {
-        SBUInteger        i = 0, iMax = pool->tableCapacity;
-        
-        while ( i < iMax ) {
-          if ( pool->table[i] ) {
-            SBMutableHashPair*  pair = pool->table[i];
-            
-            while ( pair ) {
-              SBUInteger    j = k;
-          
-              if ( k == 0 ) {
-                keys[0] = pair->key;
-              } else {
-                while ( j > 0 ) {
-                  if ( (SBComparisonResult)[keys[j - 1] perform:comparator with:pair->key] == SBOrderDescending ) {
-                    keys[j] = keys[j - 1];
-                    j--;
-                  } else {
-                    break;
-                  }
-                }
-                keys[j] = pair->key;
-              }
-              k++;
-              pair = pair->link;
+      SBOpenHashIterator    iterator;
+      SBOpenHashSlot*       slot;
+      id                    keys[count];
+      SBUInteger            k = 0;
+
+      SBOpenHashIteratorInit(&iterator, _table, _oldTable);
+      while ( (slot = SBOpenHashIteratorNext(&iterator)) ) {
+        SBUInteger    j = k;
+
+        if ( k == 0 ) {
+          keys[0] = slot->key;
+        } else {
+          while ( j > 0 ) {
+            if ( (SBComparisonResult)[keys[j - 1] perform:comparator with:slot->key] == SBOrderDescending ) {
+              keys[j] = keys[j - 1];
+              j--;
+            } else {
+              break;
             }
           }
-          i++;
+          keys[j] = slot->key;
         }
-        pool = pool->link;
+        k++;
       }
-      
+
       if ( k )
         aKeys = [SBArray arrayWithObjects:keys count:k];
     }
     return aKeys;
   }
-  
+
 //
 
   - (void) makeObjectsPerformSelector:(SEL)aSelector
   {
-    SBMutableHashPairPool*    pool = _pools;
-    
-    while ( pool ) {
-      SBUInteger        i = 0, iMax = pool->tableCapacity;
-      
-      while ( i < iMax ) {
-        if ( pool->table[i] ) {
-          SBMutableHashPair*  pair = pool->table[i];
-          
-          while ( pair ) {
-            [pair->object perform:aSelector];
-            pair = pair->link;
-          }
-        }
-        i++;
-      }
-      pool = pool->link;
-    }
+    SBOpenHashIterator    iterator;
+    SBOpenHashSlot*       slot;
+
+    SBOpenHashIteratorInit(&iterator, _table, _oldTable);
+    while ( (slot = SBOpenHashIteratorNext(&iterator)) )
+      [slot->object perform:aSelector];
   }
-  
+
 //
 
   - (void) makeObjectsPerformSelector:(SEL)aSelector
     withObject:(id)argument
   {
-    SBMutableHashPairPool*    pool = _pools;
-    
-    while ( pool ) {
-      SBUInteger        i = 0, iMax = pool->tableCapacity;
-      
-      while ( i < iMax ) {
-        if ( pool->table[i] ) {
-          SBMutableHashPair*  pair = pool->table[i];
-          
-          while ( pair ) {
-            [pair->object perform:aSelector with:argument];
-            pair = pair->link;
-          }
-        }
-        i++;
-      }
-      pool = pool->link;
-    }
+    SBOpenHashIterator    iterator;
+    SBOpenHashSlot*       slot;
+
+    SBOpenHashIteratorInit(&iterator, _table, _oldTable);
+    while ( (slot = SBOpenHashIteratorNext(&iterator)) )
+      [slot->object perform:aSelector with:argument];
   }
-  
+
 //
 #pragma mark SBMutableDictionary methods
 //
@@ -2235,111 +2078,60 @@ SBMutableHashPairPoolFindTableIndex(
   - (void) setObject:(id)anObject
     forKey:(id)aKey
   {
-    SBUInteger              hash = [aKey hash];
-    
-    if ( _pools ) {
-      // Does the key already occur in the table?
-      SBUInteger            index = hash % [self tableCapacity];
-      SBMutableHashPair**   tableSlot = SBMutableHashPairPoolFindTableIndex(_pools, index);
-      
-      if ( tableSlot && *tableSlot ) {
-        SBMutableHashPair*  pair = *tableSlot;
-        
-        do {
-          if ( [pair->key isEqual:aKey] ) {
-            // Replace this key-value pair:
-            aKey = [aKey copy];
-            anObject = [anObject retain];
-            [pair->key release]; pair->key = aKey;
-            [pair->object release]; pair->object = anObject;
-            return;
-          }
-          pair = pair->link;
-        } while ( pair );
-      }
+    SBUInteger              hash = SBOpenHashMix([aKey hash]);
+    SBOpenHashSlot*         slot = [self slotForKey:aKey hash:hash inTable:NULL];
+
+    if ( slot ) {
+      // Replace this key-value pair:
+      aKey = [aKey copy];
+      anObject = [anObject retain];
+      [slot->key release]; slot->key = aKey;
+      [slot->object release]; slot->object = anObject;
+      return;
     }
-    
+
     // Are we at capacity?
-    if ( [self pairCapacity] == [self count] ) {
+    if ( _flags.fixedCapacity && ([self count] >= _fixedCapacity) )
+      return;
+    if ( ! _table || (_table->count >= _table->growThreshold) ) {
       if ( ! [self increaseCapacity] )
         return;
+    } else if ( _oldTable ) {
+      [self continueRehash:SBOpenHashTableRehashStep];
     }
-    
+
     // Add the pair:
-    SBUInteger            index = hash % [self tableCapacity];
-    SBMutableHashPair**   tableSlot = SBMutableHashPairPoolFindTableIndex(_pools, index);
-    SBMutableHashPair*    newPair = SBMutableHashPairPoolAllocPair(_topPool);
-    
-    if ( newPair && tableSlot ) {
-      newPair->key = [aKey copy];
-      newPair->object = [anObject retain];
-      newPair->link = NULL;
-      
-      if ( *tableSlot ) {
-        SBMutableHashPair*  pair = *tableSlot;
-        
-        // Find the end of this index's chain:
-        while ( pair && pair->link )
-          pair = pair->link;
-        
-        // Append the pair:
-        pair->link = newPair;
-        
-        _stats.collisions++;
-      } else {
-        // First item at this index:
-        *tableSlot = newPair;
-        _stats.nonCollisions++;
-      }
-      if ( _flags.countIsCached ) {
-        _count++;
+    aKey = [aKey copy];
+    anObject = [anObject retain];
+    if ( ! SBOpenHashTableInsert(_table, hash, aKey, anObject) ) {
+      // Pathologically long probe sequence; try again in a larger table:
+      if ( ! [self increaseCapacity] || ! SBOpenHashTableInsert(_table, hash, aKey, anObject) ) {
+        [aKey release];
+        [anObject release];
       }
-    } else {
-      exit(1);
     }
   }
-  
+
 //
 
   - (void) removeObjectForKey:(id)aKey
   {
-    if ( _pools ) {
-      SBUInteger            index = [aKey hash] % [self tableCapacity];
-      SBMutableHashPair**   tableSlot = SBMutableHashPairPoolFindTableIndex(_pools, index);
-      
-      if ( tableSlot && *tableSlot ) {
-        SBMutableHashPair*  pair = *tableSlot;
-        SBMutableHashPair*  prevPair = NULL;
-        
-        do {
-          if ( [pair->key isEqual:aKey] ) {
-            // Redo linking of anything behind us in the chain:
-            if ( prevPair ) {
-              prevPair->link = pair->link;
-              
-              // Update collision info:
-              _stats.collisions--;
-            } else {
-              *tableSlot = pair->link;
-              
-              if ( pair->link ) {
-                // Update collision info:
-                _stats.collisions--;
-              }
-            }
-            // Scrub the pair and re-attach it to the _topPool for recycling:
-            SBMutableHashPairPoolDeallocPair(_topPool, pair);
-            
-            // Update cached count:
-            if ( _flags.countIsCached )
-              _count--;
-              
-            return;
-          }
-          prevPair = pair;
-          pair = pair->link;
-        } while ( pair );
-      }
+    SBOpenHashTable*      table = NULL;
+    SBOpenHashSlot*       slot = [self slotForKey:aKey hash:SBOpenHashMix([aKey hash]) inTable:&table];
+
+    if ( slot ) {
+      id                  key = slot->key;
+      id                  object = slot->object;
+
+      if ( table == _table )
+        SBOpenHashTableRemoveSlot(_table, slot);
+      else
+        SBOpenHashTableVacateSlot(_oldTable, slot);
+      if ( _oldTable )
+        [self continueRehash:SBOpenHashTableRehashStep];
+
+      [key release];
+      [object release];
     }
   }
 
@@ -2349,40 +2141,32 @@ SBMutableHashPairPoolFindTableIndex(
 
   - (void) removeAllObjects
   {
-    SBMutableHashPairPool*    pool = _pools;
-    
-    // Walk each pools tables', scrubbing pairs as we go:
-    while ( pool ) {
-      SBUInteger          i = 0, iMax = pool->tableCapacity;
-      
-      while ( i < iMax ) {
-        if ( pool->table[i] ) {
-          SBMutableHashPair*  pair = pool->table[i];
-          
-          pool->table[i] = NULL;
-          do {
-            SBMutableHashPair*  nextPair = pair->link;
-            
-            // Scrub the pair and re-attach it to the _topPool for recycling:
-            SBMutableHashPairPoolDeallocPair(_topPool, pair);
-            pair = nextPair;
-          } while ( pair );
-        }
-        i++;
-      }
-      pool = pool->link;
+    SBOpenHashIterator    iterator;
+    SBOpenHashSlot*       slot;
+
+    SBOpenHashIteratorInit(&iterator, _table, _oldTable);
+    while ( (slot = SBOpenHashIteratorNext(&iterator)) ) {
+      [slot->key release];
+      [slot->object release];
+    }
+    if ( _oldTable ) {
+      objc_free(_oldTable);
+      _oldTable = NULL;
+      _rehashIndex = 0;
+    }
+    if ( _table ) {
+      // Keep the table's capacity, just scrub it:
+      memset(_table->slots, 0, _table->capacity * (sizeof(SBOpenHashSlot) + sizeof(SBOpenHashControl)));
+      _table->count = 0;
     }
-    
-    _count = _stats.collisions = _stats.nonCollisions = 0;
-    _flags.countIsCached = YES;
   }
-  
+
 //
 
   - (void) removeObjectsForKeys:(SBArray*)keyArray
   {
     SBUInteger          i = 0, iMax = [keyArray count];
-    
+
     while ( i < iMax )
       [self removeObjectForKey:[keyArray objectAtIndex:i++]];
   }
@@ -17,6 +17,7 @@
 #import "SBException.h"
 #import "SBObjectCache.h"
 #import "SBMemoryPool.h"
+#import "SBObjectAllocator.h"
 #import "SBLocale.h"
 #import "SBTimeZone.h"
 #import "SBError.h"
@@ -58,6 +59,7 @@
 #import "SBStream.h"
 #import "SBTimer.h"
 #import "SBRunLoop.h"
+#import "SBOperationQueue.h"
 #import "SBTask.h"
 
 #import "SBXMLParser.h"
@@ -279,6 +279,12 @@ static inline SBRangeEmpty(
   
   As it stands, an SBObject has a single instance variable of type SBUInteger.  The GNU Object
   class has no instance variables.
+  
+  The reference count is adjusted with atomic operations, so an object may be retained and
+  released by any number of threads at once.  Programs which never share objects between threads
+  can build SBFoundation with SB_NONATOMIC_REFERENCE_COUNTS defined (e.g. in EXTRA_CPPFLAGS) to use
+  plain arithmetic instead; individual classes whose instances never leave the thread that
+  created them can do the same with the SBOBJECT_THREAD_CONFINED_REFERENCE_COUNTING macro.
 */
 @interface SBObject : Object
 {
@@ -308,8 +314,8 @@ static inline SBRangeEmpty(
 /*!
   @method retain
   @discussion
-  Returns a reference copy of the receiver; the receiver's reference count is incremented.  This message can
-  be chained with other messages to the receiver:
+  Returns a reference copy of the receiver; the receiver's reference count is (atomically) incremented.
+  This message can be chained with other messages to the receiver:
   <pre>
     [[[SBObject alloc] init] summarizeToStream:stdout];
   </pre>
@@ -318,8 +324,8 @@ static inline SBRangeEmpty(
 /*!
   @method release
   @discussion
-  Release a reference copy of the receiver; the receiver's reference count is decremented.  If the
-  reference count has reached zero, the receiver is also sent the "dealloc" message and is no
+  Release a reference copy of the receiver; the receiver's reference count is (atomically) decremented.
+  If the reference count has reached zero, the receiver is also sent the "dealloc" message and is no
   longer a valid object.
 */
 - (void) release;
@@ -367,6 +373,25 @@ static inline SBRangeEmpty(
 
 @end
 
+/*!
+  @defined SBOBJECT_THREAD_CONFINED_REFERENCE_COUNTING
+  @discussion
+  Place this macro inside the @implementation of an SBObject subclass whose instances are only
+  ever retained and released by the thread which created them (per-request scratch objects,
+  enumerators) to give that class non-atomic retain and release methods:
+  <pre>
+    @implementation SBScratchBuffer
+    
+      SBOBJECT_THREAD_CONFINED_REFERENCE_COUNTING
+      
+        :
+  </pre>
+  Sharing an instance of such a class between threads is an error.
+*/
+#define SBOBJECT_THREAD_CONFINED_REFERENCE_COUNTING \
+  - (id) retain { _references++; return self; } \
+  - (void) release { if ( --_references == 0 ) [self dealloc]; }
+
 /*!
   @class SBNull
   @discussion
@@ -15,11 +15,32 @@
 #import "SBValue.h"
 #import "SBAutoreleasePool.h"
 #import "SBLock.h"
+#import "SBObjectAllocator.h"
 
 //
 
 SBRange SBEmptyRange = { SBUIntegerMax, 0 };
 
+//
+// Reference count arithmetic:  increments need no ordering, but the decrement that reaches
+// zero must see every other thread's writes to the object before it is deallocated.
+// Compilers without the __atomic builtins (gcc before 4.7) fall back to the fully-fenced
+// __sync builtins.
+//
+#if defined(SB_NONATOMIC_REFERENCE_COUNTS)
+#  define SBObjectReferencesLoad(P)         (*(P))
+#  define SBObjectReferencesIncrement(P)    (++(*(P)))
+#  define SBObjectReferencesDecrement(P)    (--(*(P)))
+#elif defined(__ATOMIC_RELAXED)
+#  define SBObjectReferencesLoad(P)         __atomic_load_n((P), __ATOMIC_ACQUIRE)
+#  define SBObjectReferencesIncrement(P)    __atomic_add_fetch((P), 1, __ATOMIC_RELAXED)
+#  define SBObjectReferencesDecrement(P)    __atomic_sub_fetch((P), 1, __ATOMIC_ACQ_REL)
+#else
+#  define SBObjectReferencesLoad(P)         (__sync_synchronize(), *(volatile SBUInteger*)(P))
+#  define SBObjectReferencesIncrement(P)    __sync_add_and_fetch((P), 1)
+#  define SBObjectReferencesDecrement(P)    __sync_sub_and_fetch((P), 1)
+#endif
+
 //
 
 @interface __SBClassEnumerator : SBEnumerator
@@ -120,15 +141,15 @@ __SBFoundationErrorHandler(
     }
   }
 
-#ifdef SB_DEBUG
   + (id) alloc
   {
-    id      newObj = [super alloc];
+    id      newObj = SBObjectAllocatorCreateInstance(self);
     
+#ifdef SB_DEBUG
     fprintf(stderr, "DEBUG:  [%05u] ALLOC    %s@%p\n", ++__SBObjectAllocCount, [self name], newObj);
+#endif
     return newObj;
   }
-#endif
 
 //
 
@@ -146,14 +167,14 @@ __SBFoundationErrorHandler(
 #ifdef SB_DEBUG
     fprintf(stderr, "DEBUG:  [%05" SBUIntegerFormat "] DEALLOC  %s@%p\n", --__SBObjectAllocCount, [self name], self);
 #endif
-    [super free];
+    SBObjectAllocatorDisposeInstance(self);
   }
 
 //
 
   - (SBUInteger) referenceCount
   {
-    return _references;
+    return SBObjectReferencesLoad(&_references);
   }
   
 //
@@ -167,7 +188,7 @@ __SBFoundationErrorHandler(
 
   - (id) retain
   {
-    _references++;
+    SBObjectReferencesIncrement(&_references);
     return self;
   }
 
@@ -175,7 +196,11 @@ __SBFoundationErrorHandler(
 
   - (void) release
   {
-    if ( --_references == 0 )
+    //
+    // A caller holding the only reference is the only thread that can legally touch the
+    // count, so the last release skips the (comparatively expensive) atomic decrement:
+    //
+    if ( (SBObjectReferencesLoad(&_references) == 1) || (SBObjectReferencesDecrement(&_references) == 0) )
       [self dealloc];
   }
 
@@ -183,7 +208,7 @@ __SBFoundationErrorHandler(
 
   - (id) autorelease
   {
-    [SBAutoreleasePool addObject:self];
+    SBAutoreleasePoolAddObject(self);
     return self;
   }
 
@@ -0,0 +1,84 @@
+//
+// SBFoundation : ObjC Class Library for Solaris
+// SBObjectAllocator.h
+//
+// Size-class slab allocator for object instances.
+//
+// $Id$
+//
+
+#import "SBObject.h"
+
+
+/*!
+  @header SBObjectAllocator.h
+
+  SBObject allocates and deallocates its instances through the functions in this header
+  rather than calling objc_calloc()/objc_free() once per object.
+
+  Instance sizes are rounded up to one of a small number of size classes (16-byte steps up
+  to 256 bytes, 64-byte steps up to 512 bytes).  Each thread keeps a cache of free blocks
+  for every size class, so most allocations and deallocations touch no lock and no shared
+  memory at all.  When a thread's cache for a size class runs dry it takes a batch of blocks
+  from a shared depot -- which in turn carves new blocks out of 64 KB slabs as necessary --
+  and when the cache grows too large a batch is handed back to the depot.  An object freed
+  on a thread other than the one that allocated it simply joins the freeing thread's cache,
+  and makes its way back to other threads by way of the depot.  Slab memory is never
+  returned to the system; it is reused for later instances of the same size class.
+
+  Instances larger than 512 bytes are allocated with objc_calloc() as before.
+
+  Statistics are always kept per size class.  Live-object counts per class are available,
+  too, once SBObjectAllocatorSetTracksClasses() has turned them on -- or from startup if the
+  SBOBJECTALLOCATOR_TRACK_CLASSES environment variable is set.
+
+  Build with SB_NO_SLAB_ALLOCATOR defined to have every instance allocated with
+  class_create_instance() and disposed of with object_dispose() (handy with external
+  memory debugging tools); the per-class statistics still work.
+*/
+
+
+/*!
+  @function SBObjectAllocatorCreateInstance
+
+  Allocates a zero-filled instance of aClass.
+*/
+id SBObjectAllocatorCreateInstance(Class aClass);
+/*!
+  @function SBObjectAllocatorDisposeInstance
+
+  Frees an instance which was allocated by SBObjectAllocatorCreateInstance().  Can be
+  called from any thread.
+*/
+void SBObjectAllocatorDisposeInstance(id anObject);
+
+/*!
+  @function SBObjectAllocatorTracksClasses
+
+  Returns YES if allocations and deallocations are being counted per class.
+*/
+BOOL SBObjectAllocatorTracksClasses(void);
+/*!
+  @function SBObjectAllocatorSetTracksClasses
+
+  Turn per-class counting on or off.  Each allocation and deallocation then costs an
+  atomic increment on a counter shared by every thread, so this is best left off unless
+  you're looking for something.  Counts are kept from the time tracking was first turned
+  on, so objects which were already alive then aren't included -- their deallocation
+  can make a class's live count dip below zero.
+*/
+void SBObjectAllocatorSetTracksClasses(BOOL tracksClasses);
+
+/*!
+  @function SBObjectAllocatorWriteStatistics
+
+  Writes a table of the blocks reserved, in use, and cached for each size class -- and, if
+  per-class counts are being kept, the live instance count and total allocations for each
+  class -- to stream.
+
+  The function takes no lock it might have to wait on (at worst, the per-thread figures are
+  left out of the report) and allocates no memory.  It uses stdio, though, so it is not
+  async-signal-safe:  a daemon that dumps statistics on a signal should just note the
+  request in its handler and call this function from its runloop.
+*/
+void SBObjectAllocatorWriteStatistics(FILE* stream);
@@ -0,0 +1,615 @@
+//
+// SBFoundation : ObjC Class Library for Solaris
+// SBObjectAllocator.m
+//
+// Size-class slab allocator for object instances.
+//
+// $Id$
+//
+
+#import "SBObjectAllocator.h"
+
+#include <pthread.h>
+
+//
+// Shared counters (the per-class table, depot figures read by the statistics dump) are
+// updated atomically; the increments need no ordering.
+//
+#if defined(__ATOMIC_RELAXED)
+#  define SBObjectAllocatorAtomicLoad(P)        __atomic_load_n((P), __ATOMIC_RELAXED)
+#  define SBObjectAllocatorAtomicAdd(P, N)      __atomic_add_fetch((P), (N), __ATOMIC_RELAXED)
+#else
+#  define SBObjectAllocatorAtomicLoad(P)        (*(volatile SBUInteger*)(P))
+#  define SBObjectAllocatorAtomicAdd(P, N)      __sync_add_and_fetch((P), (N))
+#endif
+
+//
+// Size classes:  16-byte steps through 256 bytes, then 64-byte steps through 512 bytes.
+//
+#define SBObjectAllocatorSmallStep          16
+#define SBObjectAllocatorSmallLimit         256
+#define SBObjectAllocatorLargeStep          64
+#define SBObjectAllocatorLargeLimit         512
+#define SBObjectAllocatorSizeClassCount     ((SBObjectAllocatorSmallLimit / SBObjectAllocatorSmallStep) + \
+                                              ((SBObjectAllocatorLargeLimit - SBObjectAllocatorSmallLimit) / SBObjectAllocatorLargeStep))
+
+#define SBObjectAllocatorSlabSize           (64 * 1024)
+
+static inline SBUInteger
+SBObjectAllocatorSizeClassForSize(
+  SBUInteger      size
+)
+{
+  if ( size <= SBObjectAllocatorSmallLimit )
+    return ( size ? (size - 1) / SBObjectAllocatorSmallStep : 0 );
+  return (SBObjectAllocatorSmallLimit / SBObjectAllocatorSmallStep) + (size - SBObjectAllocatorSmallLimit - 1) / SBObjectAllocatorLargeStep;
+}
+
+static inline SBUInteger
+SBObjectAllocatorSizeForSizeClass(
+  SBUInteger      sizeClass
+)
+{
+  if ( sizeClass < (SBObjectAllocatorSmallLimit / SBObjectAllocatorSmallStep) )
+    return (sizeClass + 1) * SBObjectAllocatorSmallStep;
+  return SBObjectAllocatorSmallLimit + (sizeClass + 1 - (SBObjectAllocatorSmallLimit / SBObjectAllocatorSmallStep)) * SBObjectAllocatorLargeStep;
+}
+
+//
+// Blocks move between a thread and the depot in batches of a fixed size:  8 KB worth of
+// blocks, but no fewer than 8 and no more than 128 of them.
+//
+static inline SBUInteger
+SBObjectAllocatorBatchCountForSizeClass(
+  SBUInteger      sizeClass
+)
+{
+  SBUInteger      count = 8192 / SBObjectAllocatorSizeForSizeClass(sizeClass);
+
+  return ( (count < 8) ? 8 : ((count > 128) ? 128 : count) );
+}
+
+//
+#pragma mark -
+//
+
+//
+// A free block.  Blocks in a batch are chained through next; batches sitting in the depot
+// are chained through the first block's nextBatch.
+//
+typedef struct _SBObjectAllocatorBlock {
+  struct _SBObjectAllocatorBlock*   next;
+  struct _SBObjectAllocatorBlock*   nextBatch;
+} SBObjectAllocatorBlock;
+
+typedef struct {
+  pthread_mutex_t           lock;
+  SBObjectAllocatorBlock*   batches;
+  SBUInteger                batchCount;
+  SBObjectAllocatorBlock*   loose;          // odd lots left behind by exited threads
+  SBUInteger                looseCount;
+  char*                     slabCursor;
+  char*                     slabEnd;
+  SBUInteger                slabBytes;
+  SBUInteger                retiredAllocations;
+  SBUInteger                retiredDeallocations;
+} SBObjectAllocatorDepot;
+
+typedef struct {
+  SBObjectAllocatorBlock*   freeList;
+  SBUInteger                freeCount;
+  SBUInteger                allocations;
+  SBUInteger                deallocations;
+} SBObjectAllocatorBin;
+
+typedef struct _SBObjectAllocatorCache {
+  struct _SBObjectAllocatorCache*   next;
+  struct _SBObjectAllocatorCache*   prev;
+  SBObjectAllocatorBin              bins[SBObjectAllocatorSizeClassCount];
+} SBObjectAllocatorCache;
+
+//
+// Per-class counts live in a fixed-size open-addressed table; classes are never removed,
+// so slots can be claimed without a lock.
+//
+typedef struct {
+  Class                     aClass;
+  SBUInteger                allocations;
+  SBUInteger                deallocations;
+} SBObjectAllocatorClassRecord;
+
+#define SBObjectAllocatorClassTableSize     4096
+
+//
+
+static SBObjectAllocatorDepot         __SBObjectAllocatorDepots[SBObjectAllocatorSizeClassCount];
+static pthread_mutex_t                __SBObjectAllocatorCachesLock = PTHREAD_MUTEX_INITIALIZER;
+static SBObjectAllocatorCache*        __SBObjectAllocatorCaches = NULL;
+static pthread_key_t                  __SBObjectAllocatorCacheKey;
+static pthread_once_t                 __SBObjectAllocatorInitOnce = PTHREAD_ONCE_INIT;
+static SBUInteger                     __SBObjectAllocatorLargeAllocations = 0;
+static SBUInteger                     __SBObjectAllocatorLargeDeallocations = 0;
+static volatile BOOL                  __SBObjectAllocatorTracksClasses = NO;
+static SBObjectAllocatorClassRecord   __SBObjectAllocatorClasses[SBObjectAllocatorClassTableSize];
+
+//
+// Each thread's cache is found through a thread-local pointer; the pthread key exists to
+// clean up after threads which exit.  Define SBOBJECTALLOCATOR_NO_TLS for compilers without
+// __thread support.
+//
+#ifndef SBOBJECTALLOCATOR_NO_TLS
+static __thread SBObjectAllocatorCache* __SBObjectAllocatorTLSCache = NULL;
+#  define SBObjectAllocatorCurrentCache()   (__SBObjectAllocatorTLSCache)
+#else
+#  define SBObjectAllocatorCurrentCache()   ((SBObjectAllocatorCache*)pthread_getspecific(__SBObjectAllocatorCacheKey))
+#endif
+
+//
+#pragma mark -
+//
+
+SBObjectAllocatorClassRecord*
+__SBObjectAllocatorClassRecord(
+  Class             aClass
+)
+{
+  SBUInteger        i = ((SBUInteger)aClass >> 4) % SBObjectAllocatorClassTableSize;
+  SBUInteger        probes = 0;
+
+  while ( probes++ < SBObjectAllocatorClassTableSize ) {
+    SBObjectAllocatorClassRecord*   record = &__SBObjectAllocatorClasses[i];
+    Class                           recordClass = record->aClass;
+
+    if ( recordClass == aClass )
+      return record;
+    if ( ! recordClass ) {
+      if ( __sync_bool_compare_and_swap(&record->aClass, (Class)NULL, aClass) || (record->aClass == aClass) )
+        return record;
+    }
+    i = (i + 1) % SBObjectAllocatorClassTableSize;
+  }
+  // Table's full:
+  return NULL;
+}
+
+//
+
+void
+__SBObjectAllocatorCountClass(
+  Class             aClass,
+  BOOL              isAllocation
+)
+{
+  SBObjectAllocatorClassRecord*   record = __SBObjectAllocatorClassRecord(aClass);
+
+  if ( record ) {
+    if ( isAllocation )
+      SBObjectAllocatorAtomicAdd(&record->allocations, 1);
+    else
+      SBObjectAllocatorAtomicAdd(&record->deallocations, 1);
+  }
+}
+
+//
+#pragma mark -
+//
+
+#ifndef SB_NO_SLAB_ALLOCATOR
+
+void
+__SBObjectAllocatorCacheDestroy(
+  void*             aCache
+)
+{
+  SBObjectAllocatorCache*   cache = (SBObjectAllocatorCache*)aCache;
+  SBUInteger                sizeClass;
+
+  //
+  // Everything the thread had cached goes back to the depot, and its counts are folded
+  // into the depot's:
+  //
+  for ( sizeClass = 0; sizeClass < SBObjectAllocatorSizeClassCount; sizeClass++ ) {
+    SBObjectAllocatorDepot* depot = &__SBObjectAllocatorDepots[sizeClass];
+    SBObjectAllocatorBin*   bin = &cache->bins[sizeClass];
+
+    pthread_mutex_lock(&depot->lock);
+    while ( bin->freeList ) {
+      SBObjectAllocatorBlock*   block = bin->freeList;
+
+      bin->freeList = block->next;
+      block->next = depot->loose;
+      depot->loose = block;
+      depot->looseCount++;
+    }
+    depot->retiredAllocations += bin->allocations;
+    depot->retiredDeallocations += bin->deallocations;
+    pthread_mutex_unlock(&depot->lock);
+  }
+
+  pthread_mutex_lock(&__SBObjectAllocatorCachesLock);
+  if ( cache->prev )
+    cache->prev->next = cache->next;
+  else
+    __SBObjectAllocatorCaches = cache->next;
+  if ( cache->next )
+    cache->next->prev = cache->prev;
+  pthread_mutex_unlock(&__SBObjectAllocatorCachesLock);
+
+#ifndef SBOBJECTALLOCATOR_NO_TLS
+  // Anything deallocated by later destructors starts a fresh cache:
+  __SBObjectAllocatorTLSCache = NULL;
+#endif
+  objc_free(cache);
+}
+
+#endif /* SB_NO_SLAB_ALLOCATOR */
+
+//
+
+void
+__SBObjectAllocatorInit(void)
+{
+  SBUInteger        sizeClass;
+
+  for ( sizeClass = 0; sizeClass < SBObjectAllocatorSizeClassCount; sizeClass++ )
+    pthread_mutex_init(&__SBObjectAllocatorDepots[sizeClass].lock, NULL);
+#ifndef SB_NO_SLAB_ALLOCATOR
+  pthread_key_create(&__SBObjectAllocatorCacheKey, __SBObjectAllocatorCacheDestroy);
+#endif
+  if ( getenv("SBOBJECTALLOCATOR_TRACK_CLASSES") )
+    __SBObjectAllocatorTracksClasses = YES;
+}
+
+//
+
+#ifndef SB_NO_SLAB_ALLOCATOR
+
+SBObjectAllocatorCache*
+__SBObjectAllocatorCacheForCurrentThread(void)
+{
+  SBObjectAllocatorCache*   cache = SBObjectAllocatorCurrentCache();
+
+  if ( ! cache ) {
+    pthread_once(&__SBObjectAllocatorInitOnce, __SBObjectAllocatorInit);
+
+    if ( ! (cache = objc_calloc(1, sizeof(SBObjectAllocatorCache))) )
+      return NULL;
+    pthread_setspecific(__SBObjectAllocatorCacheKey, cache);
+#ifndef SBOBJECTALLOCATOR_NO_TLS
+    __SBObjectAllocatorTLSCache = cache;
+#endif
+    pthread_mutex_lock(&__SBObjectAllocatorCachesLock);
+    if ( (cache->next = __SBObjectAllocatorCaches) )
+      cache->next->prev = cache;
+    __SBObjectAllocatorCaches = cache;
+    pthread_mutex_unlock(&__SBObjectAllocatorCachesLock);
+  }
+  return cache;
+}
+
+//
+
+BOOL
+__SBObjectAllocatorRefill(
+  SBObjectAllocatorBin*   bin,
+  SBUInteger              sizeClass
+)
+{
+  SBObjectAllocatorDepot* depot = &__SBObjectAllocatorDepots[sizeClass];
+  SBUInteger              batchCount = SBObjectAllocatorBatchCountForSizeClass(sizeClass);
+  SBUInteger              blockSize = SBObjectAllocatorSizeForSizeClass(sizeClass);
+  SBUInteger              count = 0;
+  SBObjectAllocatorBlock* list = NULL;
+
+  pthread_mutex_lock(&depot->lock);
+  if ( depot->batches ) {
+    // A whole batch someone handed back:
+    list = depot->batches;
+    depot->batches = list->nextBatch;
+    depot->batchCount--;
+    count = batchCount;
+  } else if ( depot->loose ) {
+    while ( depot->loose && (count < batchCount) ) {
+      SBObjectAllocatorBlock*   block = depot->loose;
+
+      depot->loose = block->next;
+      depot->looseCount--;
+      block->next = list;
+      list = block;
+      count++;
+    }
+  } else {
+    // Carve fresh blocks from the current slab, starting a new one when it runs out:
+    while ( count < batchCount ) {
+      SBObjectAllocatorBlock*   block;
+
+      if ( depot->slabCursor + blockSize > depot->slabEnd ) {
+        char*                   slab = objc_malloc(SBObjectAllocatorSlabSize);
+
+        if ( ! slab )
+          break;
+        depot->slabCursor = slab;
+        depot->slabEnd = slab + SBObjectAllocatorSlabSize;
+        SBObjectAllocatorAtomicAdd(&depot->slabBytes, SBObjectAllocatorSlabSize);
+      }
+      block = (SBObjectAllocatorBlock*)depot->slabCursor;
+      depot->slabCursor += blockSize;
+      block->next = list;
+      list = block;
+      count++;
+    }
+  }
+  pthread_mutex_unlock(&depot->lock);
+
+  bin->freeList = list;
+  bin->freeCount = count;
+  return ( count ? YES : NO );
+}
+
+//
+
+void
+__SBObjectAllocatorFlush(
+  SBObjectAllocatorBin*   bin,
+  SBUInteger              sizeClass
+)
+{
+  SBObjectAllocatorDepot* depot = &__SBObjectAllocatorDepots[sizeClass];
+  SBUInteger              batchCount = SBObjectAllocatorBatchCountForSizeClass(sizeClass);
+  SBObjectAllocatorBlock* batch = bin->freeList;
+  SBObjectAllocatorBlock* last = batch;
+  SBUInteger              i = 1;
+
+  // Split a batch off the front of the list:
+  while ( i++ < batchCount )
+    last = last->next;
+  bin->freeList = last->next;
+  bin->freeCount -= batchCount;
+  last->next = NULL;
+
+  pthread_mutex_lock(&depot->lock);
+  batch->nextBatch = depot->batches;
+  depot->batches = batch;
+  depot->batchCount++;
+  pthread_mutex_unlock(&depot->lock);
+}
+
+#endif /* SB_NO_SLAB_ALLOCATOR */
+
+//
+#pragma mark -
+//
+
+id
+SBObjectAllocatorCreateInstance(
+  Class             aClass
+)
+{
+  id                newObject = nil;
+
+#ifndef SB_NO_SLAB_ALLOCATOR
+  SBUInteger        size = class_get_instance_size(aClass);
+
+  if ( size <= SBObjectAllocatorLargeLimit ) {
+    SBObjectAllocatorCache*   cache = SBObjectAllocatorCurrentCache();
+    SBUInteger                sizeClass = SBObjectAllocatorSizeClassForSize(size);
+    SBObjectAllocatorBin*     bin;
+    SBObjectAllocatorBlock*   block;
+
+    if ( ! cache && ! (cache = __SBObjectAllocatorCacheForCurrentThread()) )
+      return nil;
+    bin = &cache->bins[sizeClass];
+    if ( ! (block = bin->freeList) ) {
+      if ( ! __SBObjectAllocatorRefill(bin, sizeClass) )
+        return nil;
+      block = bin->freeList;
+    }
+    bin->freeList = block->next;
+    bin->freeCount--;
+    bin->allocations++;
+
+    memset(block, 0, size);
+    newObject = (id)block;
+    newObject->class_pointer = aClass;
+  } else {
+    pthread_once(&__SBObjectAllocatorInitOnce, __SBObjectAllocatorInit);
+    if ( (newObject = class_create_instance(aClass)) )
+      SBObjectAllocatorAtomicAdd(&__SBObjectAllocatorLargeAllocations, 1);
+  }
+#else
+  pthread_once(&__SBObjectAllocatorInitOnce, __SBObjectAllocatorInit);
+  newObject = class_create_instance(aClass);
+#endif
+
+  if ( newObject && __SBObjectAllocatorTracksClasses )
+    __SBObjectAllocatorCountClass(aClass, YES);
+  return newObject;
+}
+
+//
+
+void
+SBObjectAllocatorDisposeInstance(
+  id                anObject
+)
+{
+  Class             aClass = object_get_class(anObject);
+
+  if ( __SBObjectAllocatorTracksClasses )
+    __SBObjectAllocatorCountClass(aClass, NO);
+
+#ifndef SB_NO_SLAB_ALLOCATOR
+  SBUInteger        size = class_get_instance_size(aClass);
+
+  if ( size <= SBObjectAllocatorLargeLimit ) {
+    SBObjectAllocatorCache*   cache = SBObjectAllocatorCurrentCache();
+    SBUInteger                sizeClass = SBObjectAllocatorSizeClassForSize(size);
+    SBObjectAllocatorBin*     bin;
+    SBObjectAllocatorBlock*   block = (SBObjectAllocatorBlock*)anObject;
+
+    if ( ! cache && ! (cache = __SBObjectAllocatorCacheForCurrentThread()) ) {
+      // No cache to be had, so straight to the depot:
+      SBObjectAllocatorDepot* depot = &__SBObjectAllocatorDepots[sizeClass];
+
+      pthread_mutex_lock(&depot->lock);
+      block->next = depot->loose;
+      depot->loose = block;
+      depot->looseCount++;
+      depot->retiredDeallocations++;
+      pthread_mutex_unlock(&depot->lock);
+      return;
+    }
+    bin = &cache->bins[sizeClass];
+    block->next = bin->freeList;
+    bin->freeList = block;
+    bin->deallocations++;
+    if ( ++bin->freeCount >= 2 * SBObjectAllocatorBatchCountForSizeClass(sizeClass) )
+      __SBObjectAllocatorFlush(bin, sizeClass);
+  } else {
+    SBObjectAllocatorAtomicAdd(&__SBObjectAllocatorLargeDeallocations, 1);
+    object_dispose(anObject);
+  }
+#else
+  object_dispose(anObject);
+#endif
+}
+
+//
+
+BOOL
+SBObjectAllocatorTracksClasses(void)
+{
+  pthread_once(&__SBObjectAllocatorInitOnce, __SBObjectAllocatorInit);
+  return __SBObjectAllocatorTracksClasses;
+}
+
+//
+
+void
+SBObjectAllocatorSetTracksClasses(
+  BOOL              tracksClasses
+)
+{
+  pthread_once(&__SBObjectAllocatorInitOnce, __SBObjectAllocatorInit);
+  __SBObjectAllocatorTracksClasses = tracksClasses;
+}
+
+//
+#pragma mark -
+//
+
+int
+__SBObjectAllocatorClassRecordCompare(
+  const void*       r1,
+  const void*       r2
+)
+{
+  const SBObjectAllocatorClassRecord*   record1 = (const SBObjectAllocatorClassRecord*)r1;
+  const SBObjectAllocatorClassRecord*   record2 = (const SBObjectAllocatorClassRecord*)r2;
+  long                                  live1 = (long)(record1->allocations - record1->deallocations);
+  long                                  live2 = (long)(record2->allocations - record2->deallocations);
+
+  // Most live instances first, then the busiest allocators:
+  if ( live1 != live2 )
+    return ( (live1 > live2) ? -1 : 1 );
+  if ( record1->allocations != record2->allocations )
+    return ( (record1->allocations > record2->allocations) ? -1 : 1 );
+  return 0;
+}
+
+//
+
+void
+SBObjectAllocatorWriteStatistics(
+  FILE*             stream
+)
+{
+  static pthread_mutex_t                sortLock = PTHREAD_MUTEX_INITIALIZER;
+  static SBObjectAllocatorClassRecord   sorted[SBObjectAllocatorClassTableSize];
+  SBUInteger                            sizeClass, i, count;
+  BOOL                                  haveThreads = NO;
+  SBUInteger                            totalReserved = 0, totalLive = 0;
+
+  fprintf(stream, "SBObjectAllocator statistics (pid %d):\n\n", (int)getpid());
+  fprintf(stream, "%8s %12s %12s %12s %12s %16s\n", "size", "reserved KB", "live", "live KB", "cached", "allocations");
+
+#ifndef SB_NO_SLAB_ALLOCATOR
+  // Threads are only added and removed under this lock, so don't wait on it:
+  if ( pthread_mutex_trylock(&__SBObjectAllocatorCachesLock) == 0 )
+    haveThreads = YES;
+#endif
+
+  for ( sizeClass = 0; sizeClass < SBObjectAllocatorSizeClassCount; sizeClass++ ) {
+    SBObjectAllocatorDepot* depot = &__SBObjectAllocatorDepots[sizeClass];
+    SBUInteger              blockSize = SBObjectAllocatorSizeForSizeClass(sizeClass);
+    SBUInteger              reserved = SBObjectAllocatorAtomicLoad(&depot->slabBytes);
+    SBUInteger              allocations = depot->retiredAllocations;
+    SBUInteger              deallocations = depot->retiredDeallocations;
+    SBUInteger              cached = depot->looseCount + depot->batchCount * SBObjectAllocatorBatchCountForSizeClass(sizeClass);
+
+    if ( ! reserved )
+      continue;
+#ifndef SB_NO_SLAB_ALLOCATOR
+    if ( haveThreads ) {
+      SBObjectAllocatorCache* cache = __SBObjectAllocatorCaches;
+
+      // The figures are read on the fly, so they can be off by a little:
+      while ( cache ) {
+        allocations += cache->bins[sizeClass].allocations;
+        deallocations += cache->bins[sizeClass].deallocations;
+        cached += cache->bins[sizeClass].freeCount;
+        cache = cache->next;
+      }
+    }
+#endif
+    fprintf(stream, "%8lu %12.1lf %12ld %12.1lf %12lu %16lu\n",
+        (unsigned long)blockSize,
+        reserved / 1024.0,
+        (long)(allocations - deallocations),
+        (long)(allocations - deallocations) * blockSize / 1024.0,
+        (unsigned long)cached,
+        (unsigned long)allocations
+      );
+    totalReserved += reserved;
+    totalLive += (allocations - deallocations) * blockSize;
+  }
+#ifndef SB_NO_SLAB_ALLOCATOR
+  if ( haveThreads )
+    pthread_mutex_unlock(&__SBObjectAllocatorCachesLock);
+#endif
+  fprintf(stream, "%8s %12.1lf %12s %12.1lf\n", "total", totalReserved / 1024.0, "", (long)totalLive / 1024.0);
+  fprintf(stream, "%8s %12s %12ld %12s %12s %16lu\n", "> 512", "",
+      (long)(__SBObjectAllocatorLargeAllocations - __SBObjectAllocatorLargeDeallocations), "", "",
+      (unsigned long)__SBObjectAllocatorLargeAllocations
+    );
+  if ( ! haveThreads )
+    fprintf(stream, "(per-thread figures omitted; the thread list was busy)\n");
+  fflush(stream);
+
+  if ( ! __SBObjectAllocatorTracksClasses )
+    return;
+
+  //
+  // Per-class counts, sorted in a static buffer since we can't allocate:
+  //
+  if ( pthread_mutex_trylock(&sortLock) != 0 )
+    return;
+  count = 0;
+  for ( i = 0; i < SBObjectAllocatorClassTableSize; i++ ) {
+    if ( __SBObjectAllocatorClasses[i].aClass )
+      sorted[count++] = __SBObjectAllocatorClasses[i];
+  }
+  qsort(sorted, count, sizeof(SBObjectAllocatorClassRecord), __SBObjectAllocatorClassRecordCompare);
+
+  fprintf(stream, "\n%-40s %8s %12s %16s\n", "class", "size", "live", "allocations");
+  for ( i = 0; i < count; i++ ) {
+    fprintf(stream, "%-40s %8lu %12ld %16lu\n",
+        class_get_class_name(sorted[i].aClass),
+        (unsigned long)class_get_instance_size(sorted[i].aClass),
+        (long)(sorted[i].allocations - sorted[i].deallocations),
+        (unsigned long)sorted[i].allocations
+      );
+  }
+  pthread_mutex_unlock(&sortLock);
+  fflush(stream);
+}
@@ -0,0 +1,308 @@
+//
+// SBFoundation : ObjC Class Library for Solaris
+// SBOperationQueue.h
+//
+// Fixed-size pool of worker threads which execute many small units of work.
+//
+// Copyright (c) 2010
+// University of Delaware
+//
+// $Id$
+//
+
+#import "SBObject.h"
+
+#include <pthread.h>
+
+@class SBArray, SBMutableArray, SBRunLoop, SBException, SBOperationQueue;
+
+/*!
+  @class SBOperation
+  @discussion
+    An SBOperation is a single unit of work to be executed by an SBOperationQueue.  The work is
+    either a message sent to a target object (see initWithTarget:selector:object:) or the main
+    method of a subclass.
+
+    An operation does not become ready to execute until every operation it depends on (see
+    addDependency:) has finished.  Dependencies must be added before the operation is added to
+    a queue; they may belong to other queues.
+
+    Cancelling an operation which has not yet started keeps its work from ever being done, but
+    it still finishes:  operations which depend on it become ready, its completion message is
+    still delivered and waitUntilFinished returns.  Cancelling an operation which is already
+    executing merely sets a flag; long-running work should check isCancelled (or, from the
+    worker thread, [[SBThread currentThread] isCancelled]) now and then and give up early.
+*/
+@interface SBOperation : SBObject
+{
+  id                    _target;
+  SEL                   _selector;
+  id                    _argument;
+  id                    _result;
+  SBException*          _exception;
+  SBMutableArray*       _dependencies;
+  SBMutableArray*       _dependents;
+  id                    _completionTarget;
+  SEL                   _completionSelector;
+  SBRunLoop*            _completionRunLoop;
+  SBOperationQueue*     _queue;
+  SBUInteger            _generation;
+  pthread_mutex_t       _stateLock;
+  pthread_cond_t        _stateChanged;
+  SBUInteger            _pendingCount;
+  volatile SBUInteger   _state;
+  volatile BOOL         _cancelled;
+}
+
+/*!
+  @method operationWithTarget:selector:object:
+  @discussion
+    Returns an autoreleased operation which sends aSelector to aTarget (see
+    initWithTarget:selector:object:).
+*/
++ (SBOperation*) operationWithTarget:(id)aTarget selector:(SEL)aSelector object:(id)anObject;
+
+/*!
+  @method initWithTarget:selector:object:
+  @discussion
+    Initializes an operation whose main method sends aSelector to aTarget with anObject as
+    its sole argument.  The method should accept a single argument of type id and return an
+    object (which becomes the operation's result) or nil:
+
+      - (id) doSomeWork:(id)argument
+
+    The target and argument are retained until the operation is deallocated.
+*/
+- (id) initWithTarget:(id)aTarget selector:(SEL)aSelector object:(id)anObject;
+
+/*!
+  @method main
+  @discussion
+    Performs the receiver's work; invoked on a worker thread inside its own autorelease
+    pool.  The default implementation sends the selector given at initialization to the
+    target and records what it returns as the result.  Subclasses may override this
+    method instead (and use setResult: to hand back a value); there is no need to chain
+    to SBOperation's implementation.  An exception raised by main is caught and kept
+    as the receiver's exception.
+*/
+- (void) main;
+
+/*!
+  @method result
+  @discussion
+    Returns the object produced by the receiver's work, or nil.  Only meaningful once
+    the receiver has finished.
+*/
+- (id) result;
+/*!
+  @method setResult:
+  @discussion
+    Sets (and retains) the object returned by the result method.
+*/
+- (void) setResult:(id)result;
+
+/*!
+  @method exception
+  @discussion
+    Returns the exception raised while the receiver was executing, or nil if its work
+    completed normally.
+*/
+- (SBException*) exception;
+
+/*!
+  @method addDependency:
+  @discussion
+    The receiver will not be executed until anOperation has finished.  Must be sent before
+    the receiver is added to a queue.
+*/
+- (void) addDependency:(SBOperation*)anOperation;
+/*!
+  @method dependencies
+  @discussion
+    Returns the operations the receiver depends on.
+*/
+- (SBArray*) dependencies;
+
+/*!
+  @method setCompletionTarget:selector:runLoop:
+  @discussion
+    Once the receiver has finished, aSelector is sent to aTarget with the receiver as its
+    sole argument.  If aRunLoop is not nil the message is posted to it (in the default
+    mode) so that it is delivered on that runloop's thread; otherwise it is sent directly
+    from the worker thread which executed the receiver.  The target is retained until the
+    message has been delivered.
+*/
+- (void) setCompletionTarget:(id)aTarget selector:(SEL)aSelector runLoop:(SBRunLoop*)aRunLoop;
+
+/*!
+  @method cancel
+  @discussion
+    Marks the receiver as cancelled.
+*/
+- (void) cancel;
+/*!
+  @method isCancelled
+  @discussion
+    Returns YES if the receiver (or, since the receiver was added to it, its queue's
+    pending work) has been cancelled.
+*/
+- (BOOL) isCancelled;
+
+/*!
+  @method isReady
+  @discussion
+    Returns YES if all of the receiver's dependencies have finished.
+*/
+- (BOOL) isReady;
+/*!
+  @method isExecuting
+  @discussion
+    Returns YES if the receiver is being executed by a worker thread.
+*/
+- (BOOL) isExecuting;
+/*!
+  @method isFinished
+  @discussion
+    Returns YES if the receiver has finished executing (or was cancelled before it ever
+    started).
+*/
+- (BOOL) isFinished;
+
+/*!
+  @method waitUntilFinished
+  @discussion
+    Blocks the calling thread until the receiver has finished.  When sent from one of
+    its queue's own worker threads, the worker keeps executing other operations while
+    it waits rather than sitting idle (and possibly starving the queue).
+*/
+- (void) waitUntilFinished;
+
+@end
+
+/*!
+  @class SBOperationQueue
+  @discussion
+    An SBOperationQueue spreads SBOperations across a fixed number of worker threads --
+    by default, one per online processor.
+
+    Each worker has its own double-ended queue of ready operations.  A worker takes the
+    most recently queued operation from the bottom of its own deque (new work spawned by
+    an operation is likely to find its data still in that processor's cache) and, when
+    its deque runs dry, steals the oldest operation from the top of another worker's
+    deque.  Operations added from outside the queue are dealt out round-robin; those
+    added by an operation running on one of the workers go to that worker's deque.  Idle
+    workers sleep until work is queued.
+
+    Each operation is executed inside its own autorelease pool, which is released as soon
+    as the operation finishes, so a worker's memory use does not grow with the number of
+    operations it works through.
+
+    While a worker is executing an operation, its SBThread's isCancelled method reflects
+    that operation's isCancelled (and shutdown of the queue), so code which only has the
+    current thread to go on can still notice cancellation.
+
+    The workers retain the queue; send it shutdown to let them go.  Like threads created
+    with detachNewThreadSelector:toTarget:withObject:, worker SBThreads are not reclaimed
+    when they exit, so queues are best created once and kept for the life of the process.
+*/
+@interface SBOperationQueue : SBObject
+{
+  SBUInteger            _workerCount;
+  void*                 _deques;
+  pthread_mutex_t       _parkLock;
+  pthread_cond_t        _workQueued;
+  pthread_cond_t        _allFinished;
+  SBUInteger            _queuedCount;
+  SBUInteger            _idleCount;
+  SBUInteger            _outstandingCount;
+  SBUInteger            _runningWorkers;
+  SBUInteger            _nextDeque;
+  SBUInteger            _generation;
+  volatile BOOL         _shutdown;
+}
+
+/*!
+  @method sharedOperationQueue
+  @discussion
+    Returns a process-wide queue with the default number of workers, creating it the
+    first time it is needed.
+*/
++ (SBOperationQueue*) sharedOperationQueue;
+
+/*!
+  @method defaultWorkerCount
+  @discussion
+    Returns the number of online processors (at least 1).
+*/
++ (SBUInteger) defaultWorkerCount;
+
+/*!
+  @method init
+  @discussion
+    Initializes a queue with defaultWorkerCount worker threads.
+*/
+- (id) init;
+/*!
+  @method initWithWorkerCount:
+  @discussion
+    Designated initializer.  Starts workerCount worker threads (at least 1).
+*/
+- (id) initWithWorkerCount:(SBUInteger)workerCount;
+
+/*!
+  @method workerCount
+  @discussion
+    Returns the number of worker threads the receiver was started with.
+*/
+- (SBUInteger) workerCount;
+
+/*!
+  @method operationCount
+  @discussion
+    Returns the number of operations which have been added to the receiver but have not
+    yet finished, including those still waiting on dependencies.
+*/
+- (SBUInteger) operationCount;
+
+/*!
+  @method addOperation:
+  @discussion
+    Adds anOperation to the receiver; it is executed as soon as its dependencies have
+    finished and a worker is free.  The operation is retained until it finishes.  An
+    operation can only be added to one queue, once.  Raises an exception if the receiver
+    has been shut down.
+*/
+- (void) addOperation:(SBOperation*)anOperation;
+/*!
+  @method addOperationWithTarget:selector:object:
+  @discussion
+    Convenience method which creates an operation (see SBOperation's
+    initWithTarget:selector:object:), adds it to the receiver and returns it.
+*/
+- (SBOperation*) addOperationWithTarget:(id)aTarget selector:(SEL)aSelector object:(id)anObject;
+
+/*!
+  @method cancelAllOperations
+  @discussion
+    Cancels every operation which has been added to the receiver and has not yet finished.
+    Operations added afterwards are not affected.
+*/
+- (void) cancelAllOperations;
+
+/*!
+  @method waitUntilAllOperationsAreFinished
+  @discussion
+    Blocks the calling thread until the receiver has no unfinished operations.  Must not
+    be sent from one of the receiver's own workers.
+*/
+- (void) waitUntilAllOperationsAreFinished;
+
+/*!
+  @method shutdown
+  @discussion
+    Cancels all unfinished operations, waits for them to drain out of the queue and
+    stops the worker threads.  No more operations can be added afterwards.
+*/
+- (void) shutdown;
+
+@end
@@ -0,0 +1,885 @@
+//
+// SBFoundation : ObjC Class Library for Solaris
+// SBOperationQueue.m
+//
+// Fixed-size pool of worker threads which execute many small units of work.
+//
+// Copyright (c) 2010
+// University of Delaware
+//
+// $Id$
+//
+
+#import "SBOperationQueue.h"
+#import "SBArray.h"
+#import "SBThread.h"
+#import "SBLock.h"
+#import "SBRunLoop.h"
+#import "SBAutoreleasePool.h"
+#import "SBException.h"
+
+#include <unistd.h>
+#include <sched.h>
+#include <sys/time.h>
+
+//
+// Counters shared between producers and idle workers.  A producer bumps the queued count
+// and then looks for idle workers; a worker going idle bumps the idle count and then looks
+// for queued work -- with full ordering on both sides one of them always sees the other,
+// so no wakeup is lost and producers skip the park lock when every worker is busy.
+//
+#if defined(__ATOMIC_SEQ_CST)
+#  define SBOperationQueueAtomicLoad(P)         __atomic_load_n((P), __ATOMIC_SEQ_CST)
+#  define SBOperationQueueAtomicIncrement(P)    __atomic_add_fetch((P), 1, __ATOMIC_SEQ_CST)
+#  define SBOperationQueueAtomicDecrement(P)    __atomic_sub_fetch((P), 1, __ATOMIC_SEQ_CST)
+#else
+#  define SBOperationQueueAtomicLoad(P)         (__sync_synchronize(), *(volatile SBUInteger*)(P))
+#  define SBOperationQueueAtomicIncrement(P)    __sync_add_and_fetch((P), 1)
+#  define SBOperationQueueAtomicDecrement(P)    __sync_sub_and_fetch((P), 1)
+#endif
+
+//
+
+enum {
+  SBOperationIsWaiting = 0,
+  SBOperationIsQueued,
+  SBOperationIsExecuting,
+  SBOperationIsFinished
+};
+
+//
+
+static SBOperationQueue*      __SBOperationQueueShared = nil;
+
+//
+#pragma mark -
+//
+
+//
+// Each worker owns a deque of ready operations:  the owner pushes and pops at the bottom,
+// other workers steal from the top.  Contention on any one deque is low (the owner plus an
+// occasional thief), so a plain mutex per deque does the job.
+//
+typedef struct {
+  pthread_mutex_t     lock;
+  SBOperation**       operations;
+  SBUInteger          capacity;
+  SBUInteger          top;
+  SBUInteger          count;
+} SBOperationQueueDeque;
+
+#define SBOperationQueueDequeInitialCapacity   64
+
+//
+
+BOOL
+__SBOperationQueueDequePush(
+  SBOperationQueueDeque*  deque,
+  SBOperation*            anOperation
+)
+{
+  BOOL                    rc = YES;
+
+  pthread_mutex_lock(&deque->lock);
+  if ( deque->count == deque->capacity ) {
+    SBUInteger            newCapacity = ( deque->capacity ? 2 * deque->capacity : SBOperationQueueDequeInitialCapacity );
+    SBOperation**         newOperations = objc_malloc(newCapacity * sizeof(SBOperation*));
+
+    if ( newOperations ) {
+      SBUInteger          i = 0;
+
+      // Unwrap the ring as we go:
+      while ( i < deque->count ) {
+        newOperations[i] = deque->operations[(deque->top + i) % deque->capacity];
+        i++;
+      }
+      if ( deque->operations ) objc_free(deque->operations);
+      deque->operations = newOperations;
+      deque->capacity = newCapacity;
+      deque->top = 0;
+    } else {
+      rc = NO;
+    }
+  }
+  if ( rc )
+    deque->operations[(deque->top + deque->count++) % deque->capacity] = anOperation;
+  pthread_mutex_unlock(&deque->lock);
+  return rc;
+}
+
+//
+
+SBOperation*
+__SBOperationQueueDequePop(
+  SBOperationQueueDeque*  deque
+)
+{
+  SBOperation*            anOperation = nil;
+
+  pthread_mutex_lock(&deque->lock);
+  if ( deque->count )
+    anOperation = deque->operations[(deque->top + --deque->count) % deque->capacity];
+  pthread_mutex_unlock(&deque->lock);
+  return anOperation;
+}
+
+//
+
+SBOperation*
+__SBOperationQueueDequeSteal(
+  SBOperationQueueDeque*  deque
+)
+{
+  SBOperation*            anOperation = nil;
+
+  // Don't bother taking the lock on a deque that looks empty:
+  if ( ! deque->count )
+    return nil;
+  pthread_mutex_lock(&deque->lock);
+  if ( deque->count ) {
+    anOperation = deque->operations[deque->top];
+    deque->top = (deque->top + 1) % deque->capacity;
+    deque->count--;
+  }
+  pthread_mutex_unlock(&deque->lock);
+  return anOperation;
+}
+
+//
+#pragma mark -
+//
+
+@interface SBOperationQueueWorker : SBThread
+{
+  SBOperationQueue*       _queue;
+  SBUInteger              _index;
+  SBOperation*            _currentOperation;
+}
+
+- (id) initWithQueue:(SBOperationQueue*)queue index:(SBUInteger)index;
+- (SBOperationQueue*) queue;
+- (SBUInteger) index;
+- (SBOperation*) currentOperation;
+- (void) setCurrentOperation:(SBOperation*)anOperation;
+
+@end
+
+//
+
+@interface SBOperation(SBOperationPrivate)
+
+- (SBOperationQueue*) queue;
+- (BOOL) setQueue:(SBOperationQueue*)queue generation:(SBUInteger)generation;
+- (void) setState:(SBUInteger)state;
+- (void) dependencyDidFinish;
+- (void) execute;
+- (void) finish;
+
+@end
+
+//
+
+@interface SBOperationQueue(SBOperationQueuePrivate)
+
+- (SBUInteger) generation;
+- (BOOL) isShutdown;
+- (SBOperationQueueWorker*) currentWorker;
+- (void) scheduleOperation:(SBOperation*)anOperation;
+- (SBOperation*) takeOperationForWorker:(SBOperationQueueWorker*)worker;
+- (void) runOperation:(SBOperation*)anOperation onWorker:(SBOperationQueueWorker*)worker;
+- (void) operationDidFinish:(SBOperation*)anOperation;
+- (void) workerMain:(SBOperationQueueWorker*)worker;
+
+@end
+
+//
+#pragma mark -
+//
+
+@implementation SBOperationQueueWorker
+
+  - (id) initWithQueue:(SBOperationQueue*)queue
+    index:(SBUInteger)index
+  {
+    if ( (self = [super init]) ) {
+      _queue = [queue retain];
+      _index = index;
+    }
+    return self;
+  }
+
+//
+
+  - (SBOperationQueue*) queue { return _queue; }
+  - (SBUInteger) index { return _index; }
+  - (SBOperation*) currentOperation { return _currentOperation; }
+  - (void) setCurrentOperation:(SBOperation*)anOperation { _currentOperation = anOperation; }
+
+//
+
+  - (void) threadMain
+  {
+    SBOperationQueue*     queue = _queue;
+
+    [queue workerMain:self];
+    _queue = nil;
+    [queue release];
+  }
+
+//
+
+  - (BOOL) isCancelled
+  {
+    if ( [super isCancelled] )
+      return YES;
+    if ( _currentOperation )
+      return [_currentOperation isCancelled];
+    return ( _queue ? [_queue isShutdown] : NO );
+  }
+
+@end
+
+//
+#pragma mark -
+//
+
+@implementation SBOperation(SBOperationPrivate)
+
+  - (SBOperationQueue*) queue
+  {
+    return _queue;
+  }
+
+//
+
+  - (BOOL) setQueue:(SBOperationQueue*)queue
+    generation:(SBUInteger)generation
+  {
+    BOOL          rc = NO;
+
+    pthread_mutex_lock(&_stateLock);
+    if ( ! _queue ) {
+      _queue = queue;
+      _generation = generation;
+      rc = YES;
+    }
+    pthread_mutex_unlock(&_stateLock);
+    return rc;
+  }
+
+//
+
+  - (void) setState:(SBUInteger)state
+  {
+    pthread_mutex_lock(&_stateLock);
+    _state = state;
+    pthread_cond_broadcast(&_stateChanged);
+    pthread_mutex_unlock(&_stateLock);
+  }
+
+//
+
+  - (void) dependencyDidFinish
+  {
+    BOOL          isReady;
+
+    pthread_mutex_lock(&_stateLock);
+    isReady = ( --_pendingCount == 0 );
+    pthread_mutex_unlock(&_stateLock);
+    if ( isReady )
+      [_queue scheduleOperation:self];
+  }
+
+//
+
+  - (void) execute
+  {
+    if ( [self isCancelled] )
+      return;
+    [self setState:SBOperationIsExecuting];
+    TRY_BEGIN
+      [self main];
+    TRY_CATCH(anException)
+      _exception = [anException retain];
+    TRY_END
+  }
+
+//
+
+  - (void) finish
+  {
+    SBMutableArray*   dependents;
+
+    pthread_mutex_lock(&_stateLock);
+    dependents = _dependents;
+    _dependents = nil;
+    _state = SBOperationIsFinished;
+    pthread_cond_broadcast(&_stateChanged);
+    pthread_mutex_unlock(&_stateLock);
+
+    if ( dependents ) {
+      SBUInteger      i = 0, iMax = [dependents count];
+
+      while ( i < iMax )
+        [[dependents objectAtIndex:i++] dependencyDidFinish];
+      [dependents release];
+    }
+
+    if ( _completionTarget ) {
+      if ( _completionRunLoop ) {
+        [_completionRunLoop postSelector:_completionSelector target:_completionTarget argument:self order:0 modes:[SBArray arrayWithObject:SBRunLoopDefaultMode]];
+        [_completionRunLoop release];
+        _completionRunLoop = nil;
+      } else {
+        [_completionTarget perform:_completionSelector with:self];
+      }
+      [_completionTarget release];
+      _completionTarget = nil;
+    }
+  }
+
+@end
+
+//
+#pragma mark -
+//
+
+@implementation SBOperation
+
+  + (SBOperation*) operationWithTarget:(id)aTarget
+    selector:(SEL)aSelector
+    object:(id)anObject
+  {
+    return [[[self alloc] initWithTarget:aTarget selector:aSelector object:anObject] autorelease];
+  }
+
+//
+
+  - (id) init
+  {
+    if ( (self = [super init]) ) {
+      pthread_mutex_init(&_stateLock, NULL);
+      pthread_cond_init(&_stateChanged, NULL);
+      // Held until the operation is added to a queue:
+      _pendingCount = 1;
+    }
+    return self;
+  }
+
+//
+
+  - (id) initWithTarget:(id)aTarget
+    selector:(SEL)aSelector
+    object:(id)anObject
+  {
+    if ( (self = [self init]) ) {
+      _target = [aTarget retain];
+      _selector = aSelector;
+      _argument = ( anObject ? [anObject retain] : nil );
+    }
+    return self;
+  }
+
+//
+
+  - (void) dealloc
+  {
+    if ( _target ) [_target release];
+    if ( _argument ) [_argument release];
+    if ( _result ) [_result release];
+    if ( _exception ) [_exception release];
+    if ( _dependencies ) [_dependencies release];
+    if ( _dependents ) [_dependents release];
+    if ( _completionTarget ) [_completionTarget release];
+    if ( _completionRunLoop ) [_completionRunLoop release];
+    pthread_cond_destroy(&_stateChanged);
+    pthread_mutex_destroy(&_stateLock);
+    [super dealloc];
+  }
+
+//
+
+  - (void) main
+  {
+    if ( _target && _selector )
+      [self setResult:[_target perform:_selector with:_argument]];
+  }
+
+//
+
+  - (id) result { return _result; }
+  - (void) setResult:(id)result
+  {
+    if ( result ) result = [result retain];
+    if ( _result ) [_result release];
+    _result = result;
+  }
+
+//
+
+  - (SBException*) exception { return _exception; }
+
+//
+
+  - (void) addDependency:(SBOperation*)anOperation
+  {
+    if ( ! anOperation || (anOperation == self) )
+      return;
+
+    pthread_mutex_lock(&_stateLock);
+    if ( _queue ) {
+      pthread_mutex_unlock(&_stateLock);
+      [SBException raise:@"Attempt to add a dependency to a queued SBOperation" format:NULL];
+    }
+    if ( ! _dependencies )
+      _dependencies = [[SBMutableArray alloc] init];
+    [_dependencies addObject:anOperation];
+
+    //
+    // If it hasn't finished yet, the dependency will let us know when it does:
+    //
+    pthread_mutex_lock(&anOperation->_stateLock);
+    if ( anOperation->_state != SBOperationIsFinished ) {
+      if ( ! anOperation->_dependents )
+        anOperation->_dependents = [[SBMutableArray alloc] init];
+      [anOperation->_dependents addObject:self];
+      _pendingCount++;
+    }
+    pthread_mutex_unlock(&anOperation->_stateLock);
+    pthread_mutex_unlock(&_stateLock);
+  }
+
+//
+
+  - (SBArray*) dependencies
+  {
+    SBArray*      dependencies;
+
+    pthread_mutex_lock(&_stateLock);
+    dependencies = ( _dependencies ? [[_dependencies copy] autorelease] : [SBArray array] );
+    pthread_mutex_unlock(&_stateLock);
+    return dependencies;
+  }
+
+//
+
+  - (void) setCompletionTarget:(id)aTarget
+    selector:(SEL)aSelector
+    runLoop:(SBRunLoop*)aRunLoop
+  {
+    if ( aTarget ) aTarget = [aTarget retain];
+    if ( _completionTarget ) [_completionTarget release];
+    _completionTarget = aTarget;
+    _completionSelector = aSelector;
+
+    if ( aRunLoop ) aRunLoop = [aRunLoop retain];
+    if ( _completionRunLoop ) [_completionRunLoop release];
+    _completionRunLoop = aRunLoop;
+  }
+
+//
+
+  - (void) cancel
+  {
+    _cancelled = YES;
+  }
+
+//
+
+  - (BOOL) isCancelled
+  {
+    if ( _cancelled )
+      return YES;
+    return ( (_queue && (_generation != [_queue generation])) ? YES : NO );
+  }
+
+//
+
+  - (BOOL) isReady
+  {
+    BOOL          isReady;
+
+    pthread_mutex_lock(&_stateLock);
+    isReady = ( _pendingCount == (_queue ? 0 : 1) );
+    pthread_mutex_unlock(&_stateLock);
+    return isReady;
+  }
+
+//
+
+  - (BOOL) isExecuting
+  {
+    return ( _state == SBOperationIsExecuting );
+  }
+
+//
+
+  - (BOOL) isFinished
+  {
+    return ( _state == SBOperationIsFinished );
+  }
+
+//
+
+  - (void) waitUntilFinished
+  {
+    SBOperationQueueWorker*   worker = [_queue currentWorker];
+
+    if ( worker ) {
+      //
+      // Rather than tie up a worker, help out with whatever else is queued:
+      //
+      while ( _state != SBOperationIsFinished ) {
+        SBOperation*          anOperation = [_queue takeOperationForWorker:worker];
+
+        if ( anOperation ) {
+          [_queue runOperation:anOperation onWorker:worker];
+        } else {
+          struct timeval      now;
+          struct timespec     until;
+
+          gettimeofday(&now, NULL);
+          until.tv_sec = now.tv_sec;
+          until.tv_nsec = 1000 * now.tv_usec + 1000000;
+          if ( until.tv_nsec >= 1000000000 ) {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000;
+          }
+          pthread_mutex_lock(&_stateLock);
+          if ( _state != SBOperationIsFinished )
+            pthread_cond_timedwait(&_stateChanged, &_stateLock, &until);
+          pthread_mutex_unlock(&_stateLock);
+        }
+      }
+    } else {
+      pthread_mutex_lock(&_stateLock);
+      while ( _state != SBOperationIsFinished )
+        pthread_cond_wait(&_stateChanged, &_stateLock);
+      pthread_mutex_unlock(&_stateLock);
+    }
+  }
+
+@end
+
+//
+#pragma mark -
+//
+
+@implementation SBOperationQueue(SBOperationQueuePrivate)
+
+  - (SBUInteger) generation
+  {
+    return SBOperationQueueAtomicLoad(&_generation);
+  }
+
+//
+
+  - (BOOL) isShutdown
+  {
+    return _shutdown;
+  }
+
+//
+
+  - (SBOperationQueueWorker*) currentWorker
+  {
+    SBThread*     currentThread = [SBThread currentThread];
+
+    if ( [currentThread isKindOf:[SBOperationQueueWorker class]] && ([(SBOperationQueueWorker*)currentThread queue] == self) )
+      return (SBOperationQueueWorker*)currentThread;
+    return nil;
+  }
+
+//
+
+  - (void) scheduleOperation:(SBOperation*)anOperation
+  {
+    SBOperationQueueDeque*    deques = (SBOperationQueueDeque*)_deques;
+    SBOperationQueueWorker*   worker = [self currentWorker];
+    SBUInteger                index;
+
+    //
+    // Work spawned on a worker stays with it; anything else is dealt out in turn:
+    //
+    if ( worker )
+      index = [worker index];
+    else
+      index = SBOperationQueueAtomicIncrement(&_nextDeque) % _workerCount;
+
+    [anOperation setState:SBOperationIsQueued];
+    if ( ! __SBOperationQueueDequePush(&deques[index], anOperation) )
+      [SBException raise:@"Unable to queue SBOperation" format:"Out of memory"];
+
+    SBOperationQueueAtomicIncrement(&_queuedCount);
+    if ( SBOperationQueueAtomicLoad(&_idleCount) ) {
+      pthread_mutex_lock(&_parkLock);
+      pthread_cond_signal(&_workQueued);
+      pthread_mutex_unlock(&_parkLock);
+    }
+  }
+
+//
+
+  - (SBOperation*) takeOperationForWorker:(SBOperationQueueWorker*)worker
+  {
+    SBOperationQueueDeque*    deques = (SBOperationQueueDeque*)_deques;
+    SBUInteger                index = [worker index];
+    SBOperation*              anOperation;
+
+    // Newest work of our own first, then the oldest work of our neighbours:
+    if ( ! (anOperation = __SBOperationQueueDequePop(&deques[index])) ) {
+      SBUInteger              i = 1;
+
+      while ( i < _workerCount ) {
+        if ( (anOperation = __SBOperationQueueDequeSteal(&deques[(index + i) % _workerCount])) )
+          break;
+        i++;
+      }
+    }
+    if ( anOperation )
+      SBOperationQueueAtomicDecrement(&_queuedCount);
+    return anOperation;
+  }
+
+//
+
+  - (void) runOperation:(SBOperation*)anOperation
+    onWorker:(SBOperationQueueWorker*)worker
+  {
+    SBOperation*          outerOperation = [worker currentOperation];
+    SBAutoreleasePool*    operationPool = [[SBAutoreleasePool alloc] init];
+
+    [worker setCurrentOperation:anOperation];
+    [anOperation execute];
+    //
+    // A completion target that raises must not keep the operation from being accounted
+    // for, otherwise waitUntilAllOperationsAreFinished and -shutdown would wait forever:
+    //
+    TRY_BEGIN
+      [anOperation finish];
+    TRY_CATCH(anException)
+      fprintf(stderr, "SBOperationQueue: exception raised while finishing operation %p\n", anOperation);
+    TRY_END
+    [worker setCurrentOperation:outerOperation];
+    [operationPool release];
+
+    [self operationDidFinish:anOperation];
+  }
+
+//
+
+  - (void) operationDidFinish:(SBOperation*)anOperation
+  {
+    [anOperation release];
+    if ( SBOperationQueueAtomicDecrement(&_outstandingCount) == 0 ) {
+      pthread_mutex_lock(&_parkLock);
+      pthread_cond_broadcast(&_allFinished);
+      pthread_mutex_unlock(&_parkLock);
+    }
+  }
+
+//
+
+  - (void) workerMain:(SBOperationQueueWorker*)worker
+  {
+    while ( 1 ) {
+      SBOperation*      anOperation = [self takeOperationForWorker:worker];
+
+      if ( anOperation ) {
+        [self runOperation:anOperation onWorker:worker];
+        continue;
+      }
+
+      if ( SBOperationQueueAtomicLoad(&_queuedCount) ) {
+        // Someone is mid-push or mid-steal; it'll show up momentarily:
+        sched_yield();
+        continue;
+      }
+
+      pthread_mutex_lock(&_parkLock);
+      SBOperationQueueAtomicIncrement(&_idleCount);
+      while ( ! _shutdown && ! SBOperationQueueAtomicLoad(&_queuedCount) )
+        pthread_cond_wait(&_workQueued, &_parkLock);
+      SBOperationQueueAtomicDecrement(&_idleCount);
+      if ( _shutdown && ! SBOperationQueueAtomicLoad(&_queuedCount) ) {
+        _runningWorkers--;
+        pthread_cond_broadcast(&_allFinished);
+        pthread_mutex_unlock(&_parkLock);
+        break;
+      }
+      pthread_mutex_unlock(&_parkLock);
+    }
+  }
+
+@end
+
+//
+#pragma mark -
+//
+
+@implementation SBOperationQueue
+
+  + (SBOperationQueue*) sharedOperationQueue
+  {
+    if ( ! __SBOperationQueueShared ) {
+      [SBGlobalLock lock];
+      if ( ! __SBOperationQueueShared )
+        __SBOperationQueueShared = [[SBOperationQueue alloc] init];
+      [SBGlobalLock unlock];
+    }
+    return __SBOperationQueueShared;
+  }
+
+//
+
+  + (SBUInteger) defaultWorkerCount
+  {
+    long          cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return ( (cpus > 0) ? (SBUInteger)cpus : 1 );
+  }
+
+//
+
+  - (id) init
+  {
+    return [self initWithWorkerCount:[SBOperationQueue defaultWorkerCount]];
+  }
+
+//
+
+  - (id) initWithWorkerCount:(SBUInteger)workerCount
+  {
+    if ( (self = [super init]) ) {
+      SBOperationQueueDeque*    deques;
+      SBUInteger                i;
+
+      if ( workerCount < 1 )
+        workerCount = 1;
+      if ( ! (deques = objc_calloc(workerCount, sizeof(SBOperationQueueDeque))) ) {
+        [self release];
+        return nil;
+      }
+      for ( i = 0; i < workerCount; i++ )
+        pthread_mutex_init(&deques[i].lock, NULL);
+      _deques = deques;
+      _workerCount = workerCount;
+      pthread_mutex_init(&_parkLock, NULL);
+      pthread_cond_init(&_workQueued, NULL);
+      pthread_cond_init(&_allFinished, NULL);
+
+      for ( i = 0; i < workerCount; i++ ) {
+        SBOperationQueueWorker*   worker = [[SBOperationQueueWorker alloc] initWithQueue:self index:i];
+
+        if ( ! worker )
+          [SBException raise:@"Unable to spawn SBOperationQueue worker" format:NULL];
+        _runningWorkers++;
+        [worker start];
+      }
+    }
+    return self;
+  }
+
+//
+
+  - (void) dealloc
+  {
+    //
+    // Workers retain the queue, so by now there are none left running.
+    //
+    if ( _deques ) {
+      SBOperationQueueDeque*    deques = (SBOperationQueueDeque*)_deques;
+      SBUInteger                i;
+
+      for ( i = 0; i < _workerCount; i++ ) {
+        pthread_mutex_destroy(&deques[i].lock);
+        if ( deques[i].operations ) objc_free(deques[i].operations);
+      }
+      objc_free(deques);
+      pthread_cond_destroy(&_allFinished);
+      pthread_cond_destroy(&_workQueued);
+      pthread_mutex_destroy(&_parkLock);
+    }
+    [super dealloc];
+  }
+
+//
+
+  - (SBUInteger) workerCount
+  {
+    return _workerCount;
+  }
+
+//
+
+  - (SBUInteger) operationCount
+  {
+    return SBOperationQueueAtomicLoad(&_outstandingCount);
+  }
+
+//
+
+  - (void) addOperation:(SBOperation*)anOperation
+  {
+    if ( _shutdown )
+      [SBException raise:@"Attempt to add an SBOperation to a queue which has been shut down" format:NULL];
+    if ( ! [anOperation setQueue:self generation:[self generation]] )
+      [SBException raise:@"Attempt to add an SBOperation to more than one queue" format:NULL];
+
+    //
+    // The queue holds a reference until the operation finishes.  Dropping the reference
+    // the operation started out with makes it ready once all its dependencies are done:
+    //
+    [anOperation retain];
+    SBOperationQueueAtomicIncrement(&_outstandingCount);
+    [anOperation dependencyDidFinish];
+  }
+
+//
+
+  - (SBOperation*) addOperationWithTarget:(id)aTarget
+    selector:(SEL)aSelector
+    object:(id)anObject
+  {
+    SBOperation*      anOperation = [SBOperation operationWithTarget:aTarget selector:aSelector object:anObject];
+
+    if ( anOperation )
+      [self addOperation:anOperation];
+    return anOperation;
+  }
+
+//
+
+  - (void) cancelAllOperations
+  {
+    SBOperationQueueAtomicIncrement(&_generation);
+  }
+
+//
+
+  - (void) waitUntilAllOperationsAreFinished
+  {
+    if ( [self currentWorker] )
+      [SBException raise:@"Attempt to wait on an SBOperationQueue from one of its own workers" format:NULL];
+    pthread_mutex_lock(&_parkLock);
+    while ( SBOperationQueueAtomicLoad(&_outstandingCount) )
+      pthread_cond_wait(&_allFinished, &_parkLock);
+    pthread_mutex_unlock(&_parkLock);
+  }
+
+//
+
+  - (void) shutdown
+  {
+    [self cancelAllOperations];
+    [self waitUntilAllOperationsAreFinished];
+
+    pthread_mutex_lock(&_parkLock);
+    _shutdown = YES;
+    pthread_cond_broadcast(&_workQueued);
+    while ( _runningWorkers )
+      pthread_cond_wait(&_allFinished, &_parkLock);
+    pthread_mutex_unlock(&_parkLock);
+  }
+
+@end
@@ -13,7 +13,7 @@
 
 #import "SBObject.h"
 
-@class SBMutableDictionary, SBArray, SBMutableArray, SBTimer, SBDate, SBTimeInterval;
+@class SBMutableDictionary, SBArray, SBMutableArray, SBTimer, SBDate, SBTimeInterval, SBLock;
 
 /*!
   @class SBRunLoop
@@ -32,6 +32,14 @@
     "scheduled" to fire so long as the runloop is given CPU time in that mode.  This
     class also augments SBObject to allow for delayed invocation of a selector on an
     object.
+    
+    File descriptors are multiplexed using epoll where available and pselect()
+    elsewhere.  Descriptors remain registered from one pass of the runloop to the
+    next, so each pass costs in proportion to the number of sources in the mode and
+    the number of descriptors which are ready, not the highest descriptor number;
+    with epoll, descriptors beyond FD_SETSIZE can be watched, too.  Timers are kept
+    ordered by fire date on the monotonic clock, so finding those which are due is
+    cheap however many are scheduled.
 */
 @interface SBRunLoop : SBObject
 {
@@ -41,9 +49,13 @@
   SBMutableDictionary*    _outputSources;
   SBMutableArray*         _messageQueue;
   SBMutableArray*         _timedMessageQueue;
-  void*                   _inputSourceMap;
-  void*                   _outputSourceMap;
+  void*                   _poller;
   BOOL                    _earlyExit;
+  
+  SBLock*                 _postLock;
+  SBMutableArray*         _postedMessages;
+  int                     _wakePipe[2];
+  volatile BOOL           _hasPostedMessages;
 }
 
 /*!
@@ -81,6 +93,15 @@
     and remove the invocation from the queue.
 */
 - (void) performSelector:(SEL)aSelector target:(id)target argument:(id)anArgument order:(SBUInteger)order modes:(SBArray*)modes;
+/*!
+  @method postSelector:target:argument:order:modes:
+  @discussion
+    Thread-safe counterpart to performSelector:target:argument:order:modes: which may be sent
+    to a runloop from any thread.  The invocation is handed over to the receiver's own thread
+    -- which is woken if it is blocked waiting for input or for a timer -- and is performed
+    there the next time the receiver is given time in one of the modes.
+*/
+- (void) postSelector:(SEL)aSelector target:(id)target argument:(id)anArgument order:(SBUInteger)order modes:(SBArray*)modes;
 /*!
   @method cancelPerformSelectorsWithTarget:
   @discussion
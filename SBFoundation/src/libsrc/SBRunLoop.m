@@ -20,10 +20,25 @@
 #import "SBStream.h"
 #import "SBStreamPrivate.h"
 #import "SBThread.h"
+#import "SBLock.h"
 #import "SBException.h"
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/select.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+//
+// I/O multiplexing goes through a small poller interface so that a platform's scalable
+// readiness mechanism can be used where there is one -- epoll on Linux -- with pselect()
+// as the portable fallback (and the only choice elsewhere, e.g. Solaris).  Define
+// SBRUNLOOP_NO_EPOLL to force the pselect() backend.
+//
+#if defined(__linux__) && ! defined(SBRUNLOOP_NO_EPOLL)
+#  define SBRUNLOOP_USE_EPOLL
+#  include <sys/epoll.h>
+#endif
 
 //
 
@@ -33,163 +48,774 @@ SBString* const SBRunLoopThreadKey = @"SBRunLoopForThread";
 
 //
 
+int64_t
+SBRunLoopMonotonicTimeForDate(
+  SBDate*         aDate
+)
+{
+  int64_t         now, ticks;
+
+  if ( ! aDate )
+    return INT64_MAX;
+
+  now = SBRunLoopMonotonicTime();
+  // UTC timestamps are in 100 ns ticks:
+  ticks = [aDate utcTimestamp] - [[SBDate dateWhichIsAlwaysNow] utcTimestamp];
+  if ( ticks >= (INT64_MAX - now) / 100 )
+    return INT64_MAX;
+  if ( ticks <= -(now / 100) )
+    return 0;
+  return now + 100 * ticks;
+}
+
+//
+#pragma mark -
+//
+
+enum {
+  SBRunLoopPollRead       = 1 << 0,
+  SBRunLoopPollWrite      = 1 << 1,
+  SBRunLoopPollError      = 1 << 2
+};
+
 typedef struct {
-  int       fd;
-  id        object;
-} SBRunLoopObjectForDescriptor;
+  int             fd;
+  unsigned int    events;
+} SBRunLoopPollEvent;
 
-int
-__SBRunLoopObjectForDescriptorBSearchDriver(
-  const void* key,
-  const void* value
-)
+//
+// Readiness reported by a single wait on the backend is capped at this many descriptors;
+// anything left over is still ready on the next pass:
+//
+#define SBRunLoopPollEventMax   256
+
+typedef enum {
+  SBRunLoopWatchOK = 0,
+  SBRunLoopWatchFailed,
+  SBRunLoopWatchAlwaysReady     // the backend can't watch it, but it never blocks
+} SBRunLoopWatchResult;
+
+//
+// A backend keeps its own record of the descriptors it has been asked to watch.  watch()
+// moves fd from oldEvents to newEvents (zero meaning not watched at all); wait() blocks
+// for at most timeout nanoseconds (forever if negative) and returns the number of events
+// filled-in, or -1 with errno set.
+//
+typedef struct {
+  const char*             name;
+  void*                   (*create)(void);
+  void                    (*destroy)(void* backend);
+  SBRunLoopWatchResult    (*watch)(void* backend, int fd, unsigned int oldEvents, unsigned int newEvents);
+  int                     (*wait)(void* backend, SBRunLoopPollEvent* events, int maxEvents, int64_t timeout);
+} SBRunLoopPollerBackend;
+
+//
+
+typedef struct {
+  fd_set          readFds, writeFds;
+  int             maxFd;
+} SBRunLoopSelectBackend;
+
+void*
+__SBRunLoopSelectCreate(void)
 {
-  int       keyFd = *((int*)key);
-  int       valueFd = ((SBRunLoopObjectForDescriptor*)value)->fd;
+  SBRunLoopSelectBackend*   backend = objc_malloc(sizeof(SBRunLoopSelectBackend));
   
-  return (keyFd - valueFd);
+  if ( backend ) {
+    FD_ZERO(&backend->readFds);
+    FD_ZERO(&backend->writeFds);
+    backend->maxFd = -1;
+  }
+  return backend;
 }
 
 //
 
-typedef struct {
-  SBUInteger                      count, capacity;
-  SBRunLoopObjectForDescriptor*   objectMap;
-} SBRunLoopObjectMap;
+void
+__SBRunLoopSelectDestroy(
+  void*           backend
+)
+{
+  objc_free(backend);
+}
 
 //
 
-SBRunLoopObjectMap*
-__SBRunLoopObjectMapAlloc(
-  SBUInteger        sizeHint
+SBRunLoopWatchResult
+__SBRunLoopSelectWatch(
+  void*           backend,
+  int             fd,
+  unsigned int    oldEvents,
+  unsigned int    newEvents
 )
 {
-  SBRunLoopObjectMap*   objMap = NULL;
-  size_t                byteSize = sizeof(SBRunLoopObjectMap);
+  SBRunLoopSelectBackend*   selectBackend = (SBRunLoopSelectBackend*)backend;
+  
+  if ( fd >= FD_SETSIZE )
+    return SBRunLoopWatchFailed;
   
-  if ( sizeHint == 0 )
-    sizeHint = 8;
+  if ( newEvents & SBRunLoopPollRead )
+    FD_SET(fd, &selectBackend->readFds);
   else
-    sizeHint = 8 * (sizeHint / 8 + ((sizeHint % 8) ? 1 : 0));
+    FD_CLR(fd, &selectBackend->readFds);
+  if ( newEvents & SBRunLoopPollWrite )
+    FD_SET(fd, &selectBackend->writeFds);
+  else
+    FD_CLR(fd, &selectBackend->writeFds);
   
-  byteSize += sizeHint * sizeof(SBRunLoopObjectForDescriptor);
+  if ( newEvents ) {
+    if ( fd > selectBackend->maxFd )
+      selectBackend->maxFd = fd;
+  } else if ( fd == selectBackend->maxFd ) {
+    while ( (selectBackend->maxFd >= 0) && ! FD_ISSET(selectBackend->maxFd, &selectBackend->readFds) && ! FD_ISSET(selectBackend->maxFd, &selectBackend->writeFds) )
+      selectBackend->maxFd--;
+  }
+  return SBRunLoopWatchOK;
+}
+
+//
+
+int
+__SBRunLoopSelectWait(
+  void*                 backend,
+  SBRunLoopPollEvent*   events,
+  int                   maxEvents,
+  int64_t               timeout
+)
+{
+  SBRunLoopSelectBackend*   selectBackend = (SBRunLoopSelectBackend*)backend;
+  fd_set                    rfds = selectBackend->readFds;
+  fd_set                    wfds = selectBackend->writeFds;
+  fd_set                    efds;
+  struct timespec           ts;
+  int                       fd, count = 0, rc;
+  
+  // Exceptional conditions are watched on everything we watch at all:
+  FD_ZERO(&efds);
+  for ( fd = 0; fd <= selectBackend->maxFd; fd++ )
+    if ( FD_ISSET(fd, &rfds) || FD_ISSET(fd, &wfds) )
+      FD_SET(fd, &efds);
+  
+  if ( timeout >= 0 ) {
+    ts.tv_sec = timeout / 1000000000LL;
+    ts.tv_nsec = timeout % 1000000000LL;
+  }
+  if ( (rc = pselect(selectBackend->maxFd + 1, &rfds, &wfds, &efds, ( (timeout >= 0) ? &ts : NULL ), NULL)) <= 0 )
+    return rc;
   
-  if ( (objMap = objc_malloc(byteSize)) ) {
-    void*     p = ((void*)objMap) + sizeof(SBRunLoopObjectMap);
+  for ( fd = 0; (fd <= selectBackend->maxFd) && (count < maxEvents); fd++ ) {
+    unsigned int            ready = 0;
     
-    objMap->count = 0; objMap->capacity = sizeHint;
-    objMap->objectMap = (SBRunLoopObjectForDescriptor*)p;
+    if ( FD_ISSET(fd, &efds) )
+      ready |= SBRunLoopPollError;
+    if ( FD_ISSET(fd, &rfds) )
+      ready |= SBRunLoopPollRead;
+    if ( FD_ISSET(fd, &wfds) )
+      ready |= SBRunLoopPollWrite;
+    if ( ready ) {
+      events[count].fd = fd;
+      events[count++].events = ready;
+    }
   }
-  return objMap;
+  return count;
 }
 
 //
 
-SBRunLoopObjectMap*
-__SBRunLoopObjectMapRealloc(
-  SBRunLoopObjectMap*   anObjMap,
-  SBUInteger            sizeHint
+SBRunLoopPollerBackend    __SBRunLoopSelectBackend = {
+                              "pselect",
+                              __SBRunLoopSelectCreate,
+                              __SBRunLoopSelectDestroy,
+                              __SBRunLoopSelectWatch,
+                              __SBRunLoopSelectWait
+                            };
+
+//
+
+#ifdef SBRUNLOOP_USE_EPOLL
+
+typedef struct {
+  int                   epollFd;
+  struct epoll_event    events[SBRunLoopPollEventMax];
+} SBRunLoopEPollBackend;
+
+void*
+__SBRunLoopEPollCreate(void)
+{
+  SBRunLoopEPollBackend*    backend = objc_malloc(sizeof(SBRunLoopEPollBackend));
+  
+  if ( backend ) {
+    if ( (backend->epollFd = epoll_create(SBRunLoopPollEventMax)) < 0 ) {
+      objc_free(backend);
+      return NULL;
+    }
+    fcntl(backend->epollFd, F_SETFD, FD_CLOEXEC);
+  }
+  return backend;
+}
+
+//
+
+void
+__SBRunLoopEPollDestroy(
+  void*           backend
 )
 {
-  SBRunLoopObjectMap*   newObjMap = NULL;
-  size_t                byteSize = sizeof(SBRunLoopObjectMap);
+  close(((SBRunLoopEPollBackend*)backend)->epollFd);
+  objc_free(backend);
+}
+
+//
+
+SBRunLoopWatchResult
+__SBRunLoopEPollWatch(
+  void*           backend,
+  int             fd,
+  unsigned int    oldEvents,
+  unsigned int    newEvents
+)
+{
+  int                 epollFd = ((SBRunLoopEPollBackend*)backend)->epollFd;
+  struct epoll_event  event;
+  int                 op;
   
-  if ( sizeHint <= anObjMap->capacity )
-    return anObjMap;
+  memset(&event, 0, sizeof(event));
+  if ( ! newEvents ) {
+    // Failure here just means the descriptor was closed, which already removed it:
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, &event);
+    return SBRunLoopWatchOK;
+  }
+  event.events = ( (newEvents & SBRunLoopPollRead) ? EPOLLIN : 0 ) | ( (newEvents & SBRunLoopPollWrite) ? EPOLLOUT : 0 );
+  event.data.fd = fd;
+  op = ( oldEvents ? EPOLL_CTL_MOD : EPOLL_CTL_ADD );
+  if ( epoll_ctl(epollFd, op, fd, &event) == 0 )
+    return SBRunLoopWatchOK;
   
-  if ( sizeHint == 0 )
-    sizeHint = 8;
-  else
-    sizeHint = 8 * (sizeHint / 8 + ((sizeHint % 8) ? 1 : 0));
+  //
+  // Closing a descriptor drops it from the interest set behind our back, and a new one
+  // may since have been opened under the same number:
+  //
+  if ( (op == EPOLL_CTL_MOD) && (errno == ENOENT) ) {
+    if ( epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == 0 )
+      return SBRunLoopWatchOK;
+  } else if ( (op == EPOLL_CTL_ADD) && (errno == EEXIST) ) {
+    if ( epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event) == 0 )
+      return SBRunLoopWatchOK;
+  }
+  
+  // Regular files can't be polled; select() always reports them ready, so we will, too:
+  if ( errno == EPERM )
+    return SBRunLoopWatchAlwaysReady;
+  return SBRunLoopWatchFailed;
+}
+
+//
+
+int
+__SBRunLoopEPollWait(
+  void*                 backend,
+  SBRunLoopPollEvent*   events,
+  int                   maxEvents,
+  int64_t               timeout
+)
+{
+  SBRunLoopEPollBackend*    epollBackend = (SBRunLoopEPollBackend*)backend;
+  int                       msTimeout = -1, i, rc;
   
-  byteSize += sizeHint * sizeof(SBRunLoopObjectForDescriptor);
+  if ( timeout >= 0 ) {
+    // Round up, otherwise we'd spin until a timer is actually due:
+    timeout = (timeout + 999999) / 1000000;
+    msTimeout = ( (timeout > INT_MAX) ? INT_MAX : (int)timeout );
+  }
+  if ( maxEvents > SBRunLoopPollEventMax )
+    maxEvents = SBRunLoopPollEventMax;
+  if ( (rc = epoll_wait(epollBackend->epollFd, epollBackend->events, maxEvents, msTimeout)) <= 0 )
+    return rc;
+  
+  for ( i = 0; i < rc; i++ ) {
+    uint32_t                ready = epollBackend->events[i].events;
+    
+    events[i].fd = epollBackend->events[i].data.fd;
+    events[i].events = 0;
+    if ( ready & EPOLLERR )
+      events[i].events |= SBRunLoopPollError;
+    // A hang-up reads as end-of-file and fails writes, just as select() reports it:
+    if ( ready & (EPOLLIN | EPOLLPRI | EPOLLHUP) )
+      events[i].events |= SBRunLoopPollRead;
+    if ( ready & (EPOLLOUT | EPOLLHUP) )
+      events[i].events |= SBRunLoopPollWrite;
+  }
+  return rc;
+}
+
+//
+
+SBRunLoopPollerBackend    __SBRunLoopEPollBackend = {
+                              "epoll",
+                              __SBRunLoopEPollCreate,
+                              __SBRunLoopEPollDestroy,
+                              __SBRunLoopEPollWatch,
+                              __SBRunLoopEPollWait
+                            };
+
+#endif /* SBRUNLOOP_USE_EPOLL */
+
+//
+// Backends in order of preference; the first one that can be created is used:
+//
+SBRunLoopPollerBackend*   __SBRunLoopPollerBackends[] = {
+#ifdef SBRUNLOOP_USE_EPOLL
+                              &__SBRunLoopEPollBackend,
+#endif
+                              &__SBRunLoopSelectBackend,
+                              NULL
+                            };
+
+//
+#pragma mark -
+//
+
+//
+// The run loop's side of fd registration:  a table indexed by descriptor which records
+// the input and output source using each one and what the backend is watching it for.
+// Each pass of the run loop re-reads the descriptors of the current mode's sources and
+// only hands the differences to the backend.
+//
+typedef struct {
+  SBUInteger      pass;             // last pass on which a source was using the fd
+  id              input, output;    // sources as registered with the backend
+  id              nextInput, nextOutput;
+  unsigned int    events;           // what we're currently watching for
+  unsigned int    wanted;           // what this pass' sources want
+  BOOL            alwaysReady;      // events are synthesized rather than watched
+} SBRunLoopRegistration;
+
+typedef struct {
+  SBRunLoopPollerBackend*   backend;
+  void*                     backendState;
+  SBUInteger                pass;
+  SBRunLoopRegistration*    registrations;
+  int                       registrationCapacity;
+  int*                      activeFds;        // fds with events != 0
+  SBUInteger                activeCount, activeCapacity;
+  int*                      touchedFds;       // fds used by this pass' sources
+  SBUInteger                touchedCount, touchedCapacity;
+  SBUInteger                alwaysReadyCount;
+  SBRunLoopPollEvent        events[SBRunLoopPollEventMax];
+} SBRunLoopPoller;
+
+//
+
+SBRunLoopPoller*
+__SBRunLoopPollerAlloc(void)
+{
+  SBRunLoopPoller*          poller = objc_calloc(1, sizeof(SBRunLoopPoller));
+  SBRunLoopPollerBackend**  backend = __SBRunLoopPollerBackends;
   
-  if ( (newObjMap = objc_realloc(anObjMap, byteSize)) ) {
-    void*     p = ((void*)newObjMap) + sizeof(SBRunLoopObjectMap);
+  if ( poller ) {
+    while ( *backend ) {
+      if ( (poller->backendState = (*backend)->create()) ) {
+        poller->backend = *backend;
+        break;
+      }
+      backend++;
+    }
+    if ( ! poller->backend ) {
+      objc_free(poller);
+      poller = NULL;
+    }
+  }
+  return poller;
+}
+
+//
+
+void
+__SBRunLoopPollerDealloc(
+  SBRunLoopPoller*    poller
+)
+{
+  poller->backend->destroy(poller->backendState);
+  if ( poller->registrations ) objc_free(poller->registrations);
+  if ( poller->activeFds ) objc_free(poller->activeFds);
+  if ( poller->touchedFds ) objc_free(poller->touchedFds);
+  objc_free(poller);
+}
+
+//
+
+BOOL
+__SBRunLoopPollerAppendFd(
+  int**           fds,
+  SBUInteger*     count,
+  SBUInteger*     capacity,
+  int             fd
+)
+{
+  if ( *count == *capacity ) {
+    SBUInteger    newCapacity = ( *capacity ? 2 * *capacity : 16 );
+    int*          newFds = objc_realloc(*fds, newCapacity * sizeof(int));
     
-    newObjMap->capacity = sizeHint;
-    newObjMap->objectMap = (SBRunLoopObjectForDescriptor*)p;
+    if ( ! newFds )
+      return NO;
+    *fds = newFds;
+    *capacity = newCapacity;
+  }
+  (*fds)[(*count)++] = fd;
+  return YES;
+}
+
+//
+
+SBRunLoopRegistration*
+__SBRunLoopPollerTouch(
+  SBRunLoopPoller*    poller,
+  int                 fd
+)
+{
+  SBRunLoopRegistration*  registration;
+  
+  if ( fd >= poller->registrationCapacity ) {
+    int                     newCapacity = 64 * (fd / 64 + 1);
+    SBRunLoopRegistration*  newRegistrations = objc_realloc(poller->registrations, newCapacity * sizeof(SBRunLoopRegistration));
     
-    return newObjMap;
+    if ( ! newRegistrations )
+      return NULL;
+    memset(&newRegistrations[poller->registrationCapacity], 0, (newCapacity - poller->registrationCapacity) * sizeof(SBRunLoopRegistration));
+    poller->registrations = newRegistrations;
+    poller->registrationCapacity = newCapacity;
   }
-  return anObjMap;
+  registration = &poller->registrations[fd];
+  if ( registration->pass != poller->pass ) {
+    if ( ! __SBRunLoopPollerAppendFd(&poller->touchedFds, &poller->touchedCount, &poller->touchedCapacity, fd) )
+      return NULL;
+    registration->pass = poller->pass;
+    registration->wanted = 0;
+    registration->nextInput = registration->nextOutput = nil;
+  }
+  return registration;
 }
 
 //
 
-id
-__SBRunLoopObjectMapObjectForFD(
-  SBRunLoopObjectMap*   anObjMap,
-  int                   fd
+void
+__SBRunLoopPollerUnwatch(
+  SBRunLoopPoller*    poller,
+  int                 fd
 )
 {
-  SBRunLoopObjectForDescriptor* match = bsearch(
-                                            &fd,
-                                            anObjMap->objectMap,
-                                            anObjMap->count,
-                                            sizeof(SBRunLoopObjectForDescriptor),
-                                            __SBRunLoopObjectForDescriptorBSearchDriver
-                                          );
-  if ( match )
-    return match->object;
-  return nil;
+  SBRunLoopRegistration*  registration = &poller->registrations[fd];
+  
+  if ( registration->alwaysReady )
+    poller->alwaysReadyCount--;
+  else if ( registration->events )
+    poller->backend->watch(poller->backendState, fd, registration->events, 0);
+  registration->events = 0;
+  registration->alwaysReady = NO;
+  registration->input = registration->output = nil;
 }
 
 //
 
 void
-__SBRunLoopObjectMapAdd(
-  SBRunLoopObjectMap*   anObjMap,
-  int                   fd,
-  id                    object
+__SBRunLoopPollerWatch(
+  SBRunLoopPoller*    poller,
+  int                 fd
 )
 {
-  if ( anObjMap->count < anObjMap->capacity ) {
-    SBUInteger          i = 0;
+  SBRunLoopRegistration*  registration = &poller->registrations[fd];
+  BOOL                    wasActive = ( registration->events ? YES : NO );
+  
+  //
+  // A different source on the same descriptor means the old one was closed and the
+  // number reused; start over with the backend rather than trusting what it has:
+  //
+  if ( wasActive && ((registration->input != registration->nextInput) || (registration->output != registration->nextOutput)) )
+    __SBRunLoopPollerUnwatch(poller, fd);
+  
+  if ( registration->events != registration->wanted ) {
+    switch ( poller->backend->watch(poller->backendState, fd, ( registration->alwaysReady ? 0 : registration->events ), registration->wanted) ) {
     
-    while ( i < anObjMap->count ) {
-      if ( anObjMap->objectMap[i].fd > fd ) {
-        // Insert here:
-        memmove(&anObjMap->objectMap[i + 1], &anObjMap->objectMap[i], anObjMap->count - i);
-        anObjMap->objectMap[i].fd = fd;
-        anObjMap->objectMap[i].object = object;
-        anObjMap->count++;
-        return;
-      } else if ( anObjMap->objectMap[i].fd == fd ) {
-        // Replace here:
-        anObjMap->objectMap[i].object = object;
-        anObjMap->count++;
-        return;
+      case SBRunLoopWatchOK:
+        if ( registration->alwaysReady ) {
+          registration->alwaysReady = NO;
+          poller->alwaysReadyCount--;
+        }
+        registration->events = registration->wanted;
+        break;
+      
+      case SBRunLoopWatchAlwaysReady:
+        if ( ! registration->alwaysReady ) {
+          registration->alwaysReady = YES;
+          poller->alwaysReadyCount++;
+        }
+        registration->events = registration->wanted;
+        break;
+      
+      case SBRunLoopWatchFailed:
+        // Leave it out of this pass; we'll try again on the next:
+        if ( registration->alwaysReady ) {
+          registration->alwaysReady = NO;
+          poller->alwaysReadyCount--;
+        }
+        registration->events = 0;
+        break;
+        
+    }
+  }
+  registration->input = registration->nextInput;
+  registration->output = registration->nextOutput;
+  
+  if ( registration->events && ! wasActive ) {
+    __SBRunLoopPollerAppendFd(&poller->activeFds, &poller->activeCount, &poller->activeCapacity, fd);
+  } else if ( ! registration->events && wasActive ) {
+    SBUInteger            i = 0;
+    
+    while ( i < poller->activeCount ) {
+      if ( poller->activeFds[i] == fd ) {
+        poller->activeFds[i] = poller->activeFds[--poller->activeCount];
+        break;
       }
       i++;
     }
-    anObjMap->objectMap[i].fd = fd;
-    anObjMap->objectMap[i].object = object;
-    anObjMap->count++;
   }
 }
 
+//
+// Another thread which posts a message to a run loop writes a byte to its wake pipe; the
+// run loop always watches the read end so that it can't sleep through the message:
+//
+void
+__SBRunLoopDrainWakePipe(
+  int                 fd
+)
+{
+  char                buffer[64];
+  
+  while ( read(fd, buffer, sizeof(buffer)) == sizeof(buffer) );
+}
+
+//
+#pragma mark -
+//
+
+//
+// Each mode's timers are kept in a binary min-heap ordered by their monotonic fire time
+// (ties go to the timer added first), so finding the next timer to fire -- or finding
+// that none are due -- doesn't mean visiting every one of them.
+//
+typedef struct {
+  int64_t         fireTime;
+  SBUInteger      sequence;
+  SBTimer*        timer;
+} SBRunLoopTimerHeapEntry;
+
+static inline BOOL
+__SBRunLoopTimerHeapEntryPrecedes(
+  SBRunLoopTimerHeapEntry*  e1,
+  SBRunLoopTimerHeapEntry*  e2
+)
+{
+  if ( e1->fireTime == e2->fireTime )
+    return ( e1->sequence < e2->sequence );
+  return ( e1->fireTime < e2->fireTime );
+}
+
+//
+
+void
+__SBRunLoopTimerHeapSiftUp(
+  SBRunLoopTimerHeapEntry*  entries,
+  SBUInteger                i
+)
+{
+  SBRunLoopTimerHeapEntry   entry = entries[i];
+  
+  while ( i > 0 ) {
+    SBUInteger              parent = (i - 1) / 2;
+    
+    if ( ! __SBRunLoopTimerHeapEntryPrecedes(&entry, &entries[parent]) )
+      break;
+    entries[i] = entries[parent];
+    i = parent;
+  }
+  entries[i] = entry;
+}
+
 //
 
 void
-__SBRunLoopObjectMapDebug(
-  SBRunLoopObjectMap*   anObjMap
+__SBRunLoopTimerHeapSiftDown(
+  SBRunLoopTimerHeapEntry*  entries,
+  SBUInteger                count,
+  SBUInteger                i
 )
 {
-  SBUInteger            i = 0;
+  SBRunLoopTimerHeapEntry   entry = entries[i];
   
-  printf("SBRunLoopObjectMap@%p ( %u / %u ) {\n", anObjMap, anObjMap->count, anObjMap->capacity);
-  while ( i < anObjMap->count ) {
-    printf("  %05d => %p\n", anObjMap->objectMap[i].fd, anObjMap->objectMap[i].object);
-    i++;
+  while ( 1 ) {
+    SBUInteger              child = 2 * i + 1;
+    
+    if ( child >= count )
+      break;
+    if ( (child + 1 < count) && __SBRunLoopTimerHeapEntryPrecedes(&entries[child + 1], &entries[child]) )
+      child++;
+    if ( ! __SBRunLoopTimerHeapEntryPrecedes(&entries[child], &entry) )
+      break;
+    entries[i] = entries[child];
+    i = child;
   }
-  printf("}\n");
+  entries[i] = entry;
 }
 
 //
 #pragma mark -
 //
 
+@interface SBRunLoopTimerHeap : SBObject
+{
+  SBUInteger                  _count, _capacity;
+  SBUInteger                  _nextSequence;
+  SBRunLoopTimerHeapEntry*    _entries;
+}
+
+- (SBUInteger) count;
+- (SBTimer*) firstTimer;
+- (int64_t) firstFireTime;
+- (BOOL) containsTimer:(SBTimer*)aTimer;
+- (void) addTimer:(SBTimer*)aTimer;
+- (SBTimer*) removeFirstTimer;
+- (void) removeTimer:(SBTimer*)aTimer;
+- (void) updateTimer:(SBTimer*)aTimer;
+- (void) detachTimersFromRunLoop:(SBRunLoop*)aRunLoop;
+
+@end
+
+@implementation SBRunLoopTimerHeap
+
+  - (void) dealloc
+  {
+    if ( _entries ) {
+      SBUInteger      i = 0;
+      
+      while ( i < _count )
+        [_entries[i++].timer release];
+      objc_free(_entries);
+    }
+    [super dealloc];
+  }
+
+//
+
+  - (SBUInteger) count { return _count; }
+  - (SBTimer*) firstTimer { return ( _count ? _entries[0].timer : nil ); }
+  - (int64_t) firstFireTime { return ( _count ? _entries[0].fireTime : INT64_MAX ); }
+
+//
+
+  - (BOOL) containsTimer:(SBTimer*)aTimer
+  {
+    SBUInteger        i = 0;
+    
+    while ( i < _count )
+      if ( _entries[i++].timer == aTimer )
+        return YES;
+    return NO;
+  }
+
+//
+
+  - (void) addTimer:(SBTimer*)aTimer
+  {
+    if ( _count == _capacity ) {
+      SBUInteger                newCapacity = ( _capacity ? 2 * _capacity : 8 );
+      SBRunLoopTimerHeapEntry*  newEntries = objc_realloc(_entries, newCapacity * sizeof(SBRunLoopTimerHeapEntry));
+      
+      if ( ! newEntries )
+        return;
+      _entries = newEntries;
+      _capacity = newCapacity;
+    }
+    _entries[_count].fireTime = [aTimer fireTime];
+    _entries[_count].sequence = _nextSequence++;
+    _entries[_count].timer = [aTimer retain];
+    __SBRunLoopTimerHeapSiftUp(_entries, _count++);
+  }
+
+//
+
+  - (SBTimer*) removeFirstTimer
+  {
+    SBTimer*          timer = nil;
+    
+    if ( _count ) {
+      // The caller inherits our reference:
+      timer = _entries[0].timer;
+      if ( --_count ) {
+        _entries[0] = _entries[_count];
+        __SBRunLoopTimerHeapSiftDown(_entries, _count, 0);
+      }
+    }
+    return timer;
+  }
+
+//
+
+  - (void) removeTimer:(SBTimer*)aTimer
+  {
+    SBUInteger        i = 0;
+    
+    while ( i < _count ) {
+      if ( _entries[i].timer == aTimer ) {
+        if ( i < --_count ) {
+          _entries[i] = _entries[_count];
+          __SBRunLoopTimerHeapSiftDown(_entries, _count, i);
+          __SBRunLoopTimerHeapSiftUp(_entries, i);
+        }
+        [aTimer release];
+        break;
+      }
+      i++;
+    }
+  }
+
+//
+
+  - (void) updateTimer:(SBTimer*)aTimer
+  {
+    SBUInteger        i = 0;
+    
+    while ( i < _count ) {
+      if ( _entries[i].timer == aTimer ) {
+        _entries[i].fireTime = [aTimer fireTime];
+        __SBRunLoopTimerHeapSiftDown(_entries, _count, i);
+        __SBRunLoopTimerHeapSiftUp(_entries, i);
+        break;
+      }
+      i++;
+    }
+  }
+
+//
+
+  - (void) detachTimersFromRunLoop:(SBRunLoop*)aRunLoop
+  {
+    SBUInteger        i = 0;
+    
+    while ( i < _count ) {
+      SBTimer*        timer = _entries[i++].timer;
+      
+      if ( [timer runLoop] == aRunLoop )
+        [timer setRunLoop:nil];
+    }
+  }
+
+@end
+
+//
+#pragma mark -
+//
+
 @interface SBRunLoopQueuedMessage : SBObject
 {
   id              _target;
@@ -360,6 +986,9 @@ __SBRunLoopFromThreadProperties(
       _outputSources      = [[SBMutableDictionary alloc] init];
       _messageQueue       = [[SBMutableArray alloc] init];
       _timedMessageQueue  = [[SBMutableArray alloc] init];
+      _postLock           = [[SBLock alloc] init];
+      _postedMessages     = [[SBMutableArray alloc] init];
+      _wakePipe[0] = _wakePipe[1] = -1;
     }
     return self;
   }
@@ -368,14 +997,25 @@ __SBRunLoopFromThreadProperties(
 
   - (void) dealloc
   {
-    if ( _timers ) [_timers release];
+    if ( _timers ) {
+      // Timers which outlive us mustn't come looking for us:
+      SBEnumerator*         eHeaps = [_timers objectEnumerator];
+      SBRunLoopTimerHeap*   heap;
+      
+      while ( (heap = [eHeaps nextObject]) )
+        [heap detachTimersFromRunLoop:self];
+      [_timers release];
+    }
     if ( _inputSources ) [_inputSources release];
     if ( _outputSources ) [_outputSources release];
     if ( _messageQueue ) [_messageQueue release];
     if ( _timedMessageQueue ) [_timedMessageQueue release];
+    if ( _postedMessages ) [_postedMessages release];
+    if ( _postLock ) [_postLock release];
     
-    if ( _inputSourceMap ) objc_free(_inputSourceMap);
-    if ( _outputSourceMap ) objc_free(_outputSourceMap);
+    if ( _poller ) __SBRunLoopPollerDealloc((SBRunLoopPoller*)_poller);
+    if ( _wakePipe[0] >= 0 ) close(_wakePipe[0]);
+    if ( _wakePipe[1] >= 0 ) close(_wakePipe[1]);
     
     [super dealloc];
   }
@@ -385,15 +1025,19 @@ __SBRunLoopFromThreadProperties(
   - (void) addTimer:(SBTimer*)aTimer
     forMode:(SBString*)aMode
   {
-    SBMutableArray*     timersForMode = [_timers objectForKey:aMode];
+    SBRunLoopTimerHeap*   timersForMode = [_timers objectForKey:aMode];
     
+    if ( ! [aTimer isValid] )
+      return;
     if ( ! timersForMode ) {
-      timersForMode = [[SBMutableArray alloc] init];
+      timersForMode = [[SBRunLoopTimerHeap alloc] init];
       [_timers setObject:timersForMode forKey:aMode];
       [timersForMode release];
     }
-    if ( ! [timersForMode containsObject:aTimer] )
-      [timersForMode addObject:aTimer];
+    if ( ! [timersForMode containsTimer:aTimer] ) {
+      [timersForMode addTimer:aTimer];
+      [aTimer setRunLoop:self];
+    }
   }
 
 //
@@ -412,6 +1056,34 @@ __SBRunLoopFromThreadProperties(
     }
   }
   
+//
+
+  - (void) postSelector:(SEL)aSelector
+    target:(id)target
+    argument:(id)anArgument
+    order:(SBUInteger)order
+    modes:(SBArray*)modes
+  {
+    SBRunLoopQueuedMessage*     message = [[SBRunLoopQueuedMessage alloc] initWithSelector:aSelector
+                                                target:target argument:anArgument order:order modes:modes];
+    if ( message ) {
+      [_postLock lock];
+      [_postedMessages addObject:message];
+      _hasPostedMessages = YES;
+      if ( _wakePipe[1] >= 0 ) {
+        ssize_t         rc;
+
+        while ( ((rc = write(_wakePipe[1], "", 1)) < 0) && (errno == EINTR) );
+        // A full pipe is wake-up enough; anything else means the run loop may sleep
+        // through this message until its next timeout:
+        if ( (rc < 0) && (errno != EAGAIN) && (errno != EWOULDBLOCK) )
+          fprintf(stderr, "SBRunLoop: unable to wake run loop %p (errno = %d)\n", self, errno);
+      }
+      [_postLock unlock];
+      [message release];
+    }
+  }
+  
 //
 
   - (void) cancelPerformSelectorsWithTarget:(id)target
@@ -507,21 +1179,9 @@ __SBRunLoopFromThreadProperties(
       
       if ( ! [self runMode:SBRunLoopDefaultMode beforeDate:waitUntil] ) {
         // We didn't process any input, so go ahead and just sleep until
-        // the limiting date arrives:
-        while ( ! _earlyExit && ([now laterDate:waitUntil] == waitUntil) ) {
-          SBTimeInterval*   sleepInterval = [waitUntil timeIntervalSinceDate:now];
-          double            secondsToWait = [sleepInterval totalSecondsInTimeInterval];
-          struct timespec   sleepTime;
-          
-          if ( secondsToWait > LONG_MAX ) {
-            sleepTime.tv_sec = LONG_MAX;
-            sleepTime.tv_nsec = 0;
-          } else {
-            sleepTime.tv_sec = floor(secondsToWait);
-            sleepTime.tv_nsec = floor((secondsToWait - sleepTime.tv_sec) * 1.0e9);
-          }
-          nanosleep(&sleepTime, NULL);
-        }
+        // the limiting date arrives (or another thread posts us a message):
+        while ( ! _earlyExit && ! _hasPostedMessages && ([now laterDate:waitUntil] == waitUntil) )
+          [self waitForPostedMessagesBeforeDate:waitUntil];
       }
       [loopPool release];
     }
@@ -564,9 +1224,8 @@ __SBRunLoopFromThreadProperties(
       return rc;
     
     SBAutoreleasePool*    localPool = [[SBAutoreleasePool alloc] init];
-    SBDate*               now = [SBDate dateWhichIsAlwaysNow];
     SBString*             oldMode = _currentMode;
-    SBDate*               runUntil;
+    SBTimer*              nextTimer = nil;
     SBUInteger            i, iMax;
     
     // Change mode:
@@ -576,6 +1235,9 @@ __SBRunLoopFromThreadProperties(
     if ( _earlyExit )
       goto earlyExit;
     
+    // Pick up messages other threads have posted to us:
+    [self receivePostedMessages];
+    
     // Let's see if we have any queued messages that need to be sent:
     if ( (iMax = [_messageQueue count]) ) {
       SBMutableArray*   messages = [_messageQueue mutableCopy];
@@ -611,39 +1273,42 @@ __SBRunLoopFromThreadProperties(
     if ( _earlyExit )
       goto earlyExit;
     
-    // If someone wants a limit date, then by default let's give 'em the most distant date
-    // possible, in case there are no timers:
-    runUntil = [SBDate distantFuture];
+    // Fire any timers which have come due; a timer which was moved later without our
+    // hearing about it just goes back into the heap:
+    SBRunLoopTimerHeap*   timers = [_timers objectForKey:aMode];
+    int64_t               now = SBRunLoopMonotonicTime();
+    int64_t               deadline = INT64_MAX;
     
-    // Check for any timers which have expired:
-    if ( (iMax = [self countOfTimersForMode:aMode]) ) {
-      SBMutableArray*     timers = [_timers objectForKey:aMode];
-      
-      i = 0;
-      while ( i < iMax ) {
-        SBTimer*          theTimer = [[timers objectAtIndex:i] retain];
+    if ( timers ) {
+      iMax = [timers count];
+      while ( iMax-- && ([timers firstFireTime] <= now) ) {
+        SBTimer*          theTimer = [timers removeFirstTimer];
         
         if ( [theTimer isValid] ) {
-          if ( [[theTimer fireDate] laterDate:now] == now ) {
+          if ( [theTimer fireTime] <= now ) {
+            // While it's out of the heap, the timer needn't tell us about changes:
+            [theTimer setRunLoop:nil];
             [theTimer fire];
           }
           if ( [theTimer isValid] ) {
-            SBDate*   then = [theTimer fireDate];
-            
-            if ( [then laterDate:runUntil] == runUntil ) {
-              then = [then retain];
-              [runUntil release];
-              runUntil = then;
-            }
+            [timers addTimer:theTimer];
+            [theTimer setRunLoop:self];
           }
         }
-        if ( ! [theTimer isValid] ) {
-          [timers removeObjectAtIndex:i];
-          iMax--;
-        } else {
-          i++;
-        }
         [theTimer release];
+        
+        if ( _earlyExit )
+          break;
+      }
+      
+      // Timers that went invalid while sitting in the heap get dropped once they reach
+      // the top of it:
+      while ( [timers count] && ! [[timers firstTimer] isValid] )
+        [[timers removeFirstTimer] release];
+      
+      if ( (nextTimer = [timers firstTimer]) ) {
+        nextTimer = [nextTimer retain];
+        deadline = [timers firstFireTime];
       }
     }
     
@@ -651,154 +1316,108 @@ __SBRunLoopFromThreadProperties(
     if ( _earlyExit )
       goto earlyExit;
     
-    // Get setup to poll for i/o on all files we're supposed to watch:
-    fd_set      rfds, wfds, refds, wefds;
-    int         maxRFD = -1, maxWFD = -1;
-    
-    FD_ZERO(&rfds);
-    FD_ZERO(&wfds);
-    FD_ZERO(&refds);
-    FD_ZERO(&wefds);
-    [self setupIOSelectForMode:aMode read:&rfds maxReadFd:&maxRFD write:&wfds maxWriteFd:&maxWFD readError:&refds writeError:&wefds];
-    
-    int               selectrc;
-    struct timespec   timeout = { 0 , 0 };
-    struct timespec*  timeoutPtr = &timeout;
-    
-    if ( ! _earlyExit && (maxWFD >= 0) ) {
-      // Setup the timeout:
-      if ( aDate ) {
-        SBDate*           sooner = [aDate earlierDate:runUntil];
-        SBTimeInterval*   ti = [sooner timeIntervalSinceDate:now];
-        double            secondsToWait = [ti totalSecondsInTimeInterval];
+    // Bring the poller up to date with this mode's sources:
+    if ( [self registerSourcesForMode:aMode] ) {
+      SBRunLoopPoller*    poller = (SBRunLoopPoller*)_poller;
+      int64_t             timeout = 0;
+      int                 eventCount;
+      
+      //
+      // Block until the earlier of aDate and the next timer; no date at all means just
+      // poll.  Descriptors the backend can't watch are always ready, so no blocking
+      // then, either:
+      //
+      if ( aDate && ! poller->alwaysReadyCount ) {
+        int64_t           dateDeadline = SBRunLoopMonotonicTimeForDate(aDate);
         
-        if ( secondsToWait > 0.0 ) {
-          if ( secondsToWait < LONG_MAX ) {
-            timeout.tv_sec = floor(secondsToWait); secondsToWait -= timeout.tv_sec;
-            timeout.tv_nsec = floor(secondsToWait * 1e9);
-          } else {
-            timeoutPtr = NULL;
-          }
+        if ( dateDeadline < deadline )
+          deadline = dateDeadline;
+        if ( deadline == INT64_MAX ) {
+          timeout = -1;
+        } else {
+          now = SBRunLoopMonotonicTime();
+          timeout = ( (deadline > now) ? (deadline - now) : 0 );
         }
       }
       
-      // Do any writing first, on an immediate-poll:
       if ( _earlyExit )
         goto earlyExit;
-      selectrc = pselect(maxWFD + 1, NULL, &wfds, &wefds, timeoutPtr, NULL);
-      if ( selectrc < 0 ) {
+      eventCount = poller->backend->wait(poller->backendState, poller->events, SBRunLoopPollEventMax, timeout);
+      if ( eventCount < 0 ) {
         switch ( errno ) {
           
           case EINTR: {
             // A signal was caught in the midst of the polling; return to
             // the caller now so it can react to something the signal may
             // have signified:
+            eventCount = 0;
             break;
           }
           
           default: {
-            [SBException raise:@"Unrecoverable pselect() error in SBRunLoop" format:"Errno = %d", errno];
+            [SBException raise:@"Unrecoverable poller error in SBRunLoop" format:"Backend = %s, Errno = %d", poller->backend->name, errno];
             break;
           }
             
         }
-      } else if ( selectrc ) {
-        // Walk the error descriptors first:
-        i = 0;
-        while ( i <= maxWFD ) {
-          if ( FD_ISSET(i, &wefds) ) {
-            id<SBFileDescriptorStream>  obj;
-            int                         local_errno;
-            socklen_t                   local_errno_size = sizeof(local_errno);
-            
-            getsockopt(i, SOL_SOCKET, SO_ERROR, &local_errno, &local_errno_size);
-            if ( _outputSourceMap && (obj = __SBRunLoopObjectMapObjectForFD(_outputSourceMap, i)) )
-              [obj fileDescriptorHasError:local_errno];
-          }
-          i++;
-        }
-        
-        // Walk the output descriptors:
-        i = 0;
-        while ( i <= maxWFD ) {
-          if ( FD_ISSET(i, &wfds) ) {
-            id<SBFileDescriptorStream>  obj;
-            
-            if ( _outputSourceMap && (obj = __SBRunLoopObjectMapObjectForFD(_outputSourceMap, i)) )
-              [obj fileDescriptorReady];
-          }
-          i++;
-        }
-      }
-      rc = YES;
-    }
-    if ( ! _earlyExit && (maxRFD >= 0) ) {
-      // Setup the timeout:
-      timeout.tv_sec = timeout.tv_nsec = 0;
-      timeoutPtr = &timeout;
-      if ( aDate ) {
-        SBDate*           sooner = [aDate earlierDate:runUntil];
-        SBTimeInterval*   ti = [sooner timeIntervalSinceDate:now];
-        double            secondsToWait = [ti totalSecondsInTimeInterval];
-        
-        if ( secondsToWait > 0.0 ) {
-          if ( secondsToWait < LONG_MAX ) {
-            timeout.tv_sec = floor(secondsToWait); secondsToWait -= timeout.tv_sec;
-            timeout.tv_nsec = floor(secondsToWait * 1e9);
-          } else {
-            timeoutPtr = NULL;
-          }
-        }
       }
       
-      if ( _earlyExit )
-        goto earlyExit;
-      selectrc = pselect(maxRFD + 1, &rfds, NULL, &refds, timeoutPtr, NULL);
-      // Was there an error?
-      if ( selectrc < 0 ) {
-        switch ( errno ) {
-          
-          case EINTR: {
-            // A signal was caught in the midst of the polling; return to
-            // the caller now so it can react to something the signal may
-            // have signified:
-            break;
-          }
+      // Tack-on the descriptors which are always ready:
+      if ( poller->alwaysReadyCount ) {
+        i = 0;
+        while ( (i < poller->activeCount) && (eventCount < SBRunLoopPollEventMax) ) {
+          int                       fd = poller->activeFds[i++];
+          SBRunLoopRegistration*    registration = &poller->registrations[fd];
           
-          default: {
-            [SBException raise:@"Unrecoverable pselect() error in SBRunLoop" format:"Errno = %d", errno];
-            break;
+          if ( registration->alwaysReady ) {
+            poller->events[eventCount].fd = fd;
+            poller->events[eventCount++].events = registration->events;
           }
-            
         }
-      } else if ( selectrc ) {
-        // Walk the error descriptors first:
+      }
+      
+      if ( eventCount > 0 ) {
+        //
+        // A source's callback may well remove other sources from the run loop, so keep
+        // everything that is about to be called alive until we're done:
+        //
         i = 0;
-        while ( i <= maxRFD ) {
-          if ( FD_ISSET(i, &refds) ) {
-            id<SBFileDescriptorStream>  obj;
-            int                         local_errno;
-            socklen_t                   local_errno_size = sizeof(local_errno);
-            
-            getsockopt(i, SOL_SOCKET, SO_ERROR, &local_errno, &local_errno_size);
-            if ( _inputSourceMap && (obj = __SBRunLoopObjectMapObjectForFD(_inputSourceMap, i)) )
-              [obj fileDescriptorHasError:local_errno];
-            if ( _outputSourceMap && (obj = __SBRunLoopObjectMapObjectForFD(_outputSourceMap, i)) )
-              [obj fileDescriptorHasError:local_errno];
-          }
-          i++;
+        while ( i < eventCount ) {
+          SBRunLoopRegistration*    registration = &poller->registrations[poller->events[i++].fd];
+          
+          if ( registration->input ) [[registration->input retain] autorelease];
+          if ( registration->output ) [[registration->output retain] autorelease];
         }
         
-        // Walk the input descriptors:
         i = 0;
-        while ( i <= maxRFD ) {
-          if ( FD_ISSET(i, &rfds) ) {
-            id<SBFileDescriptorStream>  obj;
+        while ( i < eventCount ) {
+          int                       fd = poller->events[i].fd;
+          unsigned int              ready = poller->events[i++].events;
+          SBRunLoopRegistration*    registration = &poller->registrations[fd];
+          id<SBFileDescriptorStream>  input = ( (registration->events & SBRunLoopPollRead) ? registration->input : nil );
+          id<SBFileDescriptorStream>  output = ( (registration->events & SBRunLoopPollWrite) ? registration->output : nil );
+          
+          // Another thread posted a message; it gets picked-up next pass:
+          if ( fd == _wakePipe[0] ) {
+            __SBRunLoopDrainWakePipe(fd);
+            continue;
+          }
+          // Errors first:
+          if ( ready & SBRunLoopPollError ) {
+            int                     local_errno = 0;
+            socklen_t               local_errno_size = sizeof(local_errno);
             
-            if ( _inputSourceMap && (obj = __SBRunLoopObjectMapObjectForFD(_inputSourceMap, i)) )
-              [obj fileDescriptorReady];
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &local_errno, &local_errno_size);
+            if ( input )
+              [input fileDescriptorHasError:local_errno];
+            if ( output )
+              [output fileDescriptorHasError:local_errno];
           }
-          i++;
+          // Then writing, then reading:
+          if ( output && (ready & SBRunLoopPollWrite) )
+            [output fileDescriptorReady];
+          if ( input && (ready & SBRunLoopPollRead) )
+            [input fileDescriptorReady];
         }
       }
       rc = YES;
@@ -809,10 +1428,11 @@ earlyExit:
     [localPool release];
     _currentMode = oldMode;
     if ( fireDate ) {
-      *fireDate = ( runUntil ? [runUntil autorelease] : nil );
-    } else {
-      [runUntil release];
+      // If there are no timers, the limit is as distant as possible:
+      *fireDate = ( nextTimer ? [[[nextTimer fireDate] retain] autorelease] : [SBDate distantFuture] );
     }
+    if ( nextTimer )
+      [nextTimer release];
     return rc;
   }
 
@@ -951,12 +1571,39 @@ earlyExit:
     }
   }
 
+//
+
+  - (void) invalidateFileDescriptorForSource:(id)source
+  {
+    SBRunLoopPoller*  poller = (SBRunLoopPoller*)_poller;
+    SBUInteger        i = 0;
+    
+    //
+    // Each pass only compares sources and events, so a source whose descriptor is
+    // replaced by one with the same number would never be handed to the backend again.
+    // Forget everything registered for it; the next pass starts over:
+    //
+    if ( ! poller )
+      return;
+    while ( i < poller->activeCount ) {
+      int                     fd = poller->activeFds[i];
+      SBRunLoopRegistration*  registration = &poller->registrations[fd];
+      
+      if ( (registration->input == source) || (registration->output == source) ) {
+        __SBRunLoopPollerUnwatch(poller, fd);
+        poller->activeFds[i] = poller->activeFds[--poller->activeCount];
+      } else {
+        i++;
+      }
+    }
+  }
+
 //
 
   - (SBUInteger) countOfTimersForMode:(SBString*)aMode
   {
-    SBUInteger        count = 0;
-    SBArray*          a = [_timers objectForKey:aMode];
+    SBUInteger            count = 0;
+    SBRunLoopTimerHeap*   a = [_timers objectForKey:aMode];
     
     if ( a )
       count = [a count];
@@ -992,77 +1639,168 @@ earlyExit:
 
 //
 
-  - (void) setupIOSelectForMode:(SBString*)aMode
-    read:(fd_set*)rfds
-    maxReadFd:(int*)maxrfd
-    write:(fd_set*)wfds
-    maxWriteFd:(int*)maxwfd
-    readError:(fd_set*)refds
-    writeError:(fd_set*)wefds
+  - (void) removeTimer:(SBTimer*)aTimer
+  {
+    SBEnumerator*         eHeaps = [_timers objectEnumerator];
+    SBRunLoopTimerHeap*   heap;
+    
+    if ( [aTimer runLoop] == self )
+      [aTimer setRunLoop:nil];
+    while ( (heap = [eHeaps nextObject]) )
+      [heap removeTimer:aTimer];
+  }
+
+//
+
+  - (void) timerDidChangeFireDate:(SBTimer*)aTimer
   {
+    if ( [aTimer isValid] ) {
+      SBEnumerator*         eHeaps = [_timers objectEnumerator];
+      SBRunLoopTimerHeap*   heap;
+      
+      while ( (heap = [eHeaps nextObject]) )
+        [heap updateTimer:aTimer];
+    } else {
+      [self removeTimer:aTimer];
+    }
+  }
+
+//
+
+  - (BOOL) registerSourcesForMode:(SBString*)aMode
+  {
+    SBRunLoopPoller*  poller = (SBRunLoopPoller*)_poller;
     SBArray*          input = [_inputSources objectForKey:aMode];
     SBArray*          output = [_outputSources objectForKey:aMode];
-    SBUInteger        inputCount = (input ? [input count] : 0);
-    SBUInteger        outputCount = (output ? [output count] : 0);
+    SBUInteger        i, iMax;
+    BOOL              haveSources = NO;
     
-    if ( inputCount ) {
-      SBRunLoopObjectMap*   objMap = (SBRunLoopObjectMap*)_inputSourceMap;
+    if ( ! poller ) {
+      if ( ! (poller = __SBRunLoopPollerAlloc()) )
+        [SBException raise:@"Unable to create poller in SBRunLoop" format:"Errno = %d", errno];
+      _poller = poller;
+    }
+    
+    //
+    // Sources don't tell us when their descriptors come and go (a stream has none until
+    // it is opened) so note what each one is using right now:
+    //
+    poller->pass++;
+    poller->touchedCount = 0;
+    i = 0; iMax = ( input ? [input count] : 0 );
+    while ( i < iMax ) {
+      id<SBFileDescriptorStream>    source = [input objectAtIndex:i++];
+      int                           fd = [source fileDescriptorForStream];
+      SBRunLoopRegistration*        registration;
       
-      if ( ! objMap )
-        objMap = __SBRunLoopObjectMapAlloc(inputCount);
-      else if ( objMap->count < inputCount )
-        objMap = __SBRunLoopObjectMapRealloc(objMap, inputCount);
+      if ( (fd >= 0) && (registration = __SBRunLoopPollerTouch(poller, fd)) ) {
+        registration->wanted |= SBRunLoopPollRead;
+        registration->nextInput = source;
+        haveSources = YES;
+      }
+    }
+    i = 0; iMax = ( output ? [output count] : 0 );
+    while ( i < iMax ) {
+      id<SBFileDescriptorStream>    source = [output objectAtIndex:i++];
+      int                           fd = [source fileDescriptorForStream];
+      SBRunLoopRegistration*        registration;
       
-      if ( objMap ) {
-        // Fill-in the struct:
-        SBUInteger      i = 0;
-        int             maxFD = -1;
-        
-        objMap->count = 0;
-        while ( i < inputCount ) {
-          id<SBFileDescriptorStream>    source = [input objectAtIndex:i++];
-          int                           fd = [source fileDescriptorForStream];
-          
-          if ( fd >= 0 ) {
-            FD_SET(fd, rfds);
-            FD_SET(fd, refds);
-            __SBRunLoopObjectMapAdd(objMap, fd, source);
-            if ( fd > maxFD )
-              *maxrfd = maxFD = fd;
-          }
-        }
+      if ( (fd >= 0) && (registration = __SBRunLoopPollerTouch(poller, fd)) ) {
+        registration->wanted |= SBRunLoopPollWrite;
+        registration->nextOutput = source;
+        haveSources = YES;
+      }
+    }
+    // The wake pipe is watched in every mode, but isn't a source:
+    if ( _wakePipe[0] >= 0 ) {
+      SBRunLoopRegistration*        registration;
+      
+      if ( (registration = __SBRunLoopPollerTouch(poller, _wakePipe[0])) )
+        registration->wanted |= SBRunLoopPollRead;
+    }
+    
+    // Stop watching descriptors nothing in this mode is using:
+    i = 0;
+    while ( i < poller->activeCount ) {
+      int             fd = poller->activeFds[i];
+      
+      if ( poller->registrations[fd].pass != poller->pass ) {
+        __SBRunLoopPollerUnwatch(poller, fd);
+        poller->activeFds[i] = poller->activeFds[--poller->activeCount];
+      } else {
+        i++;
       }
-      _inputSourceMap = objMap;
     }
     
-    if ( outputCount ) {
-      SBRunLoopObjectMap*   objMap = (SBRunLoopObjectMap*)_outputSourceMap;
+    // Only changes go to the backend:
+    i = 0;
+    while ( i < poller->touchedCount )
+      __SBRunLoopPollerWatch(poller, poller->touchedFds[i++]);
+    
+    return haveSources;
+  }
+
+//
+
+  - (void) receivePostedMessages
+  {
+    if ( _wakePipe[0] < 0 ) {
+      //
+      // Set up the wake pipe the first time we run; anything posted before then is
+      // picked-up below:
+      //
+      [_postLock lock];
+      if ( pipe(_wakePipe) == 0 ) {
+        fcntl(_wakePipe[0], F_SETFL, O_NONBLOCK);
+        fcntl(_wakePipe[1], F_SETFL, O_NONBLOCK);
+        fcntl(_wakePipe[0], F_SETFD, FD_CLOEXEC);
+        fcntl(_wakePipe[1], F_SETFD, FD_CLOEXEC);
+      } else {
+        _wakePipe[0] = _wakePipe[1] = -1;
+      }
+      [_postLock unlock];
+    }
+    if ( _hasPostedMessages ) {
+      SBUInteger      i = 0, iMax;
       
-      if ( ! objMap )
-        objMap = __SBRunLoopObjectMapAlloc(outputCount);
-      else if ( objMap->count < outputCount )
-        objMap = __SBRunLoopObjectMapRealloc(objMap, outputCount);
+      [_postLock lock];
+      iMax = [_postedMessages count];
+      while ( i < iMax )
+        [self addMessageToQueue:[_postedMessages objectAtIndex:i++] afterExtant:YES];
+      [_postedMessages removeAllObjects];
+      _hasPostedMessages = NO;
+      [_postLock unlock];
+    }
+  }
+
+//
+
+  - (void) waitForPostedMessagesBeforeDate:(SBDate*)aDate
+  {
+    SBRunLoopPoller*  poller = (SBRunLoopPoller*)_poller;
+    int64_t           deadline = SBRunLoopMonotonicTimeForDate(aDate);
+    int64_t           timeout = -1;
+    
+    if ( deadline != INT64_MAX ) {
+      int64_t         now = SBRunLoopMonotonicTime();
       
-      if ( objMap ) {
-        // Fill-in the struct:
-        SBUInteger      i = 0;
-        int             maxFD = -1;
-        
-        objMap->count = 0;
-        while ( i < outputCount ) {
-          id<SBFileDescriptorStream>    source = [output objectAtIndex:i++];
-          int                           fd = [source fileDescriptorForStream];
-          
-          if ( fd >= 0 ) {
-            FD_SET(fd, wfds);
-            FD_SET(fd, wefds);
-            __SBRunLoopObjectMapAdd(objMap, fd, source);
-            if ( fd > maxFD )
-              *maxwfd = maxFD = fd;
-          }
-        }
+      timeout = ( (deadline > now) ? (deadline - now) : 0 );
+    }
+    if ( poller && (_wakePipe[0] >= 0) && (poller->activeCount == 1) && (poller->activeFds[0] == _wakePipe[0]) ) {
+      // Nothing but the wake pipe is registered:
+      if ( poller->backend->wait(poller->backendState, poller->events, SBRunLoopPollEventMax, timeout) > 0 )
+        __SBRunLoopDrainWakePipe(_wakePipe[0]);
+    } else if ( timeout ) {
+      struct timespec   sleepTime;
+      
+      if ( (timeout < 0) || (timeout / 1000000000LL > LONG_MAX) ) {
+        sleepTime.tv_sec = LONG_MAX;
+        sleepTime.tv_nsec = 0;
+      } else {
+        sleepTime.tv_sec = timeout / 1000000000LL;
+        sleepTime.tv_nsec = timeout % 1000000000LL;
       }
-      _outputSourceMap = objMap;
+      nanosleep(&sleepTime, NULL);
     }
   }
 
@@ -10,6 +10,39 @@
 // $Id$
 //
 
+#include <time.h>
+
+@class SBTimer, SBDate;
+
+/*!
+  @function SBRunLoopMonotonicTime
+  @discussion
+    Returns the current reading of the monotonic clock in nanoseconds.  Timer deadlines
+    in the run loop are kept on this clock so that stepping the wall clock neither
+    fires timers early nor stalls them.
+*/
+static inline int64_t
+SBRunLoopMonotonicTime()
+{
+  struct timespec     now;
+
+#ifdef CLOCK_MONOTONIC
+  clock_gettime(CLOCK_MONOTONIC, &now);
+#else
+  clock_gettime(CLOCK_REALTIME, &now);
+#endif
+  return (int64_t)now.tv_sec * 1000000000LL + (int64_t)now.tv_nsec;
+}
+
+/*!
+  @function SBRunLoopMonotonicTimeForDate
+  @discussion
+    Translates aDate into a reading of the monotonic clock (see SBRunLoopMonotonicTime)
+    relative to the current time.  Dates too far off to represent are pinned to zero or
+    INT64_MAX; so is a nil date, which is taken to be infinitely far off.
+*/
+int64_t SBRunLoopMonotonicTimeForDate(SBDate* aDate);
+
 @interface SBRunLoop(SBRunLoopPrivate)
 
 - (BOOL) runMode:(SBString*)aMode beforeDate:(SBDate*)aDate nextTimerFiresAt:(SBDate**)fireDate;
@@ -27,10 +60,36 @@
 - (void) removeOutputSource:(id)source;
 - (void) removeOutputSource:(id)source forMode:(SBString*)aMode;
 
+//
+// Must be sent (on the run loop's thread) by a source whose file descriptor is about to be
+// closed and replaced, since the new one may well get the same number:
+//
+- (void) invalidateFileDescriptorForSource:(id)source;
+
 - (SBUInteger) countOfTimersForMode:(SBString*)aMode;
 - (SBUInteger) countOfInputSourcesForMode:(SBString*)aMode;
 - (SBUInteger) countOfOutputSourcesForMode:(SBString*)aMode;
 
-- (void) setupIOSelectForMode:(SBString*)aMode read:(fd_set*)rfds maxReadFd:(int*)maxrfd write:(fd_set*)wfds maxWriteFd:(int*)maxwfd readError:(fd_set*)refds writeError:(fd_set*)wefds;
+- (void) removeTimer:(SBTimer*)aTimer;
+- (void) timerDidChangeFireDate:(SBTimer*)aTimer;
+
+- (BOOL) registerSourcesForMode:(SBString*)aMode;
+- (void) receivePostedMessages;
+- (void) waitForPostedMessagesBeforeDate:(SBDate*)aDate;
+
+@end
+
+/*!
+  @category SBTimer(SBTimerRunLoopPrivate)
+  @discussion
+    Bookkeeping shared between a timer and the run loop it has been added to.  The
+    run loop keeps its timers in a heap ordered by fireTime; the timer in turn tells
+    that run loop when its fire date changes or it is invalidated.
+*/
+@interface SBTimer(SBTimerRunLoopPrivate)
+
+- (int64_t) fireTime;
+- (SBRunLoop*) runLoop;
+- (void) setRunLoop:(SBRunLoop*)aRunLoop;
 
 @end
@@ -37,6 +37,7 @@
               <li>SBConcreteStringSubString</li>
             </ul>
           </li>
+          <li>SBConcreteCompactString</li>
           <li>SBMutableString
             <ul>
               <li>SBConcreteMutableString</li>
@@ -55,6 +56,10 @@
     of SBConcreteString which also retains a reference to the parent string but sends itself
     the initWithUncopiedCharacters:length:freeWhenDone: message with the applicable region 
     of the parent strings' UTF-16 buffer.
+    
+    Immutable strings whose characters all fall in the Latin-1 range are created as
+    SBConcreteCompactString objects, which store one byte per character.  Their UTF-16 form
+    is only built when needed, and for pure-ASCII text the UTF-8 form costs nothing.
   </blockquote>
 
   <b>String Compare and Search</b>
@@ -330,6 +335,62 @@ enum {
 
 @end
 
+/*!
+  @category SBString(SBStringInterning)
+  
+  Category of SBString which maintains a program-wide table of canonical string instances.
+  Interning the strings used over and over as keys and identifiers -- database field names,
+  XML element and attribute names -- means that each distinct string is created only once,
+  has its hash calculated only once, and compares equal to its other uses by pointer.
+  
+  Interned strings are never deallocated, so they need not be retained (though doing so is
+  harmless).  The table is thread safe.  It stops accepting new strings once it holds 65536
+  of them; after that, these methods return ordinary autoreleased strings for any text not
+  already in the table.
+*/
+@interface SBString(SBStringInterning)
+
+/*!
+  @method internedStringWithUTF8String:
+  
+  Returns the interned string equal to the UTF-8 encoded cString.
+*/
++ (SBString*) internedStringWithUTF8String:(const char*)cString;
+/*!
+  @method internedStringWithUTF8String:length:
+  
+  Returns the interned string equal to the first length bytes of the UTF-8 encoded cString.
+*/
++ (SBString*) internedStringWithUTF8String:(const char*)cString length:(SBUInteger)length;
+/*!
+  @method internedStringWithCharacters:length:
+  
+  Returns the interned string equal to the given UTF-16 characters.
+*/
++ (SBString*) internedStringWithCharacters:(const UChar*)characters length:(SBUInteger)length;
+/*!
+  @method internedString
+  
+  Returns the interned string equal to the receiver.  String constants and other immutable
+  strings which own their storage may themselves become the interned instance.
+*/
+- (SBString*) internedString;
+
+@end
+
+/*!
+  @typedef SBStringUTF8Buffer
+  @discussion
+  Caller-provided scratch space for the utf8CharactersWithBuffer:length: method.  It is
+  meant to be allocated on the stack; strings whose UTF-8 form fits in it (including the NUL
+  terminator) are transcoded without any heap allocation.
+*/
+#define SBStringUTF8BufferInlineLength 128
+
+typedef struct {
+  unsigned char     inlineBytes[SBStringUTF8BufferInlineLength];
+} SBStringUTF8Buffer;
+
 /*!
   @category SBString(SBStringExtensions)
   
@@ -413,6 +474,20 @@ enum {
   memory you've allocated.
 */
 - (const unsigned char*) utf8Characters;
+/*!
+  @method utf8CharactersWithBuffer:length:
+  
+  Return a pointer to the receiver's NUL-terminated character data in UTF-8 encoding, and
+  (if length is not NULL) the number of bytes preceding the NUL.  When the receiver already
+  holds its characters as UTF-8 -- string constants, ASCII-only strings, or strings whose
+  UTF-8 form has been cached by an earlier call to utf8Characters -- a pointer to that
+  storage is returned and nothing is copied.  Otherwise the characters are transcoded into
+  buffer if they fit; longer strings fall back to utf8Characters.
+  
+  The returned pointer is borrowed:  it is valid only as long as both buffer and the
+  receiver are, and it must not be written through.
+*/
+- (const unsigned char*) utf8CharactersWithBuffer:(SBStringUTF8Buffer*)buffer length:(SBUInteger*)length;
 /*!
   @method utf32Length
   
@@ -1053,9 +1128,7 @@ SBString* SBHomeDirectoryForUser(SBString* userName);
 @end
 
 /*
-  Since we're using the GNU compiler collection we can get away with variable-length stack-based
-  allocations (a'la Fortran).  This means that for standard C APIs which are expecting ASCII
-  argument strings we could do:
+  For standard C APIs which are expecting UTF-8 (or ASCII) argument strings we can do:
   
     SBString*   aPath = [SBString stringWithUTF8String:"/etc/passwd"];
     
@@ -1066,7 +1139,12 @@ SBString* SBHomeDirectoryForUser(SBString* userName);
         :
     SBSTRING_AS_UTF8_END
     
-  The UTF8 version of the string is named by appending "_utf8" to the SBString object's name.
-*/
-#define SBSTRING_AS_UTF8_BEGIN(S) if ( S && ([S utf8Length] > 0) ) { char S ## _utf8[[S utf8Length] + 1]; if ( [S copyUTF8CharactersToBuffer:S ## _utf8 length:[S utf8Length] + 1] ) {
+  The UTF-8 version of the string is named by appending "_utf8" to the SBString object's name
+  (and its length in bytes by appending "_utf8Length").  It comes from the
+  utf8CharactersWithBuffer:length: method, so it points directly at the string's own storage
+  when possible and otherwise at a stack buffer; only long strings without a UTF-8 form
+  touch the heap.  The body is skipped for nil and empty strings.  Treat the characters as
+  read-only.
+*/
+#define SBSTRING_AS_UTF8_BEGIN(S) if ( S ) { SBStringUTF8Buffer S ## _utf8Buffer; SBUInteger S ## _utf8Length = 0; char* S ## _utf8 = (char*)[S utf8CharactersWithBuffer:&S ## _utf8Buffer length:&S ## _utf8Length]; if ( S ## _utf8 && S ## _utf8Length ) {
 #define SBSTRING_AS_UTF8_END } }
@@ -21,6 +21,7 @@ Class cluster:
     |- SBStringSubString
     |- SBConcreteString
          |- SBConcreteStringSubString
+    |- SBConcreteCompactString
     |- SBMutableString
          |- SBConcreteMutableString
 
@@ -40,6 +41,14 @@ that many of the UTF-16-optimized methods from SBConcreteString had to be duplic
 SBConcreteMutableString.  Kinda unfortunate, but it still beats the mess that is
 multiple inheritance!
 
+Most of the strings we create -- SQL, usernames, paths, XML and HTTP header text -- are
+plain ASCII.  When SBConcreteString is initialized with UTF-8 or UTF-16 text in which every
+character falls in the Latin-1 range (U+0000 through U+00FF) it hands back an
+SBConcreteCompactString instead, which holds one byte per character.  A compact string
+builds its UTF-16 form only if something asks for it (searching, ICU case mapping, etc.),
+and when the text is pure ASCII its UTF-8 form is the compact buffer itself, so it
+reports kSBStringUTF8NativeEncoding.  Mutable strings are always UTF-16.
+
 
 == String Compare and Search ===================================
 
@@ -77,6 +86,7 @@ more details on compare/search.
 #import "SBThread.h"
 #import "SBNotification.h"
 #import "SBMemoryPool.h"
+#import "SBLock.h"
 
 #include "unicode/ustring.h"
 #include "unicode/ustdio.h"
@@ -1405,6 +1415,32 @@ __SBStringGetSharedSearchObj()
 
 @end
 
+/*!
+  @class SBConcreteCompactString
+  @discussion
+  Immutable string whose characters all fall in the Latin-1 range, stored one byte per
+  character in a NUL-terminated buffer.  The UTF-16 and (for non-ASCII content) UTF-8
+  forms are built on demand and cached.
+*/
+@interface SBConcreteCompactString : SBString
+{
+  unsigned char*  _latin1Chars;
+  SBUInteger      _length;
+  UChar*          _u16Chars;
+  SBData*         _u8Chars;
+  SBUInteger      _hash;
+  struct {
+    unsigned int  hashCalculated : 1;
+    unsigned int  isASCII : 1;
+  } _flags;
+}
+
+- (id) initWithLatin1UTF8String:(const unsigned char*)cString length:(SBUInteger)length isASCII:(BOOL)isASCII;
+- (id) initWithLatin1Characters:(const UChar*)characters length:(SBUInteger)length isASCII:(BOOL)isASCII;
+- (id) initWithLatin1Bytes:(const unsigned char*)bytes length:(SBUInteger)length isASCII:(BOOL)isASCII;
+
+@end
+
 //
 #pragma mark -
 //
@@ -1434,22 +1470,560 @@ __SBStringAppendUTF8(
   return pDest;
 }
 
+//
+// ASCII fast paths for transcoding.  Most of the text that passes through here -- SQL,
+// HTTP headers, XML markup, log lines -- is ASCII or mostly so, and for ASCII the UTF-8,
+// Latin-1 and UTF-16 forms differ only in width.  These functions measure a leading run of
+// ASCII characters and widen or narrow runs of 8-bit characters 16 (or 32) at a time; the
+// transcoding functions below them only hand what follows the ASCII run to ICU.
+//
+// SSE2 is part of the x86-64 baseline and is used whenever the compiler targets it; the
+// AVX2 scans are compiled in alongside and selected at runtime by __SBStringSelectSIMD().
+// Everything else gets the word-at-a-time scalar versions.
+//
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#  define SBSTRING_USE_SSE2
+#  if defined(__x86_64__) && (defined(__clang__) || (__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))
+#    include <immintrin.h>
+#    define SBSTRING_USE_AVX2
+#  endif
+#endif
+
+#define SBStringWordHighBits8   (((unsigned long)-1 / 0xFF) * 0x80)
+#define SBStringWordHighBits16  (((unsigned long)-1 / 0xFFFF) * 0xFF80)
+
+static SBUInteger
+__SBStringUTF8ASCIIPrefixLengthScalar(
+  const unsigned char*  bytes,
+  SBUInteger            length
+)
+{
+  SBUInteger            i = 0;
+  unsigned long         word;
+  
+  while ( i + sizeof(word) <= length ) {
+    memcpy(&word, bytes + i, sizeof(word));
+    if ( word & SBStringWordHighBits8 )
+      break;
+    i += sizeof(word);
+  }
+  while ( (i < length) && (bytes[i] < 0x80) )
+    i++;
+  return i;
+}
+
+//
+
+static SBUInteger
+__SBStringUTF16ASCIIPrefixLengthScalar(
+  const UChar*          chars,
+  SBUInteger            length
+)
+{
+  SBUInteger            i = 0;
+  unsigned long         word;
+  
+  while ( i + sizeof(word) / sizeof(UChar) <= length ) {
+    memcpy(&word, chars + i, sizeof(word));
+    if ( word & SBStringWordHighBits16 )
+      break;
+    i += sizeof(word) / sizeof(UChar);
+  }
+  while ( (i < length) && (chars[i] < 0x80) )
+    i++;
+  return i;
+}
+
+#ifdef SBSTRING_USE_SSE2
+
+static SBUInteger
+__SBStringUTF8ASCIIPrefixLengthSSE2(
+  const unsigned char*  bytes,
+  SBUInteger            length
+)
+{
+  SBUInteger            i = 0;
+  
+  while ( i + 16 <= length ) {
+    int                 mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(bytes + i)));
+    
+    if ( mask )
+      return i + __builtin_ctz(mask);
+    i += 16;
+  }
+  return i + __SBStringUTF8ASCIIPrefixLengthScalar(bytes + i, length - i);
+}
+
+//
+
+static SBUInteger
+__SBStringUTF16ASCIIPrefixLengthSSE2(
+  const UChar*          chars,
+  SBUInteger            length
+)
+{
+  const __m128i         highBits = _mm_set1_epi16((short)0xFF80);
+  const __m128i         zero = _mm_setzero_si128();
+  SBUInteger            i = 0;
+  
+  while ( i + 8 <= length ) {
+    __m128i             v = _mm_and_si128(_mm_loadu_si128((const __m128i*)(chars + i)), highBits);
+    int                 mask = _mm_movemask_epi8(_mm_cmpeq_epi16(v, zero)) ^ 0xFFFF;
+    
+    if ( mask )
+      return i + (__builtin_ctz(mask) >> 1);
+    i += 8;
+  }
+  return i + __SBStringUTF16ASCIIPrefixLengthScalar(chars + i, length - i);
+}
+
+#endif /* SBSTRING_USE_SSE2 */
+
+#ifdef SBSTRING_USE_AVX2
+
+__attribute__((target("avx2")))
+static SBUInteger
+__SBStringUTF8ASCIIPrefixLengthAVX2(
+  const unsigned char*  bytes,
+  SBUInteger            length
+)
+{
+  SBUInteger            i = 0;
+  
+  while ( i + 32 <= length ) {
+    unsigned int        mask = (unsigned int)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)(bytes + i)));
+    
+    if ( mask )
+      return i + __builtin_ctz(mask);
+    i += 32;
+  }
+  return i + __SBStringUTF8ASCIIPrefixLengthSSE2(bytes + i, length - i);
+}
+
+//
+
+__attribute__((target("avx2")))
+static SBUInteger
+__SBStringUTF16ASCIIPrefixLengthAVX2(
+  const UChar*          chars,
+  SBUInteger            length
+)
+{
+  const __m256i         highBits = _mm256_set1_epi16((short)0xFF80);
+  const __m256i         zero = _mm256_setzero_si256();
+  SBUInteger            i = 0;
+  
+  while ( i + 16 <= length ) {
+    __m256i             v = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(chars + i)), highBits);
+    unsigned int        mask = ~(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi16(v, zero));
+    
+    if ( mask )
+      return i + (__builtin_ctz(mask) >> 1);
+    i += 16;
+  }
+  return i + __SBStringUTF16ASCIIPrefixLengthSSE2(chars + i, length - i);
+}
+
+#endif /* SBSTRING_USE_AVX2 */
+
+//
+// The scans in use; __SBStringSelectSIMD() upgrades them once the CPU is known.  Setting
+// SBSTRING_SIMD to "scalar" or "sse2" in the environment pins a narrower implementation
+// instead (libtest uses this to check each of them against ICU):
+//
+#ifdef SBSTRING_USE_SSE2
+static SBUInteger (*__SBStringUTF8ASCIIPrefixLength)(const unsigned char*, SBUInteger) = __SBStringUTF8ASCIIPrefixLengthSSE2;
+static SBUInteger (*__SBStringUTF16ASCIIPrefixLength)(const UChar*, SBUInteger) = __SBStringUTF16ASCIIPrefixLengthSSE2;
+#else
+static SBUInteger (*__SBStringUTF8ASCIIPrefixLength)(const unsigned char*, SBUInteger) = __SBStringUTF8ASCIIPrefixLengthScalar;
+static SBUInteger (*__SBStringUTF16ASCIIPrefixLength)(const UChar*, SBUInteger) = __SBStringUTF16ASCIIPrefixLengthScalar;
+#endif
+
+static void
+__SBStringSelectSIMD(void)
+{
+  const char*           forced = getenv("SBSTRING_SIMD");
+  
+  if ( forced && (strcmp(forced, "scalar") == 0) ) {
+    __SBStringUTF8ASCIIPrefixLength = __SBStringUTF8ASCIIPrefixLengthScalar;
+    __SBStringUTF16ASCIIPrefixLength = __SBStringUTF16ASCIIPrefixLengthScalar;
+    return;
+  }
+  if ( forced && (strcmp(forced, "sse2") == 0) )
+    return;
+#ifdef SBSTRING_USE_AVX2
+  __builtin_cpu_init();
+  if ( __builtin_cpu_supports("avx2") ) {
+    __SBStringUTF8ASCIIPrefixLength = __SBStringUTF8ASCIIPrefixLengthAVX2;
+    __SBStringUTF16ASCIIPrefixLength = __SBStringUTF16ASCIIPrefixLengthAVX2;
+  }
+#endif
+}
+
+//
+// Zero-extend count Latin-1 characters to UTF-16:
+//
+static void
+__SBStringWidenLatin1(
+  const unsigned char*  src,
+  UChar*                dst,
+  SBUInteger            count
+)
+{
+  SBUInteger            i = 0;
+  
+#ifdef SBSTRING_USE_SSE2
+  const __m128i         zero = _mm_setzero_si128();
+  
+  while ( i + 16 <= count ) {
+    __m128i             v = _mm_loadu_si128((const __m128i*)(src + i));
+    
+    _mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi8(v, zero));
+    _mm_storeu_si128((__m128i*)(dst + i + 8), _mm_unpackhi_epi8(v, zero));
+    i += 16;
+  }
+#endif
+  while ( i < count ) {
+    dst[i] = src[i];
+    i++;
+  }
+}
+
+//
+// Narrow count UTF-16 characters -- which must all be Latin-1 -- to 8 bits:
+//
+static void
+__SBStringNarrowLatin1(
+  const UChar*          src,
+  unsigned char*        dst,
+  SBUInteger            count
+)
+{
+  SBUInteger            i = 0;
+  
+#ifdef SBSTRING_USE_SSE2
+  while ( i + 16 <= count ) {
+    __m128i             lo = _mm_loadu_si128((const __m128i*)(src + i));
+    __m128i             hi = _mm_loadu_si128((const __m128i*)(src + i + 8));
+    
+    _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+    i += 16;
+  }
+#endif
+  while ( i < count ) {
+    dst[i] = (unsigned char)src[i];
+    i++;
+  }
+}
+
+//
+// UTF-16 to UTF-8 with the contract of ICU's u_strToUTF8WithSub() (unpaired surrogates
+// become U+FFFD):  as much as fits in capacity bytes is written to buffer, a NUL follows
+// if there is room, and utf8Length gets the full number of bytes required.  Pass a NULL
+// buffer to only measure.  The leading ASCII run is narrowed here; ICU gets the rest.
+//
+static BOOL
+__SBStringUTF16ToUTF8(
+  const UChar*          u16Chars,
+  SBUInteger            u16Length,
+  unsigned char*        buffer,
+  SBUInteger            capacity,
+  SBUInteger*           utf8Length
+)
+{
+  SBUInteger            prefix = __SBStringUTF16ASCIIPrefixLength(u16Chars, u16Length);
+  
+  if ( ! buffer )
+    capacity = 0;
+  __SBStringNarrowLatin1(u16Chars, buffer, ( (prefix < capacity) ? prefix : capacity ));
+  if ( prefix == u16Length ) {
+    if ( prefix < capacity )
+      buffer[prefix] = '\0';
+  } else {
+    UErrorCode          icuErr = U_ZERO_ERROR;
+    int32_t             reqLength = 0;
+    
+    u_strToUTF8WithSub(
+        ( (prefix < capacity) ? (char*)buffer + prefix : NULL ),
+        ( (prefix < capacity) ? capacity - prefix : 0 ),
+        &reqLength,
+        u16Chars + prefix,
+        u16Length - prefix,
+        (UChar32)0xFFFD,
+        NULL,
+        &icuErr
+      );
+    if ( U_FAILURE(icuErr) && (icuErr != U_BUFFER_OVERFLOW_ERROR) )
+      return NO;
+    prefix += reqLength;
+  }
+  if ( utf8Length )
+    *utf8Length = prefix;
+  return YES;
+}
+
+//
+// UTF-8 to UTF-16, likewise with the contract of ICU's u_strFromUTF8():  fails on
+// malformed input, otherwise writes what fits in capacity characters (NUL-terminated if
+// there is room) and sets u16Length to the full number of characters required.
+//
+static BOOL
+__SBStringUTF8ToUTF16(
+  const unsigned char*  utf8,
+  SBUInteger            utf8Length,
+  UChar*                buffer,
+  SBUInteger            capacity,
+  SBUInteger*           u16Length
+)
+{
+  SBUInteger            prefix = __SBStringUTF8ASCIIPrefixLength(utf8, utf8Length);
+  
+  if ( ! buffer )
+    capacity = 0;
+  __SBStringWidenLatin1(utf8, buffer, ( (prefix < capacity) ? prefix : capacity ));
+  if ( prefix == utf8Length ) {
+    if ( prefix < capacity )
+      buffer[prefix] = 0;
+  } else {
+    UErrorCode          icuErr = U_ZERO_ERROR;
+    int32_t             reqLength = 0;
+    
+    u_strFromUTF8(
+        ( (prefix < capacity) ? buffer + prefix : NULL ),
+        ( (prefix < capacity) ? capacity - prefix : 0 ),
+        &reqLength,
+        (const char*)utf8 + prefix,
+        utf8Length - prefix,
+        &icuErr
+      );
+    if ( U_FAILURE(icuErr) && (icuErr != U_BUFFER_OVERFLOW_ERROR) )
+      return NO;
+    prefix += reqLength;
+  }
+  if ( u16Length )
+    *u16Length = prefix;
+  return YES;
+}
+
+//
+// Returns YES if the UTF-8 text at cString (NUL-terminated if byteLength is -1) only
+// contains characters in the Latin-1 range, in which case latin1Length is set to the number
+// of characters and isASCII to whether they're all 7-bit.
+//
+static BOOL
+__SBStringUTF8IsLatin1(
+  const unsigned char*  cString,
+  SBUInteger            byteLength,
+  SBUInteger*           latin1Length,
+  BOOL*                 isASCII
+)
+{
+  SBUInteger            i = 0, count = 0;
+  BOOL                  ascii = YES;
+  
+  if ( byteLength == -1 )
+    byteLength = strlen((const char*)cString);
+  while ( i < byteLength ) {
+    SBUInteger          run = __SBStringUTF8ASCIIPrefixLength(cString + i, byteLength - i);
+    
+    i += run;
+    count += run;
+    if ( i < byteLength ) {
+      unsigned char     c = cString[i];
+      
+      if ( ((c == 0xC2) || (c == 0xC3)) && (i + 1 < byteLength) && ((cString[i + 1] & 0xC0) == 0x80) ) {
+        i += 2;
+        count++;
+        ascii = NO;
+      } else {
+        return NO;
+      }
+    }
+  }
+  *latin1Length = count;
+  *isASCII = ascii;
+  return YES;
+}
+
+//
+// Likewise for UTF-16 text:
+//
+static BOOL
+__SBStringUTF16IsLatin1(
+  const UChar*          characters,
+  SBUInteger            length,
+  BOOL*                 isASCII
+)
+{
+  SBUInteger            prefix = __SBStringUTF16ASCIIPrefixLength(characters, length);
+  UChar                 bits = 0;
+  
+  characters += prefix;
+  length -= prefix;
+  while ( length-- ) {
+    if ( *characters > 0xFF )
+      return NO;
+    bits |= *characters++;
+  }
+  *isASCII = ( bits < 0x80 );
+  return YES;
+}
+
+//
+
 static UFILE* __SBStringStdout = NULL;
 static UFILE* __SBStringStderr = NULL;
 
 static SBConcreteString* __SBNullString = nil;
 
+//
+// The intern table:  an open-addressed hash table keyed by the UTF-8 form of each interned
+// string.  Interned strings live until the program exits, so the table stops accepting new
+// entries once it holds SBStringInternMaximumCount of them (untrusted input like XML names
+// could otherwise grow it without bound).
+//
+typedef struct {
+  SBUInteger              hash;
+  SBUInteger              utf8Length;
+  const unsigned char*    utf8;
+  SBString*               string;
+} SBStringInternSlot;
+
+#define SBStringInternMinimumCapacity   256
+#define SBStringInternMaximumCount      (64 * 1024)
+
+static SBLock*              __SBStringInternLock = nil;
+static SBStringInternSlot*  __SBStringInternTable = NULL;
+static SBUInteger           __SBStringInternCount = 0;
+static SBUInteger           __SBStringInternCapacity = 0;
+
+static inline SBUInteger
+__SBStringInternHash(
+  const unsigned char*  utf8,
+  SBUInteger            length
+)
+{
+  // FNV-1a:
+#if SB64BitIntegers
+  SBUInteger            hash = 0xcbf29ce484222325ULL;
+  
+  while ( length-- )
+    hash = (hash ^ *utf8++) * 0x100000001b3ULL;
+#else
+  SBUInteger            hash = 0x811c9dc5;
+  
+  while ( length-- )
+    hash = (hash ^ *utf8++) * 0x01000193;
+#endif
+  return hash;
+}
+
+//
+
+static SBStringInternSlot*
+__SBStringInternFind(
+  SBStringInternSlot*   table,
+  SBUInteger            capacity,
+  const unsigned char*  utf8,
+  SBUInteger            length,
+  SBUInteger            hash
+)
+{
+  SBUInteger            index = hash & (capacity - 1);
+  
+  while ( table[index].string ) {
+    if ( (table[index].hash == hash) && (table[index].utf8Length == length) && (memcmp(table[index].utf8, utf8, length) == 0) )
+      break;
+    index = (index + 1) & (capacity - 1);
+  }
+  return &table[index];
+}
+
+//
+
+static BOOL
+__SBStringInternGrow()
+{
+  SBUInteger            newCapacity = ( __SBStringInternCapacity ? 2 * __SBStringInternCapacity : SBStringInternMinimumCapacity );
+  SBStringInternSlot*   newTable = objc_calloc(newCapacity, sizeof(SBStringInternSlot));
+  SBUInteger            i = 0;
+  
+  if ( ! newTable )
+    return NO;
+  while ( i < __SBStringInternCapacity ) {
+    SBStringInternSlot*   slot = &__SBStringInternTable[i++];
+    
+    if ( slot->string )
+      *__SBStringInternFind(newTable, newCapacity, slot->utf8, slot->utf8Length, slot->hash) = *slot;
+  }
+  if ( __SBStringInternTable )
+    objc_free(__SBStringInternTable);
+  __SBStringInternTable = newTable;
+  __SBStringInternCapacity = newCapacity;
+  return YES;
+}
+
+//
+// Returns the interned string with the given UTF-8 form, adding one if necessary.  If
+// candidate is not nil it is the string that gets added; otherwise a new one is created.
+// Returns nil if the table is full.
+//
+static SBString*
+__SBStringIntern(
+  const unsigned char*  utf8,
+  SBUInteger            length,
+  SBString*             candidate
+)
+{
+  SBUInteger            hash = __SBStringInternHash(utf8, length);
+  SBStringInternSlot*   slot = NULL;
+  SBString*             result = nil;
+  
+  [__SBStringInternLock lock];
+  if ( __SBStringInternCapacity )
+    slot = __SBStringInternFind(__SBStringInternTable, __SBStringInternCapacity, utf8, length, hash);
+  if ( slot && slot->string ) {
+    result = slot->string;
+  } else if ( __SBStringInternCount < SBStringInternMaximumCount ) {
+    // Keep the load factor under 3/4:
+    if ( 4 * (__SBStringInternCount + 1) > 3 * __SBStringInternCapacity ) {
+      slot = ( __SBStringInternGrow() ? __SBStringInternFind(__SBStringInternTable, __SBStringInternCapacity, utf8, length, hash) : NULL );
+    }
+    if ( slot ) {
+      if ( candidate )
+        result = [candidate retain];
+      else
+        result = [[SBString alloc] initWithUTF8String:(const char*)utf8 length:length];
+      if ( result ) {
+        // Calculate (and cache) the hash up front:
+        [result hash];
+        slot->hash = hash;
+        slot->utf8Length = length;
+        slot->utf8 = [result utf8Characters];
+        slot->string = result;
+        __SBStringInternCount++;
+      }
+    }
+  }
+  [__SBStringInternLock unlock];
+  return result;
+}
+
 @implementation SBString
 
   + initialize
   {
     if ( self == [SBString class] ) {
+      __SBStringSelectSIMD();
       if ( ! __SBStringStdout )
         __SBStringStdout = u_finit(stdout, NULL, "UTF-8");
       if ( ! __SBStringStderr )
         __SBStringStderr = u_finit(stderr, NULL, "UTF-8");
       if ( ! __SBNullString )
         __SBNullString = [[SBConcreteString alloc] initWithCharacters:(UChar*)"\0\0" length:0];
+      if ( ! __SBStringInternLock )
+        __SBStringInternLock = [[SBLock alloc] init];
         
       // Watch for thread exit notifications so we can cleanup per-thread
       // memory pools, etc:
@@ -1486,6 +2060,9 @@ static SBConcreteString* __SBNullString = nil;
 
   - (BOOL) isEqual:(id)otherObject
   {
+    // Interned strings are the same object:
+    if ( otherObject == self )
+      return YES;
     if ( [otherObject isKindOf:[SBString class]] )
       return [self isEqualToString:(SBString*)otherObject];
     return NO;
@@ -1685,6 +2262,79 @@ static SBConcreteString* __SBNullString = nil;
 
 @end
 
+@implementation SBString(SBStringInterning)
+
+  + (SBString*) internedStringWithUTF8String:(const char*)cString
+  {
+    return [self internedStringWithUTF8String:cString length:( cString ? strlen(cString) : 0 )];
+  }
+  
+//
+
+  + (SBString*) internedStringWithUTF8String:(const char*)cString
+    length:(SBUInteger)length
+  {
+    SBString*     result = nil;
+    
+    if ( cString ) {
+      if ( length == -1 )
+        length = strlen(cString);
+      if ( ! (result = __SBStringIntern((const unsigned char*)cString, length, nil)) )
+        result = [SBString stringWithUTF8String:cString length:length];
+    }
+    return result;
+  }
+  
+//
+
+  + (SBString*) internedStringWithCharacters:(const UChar*)characters
+    length:(SBUInteger)length
+  {
+    SBString*     result = nil;
+    
+    if ( characters ) {
+      unsigned char   localBuffer[256];
+      unsigned char*  utf8 = localBuffer;
+      SBUInteger      utf8Len = 0;
+      
+      // Names are short, so most fit in the local buffer:
+      if ( (3 * length) >= sizeof(localBuffer) )
+        utf8 = objc_malloc(3 * length + 1);
+      if ( utf8 ) {
+        if ( __SBStringUTF16ToUTF8(characters, length, utf8, ( (utf8 == localBuffer) ? sizeof(localBuffer) : 3 * length + 1 ), &utf8Len) )
+          result = __SBStringIntern(utf8, utf8Len, nil);
+        if ( utf8 != localBuffer )
+          objc_free(utf8);
+      }
+      if ( ! result )
+        result = [SBString stringWithCharacters:(UChar*)characters length:length];
+    }
+    return result;
+  }
+  
+//
+
+  - (SBString*) internedString
+  {
+    const unsigned char*  utf8 = [self utf8Characters];
+    SBString*             result = nil;
+    
+    if ( utf8 ) {
+      //
+      // Constants and compact strings own their storage and can never change, so they
+      // can go into the table as-is:
+      //
+      result = __SBStringIntern(
+                    utf8,
+                    [self utf8Length],
+                    ( ([self isKindOf:[SBStringConst class]] || [self isKindOf:[SBConcreteCompactString class]]) ? self : nil )
+                  );
+    }
+    return ( result ? result : self );
+  }
+
+@end
+
 @implementation SBString(SBStringExtensions)
 
   + (SBStringNativeEncoding) nativeEncoding
@@ -2015,6 +2665,27 @@ static SBConcreteString* __SBNullString = nil;
     return result;
   }
   
+//
+
+  - (const unsigned char*) utf8CharactersWithBuffer:(SBStringUTF8Buffer*)buffer
+    length:(SBUInteger*)length
+  {
+    SBUInteger              utf8Len = [self utf8Length];
+    const unsigned char*    result = NULL;
+    
+    if ( utf8Len < SBStringUTF8BufferInlineLength ) {
+      if ( [self copyUTF8CharactersToBuffer:buffer->inlineBytes length:utf8Len + 1] ) {
+        buffer->inlineBytes[utf8Len] = '\0';
+        result = buffer->inlineBytes;
+      }
+    } else {
+      result = [self utf8Characters];
+    }
+    if ( length )
+      *length = ( result ? utf8Len : 0 );
+    return result;
+  }
+  
 //
 
   - (BOOL) isEqualToString:(SBString*)otherString
@@ -2753,25 +3424,17 @@ static SBConcreteString* __SBNullString = nil;
   - (void) setWithUTF8String:(const char*)cString
     length:(SBUInteger)length
   {
-    UErrorCode    icuErr = U_ZERO_ERROR;
-    int32_t       u16Count = 0;
+    SBUInteger    u16Count = 0;
+    
+    if ( cString && (length == -1) )
+      length = strlen(cString);
     
     // Count the UTF16 characters in the string:
-    u_strFromUTF8(NULL, 0, &u16Count, cString, ( (length == -1) ? -1 : length ), &icuErr);
-    if ( U_SUCCESS(icuErr) || (icuErr == U_BUFFER_OVERFLOW_ERROR) ) {
+    if ( cString && __SBStringUTF8ToUTF16((const unsigned char*)cString, length, NULL, 0, &u16Count) ) {
       if ( u16Count ) {
         UChar     u16Chars[u16Count];
         
-        icuErr = 0;
-        u_strFromUTF8(
-            u16Chars,
-            u16Count,
-            NULL,
-            cString,
-            ( (length == -1) ? -1 : length ),
-            &icuErr
-          );
-        if ( U_SUCCESS(icuErr) ) {
+        if ( __SBStringUTF8ToUTF16((const unsigned char*)cString, length, u16Chars, u16Count, NULL) ) {
           [self deleteCharactersInRange:SBRangeCreate(0,[self length])];
           [self appendCharacters:u16Chars length:u16Count];
         }
@@ -2819,33 +3482,31 @@ static SBConcreteString* __SBNullString = nil;
   - (id) initWithUTF8String:(const char*)cString
     length:(SBUInteger)length
   {
-    UErrorCode    icuErr = U_ZERO_ERROR;
-    int32_t       u16Count = 0;
+    SBUInteger    u16Count = 0;
+    SBUInteger    latin1Count;
+    BOOL          isASCII;
+    
+    if ( cString && (length == -1) )
+      length = strlen(cString);
+    
+    // Latin-1 text goes into a compact string instead:
+    if ( cString && ([self class] == [SBConcreteString class]) && __SBStringUTF8IsLatin1((const unsigned char*)cString, length, &latin1Count, &isASCII) && latin1Count ) {
+      [self release];
+      return [[SBConcreteCompactString alloc] initWithLatin1UTF8String:(const unsigned char*)cString length:latin1Count isASCII:isASCII];
+    }
     
     // Count the UTF16 characters in the string:
-    u_strFromUTF8(NULL, 0, &u16Count, cString, ( (length == -1) ? -1 : length ), &icuErr);
-    if ( U_SUCCESS(icuErr) || (icuErr == U_BUFFER_OVERFLOW_ERROR) ) {
+    if ( cString && __SBStringUTF8ToUTF16((const unsigned char*)cString, length, NULL, 0, &u16Count) ) {
       if ( u16Count && (u16Count < INT_MAX) ) {
         // Grow to the required capacity:
         if ( ! [self initWithCapacity:u16Count] ) {
           [self release];
           self = nil;
+        } else if ( ! __SBStringUTF8ToUTF16((const unsigned char*)cString, length, (UChar*)_u16Chars, u16Count, NULL) ) {
+          [self release];
+          self = nil;
         } else {
-          icuErr = 0;
-          u_strFromUTF8(
-              (UChar*)_u16Chars,
-              u16Count,
-              NULL,
-              cString,
-              ( (length == -1) ? -1 : length ),
-              &icuErr
-            );
-          if ( ! U_SUCCESS(icuErr) ) {
-            [self release];
-            self = nil;
-          } else {
-            _length = u16Count;
-          }
+          _length = u16Count;
         }
       } else {
         self = [self init];
@@ -2862,8 +3523,15 @@ static SBConcreteString* __SBNullString = nil;
   - (id) initWithCharacters:(UChar*)characters
     length:(SBUInteger)length
   {
+    BOOL          isASCII;
+    
     SBAssert1(length < INT_MAX, "String is too long: " SBUIntegerFormat, length);
     if ( characters && length ) {
+      // Latin-1 text goes into a compact string instead:
+      if ( ([self class] == [SBConcreteString class]) && __SBStringUTF16IsLatin1(characters, length, &isASCII) ) {
+        [self release];
+        return [[SBConcreteCompactString alloc] initWithLatin1Characters:characters length:length isASCII:isASCII];
+      }
       if ( self = [self initWithCapacity:length] ) {
         u_strncpy((UChar*)_u16Chars, characters, length);
         _length = length;
@@ -2877,6 +3545,18 @@ static SBConcreteString* __SBNullString = nil;
     return self;
   }
   
+//
+
+  - (id) initWithString:(SBString*)aString
+  {
+    // Compact strings are immutable, too, so just share it:
+    if ( ([self class] == [SBConcreteString class]) && [aString isKindOf:[SBConcreteCompactString class]] ) {
+      [self release];
+      return [aString retain];
+    }
+    return [super initWithString:aString];
+  }
+  
 //
 
   - (id) initWithUncopiedCharacters:(UChar*)characters
@@ -2929,6 +3609,21 @@ static SBConcreteString* __SBNullString = nil;
               self = nil;
             }
           } else {
+            BOOL      isASCII;
+            
+            //
+            // Formatted strings are mostly SQL and markup; swap a Latin-1 result for a
+            // compact string:
+            //
+            if ( actLen && ([self class] == [SBConcreteString class]) && __SBStringUTF16IsLatin1(u16Chars, actLen, &isASCII) ) {
+              SBConcreteCompactString*  compact = [[SBConcreteCompactString alloc] initWithLatin1Characters:u16Chars length:actLen isASCII:isASCII];
+              
+              if ( compact ) {
+                objc_free(u16Chars);
+                [self release];
+                return compact;
+              }
+            }
             _u16Chars = u16Chars;
             _length = actLen;
             break;
@@ -3030,26 +3725,12 @@ static SBConcreteString* __SBNullString = nil;
 
   - (SBUInteger) utf8Length
   {
-    if ( _u16Chars && _length ) {
-      UErrorCode              uerr = U_ZERO_ERROR;
-      int32_t                 reqLength = 0;
-      
-      u_strToUTF8WithSub(
-          NULL,
-          0,
-          &reqLength,
-          _u16Chars,
-          _length,
-          (UChar32)0xFFFD,
-          NULL,
-          &uerr
-        );
-      if ( U_SUCCESS(uerr) || (uerr == U_BUFFER_OVERFLOW_ERROR) )
-        return reqLength;
-    }
+    SBUInteger                utf8Len;
+    
+    if ( _u16Chars && _length && __SBStringUTF16ToUTF8(_u16Chars, _length, NULL, 0, &utf8Len) )
+      return utf8Len;
     return 0;
   }
-
 //
 
   - (SBUInteger) utf32Length
@@ -3228,31 +3909,16 @@ static SBConcreteString* __SBNullString = nil;
   {
     unsigned char*      buffer = "";
     
-    if ( ! _u8Chars ) {      
-      if ( _u16Chars && _length ) {
-        UErrorCode              uerr = U_ZERO_ERROR;
-        int32_t                 reqLength = 0;
-        
-        u_strToUTF8(
-            NULL,
-            0,
-            &reqLength,
-            (UChar*)_u16Chars,
-            _length,
-            &uerr
-          );
-        if ( reqLength && (buffer = objc_malloc(++reqLength)) ) {
-          _u8Chars = [[SBData alloc] initWithBytesNoCopy:buffer length:reqLength freeWhenDone:YES];
-          if ( _u8Chars ) {
-            uerr = 0;
-            u_strToUTF8(
-                buffer,
-                reqLength,
-                &reqLength,
-                (UChar*)_u16Chars,
-                _length,
-                &uerr
-              );
+    if ( ! _u8Chars ) {
+      SBUInteger        utf8Len;
+      
+      if ( _u16Chars && _length && __SBStringUTF16ToUTF8(_u16Chars, _length, NULL, 0, &utf8Len) && utf8Len ) {
+        if ( (buffer = objc_malloc(utf8Len + 1)) ) {
+          if ( (_u8Chars = [[SBData alloc] initWithBytesNoCopy:buffer length:utf8Len + 1 freeWhenDone:YES]) ) {
+            __SBStringUTF16ToUTF8(_u16Chars, _length, buffer, utf8Len + 1, NULL);
+          } else {
+            objc_free(buffer);
+            buffer = NULL;
           }
         }
       }
@@ -3261,31 +3927,48 @@ static SBConcreteString* __SBNullString = nil;
     }
     return buffer;
   }
+//
 
+  - (const unsigned char*) utf8CharactersWithBuffer:(SBStringUTF8Buffer*)buffer
+    length:(SBUInteger*)length
+  {
+    const unsigned char*    result = NULL;
+    SBUInteger              utf8Len = 0;
+    
+    if ( _u8Chars ) {
+      result = (const unsigned char*)[_u8Chars bytes];
+      utf8Len = [_u8Chars length] - 1;
+    } else if ( _u16Chars && _length ) {
+      //
+      // Transcode straight into the caller's buffer; if it does not fit, build (and
+      // keep) the heap-based form instead:
+      //
+      if ( __SBStringUTF16ToUTF8(_u16Chars, _length, buffer->inlineBytes, SBStringUTF8BufferInlineLength, &utf8Len) ) {
+        if ( utf8Len < SBStringUTF8BufferInlineLength ) {
+          result = buffer->inlineBytes;
+        } else if ( (result = [self utf8Characters]) && _u8Chars ) {
+          utf8Len = [_u8Chars length] - 1;
+        } else {
+          result = NULL;
+          utf8Len = 0;
+        }
+      }
+    } else {
+      result = (const unsigned char*)"";
+    }
+    if ( length )
+      *length = utf8Len;
+    return result;
+  }
 //
 
   - (BOOL) copyUTF8CharactersToBuffer:(unsigned char*)buffer
     length:(SBUInteger)length
   {
-    if ( _u16Chars && _length ) {
-      UErrorCode        uerr = U_ZERO_ERROR;
-      
-      u_strToUTF8WithSub(
-        (char*)buffer,
-        length,
-        NULL,
-        (UChar*)_u16Chars,
-        _length,
-        (UChar32)0xFFFD,
-        NULL,
-        &uerr
-      );
-      if ( U_SUCCESS(uerr) || (uerr == U_BUFFER_OVERFLOW_ERROR) )
-        return YES;
-    }
+    if ( _u16Chars && _length )
+      return __SBStringUTF16ToUTF8(_u16Chars, _length, buffer, length, NULL);
     return NO;
   }
-
 //
 
 
@@ -3487,33 +4170,23 @@ static SBConcreteString* __SBNullString = nil;
   - (id) initWithUTF8String:(const char*)cString
     length:(SBUInteger)length
   {
-    UErrorCode    icuErr = U_ZERO_ERROR;
-    int32_t       u16Count = 0;
+    SBUInteger    u16Count = 0;
+    
+    if ( cString && (length == -1) )
+      length = strlen(cString);
     
     // Count the UTF16 characters in the string:
-    u_strFromUTF8(NULL, 0, &u16Count, cString, ( (length == -1) ? -1 : length ), &icuErr);
-    if ( U_SUCCESS(icuErr) || (icuErr == U_BUFFER_OVERFLOW_ERROR) ) {
+    if ( cString && __SBStringUTF8ToUTF16((const unsigned char*)cString, length, NULL, 0, &u16Count) ) {
       if ( u16Count ) {
         // Grow to the required capacity:
         if ( ! [self initWithCapacity:u16Count] ) {
           [self release];
           self = nil;
+        } else if ( ! __SBStringUTF8ToUTF16((const unsigned char*)cString, length, (UChar*)_u16Chars, u16Count, NULL) ) {
+          [self release];
+          self = nil;
         } else {
-          icuErr = 0;
-          u_strFromUTF8(
-              (UChar*)_u16Chars,
-              u16Count,
-              NULL,
-              cString,
-              ( (length == -1) ? -1 : length ),
-              &icuErr
-            );
-          if ( ! U_SUCCESS(icuErr) ) {
-            [self release];
-            self = nil;
-          } else {
-            _length = u16Count;
-          }
+          _length = u16Count;
         }
       } else {
         self = [self init];
@@ -3703,28 +4376,12 @@ static SBConcreteString* __SBNullString = nil;
 
   - (SBUInteger) utf8Length
   {
-    SBUInteger                result = 0;
-  
-    if ( _u16Chars && _length ) {
-      UErrorCode              uerr = U_ZERO_ERROR;
-      int32_t                 reqLength = 0;
-      
-      u_strToUTF8WithSub(
-          NULL,
-          0,
-          &reqLength,
-          _u16Chars,
-          _length,
-          (UChar32)0xFFFD,
-          NULL,
-          &uerr
-        );
-      if ( U_SUCCESS(uerr) || (uerr == U_BUFFER_OVERFLOW_ERROR) )
-        result = reqLength;
-    }
-    return result;
+    SBUInteger                utf8Len;
+    
+    if ( _u16Chars && _length && __SBStringUTF16ToUTF8(_u16Chars, _length, NULL, 0, &utf8Len) )
+      return utf8Len;
+    return 0;
   }
-
 //
 
   - (SBUInteger) utf32Length
@@ -3905,32 +4562,16 @@ static SBConcreteString* __SBNullString = nil;
   {
     unsigned char*      buffer = "";
     
-    if ( ! _u8Chars ) {      
-      if ( _u16Chars && _length ) {
-        UErrorCode              uerr = U_ZERO_ERROR;
-        int32_t                 reqLength = 0;
-        
-        u_strToUTF8(
-            NULL,
-            0,
-            &reqLength,
-            (UChar*)_u16Chars,
-            _length,
-            &uerr
-          );
-        if ( reqLength && (buffer = objc_malloc(++reqLength)) ) {
-          _u8Chars = [[SBData alloc] initWithBytesNoCopy:buffer length:reqLength freeWhenDone:YES];
-          
-          if ( _u8Chars ) {
-            uerr = 0;
-            u_strToUTF8(
-                buffer,
-                reqLength,
-                &reqLength,
-                (UChar*)_u16Chars,
-                _length,
-                &uerr
-              );
+    if ( ! _u8Chars ) {
+      SBUInteger        utf8Len;
+      
+      if ( _u16Chars && _length && __SBStringUTF16ToUTF8(_u16Chars, _length, NULL, 0, &utf8Len) && utf8Len ) {
+        if ( (buffer = objc_malloc(utf8Len + 1)) ) {
+          if ( (_u8Chars = [[SBData alloc] initWithBytesNoCopy:buffer length:utf8Len + 1 freeWhenDone:YES]) ) {
+            __SBStringUTF16ToUTF8(_u16Chars, _length, buffer, utf8Len + 1, NULL);
+          } else {
+            objc_free(buffer);
+            buffer = NULL;
           }
         }
       }
@@ -3939,33 +4580,28 @@ static SBConcreteString* __SBNullString = nil;
     }
     return buffer;
   }
+//
+
+  - (const unsigned char*) utf8CharactersWithBuffer:(SBStringUTF8Buffer*)buffer
+    length:(SBUInteger*)length
+  {
+    if ( _u8Chars ) {
+      if ( length )
+        *length = [_u8Chars length] - 1;
+      return (const unsigned char*)[_u8Chars bytes];
+    }
+    return [super utf8CharactersWithBuffer:buffer length:length];
+  }
 
 //
 
   - (BOOL) copyUTF8CharactersToBuffer:(unsigned char*)buffer
     length:(SBUInteger)length
   {
-    BOOL          result = NO;
-    
-    if ( _u16Chars && _length ) {
-      UErrorCode        uerr = U_ZERO_ERROR;
-      
-      u_strToUTF8WithSub(
-        (char*)buffer,
-        length,
-        NULL,
-        (UChar*)_u16Chars,
-        _length,
-        (UChar32)0xFFFD,
-        NULL,
-        &uerr
-      );
-      if ( U_SUCCESS(uerr) || (uerr == U_BUFFER_OVERFLOW_ERROR) )
-        result = YES;
-    }
-    return result;
+    if ( _u16Chars && _length )
+      return __SBStringUTF16ToUTF8(_u16Chars, _length, buffer, length, NULL);
+    return NO;
   }
-
 //
 
   - (BOOL) copyUTF32CharactersToBuffer:(UChar32*)buffer
@@ -4245,25 +4881,17 @@ static SBConcreteString* __SBNullString = nil;
   - (void) setWithUTF8String:(const char*)cString
     length:(SBUInteger)length
   {
-    UErrorCode    icuErr = U_ZERO_ERROR;
-    int32_t       u16Count = 0;
+    SBUInteger    u16Count = 0;
+    
+    if ( cString && (length == -1) )
+      length = strlen(cString);
     
     // Count the UTF16 characters in the string:
-    u_strFromUTF8(NULL, 0, &u16Count, cString, ( (length == -1) ? -1 : length ), &icuErr);
-    if ( U_SUCCESS(icuErr) || (icuErr == U_BUFFER_OVERFLOW_ERROR) ) {
+    if ( cString && __SBStringUTF8ToUTF16((const unsigned char*)cString, length, NULL, 0, &u16Count) ) {
       if ( u16Count ) {
         UChar     u16Chars[u16Count];
         
-        icuErr = 0;
-        u_strFromUTF8(
-            u16Chars,
-            u16Count,
-            NULL,
-            cString,
-            ( (length == -1) ? -1 : length ),
-            &icuErr
-          );
-        if ( U_SUCCESS(icuErr) ) {
+        if ( __SBStringUTF8ToUTF16((const unsigned char*)cString, length, u16Chars, u16Count, NULL) ) {
           if ( _length )
             _length = 0;
           [self appendCharacters:u16Chars length:u16Count];
@@ -4388,6 +5016,373 @@ static SBConcreteString* __SBNullString = nil;
 #pragma mark -
 //
 
+//
+// A compact string builds its UTF-16 and UTF-8 forms on demand, and interned strings are
+// shared between threads -- so two threads can build them at the same time.  Each builds
+// a complete copy privately and then publishes it with a compare-and-swap; the loser
+// frees its copy and uses the winner's.  Readers pair that with an acquire load so they
+// never see the pointer before the characters behind it.
+//
+#if defined(__ATOMIC_ACQUIRE)
+#  define SBStringCachedFormLoad(P)           __atomic_load_n((P), __ATOMIC_ACQUIRE)
+#  define SBStringCachedFormPublish(P, V)     ({ __typeof__(*(P)) __expected = NULL; __atomic_compare_exchange_n((P), &__expected, (V), 0, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE); })
+#else
+#  define SBStringCachedFormLoad(P)           ({ __typeof__(*(P)) __value = *(volatile __typeof__(*(P))*)(P); __sync_synchronize(); __value; })
+#  define SBStringCachedFormPublish(P, V)     __sync_bool_compare_and_swap((P), NULL, (V))
+#endif
+
+@implementation SBConcreteCompactString
+
+  + (SBStringNativeEncoding) nativeEncoding
+  {
+    return kSBStringUnknownNativeEncoding;
+  }
+  - (SBStringNativeEncoding) nativeEncoding
+  {
+    // ASCII is already valid UTF-8:
+    return ( _flags.isASCII ? kSBStringUTF8NativeEncoding : kSBStringUTF16NativeEncoding );
+  }
+
+//
+
+  - (id) initWithLatin1UTF8String:(const unsigned char*)cString
+    length:(SBUInteger)length
+    isASCII:(BOOL)isASCII
+  {
+    if ( self = [self init] ) {
+      if ( (_latin1Chars = objc_malloc(length + 1)) ) {
+        if ( isASCII ) {
+          memcpy(_latin1Chars, cString, length);
+        } else {
+          SBUInteger      i = 0;
+          
+          while ( i < length ) {
+            SBUInteger    run = __SBStringUTF8ASCIIPrefixLength(cString, length - i);
+            
+            memcpy(_latin1Chars + i, cString, run);
+            i += run;
+            cString += run;
+            if ( i < length ) {
+              _latin1Chars[i++] = ((cString[0] & 0x03) << 6) | (cString[1] & 0x3F);
+              cString += 2;
+            }
+          }
+        }
+        _latin1Chars[length] = '\0';
+        _length = length;
+        _flags.isASCII = isASCII;
+      } else {
+        [self release];
+        self = nil;
+      }
+    }
+    return self;
+  }
+
+//
+
+  - (id) initWithLatin1Characters:(const UChar*)characters
+    length:(SBUInteger)length
+    isASCII:(BOOL)isASCII
+  {
+    if ( self = [self init] ) {
+      if ( (_latin1Chars = objc_malloc(length + 1)) ) {
+        __SBStringNarrowLatin1(characters, _latin1Chars, length);
+        _latin1Chars[length] = '\0';
+        _length = length;
+        _flags.isASCII = isASCII;
+      } else {
+        [self release];
+        self = nil;
+      }
+    }
+    return self;
+  }
+
+//
+
+  - (id) initWithLatin1Bytes:(const unsigned char*)bytes
+    length:(SBUInteger)length
+    isASCII:(BOOL)isASCII
+  {
+    if ( self = [self init] ) {
+      if ( (_latin1Chars = objc_malloc(length + 1)) ) {
+        memcpy(_latin1Chars, bytes, length);
+        _latin1Chars[length] = '\0';
+        _length = length;
+        _flags.isASCII = isASCII;
+      } else {
+        [self release];
+        self = nil;
+      }
+    }
+    return self;
+  }
+
+//
+
+  - (void) dealloc
+  {
+    if ( _latin1Chars ) objc_free(_latin1Chars);
+    if ( _u16Chars ) objc_free(_u16Chars);
+    if ( _u8Chars ) [_u8Chars release];
+    [super dealloc];
+  }
+
+//
+
+  - (SBUInteger) hash
+  {
+    if ( ! _flags.hashCalculated ) {
+      //
+      // Must match the hash of an SBConcreteString with the same characters, so hash
+      // the UTF-16 form; short strings are widened on the stack:
+      //
+      if ( _length > 0 ) {
+        if ( _u16Chars || (_length > 128) ) {
+          _hash = [self hashForData:[self utf16Characters] byteLength:sizeof(UChar) * _length];
+        } else {
+          UChar       u16Chars[128];
+          
+          __SBStringWidenLatin1(_latin1Chars, u16Chars, _length);
+          _hash = [self hashForData:u16Chars byteLength:sizeof(UChar) * _length];
+        }
+      } else {
+        _hash = 0x80808080;
+      }
+      _flags.hashCalculated = YES;
+    }
+    return _hash;
+  }
+
+//
+
+  - (SBUInteger) length
+  {
+    return _length;
+  }
+
+//
+
+  - (UChar) characterAtIndex:(SBUInteger)index
+  {
+    if ( index < _length )
+      return (UChar)_latin1Chars[index];
+    return (UChar)0;
+  }
+
+//
+
+  - (SBString*) substringWithRange:(SBRange)range
+  {
+    if ( range.start >= _length )
+      return [SBString string];
+    if ( range.start + range.length > _length )
+      range.length = _length - range.start;
+    return [[[SBConcreteCompactString alloc] initWithLatin1Bytes:_latin1Chars + range.start length:range.length isASCII:_flags.isASCII] autorelease];
+  }
+
+//
+
+  - (const UChar*) utf16Characters
+  {
+    UChar*          u16Chars = SBStringCachedFormLoad(&_u16Chars);
+    
+    if ( ! u16Chars ) {
+      if ( (u16Chars = objc_malloc((_length + 1) * sizeof(UChar))) ) {
+        __SBStringWidenLatin1(_latin1Chars, u16Chars, _length + 1);
+        if ( ! SBStringCachedFormPublish(&_u16Chars, u16Chars) ) {
+          objc_free(u16Chars);
+          u16Chars = SBStringCachedFormLoad(&_u16Chars);
+        }
+      }
+    }
+    return u16Chars;
+  }
+
+//
+
+  - (BOOL) copyCharactersToBuffer:(UChar*)buffer
+    length:(SBUInteger)length
+  {
+    if ( _length ) {
+      __SBStringWidenLatin1(_latin1Chars, buffer, ( (length < _length) ? length : _length ));
+      return YES;
+    }
+    return NO;
+  }
+
+//
+
+  - (SBUInteger) utf8Length
+  {
+    SBUInteger      length = _length;
+    
+    if ( ! _flags.isASCII ) {
+      SBUInteger    i = 0;
+      
+      while ( i < _length ) {
+        if ( _latin1Chars[i++] >= 0x80 )
+          length++;
+      }
+    }
+    return length;
+  }
+
+//
+
+  - (SBUInteger) utf32Length
+  {
+    return _length;
+  }
+
+//
+
+  - (UChar32) utf32CharacterAtIndex:(SBUInteger)index
+  {
+    if ( index < _length )
+      return (UChar32)_latin1Chars[index];
+    return (UChar32)0xFFFFFFFF;
+  }
+
+//
+
+  - (const unsigned char*) utf8Characters
+  {
+    if ( _flags.isASCII )
+      return _latin1Chars;
+    
+    SBData*           u8Chars = SBStringCachedFormLoad(&_u8Chars);
+    
+    if ( ! u8Chars ) {
+      SBUInteger      utf8Len = [self utf8Length];
+      unsigned char*  buffer = objc_malloc(utf8Len + 1);
+      
+      if ( buffer ) {
+        [self copyUTF8CharactersToBuffer:buffer length:utf8Len + 1];
+        if ( (u8Chars = [[SBData alloc] initWithBytesNoCopy:buffer length:utf8Len + 1 freeWhenDone:YES]) ) {
+          if ( ! SBStringCachedFormPublish(&_u8Chars, u8Chars) ) {
+            [u8Chars release];
+            u8Chars = SBStringCachedFormLoad(&_u8Chars);
+          }
+        } else {
+          objc_free(buffer);
+        }
+      }
+    }
+    return ( u8Chars ? (const unsigned char*)[u8Chars bytes] : (const unsigned char*)"" );
+  }
+
+//
+
+  - (const unsigned char*) utf8CharactersWithBuffer:(SBStringUTF8Buffer*)buffer
+    length:(SBUInteger*)length
+  {
+    if ( _flags.isASCII ) {
+      if ( length )
+        *length = _length;
+      return _latin1Chars;
+    }
+    
+    SBData*         u8Chars = SBStringCachedFormLoad(&_u8Chars);
+    
+    if ( u8Chars ) {
+      if ( length )
+        *length = [u8Chars length] - 1;
+      return (const unsigned char*)[u8Chars bytes];
+    }
+    return [super utf8CharactersWithBuffer:buffer length:length];
+  }
+
+//
+
+  - (BOOL) copyUTF8CharactersToBuffer:(unsigned char*)buffer
+    length:(SBUInteger)length
+  {
+    if ( _length ) {
+      if ( _flags.isASCII ) {
+        // Includes the NUL terminator if there's room for it:
+        memcpy(buffer, _latin1Chars, ( (length > _length) ? _length + 1 : length ));
+      } else {
+        SBUInteger      i = 0;
+        
+        while ( (i < _length) && length ) {
+          unsigned char c = _latin1Chars[i++];
+          
+          if ( c < 0x80 ) {
+            *buffer++ = c;
+            length--;
+          } else if ( length >= 2 ) {
+            *buffer++ = 0xC0 | (c >> 6);
+            *buffer++ = 0x80 | (c & 0x3F);
+            length -= 2;
+          } else {
+            break;
+          }
+        }
+        if ( length )
+          *buffer = '\0';
+      }
+      return YES;
+    }
+    return NO;
+  }
+
+//
+
+  - (void) writeToStream:(FILE*)stream
+  {
+    if ( _flags.isASCII )
+      fwrite(_latin1Chars, 1, _length, stream);
+    else
+      [super writeToStream:stream];
+  }
+
+//
+
+  - (double) doubleValue
+  {
+    char*     endptr;
+    double    result = strtod((char*)_latin1Chars, &endptr);
+    
+    if ( endptr > (char*)_latin1Chars )
+      return result;
+    return 0.0;
+  }
+  - (float) floatValue
+  {
+    char*     endptr;
+    float     result = strtof((char*)_latin1Chars, &endptr);
+    
+    if ( endptr > (char*)_latin1Chars )
+      return result;
+    return 0.0f;
+  }
+  - (int) intValue
+  {
+    char*     endptr;
+    long int  result = strtol((char*)_latin1Chars, &endptr, 10);
+    
+    if ( endptr > (char*)_latin1Chars )
+      return result;
+    return 0;
+  }
+  - (long long int) longLongIntValue
+  {
+    char*           endptr;
+    long long int   result = strtoll((char*)_latin1Chars, &endptr, 10);
+    
+    if ( endptr > (char*)_latin1Chars )
+      return result;
+    return 0LL;
+  }
+
+@end
+
+//
+#pragma mark -
+//
+
 typedef struct {
   @defs(SBStringConst)
 } SBStringConstAsStruct;
@@ -4482,22 +5477,11 @@ static SBMutableDictionary* __SBStringConst_U16Forms = nil;
   - (SBUInteger) length
   {
     SBStringConstInstanceData*    iData = (SBStringConstInstanceData*)(&((SBStringConstAsStruct*)self)->_references);
+    SBUInteger                    actLen = 0;
     
-    if ( iData->byGCC.s ) {
-      UErrorCode  icuErr = 0;
-      int32_t     actLen = 0;
-      
-      u_strFromUTF8(
-          NULL,
-          0,
-          &actLen,
-          iData->byGCC.s,
-          iData->byGCC.l,
-          &icuErr
-        );
-      return actLen;
-    }
-    return 0;
+    if ( iData->byGCC.s )
+      __SBStringUTF8ToUTF16((const unsigned char*)iData->byGCC.s, iData->byGCC.l, NULL, 0, &actLen);
+    return actLen;
   }
   
 //
@@ -4618,6 +5602,18 @@ static SBMutableDictionary* __SBStringConst_U16Forms = nil;
     return (const unsigned char*)iData->byGCC.s;
   }
 
+//
+
+  - (const unsigned char*) utf8CharactersWithBuffer:(SBStringUTF8Buffer*)buffer
+    length:(SBUInteger*)length
+  {
+    SBStringConstInstanceData*    iData = (SBStringConstInstanceData*)(&((SBStringConstAsStruct*)self)->_references);
+    
+    if ( length )
+      *length = ( iData->byGCC.s ? iData->byGCC.l : 0 );
+    return (const unsigned char*)iData->byGCC.s;
+  }
+
 //
 
   - (SBString*) substringWithRange:(SBRange)range
@@ -12,7 +12,7 @@
 
 #import "SBObject.h"
 
-@class SBDate, SBTimeInterval;
+@class SBDate, SBTimeInterval, SBRunLoop;
 
 /*!
   @class SBTimer
@@ -48,11 +48,13 @@
 {
   SBTimeInterval*     _timeInterval;
   SBDate*             _fireDate;
+  int64_t             _fireTime;
   
   id                  _target;
   SEL                 _selector;
   id                  _userInfo;
   
+  SBRunLoop*          _runLoop;
   BOOL                _isValid;
 }
 
@@ -13,6 +13,7 @@
 #import "SBTimer.h"
 #import "SBDate.h"
 #import "SBRunLoop.h"
+#import "SBRunLoopPrivate.h"
 #import "SBDateFormatter.h"
 #import "SBString.h"
 
@@ -105,6 +106,8 @@
 
   - (void) dealloc
   {
+    // Any run loop we were added to has already let go of us:
+    _runLoop = nil;
     [self invalidate];
     if ( _target ) [_target release];
     if ( _userInfo ) [_userInfo release];
@@ -122,11 +125,15 @@
     if ( fireDate ) fireDate = [fireDate retain];
     if ( _fireDate ) [_fireDate release];
     _fireDate = fireDate;
+    _fireTime = SBRunLoopMonotonicTimeForDate(_fireDate);
     _isValid = YES;
     
-    if ( [[SBDate dateWhichIsAlwaysNow] earlierDate:_fireDate] == _fireDate )
+    if ( [[SBDate dateWhichIsAlwaysNow] earlierDate:_fireDate] == _fireDate ) {
       // Fire now and reschedule:
       [self fire];
+    } else if ( _runLoop ) {
+      [_runLoop timerDidChangeFireDate:self];
+    }
   }
 
 //
@@ -153,6 +160,13 @@
       [_timeInterval release];
       _timeInterval = nil;
     }
+    _fireTime = INT64_MAX;
+    if ( _runLoop ) {
+      // The run loop may hold the last reference to us:
+      [self retain];
+      [_runLoop removeTimer:self];
+      [self release];
+    }
   }
   
 //
@@ -184,8 +198,33 @@
         }
         [_fireDate release];
         _fireDate = nextFireDate;
+        _fireTime = SBRunLoopMonotonicTimeForDate(_fireDate);
+      }
+      
+      // When the run loop fires us it takes care of rescheduling; otherwise, let it know
+      // we've moved (or are done):
+      if ( _runLoop ) {
+        [self retain];
+        [_runLoop timerDidChangeFireDate:self];
+        [self release];
       }
     }
   }
 
 @end
+
+//
+#pragma mark -
+//
+
+@implementation SBTimer(SBTimerRunLoopPrivate)
+
+  - (int64_t) fireTime { return _fireTime; }
+  - (SBRunLoop*) runLoop { return _runLoop; }
+  - (void) setRunLoop:(SBRunLoop*)aRunLoop
+  {
+    // Not retained; the run loop retains us:
+    _runLoop = aRunLoop;
+  }
+
+@end
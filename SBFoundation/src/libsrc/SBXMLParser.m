@@ -280,14 +280,13 @@ __SBXMLParser_Expat_StartElement(
     attributeDict = [THE_PARSER state_getAttributeDict];
     
     while ( *attributes ) {
-      SBString*             key = [[SBString alloc] initWithCharacters:(UChar*)*attributes length:__EXPAT_strlen_UTF16(*attributes)];
+      SBString*             key = [SBString internedStringWithCharacters:(UChar*)*attributes length:__EXPAT_strlen_UTF16(*attributes)];
       attributes++;
       
       SBString*             value = [[SBString alloc] initWithCharacters:(UChar*)*attributes length:__EXPAT_strlen_UTF16(*attributes)];
       attributes++;
       
       [attributeDict setValue:value forKey:key];
-      [key release];
       [value release];
     }
     if ( [attributeDict count] )
@@ -296,7 +295,7 @@ __SBXMLParser_Expat_StartElement(
       attributeDict = nil;
   }
   
-  SBString*               qName = [[SBString alloc] initWithCharacters:(UChar*)name length:__EXPAT_strlen_UTF16(name)];
+  SBString*               qName = [SBString internedStringWithCharacters:(UChar*)name length:__EXPAT_strlen_UTF16(name)];
   
   [delegate xmlParser:THE_PARSER
                 didStartElement:qName
@@ -304,8 +303,6 @@ __SBXMLParser_Expat_StartElement(
                 qualifiedName:qName
                 attributes:attributeDict
               ];
-              
-  [qName release];
 }
 
 //
@@ -327,15 +324,13 @@ __SBXMLParser_Expat_EndElement(
   if ( ! delegate )
     return;
   
-  SBString*               qName = [[SBString alloc] initWithCharacters:(UChar*)name length:__EXPAT_strlen_UTF16(name)];
+  SBString*               qName = [SBString internedStringWithCharacters:(UChar*)name length:__EXPAT_strlen_UTF16(name)];
   
   [delegate xmlParser:THE_PARSER
                 didEndElement:qName
                 namespaceURI:nil
                 qualifiedName:qName
               ];
-  
-  [qName release];
 }
 
 //
@@ -366,14 +361,13 @@ __SBXMLParser_Expat_StartElementNS(
     [attributeDict removeAllObjects];
     
     while ( *attributes ) {
-      SBString*             key = [[SBString alloc] initWithCharacters:(UChar*)*attributes length:__EXPAT_strlen_UTF16(*attributes)];
+      SBString*             key = [SBString internedStringWithCharacters:(UChar*)*attributes length:__EXPAT_strlen_UTF16(*attributes)];
       attributes++;
       
       SBString*             value = [[SBString alloc] initWithCharacters:(UChar*)*attributes length:__EXPAT_strlen_UTF16(*attributes)];
       attributes++;
       
       [attributeDict setValue:value forKey:key];
-      [key release];
       [value release];
     }
     if ( [attributeDict count] )
@@ -382,7 +376,7 @@ __SBXMLParser_Expat_StartElementNS(
       attributeDict = nil;
   }
   
-  SBString*               qName = [[SBString alloc] initWithCharacters:(UChar*)name length:__EXPAT_strlen_UTF16(name)];
+  SBString*               qName = [SBString internedStringWithCharacters:(UChar*)name length:__EXPAT_strlen_UTF16(name)];
   SBString*               nsURI = nil;
   SBString*               localName = qName;
   
@@ -405,7 +399,6 @@ __SBXMLParser_Expat_StartElementNS(
                 attributes:attributeDict
               ];
               
-  [qName release];
   if ( attributeDict )
     [attributeDict release];
 }
@@ -429,7 +422,7 @@ __SBXMLParser_Expat_EndElementNS(
   if ( ! delegate )
     return;
   
-  SBString*               qName = [[SBString alloc] initWithCharacters:(UChar*)name length:__EXPAT_strlen_UTF16(name)];
+  SBString*               qName = [SBString internedStringWithCharacters:(UChar*)name length:__EXPAT_strlen_UTF16(name)];
   SBString*               nsURI = nil;
   SBString*               localName = qName;
   
@@ -450,8 +443,6 @@ __SBXMLParser_Expat_EndElementNS(
                 namespaceURI:nsURI
                 qualifiedName:qName
               ];
-  
-  [qName release];
 }
 
 //
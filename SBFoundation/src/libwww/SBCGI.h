@@ -344,3 +344,59 @@ SBHTTPMethod SBHTTPMethodFromEnv(void);
 - (void) sendDebuggingData;
 
 @end
+
+//
+
+/*!
+  @typedef SBCGIRequestHandler
+  @discussion
+    Type of the function called by the SBCGIRequestLoop methods once per request.  The CGI
+    environment variables, stdin and stdout are set up for the request before the function
+    is called, exactly as they would be for a classic CGI process.  The context pointer is
+    passed through unmodified.
+*/
+typedef void (*SBCGIRequestHandler)(void* context);
+
+/*!
+  @category SBCGI(SBCGIRequestLoop)
+  @discussion
+    Persistent execution support.  When Apache (mod_fcgid, mod_fastcgi) spawns the program
+    as a FastCGI application, stdin is a listening socket rather than the request body; a
+    program that routes its request handling through runRequestLoopWithHandler:context:
+    will then accept and answer requests one after another in the same process, keeping
+    its database connection, prepared statements and object caches warm.  When run as a
+    classic CGI the handler is called exactly once.
+
+    Each request is handled inside its own autorelease pool, and a new SBCGI (or subclass)
+    instance should be created by the handler for every request so no per-request state
+    leaks into the next one.
+*/
+@interface SBCGI(SBCGIRequestLoop)
+
+/*!
+  @method isFastCGI
+  @discussion
+    Returns boolean YES if the process was started as a FastCGI application, i.e. stdin
+    is a socket which is not connected to a peer.
+*/
++ (BOOL) isFastCGI;
+
+/*!
+  @method runRequestLoopWithHandler:context:
+  @discussion
+    Sends the runRequestLoopWithHandler:context:maximumRequests: message with no limit
+    on the number of requests.
+*/
++ (int) runRequestLoopWithHandler:(SBCGIRequestHandler)handler context:(void*)context;
+
+/*!
+  @method runRequestLoopWithHandler:context:maximumRequests:
+  @discussion
+    Call handler once per request; under FastCGI, the loop returns after maxRequests
+    requests have been answered (zero implies no limit) so that the process manager
+    can start a fresh process.  Returns zero on a normal exit, non-zero if the FastCGI
+    listening socket failed.
+*/
++ (int) runRequestLoopWithHandler:(SBCGIRequestHandler)handler context:(void*)context maximumRequests:(SBUInteger)maxRequests;
+
+@end
@@ -16,6 +16,11 @@
 #import "SBEnumerator.h"
 #import "SBInetAddress.h"
 #import "SBFileHandle.h"
+#import "SBAutoreleasePool.h"
+
+#include <sys/socket.h>
+#include <signal.h>
+#include <errno.h>
 
 enum {
   kSBCGIFlagQueryStringHasBeenParsed        = 1 << 0
@@ -721,3 +726,643 @@ strnchr(
   }
 
 @end
+
+//
+#pragma mark -
+//
+
+/*
+ * FastCGI protocol (version 1) constants:
+ */
+#define SBFCGI_VERSION_1              1
+#define SBFCGI_HEADER_LEN             8
+#define SBFCGI_MAX_CONTENT_LEN        65535
+#define SBFCGI_MAX_PADDING_LEN        255
+
+enum {
+  kSBFCGIBeginRequest               = 1,
+  kSBFCGIAbortRequest               = 2,
+  kSBFCGIEndRequest                 = 3,
+  kSBFCGIParams                     = 4,
+  kSBFCGIStdin                      = 5,
+  kSBFCGIStdout                     = 6,
+  kSBFCGIStderr                     = 7,
+  kSBFCGIData                       = 8,
+  kSBFCGIGetValues                  = 9,
+  kSBFCGIGetValuesResult            = 10,
+  kSBFCGIUnknownType                = 11
+};
+
+enum {
+  kSBFCGIRoleResponder              = 1
+};
+
+enum {
+  kSBFCGIBeginFlagKeepConn          = 1 << 0
+};
+
+enum {
+  kSBFCGIStatusRequestComplete      = 0,
+  kSBFCGIStatusCantMultiplexConn    = 1,
+  kSBFCGIStatusOverloaded           = 2,
+  kSBFCGIStatusUnknownRole          = 3
+};
+
+/*
+ * State of the FastCGI accept loop.  Only one request is handled at a time; the request
+ * body is spooled to an unlinked temporary file that sits on fd 0 and the response is
+ * captured in a second one on fd 1, so code written for classic CGI runs unmodified.
+ */
+typedef struct {
+  int               connFd;
+  unsigned int      requestId;
+  BOOL              keepConn;
+  BOOL              haveParams;
+  //
+  unsigned char*    params;
+  size_t            paramsLen, paramsCapacity;
+  //
+  char**            envNames;
+  char**            envSaved;         // value each name had before the request, or NULL
+  unsigned int      envCount, envCapacity;
+  //
+  unsigned char     record[SBFCGI_HEADER_LEN + SBFCGI_MAX_CONTENT_LEN + SBFCGI_MAX_PADDING_LEN];
+} SBFastCGIState;
+
+//
+
+BOOL
+__SBFastCGIReadFully(
+  int           fd,
+  void*         buffer,
+  size_t        length
+)
+{
+  unsigned char*  p = (unsigned char*)buffer;
+  
+  while ( length ) {
+    ssize_t       c = read(fd, p, length);
+    
+    if ( c < 0 ) {
+      if ( errno == EINTR )
+        continue;
+      return NO;
+    }
+    if ( c == 0 )
+      return NO;
+    p += c;
+    length -= c;
+  }
+  return YES;
+}
+
+//
+
+BOOL
+__SBFastCGIWriteFully(
+  int           fd,
+  const void*   buffer,
+  size_t        length
+)
+{
+  const unsigned char*  p = (const unsigned char*)buffer;
+  
+  while ( length ) {
+    ssize_t       c = write(fd, p, length);
+    
+    if ( c < 0 ) {
+      if ( errno == EINTR )
+        continue;
+      return NO;
+    }
+    p += c;
+    length -= c;
+  }
+  return YES;
+}
+
+//
+
+BOOL
+__SBFastCGIWriteRecord(
+  int           fd,
+  int           type,
+  unsigned int  requestId,
+  const void*   content,
+  size_t        contentLen
+)
+{
+  static unsigned char  padding[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+  unsigned char         header[SBFCGI_HEADER_LEN];
+  size_t                paddingLen = (8 - (contentLen & 7)) & 7;
+  
+  header[0] = SBFCGI_VERSION_1;
+  header[1] = (unsigned char)type;
+  header[2] = (requestId >> 8) & 0xFF;
+  header[3] = requestId & 0xFF;
+  header[4] = (contentLen >> 8) & 0xFF;
+  header[5] = contentLen & 0xFF;
+  header[6] = (unsigned char)paddingLen;
+  header[7] = 0;
+  
+  if ( ! __SBFastCGIWriteFully(fd, header, sizeof(header)) )
+    return NO;
+  if ( contentLen && ! __SBFastCGIWriteFully(fd, content, contentLen) )
+    return NO;
+  if ( paddingLen && ! __SBFastCGIWriteFully(fd, padding, paddingLen) )
+    return NO;
+  return YES;
+}
+
+//
+
+BOOL
+__SBFastCGIWriteEndRequest(
+  int           fd,
+  unsigned int  requestId,
+  unsigned int  appStatus,
+  int           protocolStatus
+)
+{
+  unsigned char body[8];
+  
+  body[0] = (appStatus >> 24) & 0xFF;
+  body[1] = (appStatus >> 16) & 0xFF;
+  body[2] = (appStatus >> 8) & 0xFF;
+  body[3] = appStatus & 0xFF;
+  body[4] = (unsigned char)protocolStatus;
+  body[5] = body[6] = body[7] = 0;
+  return __SBFastCGIWriteRecord(fd, kSBFCGIEndRequest, requestId, body, sizeof(body));
+}
+
+//
+
+BOOL
+__SBFastCGIDecodeLength(
+  const unsigned char**   p,
+  const unsigned char*    end,
+  size_t*                 length
+)
+{
+  const unsigned char*    s = *p;
+  
+  if ( s >= end )
+    return NO;
+  if ( (*s & 0x80) == 0 ) {
+    *length = *s;
+    *p = s + 1;
+    return YES;
+  }
+  if ( end - s < 4 )
+    return NO;
+  *length = ((size_t)(s[0] & 0x7F) << 24) | ((size_t)s[1] << 16) | ((size_t)s[2] << 8) | (size_t)s[3];
+  *p = s + 4;
+  return YES;
+}
+
+//
+
+size_t
+__SBFastCGIEncodePair(
+  unsigned char*  buffer,
+  const char*     name,
+  const char*     value
+)
+{
+  size_t          nameLen = strlen(name), valueLen = strlen(value);
+  
+  // Names and values here are always short, so single-byte lengths suffice:
+  buffer[0] = (unsigned char)nameLen;
+  buffer[1] = (unsigned char)valueLen;
+  memcpy(buffer + 2, name, nameLen);
+  memcpy(buffer + 2 + nameLen, value, valueLen);
+  return 2 + nameLen + valueLen;
+}
+
+//
+
+BOOL
+__SBFastCGIAppendParams(
+  SBFastCGIState*       state,
+  const unsigned char*  bytes,
+  size_t                length
+)
+{
+  if ( state->paramsLen + length > state->paramsCapacity ) {
+    size_t          newCapacity = ( state->paramsCapacity ? 2 * state->paramsCapacity : 4096 );
+    unsigned char*  newParams;
+    
+    while ( newCapacity < state->paramsLen + length )
+      newCapacity *= 2;
+    if ( ! (newParams = objc_realloc(state->params, newCapacity)) )
+      return NO;
+    state->params = newParams;
+    state->paramsCapacity = newCapacity;
+  }
+  memcpy(state->params + state->paramsLen, bytes, length);
+  state->paramsLen += length;
+  return YES;
+}
+
+//
+
+void
+__SBFastCGIResetEnvironment(
+  SBFastCGIState*   state
+)
+{
+  //
+  // Undone last to first, so a name set twice ends up with the value it had before either.
+  // A name that was already in the process environment (PATH, TZ...) gets its value back
+  // rather than being dropped:
+  //
+  while ( state->envCount ) {
+    char*           name = state->envNames[--state->envCount];
+    char*           saved = state->envSaved[state->envCount];
+    
+    if ( saved ) {
+      setenv(name, saved, 1);
+      objc_free(saved);
+    } else {
+      unsetenv(name);
+    }
+    objc_free(name);
+  }
+}
+
+//
+
+BOOL
+__SBFastCGISetEnvironment(
+  SBFastCGIState*   state
+)
+{
+  const unsigned char*  p = state->params;
+  const unsigned char*  end = p + state->paramsLen;
+  
+  //
+  // Drop whatever the previous request set; the CGI accessors all go through getenv():
+  //
+  __SBFastCGIResetEnvironment(state);
+  
+  while ( p < end ) {
+    size_t            nameLen, valueLen;
+    char*             name;
+    char*             value;
+    char*             saved;
+    
+    if ( ! __SBFastCGIDecodeLength(&p, end, &nameLen) || ! __SBFastCGIDecodeLength(&p, end, &valueLen) )
+      return NO;
+    if ( (size_t)(end - p) < nameLen + valueLen )
+      return NO;
+    if ( nameLen == 0 || memchr(p, '=', nameLen) ) {
+      p += nameLen + valueLen;
+      continue;
+    }
+    
+    if ( state->envCount == state->envCapacity ) {
+      unsigned int    newCapacity = ( state->envCapacity ? 2 * state->envCapacity : 64 );
+      char**          newNames = objc_realloc(state->envNames, newCapacity * sizeof(char*));
+      char**          newSaved;
+      
+      if ( ! newNames )
+        return NO;
+      state->envNames = newNames;
+      if ( ! (newSaved = objc_realloc(state->envSaved, newCapacity * sizeof(char*))) )
+        return NO;
+      state->envSaved = newSaved;
+      state->envCapacity = newCapacity;
+    }
+    name = objc_malloc(nameLen + valueLen + 2);
+    value = name + nameLen + 1;
+    memcpy(name, p, nameLen); name[nameLen] = '\0';
+    memcpy(value, p + nameLen, valueLen); value[valueLen] = '\0';
+    p += nameLen + valueLen;
+    
+    if ( (saved = getenv(name)) ) {
+      size_t          savedLen = strlen(saved) + 1;
+      char*           copy = objc_malloc(savedLen);
+      
+      if ( ! copy ) {
+        objc_free(name);
+        return NO;
+      }
+      saved = memcpy(copy, saved, savedLen);
+    }
+    setenv(name, value, 1);
+    state->envSaved[state->envCount] = saved;
+    state->envNames[state->envCount++] = name;
+  }
+  return YES;
+}
+
+//
+
+BOOL
+__SBFastCGISendValues(
+  SBFastCGIState*       state,
+  const unsigned char*  content,
+  size_t                contentLen
+)
+{
+  const unsigned char*  p = content;
+  const unsigned char*  end = content + contentLen;
+  unsigned char         reply[256];
+  size_t                replyLen = 0;
+  
+  while ( p < end ) {
+    size_t              nameLen, valueLen;
+    const char*         value = NULL;
+    
+    if ( ! __SBFastCGIDecodeLength(&p, end, &nameLen) || ! __SBFastCGIDecodeLength(&p, end, &valueLen) )
+      break;
+    if ( (size_t)(end - p) < nameLen + valueLen )
+      break;
+    if ( nameLen == 14 && strncmp((const char*)p, "FCGI_MAX_CONNS", 14) == 0 )
+      value = "1";
+    else if ( nameLen == 13 && strncmp((const char*)p, "FCGI_MAX_REQS", 13) == 0 )
+      value = "1";
+    else if ( nameLen == 15 && strncmp((const char*)p, "FCGI_MPXS_CONNS", 15) == 0 )
+      value = "0";
+    if ( value && (replyLen + 2 + nameLen + 1 <= sizeof(reply)) ) {
+      char              name[16];
+      
+      memcpy(name, p, nameLen); name[nameLen] = '\0';
+      replyLen += __SBFastCGIEncodePair(reply + replyLen, name, value);
+    }
+    p += nameLen + valueLen;
+  }
+  return __SBFastCGIWriteRecord(state->connFd, kSBFCGIGetValuesResult, 0, reply, replyLen);
+}
+
+//
+
+BOOL
+__SBFastCGIReadRequest(
+  SBFastCGIState*   state
+)
+{
+  state->requestId = 0;
+  state->haveParams = NO;
+  state->paramsLen = 0;
+  
+  while ( 1 ) {
+    unsigned char*  header = state->record;
+    unsigned char*  content = state->record + SBFCGI_HEADER_LEN;
+    unsigned int    requestId;
+    size_t          contentLen;
+    int             type;
+    
+    if ( ! __SBFastCGIReadFully(state->connFd, header, SBFCGI_HEADER_LEN) )
+      return NO;
+    if ( header[0] != SBFCGI_VERSION_1 )
+      return NO;
+    type = header[1];
+    requestId = (header[2] << 8) | header[3];
+    contentLen = (header[4] << 8) | header[5];
+    if ( ! __SBFastCGIReadFully(state->connFd, content, contentLen + header[6]) )
+      return NO;
+    
+    if ( requestId == 0 ) {
+      //
+      // Management record:
+      //
+      if ( type == kSBFCGIGetValues ) {
+        if ( ! __SBFastCGISendValues(state, content, contentLen) )
+          return NO;
+      } else {
+        unsigned char   body[8] = { (unsigned char)type, 0, 0, 0, 0, 0, 0, 0 };
+        
+        if ( ! __SBFastCGIWriteRecord(state->connFd, kSBFCGIUnknownType, 0, body, sizeof(body)) )
+          return NO;
+      }
+      continue;
+    }
+    
+    switch ( type ) {
+    
+      case kSBFCGIBeginRequest: {
+        if ( contentLen < 8 )
+          return NO;
+        if ( state->requestId ) {
+          // We do not multiplex:
+          if ( ! __SBFastCGIWriteEndRequest(state->connFd, requestId, 0, kSBFCGIStatusCantMultiplexConn) )
+            return NO;
+          break;
+        }
+        state->keepConn = ( (content[2] & kSBFCGIBeginFlagKeepConn) != 0 );
+        if ( ((content[0] << 8) | content[1]) != kSBFCGIRoleResponder ) {
+          if ( ! __SBFastCGIWriteEndRequest(state->connFd, requestId, 0, kSBFCGIStatusUnknownRole) || ! state->keepConn )
+            return NO;
+          break;
+        }
+        state->requestId = requestId;
+        state->haveParams = NO;
+        state->paramsLen = 0;
+        if ( ftruncate(STDIN_FILENO, 0) || (lseek(STDIN_FILENO, 0, SEEK_SET) < 0) )
+          return NO;
+        break;
+      }
+      
+      case kSBFCGIAbortRequest: {
+        if ( requestId == state->requestId ) {
+          if ( ! __SBFastCGIWriteEndRequest(state->connFd, requestId, 0, kSBFCGIStatusRequestComplete) || ! state->keepConn )
+            return NO;
+          state->requestId = 0;
+        }
+        break;
+      }
+      
+      case kSBFCGIParams: {
+        if ( requestId == state->requestId ) {
+          if ( contentLen ) {
+            if ( ! __SBFastCGIAppendParams(state, content, contentLen) )
+              return NO;
+          } else {
+            state->haveParams = YES;
+          }
+        }
+        break;
+      }
+      
+      case kSBFCGIStdin: {
+        if ( requestId == state->requestId ) {
+          if ( contentLen ) {
+            if ( ! __SBFastCGIWriteFully(STDIN_FILENO, content, contentLen) )
+              return NO;
+          } else if ( state->haveParams ) {
+            //
+            // Request is complete; rewind the body for the handler:
+            //
+            return ( lseek(STDIN_FILENO, 0, SEEK_SET) == 0 );
+          }
+        }
+        break;
+      }
+      
+      default:
+        // FCGI_DATA et al. are meaningless for the Responder role:
+        break;
+        
+    }
+  }
+}
+
+//
+
+BOOL
+__SBFastCGISendResponse(
+  SBFastCGIState*   state
+)
+{
+  unsigned char*    buffer = state->record + SBFCGI_HEADER_LEN;
+  BOOL              rc = YES;
+  
+  fflush(stdout);
+  if ( lseek(STDOUT_FILENO, 0, SEEK_SET) < 0 )
+    rc = NO;
+  while ( rc ) {
+    ssize_t         c = read(STDOUT_FILENO, buffer, 32768);
+    
+    if ( c < 0 ) {
+      if ( errno == EINTR )
+        continue;
+      rc = NO;
+    } else if ( c == 0 ) {
+      break;
+    } else {
+      rc = __SBFastCGIWriteRecord(state->connFd, kSBFCGIStdout, state->requestId, buffer, c);
+    }
+  }
+  if ( rc )
+    rc = __SBFastCGIWriteRecord(state->connFd, kSBFCGIStdout, state->requestId, NULL, 0)
+          && __SBFastCGIWriteEndRequest(state->connFd, state->requestId, 0, kSBFCGIStatusRequestComplete);
+  
+  //
+  // Empty the capture file for the next request:
+  //
+  if ( ftruncate(STDOUT_FILENO, 0) == 0 )
+    fseek(stdout, 0L, SEEK_SET);
+  return rc;
+}
+
+//
+
+int
+__SBFastCGIRunLoop(
+  SBCGIRequestHandler   handler,
+  void*                 context,
+  SBUInteger            maxRequests
+)
+{
+  SBFastCGIState*       state = objc_calloc(1, sizeof(SBFastCGIState));
+  SBUInteger            requestCount = 0;
+  FILE*                 bodyFile = tmpfile();
+  FILE*                 responseFile = tmpfile();
+  int                   listenFd = dup(STDIN_FILENO);
+  int                   rc = 0;
+  
+  if ( ! state || ! bodyFile || ! responseFile || (listenFd < 0) ) {
+    rc = 1;
+    goto cleanup;
+  }
+  
+  //
+  // Move the listening socket out of the way and put the spool files in place of
+  // stdin and stdout:
+  //
+  fflush(stdout);
+  if ( (dup2(fileno(bodyFile), STDIN_FILENO) < 0) || (dup2(fileno(responseFile), STDOUT_FILENO) < 0) ) {
+    rc = 1;
+    goto cleanup;
+  }
+  
+  //
+  // A web server hanging up on us should end the connection, not the process:
+  //
+  signal(SIGPIPE, SIG_IGN);
+  
+  while ( ! maxRequests || (requestCount < maxRequests) ) {
+    if ( (state->connFd = accept(listenFd, NULL, NULL)) < 0 ) {
+      if ( errno == EINTR || errno == ECONNABORTED )
+        continue;
+      rc = 1;
+      break;
+    }
+    
+    while ( __SBFastCGIReadRequest(state) ) {
+      if ( __SBFastCGISetEnvironment(state) ) {
+        SBAutoreleasePool*    pool = [[SBAutoreleasePool alloc] init];
+        
+        handler(context);
+        [pool release];
+      }
+      requestCount++;
+      if ( ! __SBFastCGISendResponse(state) || ! state->keepConn || (maxRequests && (requestCount >= maxRequests)) )
+        break;
+    }
+    close(state->connFd);
+    state->connFd = -1;
+  }
+  
+cleanup:
+  if ( state ) {
+    __SBFastCGIResetEnvironment(state);
+    if ( state->params ) objc_free(state->params);
+    if ( state->envNames ) objc_free(state->envNames);
+    if ( state->envSaved ) objc_free(state->envSaved);
+    objc_free(state);
+  }
+  if ( listenFd >= 0 ) close(listenFd);
+  if ( bodyFile ) fclose(bodyFile);
+  if ( responseFile ) fclose(responseFile);
+  return rc;
+}
+
+//
+
+@implementation SBCGI(SBCGIRequestLoop)
+
+  + (BOOL) isFastCGI
+  {
+    static int      __SBCGIIsFastCGI = -1;
+    
+    if ( __SBCGIIsFastCGI < 0 ) {
+      struct sockaddr_storage   peer;
+      socklen_t                 peerLen = sizeof(peer);
+      
+      //
+      // A FastCGI application inherits its listening socket on fd 0; getpeername()
+      // on an unconnected socket fails with ENOTCONN (a pipe or file gives ENOTSOCK):
+      //
+      __SBCGIIsFastCGI = ( (getpeername(STDIN_FILENO, (struct sockaddr*)&peer, &peerLen) != 0) && (errno == ENOTCONN) );
+    }
+    return ( __SBCGIIsFastCGI ? YES : NO );
+  }
+
+//
+
+  + (int) runRequestLoopWithHandler:(SBCGIRequestHandler)handler
+    context:(void*)context
+  {
+    return [self runRequestLoopWithHandler:handler context:context maximumRequests:0];
+  }
+  
+//
+
+  + (int) runRequestLoopWithHandler:(SBCGIRequestHandler)handler
+    context:(void*)context
+    maximumRequests:(SBUInteger)maxRequests
+  {
+    if ( [self isFastCGI] )
+      return __SBFastCGIRunLoop(handler, context, maxRequests);
+    
+    SBAutoreleasePool*    pool = [[SBAutoreleasePool alloc] init];
+    
+    handler(context);
+    [pool release];
+    fflush(stdout);
+    return 0;
+  }
+
+@end
@@ -13,14 +13,42 @@
 #import "SBZFSFilesystem.h"
 #import "SBString.h"
 
+#include <pthread.h>
+
+//
+// A libzfs handle is not safe to share between threads (it carries the error state and
+// the mount table cache), so each thread lazily opens its own and it gets closed when
+// the thread exits.  Any SBZFSFilesystem must be used only on the thread that created it.
+//
+static pthread_key_t    __SBZFSManager_LibHandleKey;
+static pthread_once_t   __SBZFSManager_LibHandleOnce = PTHREAD_ONCE_INIT;
+
+void
+__SBZFSManager_ReleaseLibHandle(
+  void*       libHandle
+)
+{
+  if ( libHandle )
+    libzfs_fini((libzfs_handle_t*)libHandle);
+}
+
+void
+__SBZFSManager_InitLibHandleKey(void)
+{
+  pthread_key_create(&__SBZFSManager_LibHandleKey, __SBZFSManager_ReleaseLibHandle);
+}
+
 libzfs_handle_t*
 __SBZFSManager_GetLibHandle()
 {
-  static libzfs_handle_t*     sharedLibHandle = NULL;
+  libzfs_handle_t*    libHandle;
   
-  if ( sharedLibHandle == NULL )
-    sharedLibHandle = libzfs_init();
-  return sharedLibHandle;
+  pthread_once(&__SBZFSManager_LibHandleOnce, __SBZFSManager_InitLibHandleKey);
+  if ( (libHandle = pthread_getspecific(__SBZFSManager_LibHandleKey)) == NULL ) {
+    if ( (libHandle = libzfs_init()) )
+      pthread_setspecific(__SBZFSManager_LibHandleKey, libHandle);
+  }
+  return libHandle;
 }
 
 //
@@ -12,7 +12,7 @@
 
 #import "SHUEBox.h"
 
-@class SBString, SBMutableString, SBError, SHUEBoxCollaboration;
+@class SBString, SBMutableString, SBMutableDictionary, SBError, SBTimer, SHUEBoxCollaboration;
 
 @protocol SHUEBoxApacheConf
 
@@ -24,13 +24,20 @@
 
 @interface SHUEBoxApacheManager : SBObject
 {
-  BOOL        _delayRestarts;
-  int         _restart;
+  BOOL                    _delayRestarts;
+  int                     _restart;
+  SBMutableDictionary*    _configHashes;
+  SBUInteger              _restartWindow;
+  SBTimer*                _restartTimer;
 }
 
 + (id) shueboxApacheManager;
 
 - (SBError*) writeConfiguration:(SBString*)config forCollaboration:(SHUEBoxCollaboration*)collaboration isHTTPS:(BOOL)isHTTPS;
+//
+// Leaves the file alone (and sets *didChange to NO) if it already holds exactly config:
+//
+- (SBError*) writeConfiguration:(SBString*)config forCollaboration:(SHUEBoxCollaboration*)collaboration isHTTPS:(BOOL)isHTTPS didChange:(BOOL*)didChange;
 - (SBError*) removeConfigurationForCollaboration:(SHUEBoxCollaboration*)collaboration isHTTPS:(BOOL)isHTTPS;
 
 - (SBError*) hardRestart;
@@ -42,4 +49,16 @@
 - (BOOL) delayRestarts;
 - (void) setDelayRestarts:(BOOL)delayRestarts;
 
+//
+// With a non-zero window, a restart request starts a timer on the current runloop and
+// any further requests made before it fires are folded into that one restart (a hard
+// restart wins over a graceful one).  Zero -- the default -- restarts immediately, which
+// is what programs that never run their runloop need.
+//
+- (SBUInteger) restartCoalescingWindow;
+- (void) setRestartCoalescingWindow:(SBUInteger)seconds;
+
+- (BOOL) hasPendingRestart;
+- (SBError*) performPendingRestart;
+
 @end
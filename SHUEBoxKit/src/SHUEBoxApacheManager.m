@@ -15,9 +15,16 @@
 #import "SHUEBoxCollaboration.h"
 #import "SBString.h"
 #import "SBError.h"
+#import "SBArray.h"
 #import "SBDictionary.h"
 #import "SBMailer.h"
 #import "SBFileManager.h"
+#import "SBData.h"
+#import "SBValue.h"
+#import "SBDate.h"
+#import "SBTimer.h"
+
+#include <sys/stat.h>
 
 enum {
   kSHUEBoxApacheManagerCmdNOP = 0,
@@ -25,9 +32,62 @@ enum {
   kSHUEBoxApacheManagerCmdGracefulRestart
 };
 
+//
+// 64-bit FNV-1a over the bytes of a configuration file; only ever compared against
+// other values produced by this function in the same process:
+//
+static uint64_t
+__SHUEBoxApacheManagerHashBytes(
+  const void*   bytes,
+  size_t        length
+)
+{
+  const unsigned char*  p = (const unsigned char*)bytes;
+  uint64_t              hash = 0xcbf29ce484222325ULL;
+  
+  while ( length-- ) {
+    hash ^= *p++;
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+//
+// What we remember about a configuration file we wrote (or found to be current):  the hash
+// of its content along with the size, modification time and inode it had at the time.  If
+// any of those have changed, the file was touched by someone else and the hash no longer
+// describes it.  Returns nil if the file can't be stat'ed:
+//
+static SBArray*
+__SHUEBoxApacheManagerConfigRecord(
+  uint64_t      hash,
+  SBString*     path
+)
+{
+  SBArray*      record = nil;
+  struct stat   info;
+  
+  SBSTRING_AS_UTF8_BEGIN(path)
+    if ( stat(path_utf8, &info) == 0 ) {
+      record = [SBArray arrayWithObjects:
+                            [SBNumber numberWithUnsignedInt64:hash],
+                            [SBNumber numberWithUnsignedInt64:(uint64_t)info.st_size],
+                            [SBNumber numberWithUnsignedInt64:(uint64_t)info.st_mtime],
+                            [SBNumber numberWithUnsignedInt64:(uint64_t)info.st_ino],
+                            nil
+                          ];
+    }
+  SBSTRING_AS_UTF8_END
+  return record;
+}
+
+//
+
 @interface SHUEBoxApacheManager(SHUEBoxApacheManagerPrivate)
 
 - (SBError*) doApachectlCommand:(int)command;
+- (SBError*) requestRestart:(int)command;
+- (void) restartTimerDidFire:(SBTimer*)aTimer;
 
 @end
 
@@ -62,6 +122,7 @@ enum {
                 "-t",
                 NULL
               );
+            _exit(127);
           }
           default: {
             int     status;
@@ -111,6 +172,7 @@ enum {
                       arg2,
                       NULL
                     );
+                  _exit(127);
                 }
                 default: {
                   int     status;
@@ -146,6 +208,33 @@ enum {
     return error;
   }
 
+//
+
+  - (SBError*) requestRestart:(int)command
+  {
+    //
+    // A pending hard restart covers a graceful one:
+    //
+    if ( _restart != kSHUEBoxApacheManagerCmdRestart )
+      _restart = command;
+    if ( _delayRestarts )
+      return nil;
+    if ( _restartWindow ) {
+      if ( ! _restartTimer )
+        _restartTimer = [[SBTimer scheduledTimerWithFireDate:[SBDate dateWithSecondsSinceNow:_restartWindow] target:self selector:@selector(restartTimerDidFire:) userInfo:nil] retain];
+      return nil;
+    }
+    return [self performPendingRestart];
+  }
+
+//
+
+  - (void) restartTimerDidFire:(SBTimer*)aTimer
+  {
+    // Any error has already been mailed to the sysadmins:
+    [self performPendingRestart];
+  }
+
 @end
 
 //
@@ -164,28 +253,89 @@ enum {
     return sharedInstance;
   }
 
+//
+
+  - (id) init
+  {
+    if ( self = [super init] ) {
+      _configHashes = [[SBMutableDictionary alloc] init];
+    }
+    return self;
+  }
+
+//
+
+  - (void) dealloc
+  {
+    if ( _restartTimer ) {
+      [_restartTimer invalidate];
+      [_restartTimer release];
+    }
+    if ( _configHashes ) [_configHashes release];
+    [super dealloc];
+  }
+
 //
 
   - (SBError*) writeConfiguration:(SBString*)config
     forCollaboration:(SHUEBoxCollaboration*)collaboration
     isHTTPS:(BOOL)isHTTPS
+  {
+    return [self writeConfiguration:config forCollaboration:collaboration isHTTPS:isHTTPS didChange:NULL];
+  }
+
+//
+
+  - (SBError*) writeConfiguration:(SBString*)config
+    forCollaboration:(SHUEBoxCollaboration*)collaboration
+    isHTTPS:(BOOL)isHTTPS
+    didChange:(BOOL*)didChange
   {
     SBString*       confPath = [[SHUEBoxPathManager shueboxPathManager] pathForKey:SHUEBoxApacheConfsPath];
     SBError*        result = nil;
     
+    if ( didChange )
+      *didChange = NO;
     if ( confPath ) {
       SBString*     finalConfPath = [SBString stringWithFormat:"%S/%s/%S.conf",
                                             [confPath utf16Characters],
                                             ( isHTTPS ? "https" : "http" ),
                                             [[collaboration shortName] utf16Characters]
                                           ];
+      size_t        bytes = [config utf8Length];
+      const char*   utf8 = [config utf8Characters];
+      uint64_t      hash = __SHUEBoxApacheManagerHashBytes(utf8, bytes);
       SBString*     tmpConfPath = nil;
-      int           confFD = [[SHUEBoxPathManager shueboxPathManager] createTemporaryFile:&tmpConfPath error:&result];
+      int           confFD;
       
-      if ( confFD >= 0 ) {
-        size_t            bytes = [config utf8Length];
-        const char*       utf8 = [config utf8Characters];
+      //
+      // Is the file already there with this exact content?  Trust the hash from our own
+      // last write only if the file's size, mtime and inode are still what they were then;
+      // otherwise hash what's on disk:
+      //
+      if ( [[SBFileManager sharedFileManager] fileExistsAtPath:finalConfPath] ) {
+        SBArray*    knownRecord = [_configHashes objectForKey:finalConfPath];
+        SBArray*    diskRecord = __SHUEBoxApacheManagerConfigRecord(hash, finalConfPath);
+        BOOL        unchanged = NO;
         
+        if ( knownRecord && diskRecord && [knownRecord isEqualToArray:diskRecord] ) {
+          unchanged = YES;
+        } else {
+          SBData*   onDisk = [SBData dataWithContentsOfFile:finalConfPath];
+          
+          if ( onDisk && ([onDisk length] == bytes) )
+            unchanged = ( __SHUEBoxApacheManagerHashBytes([onDisk bytes], bytes) == hash );
+          if ( unchanged && diskRecord )
+            [_configHashes setObject:diskRecord forKey:finalConfPath];
+          else
+            [_configHashes removeObjectForKey:finalConfPath];
+        }
+        if ( unchanged )
+          return nil;
+      }
+      
+      confFD = [[SHUEBoxPathManager shueboxPathManager] createTemporaryFile:&tmpConfPath error:&result];
+      if ( confFD >= 0 ) {
         if ( write(confFD, utf8, bytes) == bytes ) {
           close(confFD);
           if ( ! [[SBFileManager sharedFileManager] movePath:tmpConfPath toPath:finalConfPath] ) {
@@ -195,6 +345,15 @@ enum {
                                 forKey:SBErrorExplanationKey
                             ]
                         ];
+          } else {
+            SBArray*    newRecord = __SHUEBoxApacheManagerConfigRecord(hash, finalConfPath);
+            
+            if ( newRecord )
+              [_configHashes setObject:newRecord forKey:finalConfPath];
+            else
+              [_configHashes removeObjectForKey:finalConfPath];
+            if ( didChange )
+              *didChange = YES;
           }
           // Set owner and group on file:
           if ( ! [[SBFileManager sharedFileManager] setOwnerUId:[self apacheUserId]
@@ -243,6 +402,7 @@ enum {
                                           ];
       
       if ( [[SBFileManager sharedFileManager] fileExistsAtPath:finalConfPath] ) {
+        [_configHashes removeObjectForKey:finalConfPath];
         if ( ! [[SBFileManager sharedFileManager] removeItemAtPath:finalConfPath] ) {
           result = [SBError errorWithDomain:SHUEBoxErrorDomain
                             code:kSHUEBoxApacheManagerConfigFileFailure
@@ -271,24 +431,38 @@ enum {
 
   - (SBError*) hardRestart
   {
-    if ( _delayRestarts ) {
-      _restart = kSHUEBoxApacheManagerCmdRestart;
-      return nil;
-    }
-    _restart = kSHUEBoxApacheManagerCmdNOP;
-    return [self doApachectlCommand:kSHUEBoxApacheManagerCmdRestart];
+    return [self requestRestart:kSHUEBoxApacheManagerCmdRestart];
   }
 
 //
 
   - (SBError*) gracefulRestart
   {
-    if ( _delayRestarts ) {
-      _restart = kSHUEBoxApacheManagerCmdGracefulRestart;
-      return nil;
+    return [self requestRestart:kSHUEBoxApacheManagerCmdGracefulRestart];
+  }
+
+//
+
+  - (BOOL) hasPendingRestart
+  {
+    return ( _restart != kSHUEBoxApacheManagerCmdNOP );
+  }
+  
+//
+
+  - (SBError*) performPendingRestart
+  {
+    int         command = _restart;
+    
+    if ( _restartTimer ) {
+      [_restartTimer invalidate];
+      [_restartTimer release];
+      _restartTimer = nil;
     }
     _restart = kSHUEBoxApacheManagerCmdNOP;
-    return [self doApachectlCommand:kSHUEBoxApacheManagerCmdGracefulRestart];
+    if ( command != kSHUEBoxApacheManagerCmdNOP )
+      return [self doApachectlCommand:command];
+    return nil;
   }
 
 //
@@ -319,18 +493,23 @@ enum {
   - (void) setDelayRestarts:(BOOL)delayRestarts
   {
     if ( ! (_delayRestarts = delayRestarts) ) {
-      switch ( _restart ) {
-        
-        case kSHUEBoxApacheManagerCmdRestart:
-          [self hardRestart];
-          break;
-        
-        case kSHUEBoxApacheManagerCmdGracefulRestart:
-          [self gracefulRestart];
-          break;
-        
-      }
+      if ( _restart != kSHUEBoxApacheManagerCmdNOP )
+        [self requestRestart:_restart];
     }
   }
 
+//
+
+  - (SBUInteger) restartCoalescingWindow { return _restartWindow; }
+  - (void) setRestartCoalescingWindow:(SBUInteger)seconds
+  {
+    _restartWindow = seconds;
+    
+    //
+    // Turning the window off should not strand a restart waiting on a timer:
+    //
+    if ( ! _restartWindow && _restartTimer )
+      [self performPendingRestart];
+  }
+
 @end
@@ -136,69 +136,21 @@ SBObjectCache* __SHUEBoxCollaborationCache = nil;
 
   + (SBArray*) collaborationsWithDatabase:(id)database
   {
-    id                idLookup = [database executeQuery:@"SELECT collabId FROM collaboration.definition"];
-    SBUInteger        rowCount;
-    
-    if ( idLookup && [idLookup queryWasSuccessful] && (rowCount = [idLookup numberOfRows]) ) {
-      SHUEBoxCollaboration*   objects[rowCount];
-      SBUInteger              index = 0;
-      
-      while ( rowCount-- ) {
-        SBNumber*     collabId = [idLookup objectForRow:rowCount fieldNum:0];
-      
-        if ( collabId )
-          objects[index++] = [self collaborationWithDatabase:database collabId:[collabId integerValue]];
-      }
-      if ( index )
-        return [SBArray arrayWithObjects:objects count:index];
-    }
-    return nil;
+    return [self databaseObjectsWithDatabase:database whereClause:nil objectCache:__SHUEBoxCollaborationCache];
   }
 
 //
 
   + (SBArray*) unprovisionedCollaborationsWithDatabase:(id)database
   {
-    id                idLookup = [database executeQuery:@"SELECT collabId FROM collaboration.definition WHERE provisioned IS NULL"];
-    SBUInteger        rowCount;
-    
-    if ( idLookup && [idLookup queryWasSuccessful] && (rowCount = [idLookup numberOfRows]) ) {
-      SHUEBoxCollaboration*   objects[rowCount];
-      SBUInteger              index = 0;
-      
-      while ( rowCount-- ) {
-        SBNumber*     collabId = [idLookup objectForRow:rowCount fieldNum:0];
-      
-        if ( collabId )
-          objects[index++] = [self collaborationWithDatabase:database collabId:[collabId integerValue]];
-      }
-      if ( index )
-        return [SBArray arrayWithObjects:objects count:index];
-    }
-    return nil;
+    return [self databaseObjectsWithDatabase:database whereClause:@"provisioned IS NULL" objectCache:__SHUEBoxCollaborationCache];
   }
 
 //
 
   + (SBArray*) collaborationsForRemovalWithDatabase:(id)database
   {
-    id                idLookup = [database executeQuery:@"SELECT collabId FROM collaboration.definition WHERE removeafter <= now()"];
-    SBUInteger        rowCount;
-    
-    if ( idLookup && [idLookup queryWasSuccessful] && (rowCount = [idLookup numberOfRows]) ) {
-      SHUEBoxCollaboration*   objects[rowCount];
-      SBUInteger              index = 0;
-      
-      while ( rowCount-- ) {
-        SBNumber*     collabId = [idLookup objectForRow:rowCount fieldNum:0];
-      
-        if ( collabId )
-          objects[index++] = [self collaborationWithDatabase:database collabId:[collabId integerValue]];
-      }
-      if ( index )
-        return [SBArray arrayWithObjects:objects count:index];
-    }
-    return nil;
+    return [self databaseObjectsWithDatabase:database whereClause:@"removeafter <= now()" objectCache:__SHUEBoxCollaborationCache];
   }
 
 //
@@ -206,31 +158,15 @@ SBObjectCache* __SHUEBoxCollaborationCache = nil;
   + (SBArray*) collaborationsWithDatabase:(id)database
     forUser:(SHUEBoxUser*)user
   {
-    SBString*         queryStr = [[SBString alloc] initWithFormat:
-                                              "SELECT collabId FROM collaboration.definition"
-                                              "  WHERE collabId IN (SELECT collabId FROM collaboration.member"
+    SBString*         whereClause = [[SBString alloc] initWithFormat:
+                                              "collabId IN (SELECT collabId FROM collaboration.member"
                                               "    WHERE userId = %lld)",
                                               (long long int)[user shueboxUserId]
                                         ];
-    id                idLookup = [database executeQuery:queryStr];
-    SBUInteger        rowCount;
+    SBArray*          collaborations = [self databaseObjectsWithDatabase:database whereClause:whereClause objectCache:__SHUEBoxCollaborationCache];
     
-    [queryStr release];
-    
-    if ( idLookup && [idLookup queryWasSuccessful] && (rowCount = [idLookup numberOfRows]) ) {
-      SHUEBoxCollaboration*   objects[rowCount];
-      SBUInteger              index = 0;
-      
-      while ( rowCount-- ) {
-        SBNumber*     collabId = [idLookup objectForRow:rowCount fieldNum:0];
-      
-        if ( collabId )
-          objects[index++] = [self collaborationWithDatabase:database collabId:[collabId integerValue]];
-      }
-      if ( index )
-        return [SBArray arrayWithObjects:objects count:index];
-    }
-    return nil;
+    [whereClause release];
+    return collaborations;
   }
 
 //
@@ -566,26 +502,26 @@ SBObjectCache* __SHUEBoxCollaborationCache = nil;
     // Build the HTTP configuration:
     error = [self appendApacheHTTPConfToString:config];
     if ( ! error ) {
-      BOOL              needsRestart = NO;
+      BOOL              needsRestart = NO, didChange;
       
-      // Write the file:
-      error = [[SHUEBoxApacheManager shueboxApacheManager] writeConfiguration:config forCollaboration:self isHTTPS:NO];
+      // Write the file (only if its content differs):
+      error = [[SHUEBoxApacheManager shueboxApacheManager] writeConfiguration:config forCollaboration:self isHTTPS:NO didChange:&didChange];
       if ( ! error ) {
-        if ( [config length] > 0 )
+        if ( didChange )
           needsRestart = YES;
         
         // Build the HTTPS configuration:
         [config deleteAllCharacters];
         error = [self appendApacheHTTPSConfToString:config];
         if ( ! error ) {
-          // Write the file:
-          error = [[SHUEBoxApacheManager shueboxApacheManager] writeConfiguration:config forCollaboration:self isHTTPS:YES];
-          if ( ! error && ([config length] > 0) )
+          // Write the file (only if its content differs):
+          error = [[SHUEBoxApacheManager shueboxApacheManager] writeConfiguration:config forCollaboration:self isHTTPS:YES didChange:&didChange];
+          if ( ! error && didChange )
             needsRestart = YES;
         }
       }
       
-      // Do a restart?
+      // Do a restart?  Nothing to do if neither file actually changed:
       if ( ! error && needsRestart )
         error = [[SHUEBoxApacheManager shueboxApacheManager] gracefulRestart];
     }
@@ -18,9 +18,11 @@
 #import "SBDate.h"
 #import "SBValue.h"
 #import "SBDatabaseAccess.h"
+#import "SBPostgres.h"
 #import "SBObjectCache.h"
 #import "SBFileManager.h"
 #import "SBRegularExpression.h"
+#import "SBLock.h"
 
 SBString* SHUEBoxRepositoryIdKey                      = @"reposid";
 SBString* SHUEBoxRepositoryParentCollabIdKey          = @"collabid";
@@ -131,18 +133,24 @@ __SHUEBoxRepositoryRoleMemberComparator(
 																		[SBString stringWithFormat:"SELECT roleId FROM collaboration.repositoryACL WHERE reposId = " SBIntegerFormat " ORDER BY roleId", [self reposId]]
 																	];
 		SBUInteger		i = 0, iMax;
+		int64_t*			roleIds;
 		
     if ( queryResult && [queryResult queryWasSuccessful] && (iMax = [queryResult numberOfRows]) ) {
 			if ( _roles )
 				[_roles release];
 			_roles = [[SBOrderedSet alloc] initWithComparator:__SHUEBoxRepositoryRoleMemberComparator];
       
-      while ( i < iMax ) {
-        SBNumber*     roleId = [queryResult objectForRow:i++ fieldNum:0];
-        SHUEBoxRole*  role = [SHUEBoxRole shueboxRoleWithDatabase:[self parentDatabase] roleId:[roleId integerValue]];
-        
-        if ( role )
-          [_roles addObject:role];
+      // Only the ids are needed, so skip creating an SBNumber for every row:
+      if ( (roleIds = objc_malloc(iMax * sizeof(int64_t))) ) {
+        if ( [queryResult getInt64Values:roleIds nullFlags:NULL forFieldNum:0] ) {
+          while ( i < iMax ) {
+            SHUEBoxRole*  role = [SHUEBoxRole shueboxRoleWithDatabase:[self parentDatabase] roleId:(SHUEBoxRoleId)roleIds[i++]];
+            
+            if ( role )
+              [_roles addObject:role];
+          }
+        }
+        objc_free(roleIds);
       }
       
 			_rolesModified = NO;
@@ -161,74 +169,43 @@ __SHUEBoxRepositoryRoleMemberComparator(
 	- (BOOL) commitRoleMembership
 	{
 		SBUInteger					i, iMax;
-		BOOL								transactionStarted = NO;
 		id									database = [self parentDatabase];
-		SBMutableString*		query = nil;
+		SBMutableArray*			queries = [[SBMutableArray alloc] init];
 		SBInteger           reposId = [self reposId];
-    
-		// Make any additions first:
+		BOOL								rc = YES;
+		
+		// Additions first, then removals -- all sent to the database as one batch:
 		if ( _addRoles && (iMax = [_addRoles count]) ) {
-			if ( ! (transactionStarted = [database beginTransaction]) )
-				return NO;
-			
-			query = [[SBMutableString alloc] init];
-			
 			i = 0;
 			while ( i < iMax ) {
 				SHUEBoxRole*  role = [_addRoles objectAtIndex:i++];
 				
-				if ( role ) {
-          [query deleteAllCharacters];
-					[query appendFormat:"INSERT INTO collaboration.repositoryACL (reposId, roleId) VALUES (" SBIntegerFormat ", %lld)", reposId, (long long)[role shueboxRoleId]];
-					if ( ! [database executeQueryWithBooleanResult:query] )
-						goto badExit;
-				}
+				if ( role )
+					[queries addObject:[SBString stringWithFormat:"INSERT INTO collaboration.repositoryACL (reposId, roleId) VALUES (" SBIntegerFormat ", %lld)", reposId, (long long)[role shueboxRoleId]]];
 			}
 		}
-		
-		// Now for removals:
 		if ( _removeRoles && (iMax = [_removeRoles count]) ) {
-			if ( ! transactionStarted && ! (transactionStarted = [database beginTransaction]) )
-				return NO;
-			
-			if ( ! query )
-				query = [[SBMutableString alloc] init];
-			
 			i = 0;
 			while ( i < iMax ) {
 				SHUEBoxRole*  role = [_removeRoles objectAtIndex:i++];
 				
-				if ( role ) {
-          [query deleteAllCharacters];
-					[query appendFormat:"DELETE FROM collaboration.repositoryACL WHERE reposId = " SBIntegerFormat " AND roleId = %lld", reposId, (long long)[role shueboxRoleId]];
-					if ( ! [database executeQueryWithBooleanResult:query] )
-						goto badExit;
-				}
+				if ( role )
+					[queries addObject:[SBString stringWithFormat:"DELETE FROM collaboration.repositoryACL WHERE reposId = " SBIntegerFormat " AND roleId = %lld", reposId, (long long)[role shueboxRoleId]]];
 			}
 		}
 		
-		if ( query ) [query release];
-		
-		// Did we start a transaction?
-		if ( transactionStarted ) {
-			if ( [database commitLastTransaction] ) {
+		if ( [queries count] ) {
+			if ( (rc = [database executeQueriesWithBooleanResult:queries]) ) {
 				if ( _addRoles )
 					[_addRoles removeAllObjects];
 				if ( _removeRoles )
 					[_removeRoles removeAllObjects];
 				_rolesModified = NO;
-			} else {
-				return NO;
 			}
 		}
-			
-		return YES;
-
-badExit:
-		if ( query ) [query release];
-		if ( transactionStarted )
-			[database discardLastTransaction];
-		return NO;
+		[queries release];
+		
+		return rc;
 	}
 
 @end
@@ -290,71 +267,70 @@ SBObjectCache*  __SHUEBoxRepositoryCache = nil;
 
 //
 
-  + (SBArray*) repositoriesWithDatabase:(id)database
+  + (Class) classForDatabase:(id)database
+    properties:(SBDictionary*)properties
   {
-    id                idLookup = [database executeQuery:@"SELECT reposId FROM collaboration.repository"];
-    SBUInteger        rowCount;
+    static SBDictionary*  __SHUEBoxRepositoryClassMappings = nil;
+    SBNumber*             repoTypeId = [properties objectForKey:SHUEBoxRepositoryTypeKey];
+    SBString*             className = nil;
+    SBDictionary*         newMappings;
+    Class                 repoClass = Nil;
     
-    if ( idLookup && [idLookup queryWasSuccessful] && (rowCount = [idLookup numberOfRows]) ) {
-      SHUEBoxRepository*      objects[rowCount];
-      SBUInteger              index = 0;
-      
-      while ( rowCount-- ) {
-        SBNumber*     reposId = [idLookup objectForRow:rowCount fieldNum:0];
+    if ( ! repoTypeId )
+      return Nil;
+    
+    //
+    // The mapping is fetched once rather than once per repository, and fetched again
+    // whenever a type turns up that it doesn't know -- a long-running process has to
+    // notice repository types added to the database after it started.  The swap
+    // happens under the global lock, and the class name is retained while in use
+    // since another thread could replace the dictionary holding it:
+    //
+    [SBGlobalLock lock];
+    if ( __SHUEBoxRepositoryClassMappings )
+      className = [[__SHUEBoxRepositoryClassMappings objectForKey:repoTypeId] retain];
+    [SBGlobalLock unlock];
+    
+    if ( ! className && (newMappings = [SHUEBoxRepository classMappingsFromDatabase:database]) ) {
+      [SBGlobalLock lock];
+      [newMappings retain];
+      if ( __SHUEBoxRepositoryClassMappings )
+        [__SHUEBoxRepositoryClassMappings release];
+      __SHUEBoxRepositoryClassMappings = newMappings;
+      className = [[newMappings objectForKey:repoTypeId] retain];
+      [SBGlobalLock unlock];
+    }
+    
+    if ( className ) {
+      SBSTRING_AS_UTF8_BEGIN(className)
       
-        if ( reposId )
-          objects[index++] = [self repositoryWithDatabase:database reposId:[reposId intValue]];
-      }
-      if ( index )
-        return [SBArray arrayWithObjects:objects count:index];
+        repoClass = objc_get_class( className_utf8 );
+        
+      SBSTRING_AS_UTF8_END
+      [className release];
     }
-    return nil;
+    return repoClass;
+  }
+
+//
+
+  + (SBArray*) repositoriesWithDatabase:(id)database
+  {
+    return [self databaseObjectsWithDatabase:database whereClause:nil objectCache:__SHUEBoxRepositoryCache];
   }
   
 //
 
   + (SBArray*) unprovisionedRepositoriesWithDatabase:(id)database
   {
-    id                idLookup = [database executeQuery:@"SELECT reposId FROM collaboration.repository WHERE provisioned IS NULL"];
-    SBUInteger        rowCount;
-    
-    if ( idLookup && [idLookup queryWasSuccessful] && (rowCount = [idLookup numberOfRows]) ) {
-      SHUEBoxRepository*      objects[rowCount];
-      SBUInteger              index = 0;
-      
-      while ( rowCount-- ) {
-        SBNumber*     reposId = [idLookup objectForRow:rowCount fieldNum:0];
-      
-        if ( reposId )
-          objects[index++] = [self repositoryWithDatabase:database reposId:[reposId integerValue]];
-      }
-      if ( index )
-        return [SBArray arrayWithObjects:objects count:index];
-    }
-    return nil;
+    return [self databaseObjectsWithDatabase:database whereClause:@"provisioned IS NULL" objectCache:__SHUEBoxRepositoryCache];
   }
 
 //
 
   + (SBArray*) repositoriesForRemovalWithDatabase:(id)database
   {
-    id                idLookup = [database executeQuery:@"SELECT reposId FROM collaboration.repository WHERE removeafter <= now() AND canBeRemoved = true"];
-    SBUInteger        rowCount;
-    
-    if ( idLookup && [idLookup queryWasSuccessful] && (rowCount = [idLookup numberOfRows]) ) {
-      SHUEBoxRepository*      objects[rowCount];
-      SBUInteger              index = 0;
-      
-      while ( rowCount-- ) {
-        SBNumber*     reposId = [idLookup objectForRow:rowCount fieldNum:0];
-      
-        if ( reposId )
-          objects[index++] = [self repositoryWithDatabase:database reposId:[reposId integerValue]];
-      }
-      if ( index )
-        return [SBArray arrayWithObjects:objects count:index];
-    }
-    return nil;
+    return [self databaseObjectsWithDatabase:database whereClause:@"removeafter <= now() AND canBeRemoved = true" objectCache:__SHUEBoxRepositoryCache];
   }
 
 //
@@ -365,29 +341,10 @@ SBObjectCache*  __SHUEBoxRepositoryCache = nil;
     // The query sorts results by descending creation date; this ensures that the "web" repository only appears at the tail end of the configuration
     // files.  This is the simplest way to enforce that...
     //
-    id                database = [aCollaboration parentDatabase];
-    SBString*         queryString = [[SBString alloc] initWithFormat:"SELECT reposId FROM collaboration.repository WHERE collabid = " SBIntegerFormat " ORDER BY created DESC", [aCollaboration collabId]];
-    
-    if ( queryString ) {
-      id                idLookup = [database executeQuery:queryString];
-      SBUInteger        rowCount;
-      
-      [queryString release];
-      if ( idLookup && [idLookup queryWasSuccessful] && (rowCount = [idLookup numberOfRows]) ) {
-        SHUEBoxRepository*      objects[rowCount];
-        SBUInteger              index = 0;
-        
-        while ( rowCount-- ) {
-          SBNumber*     reposId = [idLookup objectForRow:rowCount fieldNum:0];
-        
-          if ( reposId )
-            objects[index++] = [self repositoryWithDatabase:database reposId:[reposId integerValue]];
-        }
-        if ( index )
-          return [SBArray arrayWithObjects:objects count:index];
-      }
-    }
-    return nil;
+    return [self databaseObjectsWithDatabase:[aCollaboration parentDatabase]
+                    whereClause:[SBString stringWithFormat:"collabid = " SBIntegerFormat " ORDER BY created DESC", [aCollaboration collabId]]
+                    objectCache:__SHUEBoxRepositoryCache
+                  ];
   }
   
 //
@@ -1004,7 +961,7 @@ SBObjectCache*  __SHUEBoxRepositoryCache = nil;
 
 //
 
-	- (void) refreshCommittedProperties
+	- (void) didReplaceCommittedProperties
 	{
 		if ( _roles ) {
 			[_roles release];
@@ -1018,6 +975,13 @@ SBObjectCache*  __SHUEBoxRepositoryCache = nil;
 			[_removeRoles release];
 			_removeRoles = nil;
 		}
+	}
+	
+//
+
+	- (void) refreshCommittedProperties
+	{
+		[self didReplaceCommittedProperties];
 		[super refreshCommittedProperties];
 	}
 	
@@ -19,6 +19,7 @@
 #import "SBValue.h"
 #import "SBDictionary.h"
 #import "SBDatabaseAccess.h"
+#import "SBPostgres.h"
 #import "SBObjectCache.h"
 #import "SBNotification.h"
 
@@ -35,6 +36,11 @@ SBString* SHUEBoxRoleWasRemovedNotification   = @"SHUEBoxRoleWasRemovedNotificat
 
 SBObjectCache* __SHUEBoxRoleCache = nil;
 
+//
+// At least this many new members are loaded with COPY rather than individual INSERTs:
+//
+#define SHUEBoxRoleCopyMembersThreshold   64
+
 //
 
 SBComparisonResult
@@ -74,19 +80,25 @@ __SHUEBoxRoleMemberComparator(
 																		[SBString stringWithFormat:"SELECT userId FROM collaboration.roleMember WHERE roleId = %lld ORDER BY userId", [self shueboxRoleId]]
 																	];
 		SBUInteger		i = 0, iMax;
+		int64_t*			userIds;
 		
     if ( queryResult && [queryResult queryWasSuccessful] && (iMax = [queryResult numberOfRows]) ) {
 			if ( _membership )
 				[_membership release];
 			_membership = [[SBOrderedSet alloc] initWithComparator:__SHUEBoxRoleMemberComparator];
       
-      while ( i < iMax ) {
-        SBNumber*     userId = [queryResult objectForRow:i++ fieldNum:0];
-        SHUEBoxUser*  user = [SHUEBoxUser shueboxUserWithDatabase:[self parentDatabase] userId:[userId int64Value]];
-        
-        if ( user ) {
-          [_membership addObject:user];
+      // Only the ids are needed, so skip creating an SBNumber for every row:
+      if ( (userIds = objc_malloc(iMax * sizeof(int64_t))) ) {
+        if ( [queryResult getInt64Values:userIds nullFlags:NULL forFieldNum:0] ) {
+          while ( i < iMax ) {
+            SHUEBoxUser*  user = [SHUEBoxUser shueboxUserWithDatabase:[self parentDatabase] userId:userIds[i++]];
+            
+            if ( user ) {
+              [_membership addObject:user];
+            }
+          }
         }
+        objc_free(userIds);
       }
 			_membershipModified = NO;
 		}
@@ -104,74 +116,85 @@ __SHUEBoxRoleMemberComparator(
 	- (BOOL) commitMembership
 	{
 		SBUInteger					i, iMax;
-		BOOL								transactionStarted = NO;
 		id									database = [self parentDatabase];
-		SBMutableString*		query = nil;
+		SBMutableArray*			queries = [[SBMutableArray alloc] init];
 		SHUEBoxRoleId				roleId = [self shueboxRoleId];
+		BOOL								rc = YES;
+		BOOL								inTransaction = NO;
 		
-		// Make any additions first:
-		if ( _add && (iMax = [_add count]) ) {
-			if ( ! (transactionStarted = [database beginTransaction]) )
-				return NO;
-			
-			query = [[SBMutableString alloc] init];
+		// Bulk additions go in via COPY, inside a transaction with the removals:
+		if ( _add && ((iMax = [_add count]) >= SHUEBoxRoleCopyMembersThreshold) && [database isKindOf:[SBPostgresDatabase class]] ) {
+			SBPostgresCopyIn*		copyIn;
 			
+			if ( ! [database beginTransaction] ) {
+				[queries release];
+				return NO;
+			}
+			inTransaction = YES;
+			if ( (copyIn = [database beginCopyInWithCommand:@"COPY collaboration.roleMember (roleId, userId) FROM STDIN"]) ) {
+				char							row[48];
+				
+				i = 0;
+				while ( rc && (i < iMax) ) {
+					SHUEBoxUser*    user = [_add objectAtIndex:i++];
+					
+					if ( user ) {
+						int						rowLen = snprintf(row, sizeof(row), "%lld\t%lld\n", (long long)roleId, (long long)[user shueboxUserId]);
+						
+						rc = [copyIn appendBytes:row length:rowLen];
+					}
+				}
+				if ( rc )
+					rc = ( [copyIn finish] >= 0 );
+				else
+					[copyIn abortWithMessage:nil];
+			} else {
+				rc = NO;
+			}
+			if ( ! rc ) {
+				[database discardLastTransaction];
+				[queries release];
+				return NO;
+			}
+		}
+		// Otherwise additions first, then removals -- all sent to the database as one batch:
+		else if ( _add && (iMax = [_add count]) ) {
 			i = 0;
 			while ( i < iMax ) {
 				SHUEBoxUser*    user = [_add objectAtIndex:i++];
 				
-				if ( user ) {
-          [query deleteAllCharacters];
-					[query appendFormat:"INSERT INTO collaboration.roleMember (roleId, userId) VALUES (%lld, %lld)", (long long)roleId, (long long)[user shueboxUserId]];
-					if ( ! [database executeQueryWithBooleanResult:query] )
-						goto badExit;
-				}
+				if ( user )
+					[queries addObject:[SBString stringWithFormat:"INSERT INTO collaboration.roleMember (roleId, userId) VALUES (%lld, %lld)", (long long)roleId, (long long)[user shueboxUserId]]];
 			}
 		}
-		
-		// Now for removals:
 		if ( _remove && (iMax = [_remove count]) ) {
-			if ( ! transactionStarted && ! (transactionStarted = [database beginTransaction]) )
-				return NO;
-			
-			if ( ! query )
-				query = [[SBMutableString alloc] init];
-			
 			i = 0;
 			while ( i < iMax ) {
 				SHUEBoxUser*    user = [_remove objectAtIndex:i++];
 				
-				if ( user ) {
-          [query deleteAllCharacters];
-					[query appendFormat:"DELETE FROM collaboration.roleMember WHERE roleId = %lld AND userId = %lld", (long long)roleId, (long long)[user shueboxUserId]];
-					if ( ! [database executeQueryWithBooleanResult:query] )
-						goto badExit;
-				}
+				if ( user )
+					[queries addObject:[SBString stringWithFormat:"DELETE FROM collaboration.roleMember WHERE roleId = %lld AND userId = %lld", (long long)roleId, (long long)[user shueboxUserId]]];
 			}
 		}
 		
-		if ( query ) [query release];
-		
-		// Did we start a transaction?
-		if ( transactionStarted ) {
-			if ( [database commitLastTransaction] ) {
-				if ( _add )
-          [_add removeAllObjects];
-				if ( _remove )
-					[_remove removeAllObjects];
-				_membershipModified = NO;
-			} else {
-				return NO;
-			}
+		if ( [queries count] )
+			rc = [database executeQueriesWithBooleanResult:queries];
+		if ( inTransaction ) {
+			if ( rc )
+				rc = [database commitLastTransaction];
+			else
+				[database discardLastTransaction];
 		}
-			
-		return YES;
-
-badExit:
-		if ( query ) [query release];
-		if ( transactionStarted )
-			[database discardLastTransaction];
-		return NO;
+		if ( rc && (inTransaction || [queries count]) ) {
+			if ( _add )
+				[_add removeAllObjects];
+			if ( _remove )
+				[_remove removeAllObjects];
+			_membershipModified = NO;
+		}
+		[queries release];
+		
+		return rc;
 	}
 
 @end
@@ -303,24 +326,10 @@ badExit:
 
 	+ (SBArray*) shueboxRolesForCollaboration:(SHUEBoxCollaboration*)collaboration
 	{
-		id								database = [collaboration parentDatabase];
-    id                idLookup = [database executeQuery:[SBString stringWithFormat:"SELECT roleId FROM collaboration.role WHERE collabId = " SBIntegerFormat, [collaboration collabId]]];
-    SBUInteger        rowCount;
-    
-    if ( idLookup && [idLookup queryWasSuccessful] && (rowCount = [idLookup numberOfRows]) ) {
-      SHUEBoxRole*    objects[rowCount];
-      SBUInteger      index = 0;
-      
-      while ( rowCount-- ) {
-        SBNumber*     roleId = [idLookup objectForRow:rowCount fieldNum:0];
-      
-        if ( roleId )
-          objects[index++] = [self shueboxRoleWithDatabase:database roleId:[roleId integerValue]];
-      }
-      if ( index )
-        return [SBArray arrayWithObjects:objects count:index];
-    }
-    return nil;
+    return [self databaseObjectsWithDatabase:[collaboration parentDatabase]
+                    whereClause:[SBString stringWithFormat:"collabId = " SBIntegerFormat, [collaboration collabId]]
+                    objectCache:__SHUEBoxRoleCache
+                  ];
 	}
 
 //
@@ -685,7 +694,7 @@ badExit:
 
 //
 
-	- (void) refreshCommittedProperties
+	- (void) didReplaceCommittedProperties
 	{
 		if ( _membership ) {
 			[_membership release];
@@ -697,6 +706,13 @@ badExit:
 		if ( _remove ) {
 			[_remove removeAllObjects];
 		}
+	}
+	
+//
+
+	- (void) refreshCommittedProperties
+	{
+		[self didReplaceCommittedProperties];
 		[super refreshCommittedProperties];
 	}
 	
@@ -793,92 +793,51 @@ __SHUEBoxUserScanHexDigit(
     return SHUEBoxUserKeys;
   }
 
+//
+
+  - (BOOL) didLoadPropertiesFromDatabase
+  {
+    //
+    // Instances created by the bulk loaders need their delegate just like those
+    // created by shueboxUserWithDatabase:userId:
+    //
+    return [self setupDelegate];
+  }
+
+//
+
+  - (void) didReplaceCommittedProperties
+  {
+    //
+    // A cache hit in the bulk loaders replaced the users.base row, but a guest's
+    // password, confirmation code and welcome message state live in users.guest:
+    //
+    if ( [self isGuestUser] && _delegate )
+      [_delegate refreshCommittedProperties];
+  }
+
 //
 
   + (SBArray*) shueboxUsersForRemovalWithDatabase:(id)database
   {
-    id                idLookup = [database executeQuery:@"SELECT userId FROM users.base WHERE canBeRemoved AND now() > removeAfter"];
-    SBUInteger        rowCount;
-    SBArray*          userList = nil;
-    
-    if ( idLookup && [idLookup queryWasSuccessful] && (rowCount = [idLookup numberOfRows]) ) {
-      SHUEBoxUser*    objects[rowCount];
-      SBUInteger      index = 0;
-      
-      while ( rowCount-- ) {
-        SBNumber*     userId = [idLookup objectForRow:rowCount fieldNum:0];
-      
-        if ( userId ) {
-          SHUEBoxUser*  newUser = [self shueboxUserWithDatabase:database userId:[userId integerValue]];
-          
-          if ( newUser ) objects[index++] = [newUser retain];
-        }
-      }
-      if ( index ) {
-        userList = [SBArray arrayWithObjects:objects count:index];
-        while ( index-- > 0 ) [objects[index] release];
-      }
-    }
-    return userList;
+    return [self databaseObjectsWithDatabase:database whereClause:@"canBeRemoved AND now() > removeAfter" objectCache:__SHUEBoxUserCache];
   }
 
 //
 
   + (SBArray*) shueboxUsersNeedingWelcomeMessageWithDatabase:(id)database
   {
-    id                idLookup = [database executeQuery:@"SELECT userId FROM users.guest WHERE welcomeMsgSent IS NULL"];
-    SBUInteger        rowCount;
-    SBArray*          userList = nil;
-    
-    if ( idLookup && [idLookup queryWasSuccessful] && (rowCount = [idLookup numberOfRows]) ) {
-      SHUEBoxUser*    objects[rowCount];
-      SBUInteger      index = 0;
-      
-      while ( rowCount-- ) {
-        SBNumber*     userId = [idLookup objectForRow:rowCount fieldNum:0];
-      
-        if ( userId ) {
-          SHUEBoxUser*  newUser = [self shueboxUserWithDatabase:database userId:[userId integerValue]];
-          
-          if ( newUser ) objects[index++] = [newUser retain];
-        }
-      }
-      if ( index ) {
-        userList = [SBArray arrayWithObjects:objects count:index];
-        while ( index-- > 0 ) [objects[index] release];
-      }
-    }
-    return userList;
+    return [self databaseObjectsWithDatabase:database whereClause:@"userId IN (SELECT userId FROM users.guest WHERE welcomeMsgSent IS NULL)" objectCache:__SHUEBoxUserCache];
   }
 
 //
 
   + (SBArray*) shueboxUsersForCollaboration:(SHUEBoxCollaboration*)collaboration
   {
-		id								database = [collaboration parentDatabase];
-    id                idLookup = [database executeQuery:[SBString stringWithFormat:"SELECT userId FROM collaboration.member WHERE collabId = " SBIntegerFormat, [collaboration collabId]]];
-    SBUInteger        rowCount;
-    SBArray*          userList = nil;
-    
-    if ( idLookup && [idLookup queryWasSuccessful] && (rowCount = [idLookup numberOfRows]) ) {
-      SHUEBoxUser*    objects[rowCount];
-      SBUInteger      index = 0;
-      
-      while ( rowCount-- ) {
-        SBNumber*     userId = [idLookup objectForRow:rowCount fieldNum:0];
-      
-        if ( userId ) {
-          SHUEBoxUser*  newUser = [self shueboxUserWithDatabase:database userId:[userId integerValue]];
-          
-          if ( newUser ) objects[index++] = [newUser retain];
-        }
-      }
-      if ( index ) {
-        userList = [SBArray arrayWithObjects:objects count:index];
-        while ( index-- > 0 ) [objects[index] release];
-      }
-    }
-    return userList;
+    return [self databaseObjectsWithDatabase:[collaboration parentDatabase]
+                    whereClause:[SBString stringWithFormat:"userId IN (SELECT userId FROM collaboration.member WHERE collabId = " SBIntegerFormat ")", [collaboration collabId]]
+                    objectCache:__SHUEBoxUserCache
+                  ];
   }
 
 //
@@ -1126,8 +1085,7 @@ __SHUEBoxUserScanHexDigit(
 
 	- (void) refreshCommittedProperties
 	{
-		if ( [self isGuestUser] && _delegate )
-			[_delegate refreshCommittedProperties];
+		[self didReplaceCommittedProperties];
 		[super refreshCommittedProperties];
 	}
 	
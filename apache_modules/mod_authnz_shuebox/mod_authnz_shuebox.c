@@ -24,6 +24,11 @@
 #include "apr_xlate.h"
 #include "apu_version.h"
 #include "apr_ldap.h"
+#include "apr_shm.h"
+#include "apr_global_mutex.h"
+#include "apr_atomic.h"
+#include "apr_thread_proc.h"
+#include "libpq-fe.h"
 
 #define APR_WANT_STRFUNC
 #include "apr_want.h"
@@ -34,6 +39,12 @@
 #include <unistd.h>
 #endif
 #include <ctype.h>
+#include <errno.h>
+#include <poll.h>
+
+#ifdef AP_NEED_SET_MUTEX_PERMS
+#include "unixd.h"
+#endif
 
 #if 0
 #define AUTHNZ_SHUEBOX_DEBUG
@@ -48,17 +59,46 @@ static const char*      udEmplidLDAPAttribute = "udEmplid";
 
 #ifndef SBAUTHNZ_CACHE_SIZE
 /*
-  The initial size for our authentication caches.  Default value is 50.
+  The number of cache lines in the shared authentication cache.  The cache
+  never grows beyond this; once a set is full, the CLOCK hand chooses a line
+  to evict.  Default value is 1024.
+*/
+#define SBAUTHNZ_CACHE_SIZE 1024
+#endif
+
+#ifndef SBAUTHZ_CACHE_SIZE
+/*
+  The number of cache lines in the shared authorization decision cache.  Each
+  line holds the outcome for one (subtype, collaboration, repository, user)
+  tuple.  Default value is 4096.
+*/
+#define SBAUTHZ_CACHE_SIZE 4096
+#endif
+
+#ifndef SBAUTHNZ_CACHE_WAYS
+/*
+  The number of cache lines per set.  A lookup or update never examines more
+  than this many lines.  Default value is 8.
+*/
+#define SBAUTHNZ_CACHE_WAYS 8
+#endif
+
+#ifndef SBAUTHNZ_CACHE_STRIPES
+/*
+  The number of global mutexes guarding the cache sets; set i is guarded by
+  stripe (i % SBAUTHNZ_CACHE_STRIPES).  Default value is 16.
 */
-#define SBAUTHNZ_CACHE_SIZE 50
+#define SBAUTHNZ_CACHE_STRIPES 16
 #endif
 
-#ifndef SBAUTHNZ_CACHE_CLEANUP
+#ifndef SBAUTHNZ_CACHE_KEY_MAX
 /*
-  The number of cache lookup/update operations that are allowed to happen
-  before we purge expired lines from the cache.  Default value is 80.
+  The longest key (including the NUL terminator) that will be cached.  For
+  the authentication cache the key is the username; for the authorization
+  cache it is the subtype, collaboration id, repository id and username.
+  Longer keys are simply never cached.  Default value is 160.
 */
-#define SBAUTHNZ_CACHE_CLEANUP 80
+#define SBAUTHNZ_CACHE_KEY_MAX 160
 #endif
 
 #ifndef SBAUTHNZ_CACHE_TTL
@@ -69,83 +109,276 @@ static const char*      udEmplidLDAPAttribute = "udEmplid";
 #define SBAUTHNZ_CACHE_TTL 300 * 1000 * 1000
 #endif
 
+#ifndef SBAUTHZ_CACHE_TTL
+/*
+  The default number of seconds that an authorization decision remains valid
+  (see AuthSHUEBoxAuthzCacheTTL).  Default value is 60.
+*/
+#define SBAUTHZ_CACHE_TTL 60
+#endif
+
+/*!
+  @typedef SBAuthnzCacheLine
+  
+  A single cached item.  A line with an expires value of zero is unused.
+  
+  The digest field holds an MD5 digest of a per-server random salt, the key,
+  and a caller-provided secret (the password, for authentication) so that
+  secrets are never stored in the clear.  The value field holds whatever the
+  caller wishes to associate with the key (the decision, for authorization).
+  
+  The referenced flag is the CLOCK "second chance" bit:  set on every hit,
+  cleared as the hand sweeps past.  The generation is that of the cache at the
+  time the line was written; see SBAuthnzCacheInvalidate.
+*/
+typedef struct {
+  apr_uint32_t        hash;
+  apr_uint32_t        referenced;
+  apr_uint32_t        generation;
+  apr_int32_t         value;
+  apr_time_t          expires;
+  unsigned char       digest[APR_MD5_DIGESTSIZE];
+  char                key[SBAUTHNZ_CACHE_KEY_MAX];
+} SBAuthnzCacheLine;
+
+/*!
+  @typedef SBAuthnzCacheSet
+  
+  A fixed group of cache lines that a key hashes to, plus the position of
+  the CLOCK hand within the group.
+*/
+typedef struct {
+  apr_uint32_t        hand;
+  SBAuthnzCacheLine   lines[SBAUTHNZ_CACHE_WAYS];
+} SBAuthnzCacheSet;
+
+/*!
+  @typedef SBAuthnzCacheHeader
+  
+  Leads the shared memory segment, ahead of the sets.
+*/
+typedef struct {
+  volatile apr_uint32_t generation;
+  apr_uint32_t          reserved;
+} SBAuthnzCacheHeader;
+
 /*!
   @typedef SBAuthnzCache
   
-  Authentication caching makes use of one of these structures.  The mutex is added
-  only if APR is threaded -- otherwise, it's not necessary since Apache will be
-  running serially.  Cache lines are stored by means of an APR table which starts
-  at a particular size and will grow if exceeded (that's how an APR table behaves).
-  The 'cleanup' dictates how often a call to cache lookup/update will trigger a
-  purge.
-  
-  The purge interval should be around twice the initial cache size.  Considering that
-  the general operation here is to lookup and then update if nothing was found, on
-  average we should see far more lookups based on Apache's need to keep
-  reauthenticating a user each time a new request is handled.  The cache is NOT
-  updated coincident with such lookups when they yield a cache hit, so the
-  percentage of lookups leading to a new line's being added to the cache will
-  be fairly small.  Worst case scenario, however, we'll have N distinct users hitting
-  us in sequence and triggering a lookup+update; if we keep the cleanup interval close
-  to the expected number of events that would fill the cache, we should more likely
-  purge some old lines before adding all those new ones.
-  
-  The other route to go would be to put an upper bound on the cache size and once
-  we reach that, purge old + oldest lines.  That's more difficult to implmenent,
-  though, and for now I think this should suffice.
+  Authentication and authorization caching make use of these structures.  The
+  cache lines live in a shared memory segment created by the parent httpd in the
+  post-config phase, so an item cached by any child is a cache hit in every other
+  child.
+  
+  The segment is organized as a set-associative table:  a key hashes to exactly
+  one SBAuthnzCacheSet, and only the SBAUTHNZ_CACHE_WAYS lines of that set are
+  ever examined, so lookup and update are O(1).  Each set is guarded by one of
+  SBAUTHNZ_CACHE_STRIPES global mutexes, so children working on different keys
+  rarely contend for the same lock.
+  
+  Lines expire lazily:  a lookup that finds a stale line frees it, and an update
+  reuses free or stale lines before resorting to CLOCK eviction.  There is no
+  periodic walk of the whole cache.
 */
 typedef struct {
-#ifdef APR_HAS_THREADS
-  apr_thread_mutex_t* lock;
-#endif
-  int                 cleanup;
-  apr_table_t*        lines;
+  apr_shm_t*            shm;
+  apr_global_mutex_t*   locks[SBAUTHNZ_CACHE_STRIPES];
+  apr_interval_time_t   ttl;
+  unsigned int          setCount;
+  SBAuthnzCacheHeader*  header;
+  SBAuthnzCacheSet*     sets;
+  unsigned char         salt[16];
 } SBAuthnzCache;
 
 static SBAuthnzCache SBAuthnzCacheDefault;
+static SBAuthnzCache SBAuthzCacheDefault;
+
+/*!
+  @function __SBAuthnzCacheHash
+  
+  FNV-1a hash of a key.
+*/
+static apr_uint32_t
+__SBAuthnzCacheHash(
+  const char*           key,
+  size_t*               keyLen
+)
+{
+  const char*           s = key;
+  apr_uint32_t          hash = 2166136261U;
+  
+  while ( *s ) {
+    hash ^= (unsigned char)*s++;
+    hash *= 16777619U;
+  }
+  *keyLen = s - key;
+  return hash;
+}
+
+/*!
+  @function __SBAuthnzCacheDigest
+  
+  Fill-in digest with the salted MD5 digest of the given key and secret.
+*/
+static void
+__SBAuthnzCacheDigest(
+  SBAuthnzCache*        aCache,
+  const char*           key,
+  size_t                keyLen,
+  const char*           secret,
+  size_t                secretLen,
+  unsigned char*        digest
+)
+{
+  apr_md5_ctx_t         context;
+  
+  apr_md5_init(&context);
+  apr_md5_update(&context, aCache->salt, sizeof(aCache->salt));
+  apr_md5_update(&context, key, keyLen + 1);
+  apr_md5_update(&context, secret, secretLen);
+  apr_md5_final(digest, &context);
+}
+
+/*!
+  @function __SBAuthnzCacheCleanup
+  
+  Pool cleanup for the cache; once the parent's configuration pool goes away
+  the shared segment and mutexes are gone, too.
+*/
+static apr_status_t
+__SBAuthnzCacheCleanup(
+  void*                 cache
+)
+{
+  SBAuthnzCache*        aCache = (SBAuthnzCache*)cache;
+  
+  aCache->header = NULL;
+  aCache->sets = NULL;
+  aCache->setCount = 0;
+  aCache->shm = NULL;
+  memset(aCache->locks, 0, sizeof(aCache->locks));
+  return APR_SUCCESS;
+}
 
 /*!
   @function SBAuthnzCacheInit
   
-  Initialize a cache data structure.  Make sure the pool being passed to this
-  function is survivable through the life of the module -- since we're doing the
-  cache init with the same pool used to allocate our module data, I think we're
-  safe enough.
+  Initialize a cache data structure with room for (at least) lineCount items
+  that each remain valid for ttl microseconds.  Must be called from the parent
+  httpd in the post-config phase so that the shared memory segment and mutexes
+  are inherited by every child.  The pool should be the configuration pool;
+  when it is cleared (restart) the segment is destroyed and recreated by the
+  next post-config pass.  The shmName is only used on platforms lacking
+  anonymous shared memory.
+  
+  If the shared resources cannot be created, the cache is left disabled:
+  lookups always miss and updates do nothing.
 */
 static apr_status_t
 SBAuthnzCacheInit(
   SBAuthnzCache*        aCache,
+  unsigned int          lineCount,
+  apr_interval_time_t   ttl,
+  const char*           shmName,
   apr_pool_t*           pool,
-  const char*           directory
+  server_rec*           s
 )
 {
+  apr_status_t          rv;
+  unsigned int          setCount = (lineCount + SBAUTHNZ_CACHE_WAYS - 1) / SBAUTHNZ_CACHE_WAYS;
+  apr_size_t            size = sizeof(SBAuthnzCacheHeader) + setCount * sizeof(SBAuthnzCacheSet);
+  int                   i;
+  
   memset(aCache,0,sizeof(SBAuthnzCache));
-#ifdef APR_HAS_THREADS
-  if ( apr_thread_mutex_create(&aCache->lock, APR_THREAD_MUTEX_DEFAULT, pool) != OK ) {
-    ap_log_perror(
+  
+  rv = apr_shm_create(&aCache->shm, size, NULL, pool);
+  if ( rv == APR_ENOTIMPL ) {
+    /* No anonymous shared memory, fall back to a name-based segment: */
+    const char*         shmFile = ap_server_root_relative(pool, shmName);
+    
+    apr_shm_remove(shmFile, pool);
+    rv = apr_shm_create(&aCache->shm, size, shmFile, pool);
+  }
+  if ( rv != APR_SUCCESS ) {
+    ap_log_error(
         APLOG_MARK,
-        APLOG_INFO,
-        0,
-        pool,
-        "[authnz_shuebox] unable to allocate cache lock at %s",
-        directory
+        APLOG_ERR,
+        rv,
+        s,
+        "[authnz_shuebox] unable to allocate %lu bytes of shared memory for %s",
+        (unsigned long)size,
+        shmName
       );
-    return HTTP_INTERNAL_SERVER_ERROR;
+    aCache->shm = NULL;
+    return rv;
   }
+  for ( i = 0; i < SBAUTHNZ_CACHE_STRIPES; i++ ) {
+    rv = apr_global_mutex_create(&aCache->locks[i], NULL, APR_LOCK_DEFAULT, pool);
+    if ( rv != APR_SUCCESS ) {
+      ap_log_error(
+          APLOG_MARK,
+          APLOG_ERR,
+          rv,
+          s,
+          "[authnz_shuebox] unable to allocate lock %d for %s",
+          i,
+          shmName
+        );
+      apr_shm_destroy(aCache->shm);
+      memset(aCache,0,sizeof(SBAuthnzCache));
+      return rv;
+    }
+#ifdef AP_NEED_SET_MUTEX_PERMS
+    unixd_set_global_mutex_perms(aCache->locks[i]);
 #endif
-  if ( (aCache->lines = apr_table_make(pool,SBAUTHNZ_CACHE_SIZE)) == NULL ) {
-    ap_log_perror(
-        APLOG_MARK,
-        APLOG_INFO,
-        0,
-        pool,
-        "[authnz_shuebox] unable to allocate cache table at %s",
-        directory
-      );
-    return HTTP_INTERNAL_SERVER_ERROR;
   }
-  aCache->cleanup = SBAUTHNZ_CACHE_CLEANUP;
-  return OK;
+  apr_generate_random_bytes(aCache->salt, sizeof(aCache->salt));
+  
+  aCache->ttl = ttl;
+  aCache->header = (SBAuthnzCacheHeader*)apr_shm_baseaddr_get(aCache->shm);
+  aCache->sets = (SBAuthnzCacheSet*)(aCache->header + 1);
+  aCache->setCount = setCount;
+  memset(aCache->header, 0, size);
+  
+  apr_pool_cleanup_register(pool, aCache, __SBAuthnzCacheCleanup, apr_pool_cleanup_null);
+  return APR_SUCCESS;
+}
+
+/*!
+  @function SBAuthnzCacheChildInit
+  
+  Reattach each of the cache's global mutexes in a newly-started child.
+*/
+static void
+SBAuthnzCacheChildInit(
+  SBAuthnzCache*        aCache,
+  apr_pool_t*           pool,
+  server_rec*           s
+)
+{
+  int                   i;
+  
+  if ( ! aCache->sets )
+    return;
+  for ( i = 0; i < SBAUTHNZ_CACHE_STRIPES; i++ ) {
+    apr_status_t        rv = apr_global_mutex_child_init(&aCache->locks[i], NULL, pool);
+    
+    if ( rv != APR_SUCCESS ) {
+      ap_log_error(
+          APLOG_MARK,
+          APLOG_ERR,
+          rv,
+          s,
+          "[authnz_shuebox] unable to attach cache lock %d in child %" APR_PID_T_FMT,
+          i,
+          getpid()
+        );
+      /* Disable the cache in this child only: */
+      aCache->sets = NULL;
+      aCache->setCount = 0;
+      return;
+    }
+  }
 }
 
 /*!
@@ -158,270 +391,309 @@ SBAuthnzCacheReset(
   SBAuthnzCache*        aCache
 )
 {
-#ifdef APR_HAS_THREADS
-  apr_thread_mutex_lock(aCache->lock);
-#endif
-
-  if ( aCache->lines ) {
-    apr_table_clear(aCache->lines);
-  }
+  unsigned int          i;
   
-#ifdef APR_HAS_THREADS
-  apr_thread_mutex_unlock(aCache->lock);
-#endif
+  for ( i = 0; i < aCache->setCount; i++ ) {
+    apr_global_mutex_t* lock = aCache->locks[i % SBAUTHNZ_CACHE_STRIPES];
+    
+    apr_global_mutex_lock(lock);
+    memset(&aCache->sets[i], 0, sizeof(SBAuthnzCacheSet));
+    apr_global_mutex_unlock(lock);
+  }
 }
 
 /*!
-  @typedef SBAuthnzCacheArgs
+  @function SBAuthnzCacheInvalidate
   
-  For passing some junk to our cache-cleanup iterator function.
+  Logically discard every line in the cache in O(1) by bumping the cache's
+  generation; lines written under an older generation are treated as stale
+  (and are reclaimed lazily).  Safe to call from any thread in any child
+  without holding a stripe lock.
 */
-typedef struct {
-  apr_time_t        now;
-  int               maxCount;
-  int               keyCount;
-  const char*       *keys;
-} SBAuthnzCacheArgs;
+static void
+SBAuthnzCacheInvalidate(
+  SBAuthnzCache*        aCache
+)
+{
+  if ( aCache->header )
+    apr_atomic_inc32(&aCache->header->generation);
+}
 
 /*!
-  @function __SBAuthnzCacheCleanupIterator
-  
-  Iterator function for apr_table_do; builds a list of keys that should
-  be dropped.  Note that we build the list making use of the keys' char*
-  directly and NOT with copies of the keys; since we're mutex'ing cache
-  access the cache table is guaranteed not to change during the course of
-  the purge, so we can get away with it.
-*/
-int
-__SBAuthnzCacheCleanupIterator(
-  void*         args,
-  const char*   uname,
-  const char*   timestamp
+  @function SBAuthnzCacheGeneration
+  
+  Returns the cache's current generation.  A caller that computes a value
+  to be cached should take this snapshot before it starts, and pass it to
+  the update:  an invalidation which arrives in the meantime then leaves the
+  new line already stale rather than being lost.
+*/
+static apr_uint32_t
+SBAuthnzCacheGeneration(
+  SBAuthnzCache*        aCache
 )
 {
-  SBAuthnzCacheArgs*    ARGS = (SBAuthnzCacheArgs*)args;
+  return ( aCache->header ? apr_atomic_read32(&aCache->header->generation) : 0 );
+}
+
+/*!
+  @function __SBAuthnzCacheGet
   
-  if ( timestamp ) {
-    apr_time_t  savedTime = apr_atoi64(timestamp);
+  Lookup the given key in the cache.  If a live line is found and the secret
+  matches the one the line was written with, the line is marked as referenced
+  (so the CLOCK hand will pass it over once before evicting it), its value is
+  copied to *value (if non-NULL) and 1 is returned.  Stale lines found along
+  the way are freed.
+*/
+static int
+__SBAuthnzCacheGet(
+  SBAuthnzCache*        aCache,
+  const char*           key,
+  const char*           secret,
+  size_t                secretLen,
+  int*                  value
+)
+{
+  SBAuthnzCacheSet*     set;
+  apr_global_mutex_t*   lock;
+  apr_uint32_t          hash, generation, setIndex;
+  size_t                keyLen;
+  unsigned char         digest[APR_MD5_DIGESTSIZE];
+  apr_time_t            now;
+  int                   i, result = 0;
+  
+  if ( ! aCache->sets )
+    return 0;
+  
+  hash = __SBAuthnzCacheHash(key, &keyLen);
+  if ( keyLen >= SBAUTHNZ_CACHE_KEY_MAX )
+    return 0;
+  __SBAuthnzCacheDigest(aCache, key, keyLen, secret, secretLen, digest);
+  
+  setIndex = hash % aCache->setCount;
+  set = &aCache->sets[setIndex];
+  lock = aCache->locks[setIndex % SBAUTHNZ_CACHE_STRIPES];
+  generation = apr_atomic_read32(&aCache->header->generation);
+  now = apr_time_now();
+  
+  apr_global_mutex_lock(lock);
+  for ( i = 0; i < SBAUTHNZ_CACHE_WAYS; i++ ) {
+    SBAuthnzCacheLine*  line = &set->lines[i];
     
-    if ( ( ARGS->now - savedTime ) > SBAUTHNZ_CACHE_TTL ) {
-      ARGS->keys[ARGS->keyCount++] = uname;
-      
-      //  Stop the iteration if we hit the maximum number of lines
-      //  we can "memorize" for flushing:
-      if ( ARGS->keyCount == ARGS->maxCount )
-        return 0;
+    if ( line->expires && (line->hash == hash) && (strcmp(line->key, key) == 0) ) {
+      if ( (line->expires <= now) || (line->generation != generation) ) {
+        line->expires = 0;
+        line->referenced = 0;
+      } else if ( memcmp(line->digest, digest, APR_MD5_DIGESTSIZE) == 0 ) {
+        line->referenced = 1;
+        if ( value )
+          *value = line->value;
+        result = 1;
+      }
+      break;
     }
   }
-  return 1;
+  apr_global_mutex_unlock(lock);
+  
+  return result;
 }
 
-int
-__SBAuthnzCacheWalk(
-  void*         args,
-  const char*   uname,
-  const char*   timestamp
+/*!
+  @function __SBAuthnzCachePut
+  
+  Attempt to insert/update a cache line associated with key.  An existing
+  line for key is refreshed in-place; otherwise the first free or stale line
+  in the set is used; otherwise the set's CLOCK hand sweeps forward, clearing
+  referenced bits, until it finds an unreferenced line to evict.  The sweep
+  is bounded by two revolutions of the set.
+  
+  The line is stamped with valueGeneration, the generation in effect when
+  value was computed (see SBAuthnzCacheGeneration).
+*/
+static void
+__SBAuthnzCachePut(
+  SBAuthnzCache*        aCache,
+  const char*           key,
+  const char*           secret,
+  size_t                secretLen,
+  int                   value,
+  apr_uint32_t          valueGeneration
 )
 {
-  FILE*         ARGS = (FILE*)args;
+  SBAuthnzCacheSet*     set;
+  SBAuthnzCacheLine*    line = NULL;
+  apr_global_mutex_t*   lock;
+  apr_uint32_t          hash, generation, setIndex;
+  size_t                keyLen;
+  unsigned char         digest[APR_MD5_DIGESTSIZE];
+  apr_time_t            now;
+  int                   i;
+  
+  if ( ! aCache->sets )
+    return;
+  
+  hash = __SBAuthnzCacheHash(key, &keyLen);
+  if ( keyLen >= SBAUTHNZ_CACHE_KEY_MAX )
+    return;
+  __SBAuthnzCacheDigest(aCache, key, keyLen, secret, secretLen, digest);
+  
+  setIndex = hash % aCache->setCount;
+  set = &aCache->sets[setIndex];
+  lock = aCache->locks[setIndex % SBAUTHNZ_CACHE_STRIPES];
+  generation = apr_atomic_read32(&aCache->header->generation);
+  now = apr_time_now();
+  
+  apr_global_mutex_lock(lock);
+  
+  //  Existing line for this key, or else the first free/stale line:
+  for ( i = 0; i < SBAUTHNZ_CACHE_WAYS; i++ ) {
+    SBAuthnzCacheLine*  candidate = &set->lines[i];
+    
+    if ( candidate->expires && (candidate->hash == hash) && (strcmp(candidate->key, key) == 0) ) {
+      line = candidate;
+      break;
+    }
+    if ( ! line && ((candidate->expires <= now) || (candidate->generation != generation)) )
+      line = candidate;
+  }
+  
+  //  Set is full of live lines; run the CLOCK:
+  if ( ! line ) {
+    for ( i = 0; i < 2 * SBAUTHNZ_CACHE_WAYS; i++ ) {
+      SBAuthnzCacheLine*  candidate = &set->lines[set->hand];
+      
+      set->hand = (set->hand + 1) % SBAUTHNZ_CACHE_WAYS;
+      if ( ! candidate->referenced ) {
+        line = candidate;
+        break;
+      }
+      candidate->referenced = 0;
+    }
+  }
   
-  fprintf(ARGS, "[Cache(%08X)] { %s => %s }\n", getpid(), uname, timestamp);
+  if ( line ) {
+    line->hash = hash;
+    line->referenced = 1;
+    line->generation = valueGeneration;
+    line->value = value;
+    line->expires = now + aCache->ttl;
+    memcpy(line->digest, digest, APR_MD5_DIGESTSIZE);
+    memcpy(line->key, key, keyLen + 1);
+  }
   
-  return 1;
+  apr_global_mutex_unlock(lock);
 }
 
 /*!
   @function SBAuthnzCacheLookup
   
   Called by the main authentication function.  Lookup the given uname in
-  the cache.  If it is found, then confirm that the TTL hasn't passed on
-  that cache line; if it has, purge that line and return 0.  If the TTL
-  has not expired, then be sure that the password coming from the remote
-  host matches the password attached to the cache line (to be more sure
-  it's the same person behind the request that triggered the auth!).
-  
-  The tmpPool should be a short-lived memory pool that we can use for
-  the sake of cache purging.  The request pool is perfect for this!
-  
-  This routine decrements the internal cleanup counter for the cache and
-  performs a purge if the cleanup has reached zero (and then resets the
-  counter).
+  the cache.  A hit requires that the TTL hasn't passed on that cache line
+  and that the password coming from the remote host matches the one that
+  was cached (to be more sure it's the same person behind the request that
+  triggered the auth!).
 */
 static int
 SBAuthnzCacheLookup(
   SBAuthnzCache*        aCache,
   const char*           uname,
-  const char*           password,
-  apr_pool_t*           tmpPool
+  const char*           password
 )
 {
-  const char*   value = NULL;
-  int           result = 0;
-  apr_time_t    now = apr_time_now();
-
-#ifdef AUTHNZ_SHUEBOX_DEBUG
-  FILE*         f;
-#endif
-  
-#ifdef APR_HAS_THREADS
-  apr_thread_mutex_lock(aCache->lock);
-#endif
-
-#ifdef AUTHNZ_SHUEBOX_DEBUG
-  f = fopen("/tmp/shuebox.log", "a");
-  
-  fprintf(f, "[Cache(%08X)] Walk the cache (in lookup):\n", getpid());
-  apr_table_do(__SBAuthnzCacheWalk, f, aCache->lines, NULL);
-  fprintf(f, "[Cache(%08X)] Done walking the cache (in lookup)\n", getpid());
-#endif
-
-  //  Check for the user in the cache:
-  if ( value = apr_table_get(aCache->lines,uname) ) {
-    apr_time_t  savedTime = apr_atoi64(value);
-    char*       savedPass = strchr(value,':');
-
-#ifdef AUTHNZ_SHUEBOX_DEBUG
-    fprintf(f,"[Cache(%08X)] Cache time check: %lld > %d ? %s :: ", getpid(), now - savedTime, SBAUTHNZ_CACHE_TTL, value);
-#endif
-    if ( (now - savedTime) > SBAUTHNZ_CACHE_TTL ) {
-      apr_table_unset(aCache->lines,uname);
-#ifdef AUTHNZ_SHUEBOX_DEBUG
-      fprintf(f,"INVALIDATE LINE [%d]\n", aCache->cleanup);
-#endif
-    } else if ( strcmp(savedPass + 1,password) == 0 ) {
-      result = 1;
-#ifdef AUTHNZ_SHUEBOX_DEBUG
-      fprintf(f,"VALIDATED [%d]\n", aCache->cleanup);
-#endif
-    }
-  }
-#ifdef AUTHNZ_SHUEBOX_DEBUG
-  else {
-    fprintf(f,"[Cache(%08X)] No cache line for %s\n", getpid(), uname);
-  }
-#endif
-  
-  //  Have we hit a cleanup interval?
-  if ( --(aCache->cleanup) == 0 ) {
-    const char*               *keys = apr_palloc(tmpPool,SBAUTHNZ_CACHE_SIZE * sizeof(char*));
-    SBAuthnzCacheArgs         args = { now , SBAUTHNZ_CACHE_SIZE , 0 , keys };
-    
-    if ( keys ) {
-#ifdef AUTHNZ_SHUEBOX_DEBUG
-      fprintf(f,"[Cache(%08X)] Cleanup in lookup!\n", getpid());
-#endif
-      apr_table_do(__SBAuthnzCacheCleanupIterator,&args,aCache->lines,NULL);
-      if ( args.keyCount ) {
-        const char*           *keyMax = keys + args.keyCount;
-        
-        while ( keys < keyMax ) {
-#ifdef AUTHNZ_SHUEBOX_DEBUG
-          fprintf(f,"[Cache(%08X)] REMOVE: %s\n", getpid(), *keys);
-#endif
-          apr_table_unset(aCache->lines,*keys);
-          keys++;
-        }
-      }
-    }
-    aCache->cleanup = SBAUTHNZ_CACHE_CLEANUP;
-  }
-  
-#ifdef AUTHNZ_SHUEBOX_DEBUG
-  fclose(f);
-#endif
-
-#ifdef APR_HAS_THREADS
-  apr_thread_mutex_unlock(aCache->lock);
-#endif
-  return result;
+  return __SBAuthnzCacheGet(aCache, uname, password, strlen(password), NULL);
 }
 
 /*!
   @function SBAuthnzCacheUpdate
   
-  Called by the main authentication function.  Attempt to insert/update
-  a cache line associated with uname.  The cache line consists of the
-  textual form of the 64-bit timestamp for the current time, a colon, and
-  the password that yielded a successful authentication.
-  
-  The tmpPool should be a short-lived memory pool that we can use for
-  the sake of cache purging and line generation.  The request pool is
-  perfect for this!
-  
-  This routine decrements the internal cleanup counter for the cache and
-  performs a purge if the cleanup has reached zero (and then resets the
-  counter).
+  Called by the main authentication function once uname has successfully
+  authenticated with password.
 */
 static void
 SBAuthnzCacheUpdate(
   SBAuthnzCache*        aCache,
   const char*           uname,
   const char*           password,
-  size_t                passwordLen,
-  apr_pool_t*           tmpPool
+  size_t                passwordLen
 )
 {
-  apr_time_t        now = apr_time_now();
-  char*             timestamp = apr_palloc(tmpPool,24 + passwordLen);
+  __SBAuthnzCachePut(aCache, uname, password, passwordLen, 1, SBAuthnzCacheGeneration(aCache));
+}
 
-#ifdef AUTHNZ_SHUEBOX_DEBUG
-  FILE*         f;
-#endif
+/*!
+  @function __SBAuthzCacheKey
   
-#ifdef APR_HAS_THREADS
-  apr_thread_mutex_lock(aCache->lock);
-#endif
+  Compose the authorization cache key for a decision into buffer (which must
+  be SBAUTHNZ_CACHE_KEY_MAX characters long).  Fields are separated by a
+  character that cannot appear in collaboration or repository short names.
+  Returns 0 if the key would not fit.
+*/
+static int
+__SBAuthzCacheKey(
+  char*                 buffer,
+  int                   subType,
+  const char*           collaborationId,
+  const char*           repositoryId,
+  const char*           username
+)
+{
+  int                   len = apr_snprintf(
+                                  buffer,
+                                  SBAUTHNZ_CACHE_KEY_MAX,
+                                  "%d/%s/%s/%s",
+                                  subType,
+                                  ( collaborationId ? collaborationId : "" ),
+                                  ( repositoryId ? repositoryId : "" ),
+                                  username
+                                );
+  
+  return ( len < SBAUTHNZ_CACHE_KEY_MAX - 1 );
+}
 
-#ifdef AUTHNZ_SHUEBOX_DEBUG
-  f = fopen("/tmp/shuebox.log", "a");
+/*!
+  @function SBAuthzCacheLookup
   
-  fprintf(f, "[Cache(%08X)] Walk the cache (in update):\n", getpid());
-  apr_table_do(__SBAuthnzCacheWalk, f, aCache->lines, NULL);
-  fprintf(f, "[Cache(%08X)] Done walking the cache (in update)\n", getpid());
-#endif
-
-  //  Have we hit a cleanup interval?
-  if ( --(aCache->cleanup) == 0 ) {
-    const char*               *keys = apr_palloc(tmpPool,SBAUTHNZ_CACHE_SIZE * sizeof(char*));
-    SBAuthnzCacheArgs         args = { now , SBAUTHNZ_CACHE_SIZE , 0 , keys };
-
-#ifdef AUTHNZ_SHUEBOX_DEBUG
-    fprintf(f,"[Cache(%08X)] Cleanup in update!\n", getpid());
-#endif
-    if ( keys ) {
-      apr_table_do(__SBAuthnzCacheCleanupIterator,&args,aCache->lines,NULL);
-      if ( args.keyCount ) {
-        const char*           *keyMax = keys + args.keyCount;
-        
-        while ( keys < keyMax ) {
-#ifdef AUTHNZ_SHUEBOX_DEBUG
-          fprintf(f,"[Cache(%08X)] REMOVE: %s\n", getpid(), *keys);
-#endif
-          apr_table_unset(aCache->lines,*keys);
-          keys++;
-        }
-      }
-    }
-    aCache->cleanup = SBAUTHNZ_CACHE_CLEANUP;
-  }
+  Called by the authorization driver.  Returns 1 and sets *granted if a
+  decision is cached for the given tuple.
+*/
+static int
+SBAuthzCacheLookup(
+  SBAuthnzCache*        aCache,
+  int                   subType,
+  const char*           collaborationId,
+  const char*           repositoryId,
+  const char*           username,
+  int*                  granted
+)
+{
+  char                  key[SBAUTHNZ_CACHE_KEY_MAX];
   
-  //  Construct a textual timestamp:
-  if ( timestamp ) {
-    snprintf(timestamp,24 + passwordLen,"%lld:%s",now,password);
-    apr_table_set(aCache->lines,uname,timestamp);
-    
-#ifdef AUTHNZ_SHUEBOX_DEBUG
-    fprintf(f,"[Cache(%08X)] Cache update %s => %s\n", getpid(), uname, timestamp);
-#endif
-  }
+  if ( ! __SBAuthzCacheKey(key, subType, collaborationId, repositoryId, username) )
+    return 0;
+  return __SBAuthnzCacheGet(aCache, key, "", 0, granted);
+}
 
-#ifdef AUTHNZ_SHUEBOX_DEBUG
-  fclose(f);
-#endif
+/*!
+  @function SBAuthzCacheUpdate
   
-#ifdef APR_HAS_THREADS
-  apr_thread_mutex_unlock(aCache->lock);
-#endif
+  Called by the authorization driver once the database has produced a
+  decision for the given tuple.  generation is the cache's generation from
+  before the query was issued (see SBAuthnzCacheGeneration).
+*/
+static void
+SBAuthzCacheUpdate(
+  SBAuthnzCache*        aCache,
+  int                   subType,
+  const char*           collaborationId,
+  const char*           repositoryId,
+  const char*           username,
+  int                   granted,
+  apr_uint32_t          generation
+)
+{
+  char                  key[SBAUTHNZ_CACHE_KEY_MAX];
+  
+  if ( __SBAuthzCacheKey(key, subType, collaborationId, repositoryId, username) )
+    __SBAuthnzCachePut(aCache, key, "", 0, granted, generation);
 }
 
 /*
@@ -442,6 +714,8 @@ static APR_OPTIONAL_FN_TYPE(uldap_ssl_supported) *util_ldap_ssl_supported;
 /* APR DBD utility functions we need */
 static APR_OPTIONAL_FN_TYPE(ap_dbd_prepare) *mod_dbd_prepare;
 static APR_OPTIONAL_FN_TYPE(ap_dbd_acquire) *mod_dbd_acquire;
+static APR_OPTIONAL_FN_TYPE(ap_dbd_open) *mod_dbd_open;
+static APR_OPTIONAL_FN_TYPE(ap_dbd_close) *mod_dbd_close;
 
 
 /*!
@@ -559,154 +833,878 @@ SBAuthnzConfigMerge(
 
 
 /*!
-  @function SBAuthnzConfigSetLDAPURL
+  @struct SBAuthnzServerConfig
+  
+  Server-wide settings; only those of the main server are used, since the
+  caches are shared by every virtual host.
+*/
+typedef struct SBAuthnzServerConfig {
+
+  /* Authorization decision cache lifetime, in seconds (0 disables): */
+  int                 authzCacheTTL;
+  
+  /* Postgres connection string and channel for authz cache invalidation: */
+  char*               notifyConnInfo;
+  char*               notifyChannel;
+
+} SBAuthnzServerConfig;
+
+
+/*!
+  @function SBAuthnzServerConfigCreate
+  
+  Create a new server configuration record.
+*/
+static void*
+SBAuthnzServerConfigCreate(
+  apr_pool_t*   pool,
+  server_rec*   s
+)
+{
+  SBAuthnzServerConfig*   newConfig = apr_pcalloc(pool, sizeof(SBAuthnzServerConfig));
+  
+  newConfig->authzCacheTTL = SBAUTHZ_CACHE_TTL;
+  newConfig->notifyChannel = "authzChange";
+  
+  return newConfig;
+}
+
+
+/*!
+  @function SBAuthnzServerConfigSetAuthzCacheTTL
+  
+  Configuration-phase handler for AuthSHUEBoxAuthzCacheTTL.
+*/
+static const char*
+SBAuthnzServerConfigSetAuthzCacheTTL(
+  cmd_parms*    cmd,
+  void*         cfg,
+  const char*   ttl
+)
+{
+  SBAuthnzServerConfig*   CFG = (SBAuthnzServerConfig*)ap_get_module_config(cmd->server->module_config, &authnz_shuebox_module);
+  char*                   end = NULL;
+  long                    value = strtol(ttl, &end, 10);
+  
+  if ( ! end || *end || (value < 0) )
+    return "[authnz_shuebox] AuthSHUEBoxAuthzCacheTTL must be a non-negative number of seconds";
+  CFG->authzCacheTTL = (int)value;
+  return NULL;
+}
+
+
+/*!
+  @function SBAuthnzServerConfigSetString
+  
+  Configuration-phase handler for server-wide string directives; the
+  command's info is the offset of the field in SBAuthnzServerConfig.
+*/
+static const char*
+SBAuthnzServerConfigSetString(
+  cmd_parms*    cmd,
+  void*         cfg,
+  const char*   value
+)
+{
+  SBAuthnzServerConfig*   CFG = (SBAuthnzServerConfig*)ap_get_module_config(cmd->server->module_config, &authnz_shuebox_module);
+  
+  *(char**)((char*)CFG + (apr_size_t)cmd->info) = apr_pstrdup(cmd->pool, value);
+  return NULL;
+}
+
+
+/*!
+  @function SBAuthnzConfigSetLDAPURL
+  
+  Configuration-phase translation of an LDAP URL into its components.
+  
+  Borrowed from mod_authnz_ldap.
+*/
+static const char*
+SBAuthnzConfigSetLDAPURL(
+  cmd_parms*    cmd,
+  void*         cfg,
+  const char*   url,
+  const char*   secureMode
+)
+{
+  SBAuthnzConfig*         CFG = (SBAuthnzConfig*)cfg;
+  int                     rc;
+  unsigned int            attribCount = 0;
+  int                     emplidAttribAtIndex = -1;
+  apr_ldap_url_desc_t*    ldapURL;
+  apr_ldap_err_t*         result;
+
+  rc = apr_ldap_url_parse(cmd->pool, url, &ldapURL, &result);
+  if (rc != APR_SUCCESS) {
+      return result->reason;
+  }
+  CFG->ldap.url = apr_pstrdup(cmd->pool, url);
+  
+  /* Set the host: */
+  CFG->ldap.host = ( ldapURL->lud_host ? apr_pstrdup(cmd->pool, ldapURL->lud_host) : "localhost" );
+  
+  /* Set the base DN: */
+  CFG->ldap.baseDN = ( ldapURL->lud_dn ? apr_pstrdup(cmd->pool, ldapURL->lud_dn) : "" );
+  
+  /* Port and security information: */
+  if ( secureMode ) {
+    if ( strcasecmp(secureMode, "NONE") == 0 ) {
+      CFG->ldap.secure = APR_LDAP_NONE;
+    }
+    else if ( strcasecmp(secureMode, "SSL") == 0 ) {
+      CFG->ldap.secure = APR_LDAP_SSL;
+    }
+    else if ( strcasecmp(secureMode, "TLS") == 0 ) {
+      CFG->ldap.secure = APR_LDAP_STARTTLS;
+    }
+    else {
+      return "[authnz_shuebox] Invalid LDAP connection mode setting: must be one of NONE, "
+             "SSL, or TLS";
+    }
+  }
+  if ( strncasecmp(url, "ldaps", 5) == 0 ) {
+    CFG->ldap.secure = APR_LDAP_SSL;
+    CFG->ldap.port = ( ldapURL->lud_port ? ldapURL->lud_port : LDAPS_PORT );
+  } else {
+    CFG->ldap.port = ( ldapURL->lud_port ? ldapURL->lud_port : LDAP_PORT );
+  }
+  
+  /* Search scope: */
+  CFG->ldap.scope = ( (ldapURL->lud_scope == LDAP_SCOPE_ONELEVEL) ? LDAP_SCOPE_ONELEVEL : LDAP_SCOPE_SUBTREE );
+  
+  /* Search filter: */
+  if ( ldapURL->lud_filter) {
+    if (ldapURL->lud_filter[0] == '(') {
+      /*
+       * Get rid of the surrounding parentheses; later on when generating the per-authn
+       * filter, they'll be put back.
+       */
+      size_t        filterLen = strlen(ldapURL->lud_filter + 1);
+      
+      if ( filterLen > 0 ) {
+        if ( ldapURL->lud_filter[filterLen - 1] == ')' ) {
+          filterLen--;
+        }
+        if ( filterLen > 0 ) {
+          CFG->ldap.filter = apr_pcalloc(cmd->pool, filterLen + 1);
+          memcpy( CFG->ldap.filter, ldapURL->lud_filter + 1, filterLen );
+        }
+      }
+    } else {
+      CFG->ldap.filter = apr_pstrdup(cmd->pool, ldapURL->lud_filter);
+    }
+  }
+  if ( CFG->ldap.filter == NULL ) {
+    CFG->ldap.filter = "objectclass=*";
+  }
+  
+  /*
+   * Attributes; count how many attributes, make sure udEmplid is among them:
+   */
+  if ( ldapURL->lud_attrs && ldapURL->lud_attrs[0] ) {
+    while ( ldapURL->lud_attrs[++attribCount] ) {
+      if ( strcasecmp(ldapURL->lud_attrs[attribCount], udEmplidLDAPAttribute) == 0 )
+        emplidAttribAtIndex = attribCount;
+    }
+  }
+  
+  /* Allocate an array: */
+  CFG->ldap.searchAttributes = apr_pcalloc(cmd->pool, sizeof(char *) * (attribCount + 2 - (emplidAttribAtIndex == -1 ? 0 : 1)));
+  
+  /* Copy the attribute names: */
+  CFG->ldap.searchAttributes[0] = (char*)udEmplidLDAPAttribute;
+  if ( attribCount ) {
+    char**        attribPtr = CFG->ldap.searchAttributes + 1;
+    
+    attribCount = 0;
+    while ( ldapURL->lud_attrs[attribCount] ) {
+      if ( attribCount != emplidAttribAtIndex )
+        *attribPtr++ = apr_pstrdup(cmd->pool, ldapURL->lud_attrs[attribCount]);
+      attribCount++;
+    }
+  }
+    
+  CFG->ldap.userMatchAttribute = "uid";
+  
+  return NULL;
+}
+
+
+
+/*!
+  @function SBAuthnzPrepareQuery
+  
+  Generic configuration-phase database query preparer.
+*/
+static const char* SBAuthnzPrepareQuery(
+  cmd_parms*    cmd,
+  void*         cfg,
+  const char*   query
+)
+{
+  static unsigned int   label_num = 0;
+  char*                 label = NULL;
+  
+  /* Just in case we get hit before the optional fns hook: */
+  if ( mod_dbd_prepare == NULL ) {
+    mod_dbd_prepare = APR_RETRIEVE_OPTIONAL_FN(ap_dbd_prepare);
+    if (mod_dbd_prepare == NULL)
+      return "You must load mod_dbd to enable mod_authnz_shuebox";
+  }
+    
+  /* Create a unique label for the query: */
+  label = apr_psprintf(cmd->pool, "authnz_shuebox_%u", ++label_num);
+  
+  /* Prepare the query: */
+  mod_dbd_prepare(cmd->server, query, label);
+
+  /* Save the label in our config so we can reference the query
+     later */
+  return ap_set_string_slot(cmd, cfg, label);
+}
+
+
+#ifndef SBAUTHZ_LISTENER_POLL
+/*
+  How often (in microseconds) the NOTIFY listener thread checks whether it
+  should exit or may become the active listener.  Default value is 1 second.
+*/
+#define SBAUTHZ_LISTENER_POLL 1000 * 1000
+#endif
+
+#ifndef SBAUTHZ_LISTENER_RETRY
+/*
+  How long (in microseconds) the active listener waits before reconnecting
+  after losing its database connection.  Default value is 5 seconds.
+*/
+#define SBAUTHZ_LISTENER_RETRY 5 * 1000 * 1000
+#endif
+
+/*!
+  @typedef SBAuthzListener
+  
+  Invalidation of the authorization cache is driven by a Postgres LISTEN
+  channel; rules on the roleMember and repositoryACL tables NOTIFY that
+  channel on every change (see docs/database/role.sql).
+  
+  Every child runs a listener thread, but only one of them at a time holds the
+  election lock and thus a database connection; the others poll the lock so
+  that a replacement takes over when the active listener's child exits.  On
+  each notification the listener bumps the authorization cache's generation,
+  which invalidates every cached decision in all children at once.  The
+  generation is also bumped each time the listener (re)connects, since
+  notifications may have been missed in the interim.
+*/
+typedef struct {
+  apr_global_mutex_t*   electionLock;
+  const char*           connInfo;
+  const char*           channel;
+  server_rec*           server;
+#if APR_HAS_THREADS
+  apr_thread_t*         thread;
+#endif
+  volatile int          shouldExit;
+} SBAuthzListener;
+
+static SBAuthzListener SBAuthzListenerDefault;
+
+/*!
+  @function SBAuthzListenerInit
+  
+  Called from the parent in the post-config phase to create the election lock.
+  If connInfo is NULL, no listener is started and cached decisions simply
+  expire at the end of their TTL.
+*/
+static apr_status_t
+SBAuthzListenerInit(
+  SBAuthzListener*      aListener,
+  const char*           connInfo,
+  const char*           channel,
+  apr_pool_t*           pool,
+  server_rec*           s
+)
+{
+  apr_status_t          rv;
+  
+  memset(aListener, 0, sizeof(SBAuthzListener));
+  if ( ! connInfo || ! channel )
+    return APR_SUCCESS;
+  
+#if APR_HAS_THREADS
+  rv = apr_global_mutex_create(&aListener->electionLock, NULL, APR_LOCK_DEFAULT, pool);
+  if ( rv != APR_SUCCESS ) {
+    ap_log_error(
+        APLOG_MARK,
+        APLOG_ERR,
+        rv,
+        s,
+        "[authnz_shuebox] unable to allocate authz listener lock; cached decisions will only expire by TTL"
+      );
+    aListener->electionLock = NULL;
+    return rv;
+  }
+#ifdef AP_NEED_SET_MUTEX_PERMS
+  unixd_set_global_mutex_perms(aListener->electionLock);
+#endif
+  aListener->connInfo = connInfo;
+  aListener->channel = channel;
+  aListener->server = s;
+  return APR_SUCCESS;
+#else
+  ap_log_error(
+      APLOG_MARK,
+      APLOG_WARNING,
+      0,
+      s,
+      "[authnz_shuebox] APR lacks thread support, authz NOTIFY listener disabled; cached decisions will only expire by TTL"
+    );
+  return APR_ENOTIMPL;
+#endif
+}
+
+#if APR_HAS_THREADS
+
+/*!
+  @function __SBAuthzListenerConnect
+  
+  Open a connection to the database and LISTEN on the receiver's channel.
+  Returns NULL on failure.
+*/
+static PGconn*
+__SBAuthzListenerConnect(
+  SBAuthzListener*      aListener
+)
+{
+  PGconn*               conn = PQconnectdb(aListener->connInfo);
+  
+  if ( conn && (PQstatus(conn) == CONNECTION_OK) ) {
+    char*               channel = PQescapeIdentifier(conn, aListener->channel, strlen(aListener->channel));
+    
+    if ( channel ) {
+      char              query[256];
+      PGresult*         result;
+      
+      apr_snprintf(query, sizeof(query), "LISTEN %s", channel);
+      PQfreemem(channel);
+      result = PQexec(conn, query);
+      if ( result && (PQresultStatus(result) == PGRES_COMMAND_OK) ) {
+        PQclear(result);
+        return conn;
+      }
+      if ( result )
+        PQclear(result);
+    }
+  }
+  ap_log_error(
+      APLOG_MARK,
+      APLOG_ERR,
+      0,
+      aListener->server,
+      "[authnz_shuebox] authz listener unable to LISTEN on '%s': %s",
+      aListener->channel,
+      ( conn ? PQerrorMessage(conn) : "out of memory" )
+    );
+  if ( conn )
+    PQfinish(conn);
+  return NULL;
+}
+
+/*!
+  @function __SBAuthzListen
+  
+  Called with the election lock held; stay connected and consume notifications
+  until asked to exit.
+*/
+static void
+__SBAuthzListen(
+  SBAuthzListener*      aListener
+)
+{
+  while ( ! aListener->shouldExit ) {
+    PGconn*             conn = __SBAuthzListenerConnect(aListener);
+    
+    if ( ! conn ) {
+      apr_sleep(SBAUTHZ_LISTENER_RETRY);
+      continue;
+    }
+    
+    /* Anything could have changed while we weren't listening: */
+    SBAuthnzCacheInvalidate(&SBAuthzCacheDefault);
+    
+    while ( ! aListener->shouldExit ) {
+      struct pollfd     pollSock;
+      PGnotify*         notify;
+      int               notifyCount = 0;
+      
+      /* poll() rather than select():  a threaded child's socket can be numbered past FD_SETSIZE */
+      pollSock.fd = PQsocket(conn);
+      pollSock.events = POLLIN;
+      pollSock.revents = 0;
+      if ( poll(&pollSock, 1, (SBAUTHZ_LISTENER_POLL) / 1000) < 0 ) {
+        if ( errno == EINTR )
+          continue;
+        break;
+      }
+      if ( ! PQconsumeInput(conn) )
+        break;
+      while ( (notify = PQnotifies(conn)) ) {
+        notifyCount++;
+        PQfreemem(notify);
+      }
+      if ( notifyCount ) {
+        SBAuthnzCacheInvalidate(&SBAuthzCacheDefault);
+#ifdef AUTHNZ_SHUEBOX_DEBUG
+        ap_log_error(APLOG_MARK, APLOG_INFO, 0, aListener->server,
+            "[authnz_shuebox] %d authz change notification(s), cache invalidated", notifyCount);
+#endif
+      }
+      if ( PQstatus(conn) != CONNECTION_OK )
+        break;
+    }
+    PQfinish(conn);
+  }
+}
+
+/*!
+  @function __SBAuthzListenerMain
+  
+  Listener thread body:  wait to be elected, then listen.
+*/
+static void* APR_THREAD_FUNC
+__SBAuthzListenerMain(
+  apr_thread_t*         thread,
+  void*                 context
+)
+{
+  SBAuthzListener*      aListener = (SBAuthzListener*)context;
+  
+  while ( ! aListener->shouldExit ) {
+    if ( apr_global_mutex_trylock(aListener->electionLock) == APR_SUCCESS ) {
+      __SBAuthzListen(aListener);
+      apr_global_mutex_unlock(aListener->electionLock);
+    } else {
+      apr_sleep(SBAUTHZ_LISTENER_POLL);
+    }
+  }
+  apr_thread_exit(thread, APR_SUCCESS);
+  return NULL;
+}
+
+/*!
+  @function __SBAuthzListenerCleanup
+  
+  Child pool cleanup; stop the listener thread and wait for it to release
+  the election lock.
+*/
+static apr_status_t
+__SBAuthzListenerCleanup(
+  void*                 listener
+)
+{
+  SBAuthzListener*      aListener = (SBAuthzListener*)listener;
+  apr_status_t          rv;
+  
+  if ( aListener->thread ) {
+    aListener->shouldExit = 1;
+    apr_thread_join(&rv, aListener->thread);
+    aListener->thread = NULL;
+  }
+  return APR_SUCCESS;
+}
+
+#endif
+
+/*!
+  @function SBAuthzListenerChildInit
+  
+  Attach a newly-started child to the election lock and start its listener
+  thread.
+*/
+static void
+SBAuthzListenerChildInit(
+  SBAuthzListener*      aListener,
+  apr_pool_t*           pool,
+  server_rec*           s
+)
+{
+#if APR_HAS_THREADS
+  apr_status_t          rv;
+  
+  if ( ! aListener->electionLock || ! SBAuthzCacheDefault.sets )
+    return;
+  
+  rv = apr_global_mutex_child_init(&aListener->electionLock, NULL, pool);
+  if ( rv == APR_SUCCESS ) {
+    aListener->shouldExit = 0;
+    rv = apr_thread_create(&aListener->thread, NULL, __SBAuthzListenerMain, aListener, pool);
+  }
+  if ( rv != APR_SUCCESS ) {
+    ap_log_error(
+        APLOG_MARK,
+        APLOG_ERR,
+        rv,
+        s,
+        "[authnz_shuebox] unable to start authz listener in child %" APR_PID_T_FMT,
+        getpid()
+      );
+    aListener->thread = NULL;
+    return;
+  }
+  apr_pool_cleanup_register(pool, aListener, __SBAuthzListenerCleanup, apr_pool_cleanup_null);
+#endif
+}
+
+
+#ifndef SBAUTHN_LOG_QUEUE_SIZE
+/*
+  The number of authentication log records a child will hold for the
+  background writer.  Records arriving when the queue is full are dropped
+  (and counted) rather than blocking the request.  Default value is 512.
+*/
+#define SBAUTHN_LOG_QUEUE_SIZE 512
+#endif
+
+#ifndef SBAUTHN_LOG_BATCH
+/*
+  The number of queued records that wakes the background writer early, and
+  the most it will write in a single transaction.  Default value is 64.
+*/
+#define SBAUTHN_LOG_BATCH 64
+#endif
+
+#ifndef SBAUTHN_LOG_FLUSH_INTERVAL
+/*
+  The longest (in microseconds) a queued record waits before the background
+  writer flushes it.  Default value is 1 second.
+*/
+#define SBAUTHN_LOG_FLUSH_INTERVAL 1000 * 1000
+#endif
+
+#ifndef SBAUTHN_LOG_FIELD_MAX
+/*
+  The longest username or emplid (including the NUL terminator) a queued
+  record can hold.  Default value is 128.
+*/
+#define SBAUTHN_LOG_FIELD_MAX 128
+#endif
+
+/*!
+  @typedef SBAuthnLogRecord
   
-  Configuration-phase translation of an LDAP URL into its components.
+  A queued authentication log record.  The query label and server belong to
+  the configuration, so they outlive the request that queued the record.
+*/
+typedef struct {
+  server_rec*           server;
+  const char*           queryLabel;
+  char                  username[SBAUTHN_LOG_FIELD_MAX];
+  char                  emplid[SBAUTHN_LOG_FIELD_MAX];
+} SBAuthnLogRecord;
+
+/*!
+  @typedef SBAuthnLogWriter
+  
+  Logging of LDAP authentications is moved off the request path:  requests
+  append a record to a per-child ring buffer and return immediately, and a
+  background thread drains the buffer.  The writer wakes when
+  SBAUTHN_LOG_BATCH records are waiting or SBAUTHN_LOG_FLUSH_INTERVAL has
+  passed, takes a single mod_dbd connection, and runs the whole batch inside
+  one transaction, so a burst of logins costs one commit rather than one per
+  login.
+  
+  The configured AuthSHUEBoxAuthnLogQuery is an arbitrary prepared statement,
+  so each record is still one execution of that statement; what's coalesced is
+  the connection acquisition and the commit.
+*/
+typedef struct {
+#if APR_HAS_THREADS
+  apr_thread_t*         thread;
+  apr_thread_mutex_t*   lock;
+  apr_thread_cond_t*    ready;
+#endif
+  server_rec*           server;
+  volatile int          shouldExit;
+  unsigned int          head;
+  unsigned int          count;
+  unsigned long         dropped;
+  unsigned long         droppedReported;
+  SBAuthnLogRecord      records[SBAUTHN_LOG_QUEUE_SIZE];
+} SBAuthnLogWriter;
+
+static SBAuthnLogWriter SBAuthnLogWriterDefault;
+
+/*!
+  @function SBAuthnLogWriterEnqueue
   
-  Borrowed from mod_authnz_ldap.
+  Queue a log record for the background writer.  Returns zero if there is no
+  writer running in this child (so the caller should log synchronously);
+  otherwise returns non-zero, even when the record had to be dropped because
+  the queue was full.
 */
-static const char*
-SBAuthnzConfigSetLDAPURL(
-  cmd_parms*    cmd,
-  void*         cfg,
-  const char*   url,
-  const char*   secureMode
+static int
+SBAuthnLogWriterEnqueue(
+  SBAuthnLogWriter*     aWriter,
+  server_rec*           server,
+  const char*           queryLabel,
+  const char*           username,
+  const char*           emplid
 )
 {
-  SBAuthnzConfig*         CFG = (SBAuthnzConfig*)cfg;
-  int                     rc;
-  unsigned int            attribCount = 0;
-  int                     emplidAttribAtIndex = -1;
-  apr_ldap_url_desc_t*    ldapURL;
-  apr_ldap_err_t*         result;
-
-  rc = apr_ldap_url_parse(cmd->pool, url, &ldapURL, &result);
-  if (rc != APR_SUCCESS) {
-      return result->reason;
-  }
-  CFG->ldap.url = apr_pstrdup(cmd->pool, url);
-  
-  /* Set the host: */
-  CFG->ldap.host = ( ldapURL->lud_host ? apr_pstrdup(cmd->pool, ldapURL->lud_host) : "localhost" );
-  
-  /* Set the base DN: */
-  CFG->ldap.baseDN = ( ldapURL->lud_dn ? apr_pstrdup(cmd->pool, ldapURL->lud_dn) : "" );
+#if APR_HAS_THREADS
+  if ( ! aWriter->thread || aWriter->shouldExit )
+    return 0;
   
-  /* Port and security information: */
-  if ( secureMode ) {
-    if ( strcasecmp(secureMode, "NONE") == 0 ) {
-      CFG->ldap.secure = APR_LDAP_NONE;
-    }
-    else if ( strcasecmp(secureMode, "SSL") == 0 ) {
-      CFG->ldap.secure = APR_LDAP_SSL;
-    }
-    else if ( strcasecmp(secureMode, "TLS") == 0 ) {
-      CFG->ldap.secure = APR_LDAP_STARTTLS;
-    }
-    else {
-      return "[authnz_shuebox] Invalid LDAP connection mode setting: must be one of NONE, "
-             "SSL, or TLS";
-    }
-  }
-  if ( strncasecmp(url, "ldaps", 5) == 0 ) {
-    CFG->ldap.secure = APR_LDAP_SSL;
-    CFG->ldap.port = ( ldapURL->lud_port ? ldapURL->lud_port : LDAPS_PORT );
+  apr_thread_mutex_lock(aWriter->lock);
+  if ( aWriter->count == SBAUTHN_LOG_QUEUE_SIZE ) {
+    aWriter->dropped++;
   } else {
-    CFG->ldap.port = ( ldapURL->lud_port ? ldapURL->lud_port : LDAP_PORT );
+    SBAuthnLogRecord*   record = &aWriter->records[(aWriter->head + aWriter->count) % SBAUTHN_LOG_QUEUE_SIZE];
+    
+    record->server = server;
+    record->queryLabel = queryLabel;
+    apr_cpystrn(record->username, username, SBAUTHN_LOG_FIELD_MAX);
+    apr_cpystrn(record->emplid, emplid, SBAUTHN_LOG_FIELD_MAX);
+    if ( ++aWriter->count == SBAUTHN_LOG_BATCH )
+      apr_thread_cond_signal(aWriter->ready);
   }
+  apr_thread_mutex_unlock(aWriter->lock);
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+#if APR_HAS_THREADS
+
+/*!
+  @function __SBAuthnLogWriterFlush
   
-  /* Search scope: */
-  CFG->ldap.scope = ( (ldapURL->lud_scope == LDAP_SCOPE_ONELEVEL) ? LDAP_SCOPE_ONELEVEL : LDAP_SCOPE_SUBTREE );
-  
-  /* Search filter: */
-  if ( ldapURL->lud_filter) {
-    if (ldapURL->lud_filter[0] == '(') {
-      /*
-       * Get rid of the surrounding parentheses; later on when generating the per-authn
-       * filter, they'll be put back.
-       */
-      size_t        filterLen = strlen(ldapURL->lud_filter + 1);
+  Write a batch of records.  Consecutive records for the same server share a
+  single mod_dbd connection and transaction.  Each record is written behind a
+  savepoint of its own, so one failed insert is rolled back by itself rather
+  than aborting the transaction for the rest of the batch; the written count
+  is only what was actually committed.
+*/
+static void
+__SBAuthnLogWriterFlush(
+  SBAuthnLogRecord*     records,
+  unsigned int          count,
+  apr_pool_t*           pool
+)
+{
+  unsigned int          i = 0;
+  
+  while ( i < count ) {
+    server_rec*         server = records[i].server;
+    ap_dbd_t*           dbdConn = mod_dbd_open(pool, server);
+    apr_dbd_transaction_t*  txn = NULL;
+    unsigned int        written = 0, failed = 0;
+    int                 nrows;
+    
+    if ( dbdConn == NULL ) {
+      ap_log_error(
+          APLOG_MARK,
+          APLOG_ERR,
+          0,
+          server,
+          "[authn_shuebox] Failed to acquire database connection to log %u authentication(s)",
+          count - i
+        );
+      /* Skip the records for this server: */
+      while ( (i < count) && (records[i].server == server) )
+        i++;
+      continue;
+    }
+    if ( apr_dbd_transaction_start(dbdConn->driver, pool, dbdConn->handle, &txn) == 0 ) {
+      /* Failures are handled a record at a time below, rather than by the driver: */
+      apr_dbd_transaction_mode_set(dbdConn->driver, txn, APR_DBD_TRANSACTION_IGNORE_ERRORS);
+    } else {
+      txn = NULL;
+    }
+    while ( (i < count) && (records[i].server == server) ) {
+      SBAuthnLogRecord*     record = &records[i++];
+      apr_dbd_prepared_t*   queryStatement = apr_hash_get(dbdConn->prepared, record->queryLabel, APR_HASH_KEY_STRING);
+      apr_dbd_results_t*    queryResult = NULL;
+      apr_dbd_row_t*        queryResultRow = NULL;
       
-      if ( filterLen > 0 ) {
-        if ( ldapURL->lud_filter[filterLen - 1] == ')' ) {
-          filterLen--;
-        }
-        if ( filterLen > 0 ) {
-          CFG->ldap.filter = apr_pcalloc(cmd->pool, filterLen + 1);
-          memcpy( CFG->ldap.filter, ldapURL->lud_filter + 1, filterLen );
-        }
+      if ( queryStatement == NULL ) {
+        ap_log_error(
+            APLOG_MARK,
+            APLOG_ERR,
+            0,
+            server,
+            "[authn_shuebox] A prepared statement could not be found for AuthSHUEBoxAuthnLogQuery with the key '%s'",
+            record->queryLabel
+          );
+        failed++;
+        continue;
       }
-    } else {
-      CFG->ldap.filter = apr_pstrdup(cmd->pool, ldapURL->lud_filter);
+      if ( txn && apr_dbd_query(dbdConn->driver, dbdConn->handle, &nrows, "SAVEPOINT authn_log_record") ) {
+        failed++;
+        continue;
+      }
+      if ( apr_dbd_pvselect(dbdConn->driver, pool, dbdConn->handle, &queryResult, queryStatement, 0, record->username, record->emplid, NULL) ) {
+        ap_log_error(
+            APLOG_MARK,
+            APLOG_ERR,
+            0,
+            server,
+            "[authn_shuebox] Failure to log successful authentication of '%s'",
+            record->username
+          );
+        if ( txn )
+          apr_dbd_query(dbdConn->driver, dbdConn->handle, &nrows, "ROLLBACK TO SAVEPOINT authn_log_record");
+        failed++;
+        continue;
+      }
+      /* Discard any results we got back: */
+      while ( apr_dbd_get_row(dbdConn->driver, pool, queryResult, &queryResultRow, -1) != -1 );
+      written++;
     }
-  }
-  if ( CFG->ldap.filter == NULL ) {
-    CFG->ldap.filter = "objectclass=*";
-  }
-  
-  /*
-   * Attributes; count how many attributes, make sure udEmplid is among them:
-   */
-  if ( ldapURL->lud_attrs && ldapURL->lud_attrs[0] ) {
-    while ( ldapURL->lud_attrs[++attribCount] ) {
-      if ( strcasecmp(ldapURL->lud_attrs[attribCount], udEmplidLDAPAttribute) == 0 )
-        emplidAttribAtIndex = attribCount;
+    if ( txn && apr_dbd_transaction_end(dbdConn->driver, pool, txn) ) {
+      ap_log_error(
+          APLOG_MARK,
+          APLOG_ERR,
+          0,
+          server,
+          "[authn_shuebox] Failure to commit %u logged authentication(s)",
+          written
+        );
+      /* Nothing from this server's run made it: */
+      failed += written;
+      written = 0;
     }
+    mod_dbd_close(server, dbdConn);
+    
+#ifdef AUTHNZ_SHUEBOX_DEBUG
+    ap_log_error(APLOG_MARK, APLOG_INFO, 0, server,
+        "[authn_shuebox] authentication log batch: %u written, %u failed", written, failed);
+#endif
   }
+}
+
+/*!
+  @function __SBAuthnLogWriterMain
   
-  /* Allocate an array: */
-  CFG->ldap.searchAttributes = apr_pcalloc(cmd->pool, sizeof(char *) * (attribCount + 2 - (emplidAttribAtIndex == -1 ? 0 : 1)));
-  
-  /* Copy the attribute names: */
-  CFG->ldap.searchAttributes[0] = (char*)udEmplidLDAPAttribute;
-  if ( attribCount ) {
-    char**        attribPtr = CFG->ldap.searchAttributes + 1;
+  Writer thread body:  wait for a full batch or the flush interval, copy the
+  waiting records out of the queue and write them without holding the lock.
+  On exit, whatever is left in the queue is flushed.
+*/
+static void* APR_THREAD_FUNC
+__SBAuthnLogWriterMain(
+  apr_thread_t*         thread,
+  void*                 context
+)
+{
+  SBAuthnLogWriter*     aWriter = (SBAuthnLogWriter*)context;
+  SBAuthnLogRecord      batch[SBAUTHN_LOG_BATCH];
+  apr_pool_t*           pool;
+  int                   done = 0;
+  
+  apr_pool_create(&pool, apr_thread_pool_get(thread));
+  while ( ! done ) {
+    unsigned int        count = 0;
+    unsigned long       dropped;
     
-    attribCount = 0;
-    while ( ldapURL->lud_attrs[attribCount] ) {
-      if ( attribCount != emplidAttribAtIndex )
-        *attribPtr++ = apr_pstrdup(cmd->pool, ldapURL->lud_attrs[attribCount]);
-      attribCount++;
+    apr_thread_mutex_lock(aWriter->lock);
+    if ( ! aWriter->shouldExit && (aWriter->count < SBAUTHN_LOG_BATCH) )
+      apr_thread_cond_timedwait(aWriter->ready, aWriter->lock, SBAUTHN_LOG_FLUSH_INTERVAL);
+    while ( (count < SBAUTHN_LOG_BATCH) && aWriter->count ) {
+      batch[count++] = aWriter->records[aWriter->head];
+      aWriter->head = (aWriter->head + 1) % SBAUTHN_LOG_QUEUE_SIZE;
+      aWriter->count--;
     }
-  }
+    dropped = aWriter->dropped;
+    done = ( aWriter->shouldExit && (aWriter->count == 0) );
+    apr_thread_mutex_unlock(aWriter->lock);
     
-  CFG->ldap.userMatchAttribute = "uid";
-  
+    if ( dropped != aWriter->droppedReported ) {
+      ap_log_error(
+          APLOG_MARK,
+          APLOG_WARNING,
+          0,
+          aWriter->server,
+          "[authn_shuebox] authentication log queue full, %lu record(s) dropped in child %" APR_PID_T_FMT,
+          dropped - aWriter->droppedReported,
+          getpid()
+        );
+      aWriter->droppedReported = dropped;
+    }
+    if ( count ) {
+      __SBAuthnLogWriterFlush(batch, count, pool);
+      apr_pool_clear(pool);
+    }
+  }
+  apr_pool_destroy(pool);
+  apr_thread_exit(thread, APR_SUCCESS);
   return NULL;
 }
 
+/*!
+  @function __SBAuthnLogWriterCleanup
+  
+  Child pool cleanup; stop the writer thread once it has drained the queue.
+*/
+static apr_status_t
+__SBAuthnLogWriterCleanup(
+  void*                 writer
+)
+{
+  SBAuthnLogWriter*     aWriter = (SBAuthnLogWriter*)writer;
+  apr_status_t          rv;
+  
+  if ( aWriter->thread ) {
+    apr_thread_mutex_lock(aWriter->lock);
+    aWriter->shouldExit = 1;
+    apr_thread_cond_signal(aWriter->ready);
+    apr_thread_mutex_unlock(aWriter->lock);
+    apr_thread_join(&rv, aWriter->thread);
+    aWriter->thread = NULL;
+  }
+  return APR_SUCCESS;
+}
 
+#endif
 
 /*!
-  @function SBAuthnzPrepareQuery
+  @function SBAuthnLogWriterChildInit
   
-  Generic configuration-phase database query preparer.
+  Start a child's background log writer.  If that isn't possible, records are
+  logged synchronously by the request, as before.
 */
-static const char* SBAuthnzPrepareQuery(
-  cmd_parms*    cmd,
-  void*         cfg,
-  const char*   query
+static void
+SBAuthnLogWriterChildInit(
+  SBAuthnLogWriter*     aWriter,
+  apr_pool_t*           pool,
+  server_rec*           s
 )
 {
-  static unsigned int   label_num = 0;
-  char*                 label = NULL;
+#if APR_HAS_THREADS
+  apr_status_t          rv;
   
-  /* Just in case we get hit before the optional fns hook: */
-  if ( mod_dbd_prepare == NULL ) {
-    mod_dbd_prepare = APR_RETRIEVE_OPTIONAL_FN(ap_dbd_prepare);
-    if (mod_dbd_prepare == NULL)
-      return "You must load mod_dbd to enable mod_authnz_shuebox";
+  memset(aWriter, 0, sizeof(SBAuthnLogWriter));
+  aWriter->server = s;
+  if ( ! mod_dbd_open || ! mod_dbd_close )
+    return;
+  if ( (rv = apr_thread_mutex_create(&aWriter->lock, APR_THREAD_MUTEX_DEFAULT, pool)) == APR_SUCCESS ) {
+    if ( (rv = apr_thread_cond_create(&aWriter->ready, pool)) == APR_SUCCESS )
+      rv = apr_thread_create(&aWriter->thread, NULL, __SBAuthnLogWriterMain, aWriter, pool);
   }
-    
-  /* Create a unique label for the query: */
-  label = apr_psprintf(cmd->pool, "authnz_shuebox_%u", ++label_num);
-  
-  /* Prepare the query: */
-  mod_dbd_prepare(cmd->server, query, label);
-
-  /* Save the label in our config so we can reference the query
-     later */
-  return ap_set_string_slot(cmd, cfg, label);
+  if ( rv != APR_SUCCESS ) {
+    ap_log_error(
+        APLOG_MARK,
+        APLOG_ERR,
+        rv,
+        s,
+        "[authnz_shuebox] unable to start authentication log writer in child %" APR_PID_T_FMT ", logging synchronously",
+        getpid()
+      );
+    aWriter->thread = NULL;
+    return;
+  }
+  apr_pool_cleanup_register(pool, aWriter, __SBAuthnLogWriterCleanup, apr_pool_cleanup_null);
+#endif
 }
 
 
@@ -723,6 +1721,10 @@ SBAuthnzPostConfig(
   server_rec*   s
 )
 {
+  static const char*      initKey = "authnz_shuebox_post_config";
+  void*                   initData = NULL;
+  SBAuthnzServerConfig*   serverConf = (SBAuthnzServerConfig*)ap_get_module_config(s->module_config, &authnz_shuebox_module);
+  
   /* Make sure we got the LDAP functionality */
   if ( ap_find_linked_module("util_ldap.c") == NULL ) {
     ap_log_error(
@@ -747,10 +1749,58 @@ SBAuthnzPostConfig(
     return HTTP_INTERNAL_SERVER_ERROR;
   }
   
+  /* Startup runs the post-config phase twice; only setup the shared cache on the
+     second (real) pass: */
+  apr_pool_userdata_get(&initData, initKey, s->process->pool);
+  if ( initData == NULL ) {
+    apr_pool_userdata_set((const void*)1, initKey, apr_pool_cleanup_null, s->process->pool);
+    return OK;
+  }
+  
+  /* Failure to setup the caches isn't fatal, we just go to the backends for everything: */
+  SBAuthnzCacheInit(&SBAuthnzCacheDefault, SBAUTHNZ_CACHE_SIZE, SBAUTHNZ_CACHE_TTL, "logs/authnz_shuebox_authn", p, s);
+  if ( serverConf->authzCacheTTL > 0 ) {
+    if ( SBAuthnzCacheInit(&SBAuthzCacheDefault, SBAUTHZ_CACHE_SIZE, apr_time_from_sec(serverConf->authzCacheTTL), "logs/authnz_shuebox_authz", p, s) == APR_SUCCESS ) {
+      if ( ! serverConf->notifyConnInfo ) {
+        ap_log_error(
+            APLOG_MARK,
+            APLOG_NOTICE,
+            0,
+            s,
+            "[authnz_shuebox] no AuthSHUEBoxAuthzNotifyConnection, cached authz decisions will only expire by TTL (%d seconds)",
+            serverConf->authzCacheTTL
+          );
+      }
+      SBAuthzListenerInit(&SBAuthzListenerDefault, serverConf->notifyConnInfo, serverConf->notifyChannel, p, s);
+    }
+  } else {
+    memset(&SBAuthzCacheDefault, 0, sizeof(SBAuthzCacheDefault));
+    memset(&SBAuthzListenerDefault, 0, sizeof(SBAuthzListenerDefault));
+  }
+  
   return OK;
 }
 
 
+/*!
+  @function SBAuthnzChildInit
+  
+  Attach a newly-started child to the shared resources setup in post-config
+  and start its authz listener and authentication log writer threads.
+*/
+static void
+SBAuthnzChildInit(
+  apr_pool_t*   p,
+  server_rec*   s
+)
+{
+  SBAuthnzCacheChildInit(&SBAuthnzCacheDefault, p, s);
+  SBAuthnzCacheChildInit(&SBAuthzCacheDefault, p, s);
+  SBAuthzListenerChildInit(&SBAuthzListenerDefault, p, s);
+  SBAuthnLogWriterChildInit(&SBAuthnLogWriterDefault, p, s);
+}
+
+
 /*!
   @function __SBAuthnzAuthenticate_DBD
   
@@ -923,6 +1973,10 @@ __SBAuthnzAuthenticate_DBD(
   Logging of successful authentication is implicit for guest users, since it goes through
   the database already.  But for domestic users being authn'ed through LDAP, we need to
   follow-up with a logging query to the database.
+  
+  The record is normally handed off to this child's background writer (see
+  SBAuthnLogWriter); only if no writer is running is the query performed here,
+  synchronously.
 */
 static int
 SBAuthnzLogLDAPAuthn(
@@ -932,12 +1986,16 @@ SBAuthnzLogLDAPAuthn(
   const char*     emplid
 )
 {
-  ap_dbd_t*             dbdConn = mod_dbd_acquire(request);
+  ap_dbd_t*             dbdConn = NULL;
   apr_dbd_prepared_t*   queryStatement = NULL;
   apr_dbd_results_t*    queryResult = NULL;
   apr_dbd_row_t*        queryResultRow = NULL;
   int                   rc;
   
+  if ( SBAuthnLogWriterEnqueue(&SBAuthnLogWriterDefault, request->server, shueboxConf->dbd.authnLogQuery, username, emplid) )
+    return 0;
+  
+  dbdConn = mod_dbd_acquire(request);
   if ( dbdConn == NULL ) {
     ap_log_rerror(
         APLOG_MARK,
@@ -1221,14 +2279,30 @@ __SBAuthnzAuthorize_DBD(
   SBAuthzSubType  subType
 )
 {
-  ap_dbd_t*             dbdConn = mod_dbd_acquire(request);
+  ap_dbd_t*             dbdConn = NULL;
+  const char*           repositoryId = ( (subType == kSBAuthzSubTypeRepositoryUser) ? shueboxConf->repositoryId : NULL );
   char*                 queryLabel = NULL;
   apr_dbd_prepared_t*   queryStatement = NULL;
   apr_dbd_results_t*    queryResult = NULL;
   apr_dbd_row_t*        queryResultRow = NULL;
   int                   rc;
   apr_status_t          rv;
+  int                   granted;
+  apr_uint32_t          generation;
+  
+  /* Taken before the query, so an invalidation that lands during it isn't lost: */
+  generation = SBAuthnzCacheGeneration(&SBAuthzCacheDefault);
+  
+  /* A cached decision saves us the database round trip: */
+  if ( SBAuthzCacheLookup(&SBAuthzCacheDefault, subType, shueboxConf->collaborationId, repositoryId, username, &granted) ) {
+#ifdef AUTHNZ_SHUEBOX_DEBUG
+    ap_log_rerror(APLOG_MARK, APLOG_INFO, 0, request,
+        "[authnz_shuebox] - AUTHZ CACHE HIT (subtype = %d) for user '%s' = %d", subType, username, granted);
+#endif
+    return ( granted ? OK : HTTP_UNAUTHORIZED );
+  }
   
+  dbdConn = mod_dbd_acquire(request);
   if ( dbdConn == NULL ) {
     ap_log_rerror(
         APLOG_MARK,
@@ -1374,6 +2448,11 @@ __SBAuthnzAuthorize_DBD(
       }
     }
   }
+  
+  /* Only definitive answers are cached, never errors: */
+  if ( (rc == 0) || (rc == 1) )
+    SBAuthzCacheUpdate(&SBAuthzCacheDefault, subType, shueboxConf->collaborationId, repositoryId, username, rc, generation);
+  
   switch ( rc ) {
     case -1:
       return HTTP_UNAUTHORIZED;
@@ -1418,7 +2497,7 @@ SBAuthnzAuthenticate(
 #endif
 
     //  First and foremost, check our cache:
-    if ( SBAuthnzCacheLookup(&SBAuthnzCacheDefault, username, password, request->pool) == 0 ) {
+    if ( SBAuthnzCacheLookup(&SBAuthnzCacheDefault, username, password) == 0 ) {
     
       //  Here's where we split the task based on the inclusion of an "@" in the username:
       if ( ap_strchr(username, '@') ) {
@@ -1429,7 +2508,7 @@ SBAuthnzAuthenticate(
         
       //  Cache this user:
       if ( rc == AUTH_GRANTED ) {
-        SBAuthnzCacheUpdate(&SBAuthnzCacheDefault, username, password, passwordLen, request->pool);
+        SBAuthnzCacheUpdate(&SBAuthnzCacheDefault, username, password, passwordLen);
       } else {
         ap_note_basic_auth_failure(request);
       }
@@ -1591,6 +2670,8 @@ SBAuthnzImportOptionalFns(
   
   mod_dbd_prepare             = APR_RETRIEVE_OPTIONAL_FN(ap_dbd_prepare);
   mod_dbd_acquire             = APR_RETRIEVE_OPTIONAL_FN(ap_dbd_acquire);
+  mod_dbd_open                = APR_RETRIEVE_OPTIONAL_FN(ap_dbd_open);
+  mod_dbd_close               = APR_RETRIEVE_OPTIONAL_FN(ap_dbd_close);
 }
 
 
@@ -1600,7 +2681,8 @@ SBAuthnzImportOptionalFns(
   
   At module load, create our hooks into the authentication stack and the
   authorization chain.  Also setup hook to retrieve external module functions
-  that we use and do post-configuration checks.
+  that we use, do post-configuration checks and setup the shared cache, and
+  attach children to that cache.
 */
 static void
 SBAuthnzRegisterHooks(
@@ -1633,8 +2715,6 @@ SBAuthnzRegisterHooks(
       );
   }
   
-  SBAuthnzCacheInit(&SBAuthnzCacheDefault, p, NULL);
-  
   /* Post-configuration processing: */
   ap_hook_post_config(
       SBAuthnzPostConfig,
@@ -1643,6 +2723,14 @@ SBAuthnzRegisterHooks(
       APR_HOOK_MIDDLE
     );
   
+  /* Attach children to the shared authentication cache: */
+  ap_hook_child_init(
+      SBAuthnzChildInit,
+      NULL,
+      NULL,
+      APR_HOOK_MIDDLE
+    );
+  
   /* Hook into the authorization chain */
   ap_hook_auth_checker(
       SBAuthnzAuthorize,
@@ -1753,6 +2841,30 @@ static const command_rec SBAuthnzConfigCmdTbl[] = {
       "search on the branch <b>ou=People, o=Airius</b>."
     ),
   
+  AP_INIT_TAKE1(
+      "AuthSHUEBoxAuthzCacheTTL",
+      SBAuthnzServerConfigSetAuthzCacheTTL,
+      NULL,
+      RSRC_CONF,
+      "Number of seconds an authorization decision is cached (0 disables the cache)"
+    ),
+  
+  AP_INIT_TAKE1(
+      "AuthSHUEBoxAuthzNotifyConnection",
+      SBAuthnzServerConfigSetString,
+      (void *)APR_OFFSETOF(SBAuthnzServerConfig, notifyConnInfo),
+      RSRC_CONF,
+      "Postgres connection string used to LISTEN for authorization changes"
+    ),
+  
+  AP_INIT_TAKE1(
+      "AuthSHUEBoxAuthzNotifyChannel",
+      SBAuthnzServerConfigSetString,
+      (void *)APR_OFFSETOF(SBAuthnzServerConfig, notifyChannel),
+      RSRC_CONF,
+      "Postgres NOTIFY channel announcing authorization changes (default: authzChange)"
+    ),
+  
   AP_INIT_FLAG("AuthSHUEBoxAuthoritative", ap_set_flag_slot,
                (void *)APR_OFFSETOF(SBAuthnzConfig, authoritative),
                OR_AUTHCFG,
@@ -1776,7 +2888,7 @@ module AP_MODULE_DECLARE_DATA authnz_shuebox_module =
   STANDARD20_MODULE_STUFF,
   SBAuthnzConfigCreate,            /* dir config creater */
   SBAuthnzConfigMerge,             /* dir merger --- default is to override */
-  NULL,                            /* server config */
+  SBAuthnzServerConfigCreate,      /* server config */
   NULL,                            /* merge server config */
   SBAuthnzConfigCmdTbl,            /* command apr_table_t */
   SBAuthnzRegisterHooks            /* register hooks */
@@ -14,6 +14,14 @@
 #include "http_config.h"
 #include "http_log.h"
 #include "mod_dav.h"
+#include "http_protocol.h"
+#include "mod_status.h"
+#include "apr_hash.h"
+#if APR_HAS_THREADS
+#include "apr_thread_mutex.h"
+#endif
+
+#include <unistd.h>
 
 static const char*    mod_dav_zfsquota_versionstr = "DAVZFSQuota/0.1";
 static char*          mod_dav_zfsquota_baseDevicePath = NULL;
@@ -24,103 +32,352 @@ static char*          mod_dav_zfsquota_baseDevicePath = NULL;
 #include <libzfs.h>
 #include <sys/fs/zfs.h>
 
+#ifndef DAV_ZFSQUOTA_CACHE_TTL
+/*
+  Default number of seconds a dataset's quota properties are cached before
+  libzfs is consulted again (see DAVZFSQuotaCacheTTL).
+*/
+#define DAV_ZFSQUOTA_CACHE_TTL 10
+#endif
+
+#ifndef DAV_ZFSQUOTA_CACHE_MAX
+/*
+  Number of datasets the per-process cache will hold before it purges expired
+  entries (or, failing that, everything) to make room.
+*/
+#define DAV_ZFSQUOTA_CACHE_MAX 1024
+#endif
+
+static apr_interval_time_t  mod_dav_zfsquota_cacheTTL = apr_time_from_sec(DAV_ZFSQUOTA_CACHE_TTL);
+
+/*
+ * The quota properties of a single dataset.  Entries in the per-process cache
+ * are recycled through a free list, so the cache pool never grows beyond
+ * DAV_ZFSQUOTA_CACHE_MAX entries.
+ */
+typedef struct dav_zfsquota_entry {
+  struct dav_zfsquota_entry*  next;
+  char*                       dataset;
+  apr_size_t                  datasetSize;
+  apr_time_t                  expires;
+  uint64_t                    capacity;
+  uint64_t                    used;
+  uint64_t                    avail;
+} dav_zfsquota_entry;
+
+/*
+ * Per-process cache of dataset quota properties, keyed by dataset name.  The
+ * cache lock guards the hash, free list and counters; the libzfs lock
+ * serializes use of the (non-thread-safe) libzfs handle, so a slow zfs_open
+ * never holds up cache hits in other threads.
+ */
+static struct {
+  apr_pool_t*                 pool;
+#if APR_HAS_THREADS
+  apr_thread_mutex_t*         lock;
+  apr_thread_mutex_t*         libzfsLock;
+#endif
+  apr_hash_t*                 entries;
+  dav_zfsquota_entry*         freeList;
+  libzfs_handle_t*            libHandle;
+  apr_uint64_t                hits;
+  apr_uint64_t                misses;
+  apr_uint64_t                requestHits;
+} dav_zfsquota_cache;
+
+#if APR_HAS_THREADS
+#define DAV_ZFSQUOTA_LOCK(L)    if ( L ) apr_thread_mutex_lock(L)
+#define DAV_ZFSQUOTA_UNLOCK(L)  if ( L ) apr_thread_mutex_unlock(L)
+#else
+#define DAV_ZFSQUOTA_LOCK(L)
+#define DAV_ZFSQUOTA_UNLOCK(L)
+#endif
+
+/**/
+
+static void
+dav_zfsquota_cache_init(
+  apr_pool_t*   p,
+  server_rec*   s
+)
+{
+  if ( apr_pool_create(&dav_zfsquota_cache.pool, p) != APR_SUCCESS ) {
+    ap_log_error(APLOG_MARK, APLOG_ERR, 0, s, "mod_dav_zfsquota: unable to create cache pool");
+    dav_zfsquota_cache.pool = NULL;
+    return;
+  }
+#if APR_HAS_THREADS
+  if ( (apr_thread_mutex_create(&dav_zfsquota_cache.lock, APR_THREAD_MUTEX_DEFAULT, dav_zfsquota_cache.pool) != APR_SUCCESS) ||
+       (apr_thread_mutex_create(&dav_zfsquota_cache.libzfsLock, APR_THREAD_MUTEX_DEFAULT, dav_zfsquota_cache.pool) != APR_SUCCESS) )
+  {
+    ap_log_error(APLOG_MARK, APLOG_ERR, 0, s, "mod_dav_zfsquota: unable to create cache locks");
+    apr_pool_destroy(dav_zfsquota_cache.pool);
+    dav_zfsquota_cache.pool = NULL;
+    return;
+  }
+#endif
+  dav_zfsquota_cache.entries = apr_hash_make(dav_zfsquota_cache.pool);
+}
 
-static libzfs_handle_t*
-dav_zfsquota_libHandle(void)
+/**/
+
+/*
+ * Make room in the cache; called with the cache lock held.  Expired entries
+ * go first; if everything is still live, the whole cache is dropped.
+ */
+static void
+dav_zfsquota_cache_purge(
+  apr_time_t    now
+)
 {
-  static libzfs_handle_t* defaultZFSLibHandle = NULL;
+  apr_hash_index_t*   hi = apr_hash_first(NULL, dav_zfsquota_cache.entries);
+  int                 purgeAll = 0;
   
-  if ( defaultZFSLibHandle == NULL ) {
-    defaultZFSLibHandle = libzfs_init();
+  while ( 1 ) {
+    while ( hi ) {
+      dav_zfsquota_entry*   entry;
+      
+      apr_hash_this(hi, NULL, NULL, (void**)&entry);
+      hi = apr_hash_next(hi);
+      if ( purgeAll || (entry->expires <= now) ) {
+        apr_hash_set(dav_zfsquota_cache.entries, entry->dataset, APR_HASH_KEY_STRING, NULL);
+        entry->next = dav_zfsquota_cache.freeList;
+        dav_zfsquota_cache.freeList = entry;
+      }
+    }
+    if ( purgeAll || (apr_hash_count(dav_zfsquota_cache.entries) < DAV_ZFSQUOTA_CACHE_MAX) )
+      break;
+    purgeAll = 1;
+    hi = apr_hash_first(NULL, dav_zfsquota_cache.entries);
   }
-  return defaultZFSLibHandle;
 }
 
 /**/
 
+/*
+ * Copy the properties of dataset from the cache into *props; called with the
+ * cache lock held.
+ */
 static int
-dav_zfsquota_getProps(
-  const char* uri,
-  uint64_t*   capacity,
-  uint64_t*   used,
-  uint64_t*   avail,
-  apr_pool_t* pool
+dav_zfsquota_cache_get(
+  const char*           dataset,
+  apr_time_t            now,
+  dav_zfsquota_entry*   props
+)
+{
+  dav_zfsquota_entry*   entry = apr_hash_get(dav_zfsquota_cache.entries, dataset, APR_HASH_KEY_STRING);
+  
+  if ( entry && (entry->expires > now) ) {
+    props->capacity = entry->capacity;
+    props->used = entry->used;
+    props->avail = entry->avail;
+    return 1;
+  }
+  return 0;
+}
+
+/**/
+
+/*
+ * Record the properties of dataset in the cache; called with the cache lock
+ * held.
+ */
+static void
+dav_zfsquota_cache_put(
+  const char*           dataset,
+  apr_time_t            now,
+  dav_zfsquota_entry*   props
 )
 {
-  libzfs_handle_t*    libHandle = dav_zfsquota_libHandle();
-  static char*        path = NULL;
-  static size_t       pathLen = 0;
-  static size_t       basePathLen = 0;
+  dav_zfsquota_entry*   entry = apr_hash_get(dav_zfsquota_cache.entries, dataset, APR_HASH_KEY_STRING);
   
-  size_t              uriPortionLen = 0;
-  int                 slashCount = 0;
-  char*               newPath = (char*)uri;
+  if ( ! entry ) {
+    apr_size_t          datasetSize = strlen(dataset) + 1;
+    
+    if ( apr_hash_count(dav_zfsquota_cache.entries) >= DAV_ZFSQUOTA_CACHE_MAX )
+      dav_zfsquota_cache_purge(now);
+    
+    if ( (entry = dav_zfsquota_cache.freeList) ) {
+      dav_zfsquota_cache.freeList = entry->next;
+    } else {
+      entry = apr_pcalloc(dav_zfsquota_cache.pool, sizeof(dav_zfsquota_entry));
+    }
+    if ( entry->datasetSize < datasetSize ) {
+      entry->dataset = apr_palloc(dav_zfsquota_cache.pool, datasetSize);
+      entry->datasetSize = datasetSize;
+    }
+    memcpy(entry->dataset, dataset, datasetSize);
+    apr_hash_set(dav_zfsquota_cache.entries, entry->dataset, APR_HASH_KEY_STRING, entry);
+  }
+  entry->expires = now + mod_dav_zfsquota_cacheTTL;
+  entry->capacity = props->capacity;
+  entry->used = props->used;
+  entry->avail = props->avail;
+}
+
+/**/
+
+/*
+ * Ask libzfs for the properties of dataset; called with the libzfs lock
+ * held.
+ */
+static int
+dav_zfsquota_fetchProps(
+  const char*           dataset,
+  dav_zfsquota_entry*   props
+)
+{
+  zfs_handle_t*         fsHandle;
   
-  if ( path == NULL ) {
-    basePathLen = strlen(mod_dav_zfsquota_baseDevicePath);
+  if ( dav_zfsquota_cache.libHandle == NULL ) {
+    dav_zfsquota_cache.libHandle = libzfs_init();
+    if ( dav_zfsquota_cache.libHandle == NULL )
+      return 1;
   }
+  if ( (fsHandle = zfs_open(dav_zfsquota_cache.libHandle, dataset, ZFS_TYPE_ANY)) == NULL )
+    return 1;
+  props->used = zfs_prop_get_int(fsHandle, ZFS_PROP_USED);
+  props->capacity = zfs_prop_get_int(fsHandle, ZFS_PROP_QUOTA);
+  props->avail = zfs_prop_get_int(fsHandle, ZFS_PROP_AVAILABLE);
+  zfs_close(fsHandle);
+  return 0;
+}
+
+/**/
+
+/*
+ * Retrieve the quota properties for the dataset backing uri:  the dataset is
+ * the base device path plus the first component of the uri.
+ *
+ * Lookups are satisfied, in order, from the request pool (so a PROPFIND
+ * opens each dataset at most once, no matter how many resources and
+ * properties it lists), from the per-process cache, and finally from libzfs.
+ */
+static int
+dav_zfsquota_getProps(
+  const char*           uri,
+  dav_zfsquota_entry*   props,
+  apr_pool_t*           pool
+)
+{
+  size_t                basePathLen = strlen(mod_dav_zfsquota_baseDevicePath);
+  size_t                uriPortionLen = 0;
+  int                   slashCount = 0;
+  const char*           p = uri;
+  char*                 dataset;
+  char*                 memoKey;
+  dav_zfsquota_entry*   memo = NULL;
+  apr_time_t            now;
+  int                   rc = 1;
   
-  while ( (slashCount < 2) && *newPath ) {
-    if ( *newPath == '/' ) {
+  while ( (slashCount < 2) && *p ) {
+    if ( *p == '/' ) {
       if ( ++slashCount < 2 )
         uriPortionLen++;
     } else {
       uriPortionLen++;
     }
-    newPath++;
+    p++;
+  }
+  if ( uriPortionLen == 0 )
+    return 1;
+  
+  dataset = apr_palloc(pool, basePathLen + uriPortionLen + 1);
+  memcpy(dataset, mod_dav_zfsquota_baseDevicePath, basePathLen);
+  memcpy(dataset + basePathLen, uri, uriPortionLen);
+  dataset[basePathLen + uriPortionLen] = '\0';
+  
+  /* Already looked this dataset up for this request? */
+  memoKey = apr_pstrcat(pool, "dav_zfsquota:", dataset, NULL);
+  apr_pool_userdata_get((void**)&memo, memoKey, pool);
+  if ( memo ) {
+    *props = *memo;
+    DAV_ZFSQUOTA_LOCK(dav_zfsquota_cache.lock);
+    dav_zfsquota_cache.requestHits++;
+    DAV_ZFSQUOTA_UNLOCK(dav_zfsquota_cache.lock);
+    return 0;
   }
   
-  if ( uriPortionLen ) {
-    size_t              newSize = basePathLen + uriPortionLen + 1;
+  if ( dav_zfsquota_cache.entries == NULL ) {
+    /* No cache in this process, go straight to libzfs: */
+    DAV_ZFSQUOTA_LOCK(dav_zfsquota_cache.libzfsLock);
+    rc = dav_zfsquota_fetchProps(dataset, props);
+    DAV_ZFSQUOTA_UNLOCK(dav_zfsquota_cache.libzfsLock);
+  } else {
+    now = apr_time_now();
+    DAV_ZFSQUOTA_LOCK(dav_zfsquota_cache.lock);
+    if ( dav_zfsquota_cache_get(dataset, now, props) ) {
+      dav_zfsquota_cache.hits++;
+      rc = 0;
+    }
+    DAV_ZFSQUOTA_UNLOCK(dav_zfsquota_cache.lock);
     
-    newPath = NULL;
-    if ( pathLen < newSize ) {
-      if ( path ) {
-        if ( (path = newPath = malloc(newSize)) ) {
-          pathLen = newSize;
-        }
-      } else {
-        if ( (newPath = realloc(path, newSize)) ) {
-          path = newPath;
-          pathLen = newSize;
-        }
+    if ( rc ) {
+      DAV_ZFSQUOTA_LOCK(dav_zfsquota_cache.libzfsLock);
+      
+      /* Another thread may have fetched it while we waited for libzfs: */
+      DAV_ZFSQUOTA_LOCK(dav_zfsquota_cache.lock);
+      if ( dav_zfsquota_cache_get(dataset, now, props) ) {
+        dav_zfsquota_cache.hits++;
+        rc = 0;
       }
-    } else {
-      newPath = path;
-    }
-    if ( newPath ) {
-      memcpy(path, mod_dav_zfsquota_baseDevicePath, basePathLen);
-      memcpy(path + basePathLen, uri, uriPortionLen);
-      path[basePathLen + uriPortionLen] = '\0';
-      if ( libHandle ) {
-        zfs_handle_t*     fsHandle = zfs_open(libHandle, path, ZFS_TYPE_ANY);
-        
-        if ( fsHandle ) {
-          if ( used ) {
-            *used = zfs_prop_get_int(
-                        fsHandle,
-                        ZFS_PROP_USED
-                      );
-          }
-          if ( capacity ) {
-            *capacity = zfs_prop_get_int(
-                          fsHandle,
-                          ZFS_PROP_QUOTA
-                        );
-          }
-          if ( avail ) {
-            *avail = zfs_prop_get_int(
-                        fsHandle,
-                        ZFS_PROP_AVAILABLE
-                      );
-          }
-          zfs_close(fsHandle);
-          return 0;
-        }
+      DAV_ZFSQUOTA_UNLOCK(dav_zfsquota_cache.lock);
+      
+      if ( rc && ((rc = dav_zfsquota_fetchProps(dataset, props)) == 0) ) {
+        DAV_ZFSQUOTA_LOCK(dav_zfsquota_cache.lock);
+        dav_zfsquota_cache.misses++;
+        if ( mod_dav_zfsquota_cacheTTL > 0 )
+          dav_zfsquota_cache_put(dataset, now, props);
+        DAV_ZFSQUOTA_UNLOCK(dav_zfsquota_cache.lock);
       }
+      DAV_ZFSQUOTA_UNLOCK(dav_zfsquota_cache.libzfsLock);
     }
   }
-  return 1;
+  
+  if ( rc == 0 ) {
+    memo = apr_pmemdup(pool, props, sizeof(dav_zfsquota_entry));
+    apr_pool_userdata_setn(memo, memoKey, NULL, pool);
+  }
+  return rc;
+}
+
+/**/
+
+/*
+ * mod_status hook:  report this process' cache counters on the server-status
+ * page.
+ */
+static int
+dav_zfsquota_status(
+  request_rec*  r,
+  int           flags
+)
+{
+  apr_uint64_t  hits, misses, requestHits;
+  unsigned int  count = 0;
+  
+  DAV_ZFSQUOTA_LOCK(dav_zfsquota_cache.lock);
+  hits = dav_zfsquota_cache.hits;
+  misses = dav_zfsquota_cache.misses;
+  requestHits = dav_zfsquota_cache.requestHits;
+  if ( dav_zfsquota_cache.entries )
+    count = apr_hash_count(dav_zfsquota_cache.entries);
+  DAV_ZFSQUOTA_UNLOCK(dav_zfsquota_cache.lock);
+  
+  if ( flags & AP_STATUS_SHORT ) {
+    ap_rprintf(r, "DAVZFSQuotaCacheHits: %" APR_UINT64_T_FMT "\n", hits);
+    ap_rprintf(r, "DAVZFSQuotaCacheMisses: %" APR_UINT64_T_FMT "\n", misses);
+    ap_rprintf(r, "DAVZFSQuotaRequestHits: %" APR_UINT64_T_FMT "\n", requestHits);
+    ap_rprintf(r, "DAVZFSQuotaCacheEntries: %u\n", count);
+  } else {
+    ap_rputs("<hr />\n<h2>DAV ZFS quota cache (pid ", r);
+    ap_rprintf(r, "%" APR_PID_T_FMT ")</h2>\n<dl>\n", getpid());
+    ap_rprintf(r, "<dt>Cache hits: %" APR_UINT64_T_FMT "</dt>\n", hits);
+    ap_rprintf(r, "<dt>Cache misses: %" APR_UINT64_T_FMT "</dt>\n", misses);
+    ap_rprintf(r, "<dt>Same-request hits: %" APR_UINT64_T_FMT "</dt>\n", requestHits);
+    ap_rprintf(r, "<dt>Cached datasets: %u</dt>\n</dl>\n", count);
+  }
+  return OK;
 }
 
 /**/
@@ -189,6 +446,7 @@ dav_zfsquota_insert_prop(
   const dav_liveprop_spec*  info;
   long                      global_ns;
   uint64_t                  value;
+  dav_zfsquota_entry        props;
 
   if ( mod_dav_zfsquota_baseDevicePath == NULL ) {
     return DAV_PROP_INSERT_NOTSUPP;
@@ -197,17 +455,19 @@ dav_zfsquota_insert_prop(
   switch (propid) {
   
     case DAV_PROPID_quotabytesavail: {
-      if ( dav_zfsquota_getProps(resource->uri, NULL, NULL, &value, p) != 0 ) {
+      if ( dav_zfsquota_getProps(resource->uri, &props, p) != 0 ) {
         return DAV_PROP_INSERT_NOTSUPP;
       }
+      value = props.avail;
       break;
     }
     
     case DAV_PROPID_quotaused:
     case DAV_PROPID_quotabytesused: {
-      if ( dav_zfsquota_getProps(resource->uri, NULL, &value, NULL, p) != 0 ) {
+      if ( dav_zfsquota_getProps(resource->uri, &props, p) != 0 ) {
         return DAV_PROP_INSERT_NOTSUPP;
       }
+      value = props.used;
       if ( propid == DAV_PROPID_quotaused ) {
         value /= 512;
       }
@@ -216,9 +476,10 @@ dav_zfsquota_insert_prop(
     
     case DAV_PROPID_quota:
     case DAV_PROPID_quotabytes: {
-      if ( dav_zfsquota_getProps(resource->uri, &value, NULL, NULL, p) != 0 ) {
+      if ( dav_zfsquota_getProps(resource->uri, &props, p) != 0 ) {
         return DAV_PROP_INSERT_NOTSUPP;
       }
+      value = props.capacity;
       if ( propid == DAV_PROPID_quota ) {
         value /= 512;
       }
@@ -354,6 +615,25 @@ dav_zfsquota_cmd_devicebase(
 
 /**/
 
+static const char*
+dav_zfsquota_cmd_cachettl(
+  cmd_parms*    cmd,
+  void*         config,
+  const char*   arg1
+)
+{
+  char*         end = NULL;
+  long          ttl = strtol(arg1, &end, 10);
+  
+  if ( ! end || *end || (ttl < 0) ) {
+    return "DAVZFSQuotaCacheTTL must be a non-negative number of seconds.";
+  }
+  mod_dav_zfsquota_cacheTTL = apr_time_from_sec(ttl);
+  return NULL;
+}
+
+/**/
+
 static const command_rec dav_zfsquota_commands[] =
 {
   AP_INIT_TAKE1(
@@ -363,6 +643,13 @@ static const command_rec dav_zfsquota_commands[] =
       RSRC_CONF,
       "Base ZFS device path for DAV quota properties"
     ),
+  AP_INIT_TAKE1(
+      "DAVZFSQuotaCacheTTL",
+      dav_zfsquota_cmd_cachettl,
+      NULL,
+      RSRC_CONF,
+      "Seconds to cache a dataset's quota properties (0 disables the cache)"
+    ),
   { NULL }
 };
 
@@ -381,6 +668,17 @@ dav_zfsquota_find_liveprop(
 
 /**/
 
+static void
+dav_zfsquota_child_init(
+  apr_pool_t*       p,
+  server_rec*       s
+)
+{
+  dav_zfsquota_cache_init(p, s);
+}
+
+/**/
+
 static void
 dav_zfsquota_register_hooks(
   apr_pool_t*       p
@@ -390,6 +688,10 @@ dav_zfsquota_register_hooks(
      providers: */
   dav_hook_find_liveprop(dav_zfsquota_find_liveprop, NULL, NULL, APR_HOOK_FIRST);
   
+  /* Per-process property cache, and its counters on the server-status page: */
+  ap_hook_child_init(dav_zfsquota_child_init, NULL, NULL, APR_HOOK_MIDDLE);
+  APR_OPTIONAL_HOOK(ap, status_hook, dav_zfsquota_status, NULL, NULL, APR_HOOK_MIDDLE);
+  
   /* Register our DAV properties: */
   dav_zfsquota_register_uris(p);
   
@@ -1610,6 +1610,104 @@ handleCollaborationRequest(
 #endif
 //
 
+void
+handleRequest(
+  void*                 context
+)
+{
+  SBPostgresDatabase*   theDatabase = (SBPostgresDatabase*)context;
+  
+  //
+  // The connection persists across requests under FastCGI; if the server went away
+  // since the last request, get a new one before going any further:
+  //
+  if ( PQstatus([theDatabase databaseConnection]) != CONNECTION_OK ) {
+    if ( ! [theDatabase reconnect] ) {
+      [SBDefaultLogFile writeFormatToLog:"Unable to reestablish connection to database!"];
+      printf("Status: 503 Service Unavailable\r\nContent-type: text/plain\r\n\r\nDatabase unavailable.\n");
+      return;
+    }
+  }
+  
+  SHUEBoxCGI*         theCGI = [[SHUEBoxCGI alloc] initWithDatabase:theDatabase];
+  
+  if ( theCGI ) {
+    SHUEBoxCGITarget  theTarget = [theCGI target];
+    SBError*          theError = [theCGI lastError];
+    
+    if ( theError ) {
+      [theCGI sendErrorDocument:@"Invalid request" description:@"The request could not be interpreted by this CGI." forError:theError];
+    } else {
+      switch ( theTarget ) {
+        case kSHUEBoxCGITargetCollaboration:
+        case kSHUEBoxCGITargetCollaborationRepository:
+        case kSHUEBoxCGITargetCollaborationRepositoryRole:
+        case kSHUEBoxCGITargetCollaborationRole:
+        case kSHUEBoxCGITargetCollaborationRoleMember:
+        case kSHUEBoxCGITargetCollaborationMember: {
+          SHUEBoxCollaboration*   theCollaboration = [theCGI targetCollaboration];
+          
+          if ( theCollaboration ) {
+            //
+            // Got a collaboration, where do we go from here:
+            //
+            switch ( theTarget ) {
+            
+              case kSHUEBoxCGITargetCollaboration: {
+                handleCollaborationRequest(theDatabase, theCGI, theCollaboration);
+                break;
+              }
+            
+              case kSHUEBoxCGITargetCollaborationRepository: {
+                handleRepositoryRequest(theDatabase, theCGI, theCollaboration, [theCGI targetRepository]);
+                break;
+              }
+              
+              case kSHUEBoxCGITargetCollaborationRepositoryRole: {
+                handleRepositoryRoleRequest(theDatabase, theCGI, theCollaboration, [theCGI targetRepository], [theCGI targetSHUEBoxRole]);
+                break;
+              }
+              
+              case kSHUEBoxCGITargetCollaborationRole: {
+                handleRoleRequest(theDatabase, theCGI, theCollaboration, [theCGI targetSHUEBoxRole]);
+                break;
+              }
+              
+              case kSHUEBoxCGITargetCollaborationRoleMember: {
+                handleRoleMembershipRequest(theDatabase, theCGI, theCollaboration, [theCGI targetSHUEBoxRole], [theCGI targetSHUEBoxRoleMember]);
+                break;
+              }
+              
+              case kSHUEBoxCGITargetCollaborationMember: {
+                handleUserRequest(theDatabase, theCGI, theCollaboration, [theCGI targetSHUEBoxUser]);
+                break;
+              }
+              
+            }
+          } else {
+            [theCGI sendErrorDocument:@"No such collaboration" description:@"The collaboration associated with the URL could not be loaded." forError:nil];
+          }
+          break;
+        }
+        
+        case kSHUEBoxCGITargetKeepAlive: {
+          handleKeepAlive(theDatabase, theCGI);
+          break;
+        }
+        
+        default:
+          [theCGI sendErrorDocument:@"Invalid request" description:[SBString stringWithFormat:"The implied request target is not handled by this CGI: %S", [[theCGI pathInfo] utf16Characters]] forError:nil];
+          break;
+      }
+    }
+    [theCGI release];
+  } else {
+    [theCGI sendErrorDocument:@"Invalid request" description:@"The request could not be interpreted by this CGI." forError:nil];
+  }
+}
+
+//
+
 int
 main()
 {
@@ -1625,81 +1723,9 @@ main()
   SBPostgresDatabase*   theDatabase = [[SBPostgresDatabase alloc] initWithConnectionString:SBDefaultDatabaseConnStr];
   
   if ( theDatabase ) {
-    SHUEBoxCGI*         theCGI = [[SHUEBoxCGI alloc] initWithDatabase:theDatabase];
-    
-    if ( theCGI ) {
-      SHUEBoxCGITarget  theTarget = [theCGI target];
-      SBError*          theError = [theCGI lastError];
-      
-      if ( theError ) {
-        [theCGI sendErrorDocument:@"Invalid request" description:@"The request could not be interpreted by this CGI." forError:theError];
-      } else {
-        switch ( theTarget ) {
-          case kSHUEBoxCGITargetCollaboration:
-          case kSHUEBoxCGITargetCollaborationRepository:
-          case kSHUEBoxCGITargetCollaborationRepositoryRole:
-          case kSHUEBoxCGITargetCollaborationRole:
-          case kSHUEBoxCGITargetCollaborationRoleMember:
-          case kSHUEBoxCGITargetCollaborationMember: {
-            SHUEBoxCollaboration*   theCollaboration = [theCGI targetCollaboration];
-            
-            if ( theCollaboration ) {
-              //
-              // Got a collaboration, where do we go from here:
-              //
-              switch ( theTarget ) {
-              
-                case kSHUEBoxCGITargetCollaboration: {
-                  handleCollaborationRequest(theDatabase, theCGI, theCollaboration);
-                  break;
-                }
-              
-                case kSHUEBoxCGITargetCollaborationRepository: {
-                  handleRepositoryRequest(theDatabase, theCGI, theCollaboration, [theCGI targetRepository]);
-                  break;
-                }
-                
-                case kSHUEBoxCGITargetCollaborationRepositoryRole: {
-                  handleRepositoryRoleRequest(theDatabase, theCGI, theCollaboration, [theCGI targetRepository], [theCGI targetSHUEBoxRole]);
-                  break;
-                }
-                
-                case kSHUEBoxCGITargetCollaborationRole: {
-                  handleRoleRequest(theDatabase, theCGI, theCollaboration, [theCGI targetSHUEBoxRole]);
-                  break;
-                }
-                
-                case kSHUEBoxCGITargetCollaborationRoleMember: {
-                  handleRoleMembershipRequest(theDatabase, theCGI, theCollaboration, [theCGI targetSHUEBoxRole], [theCGI targetSHUEBoxRoleMember]);
-                  break;
-                }
-                
-                case kSHUEBoxCGITargetCollaborationMember: {
-                  handleUserRequest(theDatabase, theCGI, theCollaboration, [theCGI targetSHUEBoxUser]);
-                  break;
-                }
-                
-              }
-            } else {
-              [theCGI sendErrorDocument:@"No such collaboration" description:@"The collaboration associated with the URL could not be loaded." forError:nil];
-            }
-            break;
-          }
-          
-          case kSHUEBoxCGITargetKeepAlive: {
-            handleKeepAlive(theDatabase, theCGI);
-            break;
-          }
-          
-          default:
-            [theCGI sendErrorDocument:@"Invalid request" description:[SBString stringWithFormat:"The implied request target is not handled by this CGI: %S", [[theCGI pathInfo] utf16Characters]] forError:nil];
-            break;
-        }
-      }
-      [theCGI release];
-    } else {
-      [theCGI sendErrorDocument:@"Invalid request" description:@"The request could not be interpreted by this CGI." forError:nil];
-    }
+    // Persistent across FastCGI requests, so the same queries come around again and again:
+    [theDatabase setStatementCacheSize:SBPostgresDefaultStatementCacheSize];
+    [SBCGI runRequestLoopWithHandler:handleRequest context:theDatabase];
     [theDatabase release];
   } else {
 		[SBDefaultLogFile writeFormatToLog:"Unable to establish connection to database!"];
@@ -16,18 +16,11 @@ UChar SBUnknownRemoteAddr[9] = { '?' , '.', '?' , '.', '?' , '.', '?' , '\0' };
 
 //
 
-int
-main()
+void
+handleRequest(
+  void*          context
+)
 {
-  SBAutoreleasePool*    pool = [[SBAutoreleasePool alloc] init];
-	
-#ifdef LOG_DIR
-	const char*						logDir = LOG_DIR;
-	
-	[SBLogger setBaseLoggingPath:[SBString stringWithUTF8String:logDir]];
-#endif
-	SBDefaultLogFile = [[SBLogger loggerWithFileAtPath:@"demo.log"] retain];
-  
   SBCGI*         theCGI = [[SBCGI alloc] init];
     
   if ( theCGI ) {
@@ -50,6 +43,23 @@ main()
     [theCGI sendResponse];
     [theCGI release];
   }
+}
+
+//
+
+int
+main()
+{
+  SBAutoreleasePool*    pool = [[SBAutoreleasePool alloc] init];
+	
+#ifdef LOG_DIR
+	const char*						logDir = LOG_DIR;
+	
+	[SBLogger setBaseLoggingPath:[SBString stringWithUTF8String:logDir]];
+#endif
+	SBDefaultLogFile = [[SBLogger loggerWithFileAtPath:@"demo.log"] retain];
+  
+  [SBCGI runRequestLoopWithHandler:handleRequest context:NULL];
   
   fflush(stdout);
   [pool release];
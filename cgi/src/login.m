@@ -143,6 +143,81 @@ sendUserDescription(
 #endif
 //
 
+void
+handleRequest(
+  void*                 context
+)
+{
+  SBPostgresDatabase*   theDatabase = (SBPostgresDatabase*)context;
+  
+  //
+  // The connection persists across requests under FastCGI; if the server went away
+  // since the last request, get a new one before going any further:
+  //
+  if ( PQstatus([theDatabase databaseConnection]) != CONNECTION_OK ) {
+    if ( ! [theDatabase reconnect] ) {
+      [SBDefaultLogFile writeFormatToLog:"Unable to reestablish connection to database!"];
+      printf("Status: 503 Service Unavailable\r\nContent-type: text/plain\r\n\r\nDatabase unavailable.\n");
+      return;
+    }
+  }
+  
+  SHUEBoxCGI*         theCGI = [[SHUEBoxCGI alloc] initWithDatabase:theDatabase];
+  
+  if ( theCGI ) {
+    SHUEBoxCGITarget  theTarget = [theCGI target];
+    SBError*          theError = [theCGI lastError];
+    
+    if ( theError ) {
+      [theCGI sendErrorDocument:@"Invalid request" description:@"The request could not be interpreted by this CGI." forError:theError];
+    } else if ( theTarget != kSHUEBoxCGITargetLoginHelper ) {
+      [theCGI sendErrorDocument:@"Invalid request" description:@"The implied request target is not handled by this CGI." forError:nil];
+    } else {
+      //
+      // There need to be a "u" and "p" CGI parameter for this to work:
+      //
+      SBString*     uname = [theCGI queryArgumentForKey:@"u"];
+      SBString*     password = [theCGI queryArgumentForKey:@"p"];
+      char*         remoteAddr = getenv("REMOTE_ADDR");
+      
+      if ( uname && [uname length] && remoteAddr ) {
+        SHUEBoxUser*  targetUser = [SHUEBoxUser shueboxUserWithDatabase:theDatabase shortName:uname];
+        
+        if ( targetUser ) {
+          if ( [targetUser authenticateUsingPassword:password] ) {
+            [SBDefaultLogFile writeFormatToLog:"Authentication succeeded:  %S [%s]", [uname utf16Characters], ( remoteAddr ? remoteAddr : "?.?.?.?" )];
+            
+            // Set our auth cookie:
+            SHUEBoxAuthCookie*    cookie = [[SHUEBoxAuthCookie alloc] initWithUser:targetUser inetAddress:[SBInetAddress inetAddressWithCString:remoteAddr]];
+            
+            [theCGI setResponseHeaderValue:[cookie asString] forName:@"Set-Cookie"];
+            [cookie release];
+            sendUserDescription(theDatabase, theCGI, targetUser);
+            [theCGI sendResponse];
+          } else {
+            [theCGI sendErrorDocument:@"Authentication failed" description:@"The provided password was incorrect." forError:nil];
+            [SBDefaultLogFile writeFormatToLog:"Authentication failure:  %S [%s]", [uname utf16Characters], ( remoteAddr ? remoteAddr : "?.?.?.?" )];
+          }
+        } else {
+          [theCGI sendErrorDocument:@"Invalid request" description:@"User not registered with SHUEBox." forError:nil];
+          [SBDefaultLogFile writeFormatToLog:"Unrecognized user id:  %S [%s]", [uname utf16Characters], ( remoteAddr ? remoteAddr : "?.?.?.?" )];
+        }
+      } else {
+        [theCGI sendErrorDocument:@"Invalid request" description:@"A username is required." forError:nil];
+      }
+    }
+    [theCGI release];
+  } else {
+    printf(
+        "Content-type: text/xml\r\n\r\n"
+        "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>\n"
+        "<error><title>Invalid request</title><description>There was no request.</description></error>\n"
+      );
+  }
+}
+
+//
+
 int
 main()
 {
@@ -158,57 +233,9 @@ main()
   SBPostgresDatabase*   theDatabase = [[SBPostgresDatabase alloc] initWithConnectionString:SBDefaultDatabaseConnStr];
   
   if ( theDatabase ) {
-    SHUEBoxCGI*         theCGI = [[SHUEBoxCGI alloc] initWithDatabase:theDatabase];
-    
-    if ( theCGI ) {
-      SHUEBoxCGITarget  theTarget = [theCGI target];
-      SBError*          theError = [theCGI lastError];
-      
-      if ( theError ) {
-        [theCGI sendErrorDocument:@"Invalid request" description:@"The request could not be interpreted by this CGI." forError:theError];
-      } else if ( theTarget != kSHUEBoxCGITargetLoginHelper ) {
-        [theCGI sendErrorDocument:@"Invalid request" description:@"The implied request target is not handled by this CGI." forError:nil];
-      } else {
-        //
-        // There need to be a "u" and "p" CGI parameter for this to work:
-        //
-        SBString*     uname = [theCGI queryArgumentForKey:@"u"];
-        SBString*     password = [theCGI queryArgumentForKey:@"p"];
-        char*         remoteAddr = getenv("REMOTE_ADDR");
-        
-        if ( uname && [uname length] && remoteAddr ) {
-          SHUEBoxUser*  targetUser = [SHUEBoxUser shueboxUserWithDatabase:theDatabase shortName:uname];
-          
-          if ( targetUser ) {
-            if ( [targetUser authenticateUsingPassword:password] ) {
-              [SBDefaultLogFile writeFormatToLog:"Authentication succeeded:  %S [%s]", [uname utf16Characters], ( remoteAddr ? remoteAddr : "?.?.?.?" )];
-              
-              // Set our auth cookie:
-              SHUEBoxAuthCookie*    cookie = [[SHUEBoxAuthCookie alloc] initWithUser:targetUser inetAddress:[SBInetAddress inetAddressWithCString:remoteAddr]];
-              
-              [theCGI setResponseHeaderValue:[cookie asString] forName:@"Set-Cookie"];
-              sendUserDescription(theDatabase, theCGI, targetUser);
-              [theCGI sendResponse];
-            } else {
-              [theCGI sendErrorDocument:@"Authentication failed" description:@"The provided password was incorrect." forError:nil];
-              [SBDefaultLogFile writeFormatToLog:"Authentication failure:  %S [%s]", [uname utf16Characters], ( remoteAddr ? remoteAddr : "?.?.?.?" )];
-            }
-          } else {
-            [theCGI sendErrorDocument:@"Invalid request" description:@"User not registered with SHUEBox." forError:nil];
-            [SBDefaultLogFile writeFormatToLog:"Unrecognized user id:  %S [%s]", [uname utf16Characters], ( remoteAddr ? remoteAddr : "?.?.?.?" )];
-          }
-        } else {
-          [theCGI sendErrorDocument:@"Invalid request" description:@"A username is required." forError:nil];
-        }
-      }
-      [theCGI release];
-    } else {
-      printf(
-          "Content-type: text/xml\r\n\r\n"
-          "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>\n"
-          "<error><title>Invalid request</title><description>There was no request.</description></error>\n"
-        );
-    }
+    // Persistent across FastCGI requests, so the same queries come around again and again:
+    [theDatabase setStatementCacheSize:SBPostgresDefaultStatementCacheSize];
+    [SBCGI runRequestLoopWithHandler:handleRequest context:theDatabase];
     [theDatabase release];
   } else {
 		[SBDefaultLogFile writeFormatToLog:"Unable to establish connection to database!"];
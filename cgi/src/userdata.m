@@ -265,133 +265,159 @@ processUserUpdateRequest(
 
 //
 
-int
-main()
+void
+handleRequest(
+  void*                 context
+)
 {
-  SBAutoreleasePool*    pool = [[SBAutoreleasePool alloc] init];
-	
-#ifdef LOG_DIR
-	const char*						logDir = LOG_DIR;
-	
-	[SBLogger setBaseLoggingPath:[SBString stringWithUTF8String:logDir]];
-#endif
-	SBDefaultLogFile = [[SBLogger loggerWithFileAtPath:@"userdata.log"] retain];
-	
-  SBPostgresDatabase*   theDatabase = [[SBPostgresDatabase alloc] initWithConnectionString:SBDefaultDatabaseConnStr];
+  SBPostgresDatabase*   theDatabase = (SBPostgresDatabase*)context;
   
-  if ( theDatabase ) {
-    SHUEBoxCGI*         theCGI = [[SHUEBoxCGI alloc] initWithDatabase:theDatabase];
+  //
+  // The connection persists across requests under FastCGI; if the server went away
+  // since the last request, get a new one before going any further:
+  //
+  if ( PQstatus([theDatabase databaseConnection]) != CONNECTION_OK ) {
+    if ( ! [theDatabase reconnect] ) {
+      [SBDefaultLogFile writeFormatToLog:"Unable to reestablish connection to database!"];
+      printf("Status: 503 Service Unavailable\r\nContent-type: text/plain\r\n\r\nDatabase unavailable.\n");
+      return;
+    }
+  }
+  
+  SHUEBoxCGI*         theCGI = [[SHUEBoxCGI alloc] initWithDatabase:theDatabase];
+  
+  if ( theCGI ) {
+    switch ( [theCGI target] ) {
     
-    if ( theCGI ) {
-      switch ( [theCGI target] ) {
-      
-        case kSHUEBoxCGITargetUserData: {
-          SHUEBoxUser*      theUser = [theCGI targetSHUEBoxUser];
+      case kSHUEBoxCGITargetUserData: {
+        SHUEBoxUser*      theUser = [theCGI targetSHUEBoxUser];
+        
+        if ( theUser ) {
+          //
+          // What's the request:
+          //
+          switch ( [theCGI requestMethod] ) {
           
-          if ( theUser ) {
-            //
-            // What's the request:
-            //
-            switch ( [theCGI requestMethod] ) {
+            case kSBHTTPMethodGET: {
+              //
+              // Send a description of the user:
+              //
+              sendUserDescription(theDatabase, theCGI, theUser);
+              [SBDefaultLogFile writeFormatToLog:"User description sent for `%S` [%S]", [[theUser shortName] utf16Characters], [[[theCGI remoteInetAddress] inetAddressAsString] utf16Characters]];
+              break;
+            }
             
-              case kSBHTTPMethodGET: {
+            case kSBHTTPMethodPOST: {
+              SBXMLDocument*		userUpdateDoc = [theCGI xmlDocumentFromStdin];
+              
+              if ( userUpdateDoc ) {
                 //
-                // Send a description of the user:
+                // Valid document?
                 //
-                sendUserDescription(theDatabase, theCGI, theUser);
-                [SBDefaultLogFile writeFormatToLog:"User description sent for `%S` [%S]", [[theUser shortName] utf16Characters], [[[theCGI remoteInetAddress] inetAddressAsString] utf16Characters]];
-                break;
-              }
-              
-              case kSBHTTPMethodPOST: {
-                SBXMLDocument*		userUpdateDoc = [theCGI xmlDocumentFromStdin];
-                
-                if ( userUpdateDoc ) {
-                  //
-                  // Valid document?
-                  //
-                  if ( [userUpdateDoc isNamedDocument:@"user"] ) {
-                    SBXMLElement*	xmlElement = [userUpdateDoc rootElement];
-                    SBNumber*     userId = [xmlElement numberAttributeForName:@"id"];
-                    BOOL					valid = NO;
-                    
-                    if ( userId && ([userId int64Value] == [theUser shueboxUserId]) ) {
-                      //
-                      // Okay, we've validated the incoming XML document.  Now react to its directives:
-                      //
-                      valid = YES;
-                      processUserUpdateRequest(theDatabase, theCGI, theUser, xmlElement);
-                    }
-                    if ( ! valid )
-                      [theCGI sendErrorDocument:@"Invalid request" description:@"The XML document sent with the request was not a valid `user` document." forError:nil];
-                  } else {
-                    [theCGI sendErrorDocument:@"Invalid request" description:@"The XML document sent with the request was not a `user` document." forError:nil];
+                if ( [userUpdateDoc isNamedDocument:@"user"] ) {
+                  SBXMLElement*	xmlElement = [userUpdateDoc rootElement];
+                  SBNumber*     userId = [xmlElement numberAttributeForName:@"id"];
+                  BOOL					valid = NO;
+                  
+                  if ( userId && ([userId int64Value] == [theUser shueboxUserId]) ) {
+                    //
+                    // Okay, we've validated the incoming XML document.  Now react to its directives:
+                    //
+                    valid = YES;
+                    processUserUpdateRequest(theDatabase, theCGI, theUser, xmlElement);
                   }
+                  if ( ! valid )
+                    [theCGI sendErrorDocument:@"Invalid request" description:@"The XML document sent with the request was not a valid `user` document." forError:nil];
                 } else {
-                  [theCGI sendErrorDocument:@"Invalid request" description:@"No XML document was sent with the request." forError:nil];
+                  [theCGI sendErrorDocument:@"Invalid request" description:@"The XML document sent with the request was not a `user` document." forError:nil];
                 }
-                break;
-              }
-              
-              default: {
-                [theCGI sendErrorDocument:@"Invalid request" description:@"The HTTP request is invalid." forError:nil];
-                break;
+              } else {
+                [theCGI sendErrorDocument:@"Invalid request" description:@"No XML document was sent with the request." forError:nil];
               }
+              break;
+            }
+            
+            default: {
+              [theCGI sendErrorDocument:@"Invalid request" description:@"The HTTP request is invalid." forError:nil];
+              break;
             }
-          } else {
-            [theCGI sendErrorDocument:@"Unknown user" description:@"This interface is only accessible by authenticated SHUEBox users." forError:nil];
           }
-          break;
+        } else {
+          [theCGI sendErrorDocument:@"Unknown user" description:@"This interface is only accessible by authenticated SHUEBox users." forError:nil];
         }
+        break;
+      }
+      
+      case kSHUEBoxCGITargetGuestAccountConfirm: {
+        SHUEBoxUser*      theUser = [theCGI targetSHUEBoxUser];
         
-        case kSHUEBoxCGITargetGuestAccountConfirm: {
-          SHUEBoxUser*      theUser = [theCGI targetSHUEBoxUser];
+        if ( theUser ) {
+          //
+          // We really don't care what HTTP method was used.
+          //
+          SBString*       confirmationCode = [theCGI targetConfirmationCode];
           
-          if ( theUser ) {
-            //
-            // We really don't care what HTTP method was used.
-            //
-            SBString*       confirmationCode = [theCGI targetConfirmationCode];
+          if ( confirmationCode && ([confirmationCode length] == 32) ) {
+            SBError*      theError = [theUser confirmAccountWithCode:confirmationCode];
             
-            if ( confirmationCode && ([confirmationCode length] == 32) ) {
-              SBError*      theError = [theUser confirmAccountWithCode:confirmationCode];
-              
-              if ( theError ) {
-                [SBDefaultLogFile writeFormatToLog:"Guest account confirmation failed for user %lld", [theUser shueboxUserId]];
-                [theCGI sendErrorDocument:@"Invalid confirmation code" description:@"The provided confirmation code is invalid." forError:theError];              
-              } else if ( ! [theUser commitModifications] ) {
-                [theCGI sendErrorDocument:@"Database error" description:@"Error while commiting guest confirmation to database." forError:nil];   
-              } else {
-                //
-                // Success!
-                //
-                SBString*       baseURI = [theDatabase stringForFullDictionaryKey:SHUEBoxDictionarySystemBaseURIAuthorityKey];
-                
-                [SBDefaultLogFile writeFormatToLog:"Guest account confirmed for user %lld", [theUser shueboxUserId]];
-                [theCGI setResponseHeaderValue:@"text/html; charset=utf-8" forName:@"Content-type"];
-                [theCGI appendFormatToResponseText:"<html><head><title>Account confirmation successful</title><meta http-equiv=\"refresh\" content=\"0; url=%S\"/></head><body><h1>Account confirmation successful.</h1><h3>Go to the <a href=\"%S\">SHUEBox web console</a>.</h3></body></html>",
-                          [baseURI utf16Characters],
-                          [baseURI utf16Characters]
-                        ];
-                [theCGI sendResponse];
-              }
+            if ( theError ) {
+              [SBDefaultLogFile writeFormatToLog:"Guest account confirmation failed for user %lld", [theUser shueboxUserId]];
+              [theCGI sendErrorDocument:@"Invalid confirmation code" description:@"The provided confirmation code is invalid." forError:theError];              
+            } else if ( ! [theUser commitModifications] ) {
+              [theCGI sendErrorDocument:@"Database error" description:@"Error while commiting guest confirmation to database." forError:nil];   
             } else {
-              [theCGI sendErrorDocument:@"Invalid confirmation code" description:@"The provided confirmation code is invalid." forError:[theCGI lastError]];
+              //
+              // Success!
+              //
+              SBString*       baseURI = [theDatabase stringForFullDictionaryKey:SHUEBoxDictionarySystemBaseURIAuthorityKey];
+              
+              [SBDefaultLogFile writeFormatToLog:"Guest account confirmed for user %lld", [theUser shueboxUserId]];
+              [theCGI setResponseHeaderValue:@"text/html; charset=utf-8" forName:@"Content-type"];
+              [theCGI appendFormatToResponseText:"<html><head><title>Account confirmation successful</title><meta http-equiv=\"refresh\" content=\"0; url=%S\"/></head><body><h1>Account confirmation successful.</h1><h3>Go to the <a href=\"%S\">SHUEBox web console</a>.</h3></body></html>",
+                        [baseURI utf16Characters],
+                        [baseURI utf16Characters]
+                      ];
+              [theCGI sendResponse];
             }
           } else {
-            [theCGI sendErrorDocument:@"Unknown user" description:@"This interface is only accessible by authenticated SHUEBox users." forError:[theCGI lastError]];
+            [theCGI sendErrorDocument:@"Invalid confirmation code" description:@"The provided confirmation code is invalid." forError:[theCGI lastError]];
           }
-          break;
-        }
-        
-        default: {
-          [theCGI sendErrorDocument:@"Invalid request" description:@"The implied request target is not handled by this CGI." forError:[theCGI lastError]];
-          break;
+        } else {
+          [theCGI sendErrorDocument:@"Unknown user" description:@"This interface is only accessible by authenticated SHUEBox users." forError:[theCGI lastError]];
         }
-        
+        break;
+      }
+      
+      default: {
+        [theCGI sendErrorDocument:@"Invalid request" description:@"The implied request target is not handled by this CGI." forError:[theCGI lastError]];
+        break;
       }
-      [theCGI release];
+      
     }
+    [theCGI release];
+  }
+}
+
+//
+
+int
+main()
+{
+  SBAutoreleasePool*    pool = [[SBAutoreleasePool alloc] init];
+	
+#ifdef LOG_DIR
+	const char*						logDir = LOG_DIR;
+	
+	[SBLogger setBaseLoggingPath:[SBString stringWithUTF8String:logDir]];
+#endif
+	SBDefaultLogFile = [[SBLogger loggerWithFileAtPath:@"userdata.log"] retain];
+	
+  SBPostgresDatabase*   theDatabase = [[SBPostgresDatabase alloc] initWithConnectionString:SBDefaultDatabaseConnStr];
+  
+  if ( theDatabase ) {
+    // Persistent across FastCGI requests, so the same queries come around again and again:
+    [theDatabase setStatementCacheSize:SBPostgresDefaultStatementCacheSize];
+    [SBCGI runRequestLoopWithHandler:handleRequest context:theDatabase];
     [theDatabase release];
   } else {
 		[SBDefaultLogFile writeFormatToLog:"Unable to establish connection to database!"];
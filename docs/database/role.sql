@@ -108,6 +108,17 @@ CREATE RULE "collaboration.repository.initialACL" AS ON INSERT TO collaboration.
       (SELECT roleId FROM collaboration.role WHERE collabId = NEW.collabID AND shortName = 'everyone')
     );
 
+--
+-- mod_authnz_shuebox caches authorization decisions; have Postgres NOTIFY it whenever
+-- role membership or repository ACLs change so the cache can be invalidated:
+--
+CREATE RULE "collaboration.roleMember.notifyInsert" AS ON INSERT TO collaboration.roleMember DO ALSO NOTIFY "authzChange";
+CREATE RULE "collaboration.roleMember.notifyUpdate" AS ON UPDATE TO collaboration.roleMember DO ALSO NOTIFY "authzChange";
+CREATE RULE "collaboration.roleMember.notifyDelete" AS ON DELETE TO collaboration.roleMember DO ALSO NOTIFY "authzChange";
+CREATE RULE "collaboration.repositoryACL.notifyInsert" AS ON INSERT TO collaboration.repositoryACL DO ALSO NOTIFY "authzChange";
+CREATE RULE "collaboration.repositoryACL.notifyUpdate" AS ON UPDATE TO collaboration.repositoryACL DO ALSO NOTIFY "authzChange";
+CREATE RULE "collaboration.repositoryACL.notifyDelete" AS ON DELETE TO collaboration.repositoryACL DO ALSO NOTIFY "authzChange";
+
 --
 -- Check for access to a repository:
 --
@@ -15,6 +15,7 @@
 
 #import "SHUEBoxDictionary.h"
 #import "SHUEBoxCollaboration.h"
+#import "SHUEBoxPathManager.h"
 
 #import "SBString.h"
 #import "SBArray.h"
@@ -43,6 +44,9 @@ SBString* const SBCollaborationQuotaCriticalThreshold = @"quota::critical-thresh
 - (void) performInactivityCheck:(SBString*)shortName;
 - (void) performRemoval:(SBString*)shortName;
 
+- (id) quotaCheckFilesystem:(SBString*)zfsFilesystem database:(SBPostgresDatabase*)database;
+- (id) quotaUpdateFilesystem:(SBArray*)workItem database:(SBPostgresDatabase*)database;
+
 @end
 
 @implementation SBCollaborationMaintenanceTask(SBCollaborationMaintenanceTaskPrivate)
@@ -140,6 +144,9 @@ SBString* const SBCollaborationQuotaCriticalThreshold = @"quota::critical-thresh
     
     if ( collaborations ) {
       SBMutableString*    mailMessage = [[SBMutableString alloc] initWithUTF8String:"The SHUEBox ``scruffy'' maintenance daemon has just completed a collaboration quota-check run:\n\n"];
+      SHUEBoxPathManager* pathManager = [SHUEBoxPathManager shueboxPathManager];
+      SBMutableArray*     zfsFilesystems = [[SBMutableArray alloc] init];
+      SBArray*            percentages;
       SBUInteger          i = 0, iMax = [collaborations count];
       SBUInteger          count = 0;
       float               warn = 96.0f, critical = 100.0f;
@@ -163,58 +170,68 @@ SBString* const SBCollaborationQuotaCriticalThreshold = @"quota::critical-thresh
           critical = 100.0;
       }
       
+      //
+      // The ZFS property reads are fanned-out to the worker pool; it gets just the
+      // dataset names so that none of the collaboration objects leave this thread:
+      //
+      while ( i < iMax ) {
+        SBString*         zfsFilesystem = [pathManager addPathComponent:[[collaborations objectAtIndex:i++] shortName] toPathForKey:SHUEBoxZFSBaseFilesystem];
+        
+        [zfsFilesystems addObject:( zfsFilesystem ? (id)zfsFilesystem : (id)[SBNull null] )];
+      }
+      percentages = [self resultsOfWorkerSelector:@selector(quotaCheckFilesystem:database:) objects:zfsFilesystems];
+      [zfsFilesystems release];
+      
+      i = 0;
       while ( i < iMax ) {
-        SHUEBoxCollaboration* collaboration = [collaborations objectAtIndex:i++];
+        SHUEBoxCollaboration* collaboration = [collaborations objectAtIndex:i];
+        SBNumber*             percentage = [percentages objectAtIndex:i++];
         
-        if ( collaboration ) {
-          SBZFSFilesystem*  collabFS = [collaboration filesystem];
+        if ( [percentage isKindOf:[SBNumber class]] ) {
+          float             percentUsed = [percentage doubleValue];
+          
+          if ( percentUsed >= critical ) {
+            //
+            // Usage is CRITICAL:
+            //
           
-          if ( collabFS ) {
-            float           percentUsed = [collabFS inUsePercentage];
-            
-            if ( percentUsed >= critical ) {
-              //
-              // Usage is CRITICAL:
-              //
-            
-              [[self logFile] writeStringToLog:
-                  [SBString stringWithFormat:"CRITICAL:  disk usage %.1f%% for `%S`",
-                      percentUsed,
-                      [[collaboration shortName] utf16Characters]
-                    ]
-                ];
-              [mailMessage appendFormat:"\n--------\nCRITICAL:  disk usage %.1f%% for `%S`\n\n",
-                  percentUsed,
-                  [[collaboration shortName] utf16Characters]
-                ];
-              count++;
-            } else if ( percentUsed >= warn ) {
-              //
-              // Usage is nearing CRITICAL:
-              //
-            
-              [[self logFile] writeStringToLog:
-                  [SBString stringWithFormat:"WARNING:  disk usage %.1f%% for `%S`",
-                      percentUsed,
-                      [[collaboration shortName] utf16Characters]
-                    ]
-                ];
-              [mailMessage appendFormat:"\n--------\nWARNING:  disk usage %.1f%% for `%S`\n\n",
-                  percentUsed,
-                  [[collaboration shortName] utf16Characters]
-                ];
-              count++;
-            }
-          } else {
             [[self logFile] writeStringToLog:
-                [SBString stringWithFormat:"Could not get filesystem object for `%S`",
+                [SBString stringWithFormat:"CRITICAL:  disk usage %.1f%% for `%S`",
+                    percentUsed,
                     [[collaboration shortName] utf16Characters]
                   ]
               ];
-            [mailMessage appendFormat:"\n--------\nCould not get filesystem object for `%S`\n\n",
+            [mailMessage appendFormat:"\n--------\nCRITICAL:  disk usage %.1f%% for `%S`\n\n",
+                percentUsed,
                 [[collaboration shortName] utf16Characters]
               ];
+            count++;
+          } else if ( percentUsed >= warn ) {
+            //
+            // Usage is nearing CRITICAL:
+            //
+          
+            [[self logFile] writeStringToLog:
+                [SBString stringWithFormat:"WARNING:  disk usage %.1f%% for `%S`",
+                    percentUsed,
+                    [[collaboration shortName] utf16Characters]
+                  ]
+              ];
+            [mailMessage appendFormat:"\n--------\nWARNING:  disk usage %.1f%% for `%S`\n\n",
+                percentUsed,
+                [[collaboration shortName] utf16Characters]
+              ];
+            count++;
           }
+        } else {
+          [[self logFile] writeStringToLog:
+              [SBString stringWithFormat:"Could not get filesystem object for `%S`",
+                  [[collaboration shortName] utf16Characters]
+                ]
+            ];
+          [mailMessage appendFormat:"\n--------\nCould not get filesystem object for `%S`\n\n",
+              [[collaboration shortName] utf16Characters]
+            ];
         }
       }
       
@@ -253,33 +270,121 @@ SBString* const SBCollaborationQuotaCriticalThreshold = @"quota::critical-thresh
         [[self logFile] writeStringToLog:[SBString stringWithFormat:"Requested quota update for undefined collaboration `%S`", [shortName utf16Characters]]];
       }
     } else {
-      id                idLookup = [database executeQuery:@"SELECT collabId FROM collaboration.definition WHERE modified > (SELECT performedat FROM maintenance.task WHERE key = 'collaboration.quotaUpdate')"];
+      id                idLookup = [database executeQuery:@"SELECT collabId, shortName FROM collaboration.definition WHERE modified > (SELECT performedat FROM maintenance.task WHERE key = 'collaboration.quotaUpdate')"];
       SBUInteger        rowCount;
       
       if ( idLookup && [idLookup queryWasSuccessful] && (rowCount = [idLookup numberOfRows]) ) {
+        SHUEBoxPathManager*   pathManager = [SHUEBoxPathManager shueboxPathManager];
+        SBMutableArray*       workItems = [[SBMutableArray alloc] init];
+        SBMutableArray*       shortNames = [[SBMutableArray alloc] init];
+        SBArray*              syncErrors;
+        SBUInteger            i, iMax;
         
+        //
+        // Each worker reads the collaboration's limits over its own connection and applies
+        // them to the dataset; the rows are still handled (and logged) last-to-first:
+        //
         while ( rowCount-- ) {
           SBNumber*     collabId = [idLookup objectForRow:rowCount fieldNum:0];
+          SBString*     collabShortName = [idLookup objectForRow:rowCount fieldNum:1];
+          SBString*     zfsFilesystem;
           
-          if ( collabId ) {
-            SHUEBoxCollaboration*   theCollab = [SHUEBoxCollaboration collaborationWithDatabase:database collabId:[collabId integerValue]];
-            SBError*                syncError = [theCollab syncFilesystemProperties];
-            
-            if ( syncError ) {
-              [[self logFile] writeStringToLog:
-                  [SBString stringWithFormat:"Error while updating filesystem properties on `%S` (%d):",
-                      [[theCollab shortName] utf16Characters],
-                      [syncError code]
-                    ]
-                ];
-              [[self logFile] writeStringToLog:[[syncError supportingData] objectForKey:SBErrorExplanationKey]];
-            } else {
-              [[self logFile] writeStringToLog:[SBString stringWithFormat:"Successfully updated quota and reservation limits on `%S`", [[theCollab shortName] utf16Characters]]];
-            }
+          if ( collabId && collabShortName && (zfsFilesystem = [pathManager addPathComponent:collabShortName toPathForKey:SHUEBoxZFSBaseFilesystem]) ) {
+            [workItems addObject:[SBArray arrayWithObjects:collabId, zfsFilesystem, nil]];
+            [shortNames addObject:collabShortName];
           }
         }
+        syncErrors = [self resultsOfWorkerSelector:@selector(quotaUpdateFilesystem:database:) objects:workItems];
+        
+        i = 0; iMax = [shortNames count];
+        while ( i < iMax ) {
+          SBString*     collabShortName = [shortNames objectAtIndex:i];
+          SBError*      syncError = [syncErrors objectAtIndex:i++];
+          
+          if ( [syncError isKindOf:[SBError class]] ) {
+            [[self logFile] writeStringToLog:
+                [SBString stringWithFormat:"Error while updating filesystem properties on `%S` (%d):",
+                    [collabShortName utf16Characters],
+                    [syncError code]
+                  ]
+              ];
+            [[self logFile] writeStringToLog:[[syncError supportingData] objectForKey:SBErrorExplanationKey]];
+          } else {
+            [[self logFile] writeStringToLog:[SBString stringWithFormat:"Successfully updated quota and reservation limits on `%S`", [collabShortName utf16Characters]]];
+          }
+        }
+        [shortNames release];
+        [workItems release];
+      }
+    }
+  }
+  
+//
+
+  - (id) quotaCheckFilesystem:(SBString*)zfsFilesystem
+    database:(SBPostgresDatabase*)database
+  {
+    SBZFSFilesystem*    collabFS;
+    
+    if ( [zfsFilesystem isKindOf:[SBString class]] && (collabFS = [[SBZFSFilesystem alloc] initWithZFSFilesystem:zfsFilesystem]) ) {
+      SBNumber*         percentage = [SBNumber numberWithDouble:[collabFS inUsePercentage]];
+      
+      [collabFS release];
+      return percentage;
+    }
+    return nil;
+  }
+  
+//
+
+  - (id) quotaUpdateFilesystem:(SBArray*)workItem
+    database:(SBPostgresDatabase*)database
+  {
+    SBString*                 zfsFilesystem = [workItem objectAtIndex:1];
+    SBString*                 explanation = nil;
+    SBPostgresQuery*          query;
+    SBPostgresQueryResult*    queryResult = nil;
+    
+    if ( ! database )
+      return [SBError errorWithDomain:SHUEBoxErrorDomain code:kSHUEBoxCollaborationFilesystemError supportingData:
+                          [SBDictionary dictionaryWithObject:@"Worker has no database connection." forKey:SBErrorExplanationKey]
+                  ];
+    
+    if ( (query = [[SBPostgresQuery alloc] initWithQueryString:@"SELECT megabytesQuota, megabytesReserved, compressionIsEnabled FROM collaboration.definition WHERE collabId = $1" parameterCount:1]) ) {
+      [query bindObject:[workItem objectAtIndex:0] toParameter:1];
+      queryResult = [database executeQuery:query];
+      [query release];
+    }
+    if ( queryResult && [queryResult queryWasSuccessful] && [queryResult numberOfRows] ) {
+      SBZFSFilesystem*        collabFS = [[SBZFSFilesystem alloc] initWithZFSFilesystem:zfsFilesystem];
+      
+      if ( collabFS ) {
+        SBNumber*             quota = [queryResult objectForRow:0 fieldNum:0];
+        SBNumber*             reserved = [queryResult objectForRow:0 fieldNum:1];
+        SBNumber*             compress = [queryResult objectForRow:0 fieldNum:2];
+        BOOL                  state = ( [compress isKindOf:[SBNumber class]] ? [compress boolValue] : NO );
+        SBZFSCompressionType  compressType = [collabFS compressionType];
+        
+        if ( ! [collabFS setQuotaMegabytes:( [quota isKindOf:[SBNumber class]] ? [quota unsignedIntegerValue] : 0 )] ) {
+          explanation = [SBString stringWithFormat:"Unable to set collaboration ZFS quota: %S", [zfsFilesystem utf16Characters]];
+        } else if ( ! [collabFS setReservedMegabytes:( [reserved isKindOf:[SBNumber class]] ? [reserved unsignedIntegerValue] : 0 )] ) {
+          explanation = [SBString stringWithFormat:"Unable to set collaboration ZFS reservation: %S", [zfsFilesystem utf16Characters]];
+        } else if ( (state && (compressType == SBZFSCompressionTypeNone)) || (! state && (compressType != SBZFSCompressionTypeNone)) ) {
+          if ( ! [collabFS setCompressionType:( state ? SBZFSCompressionTypeDefault : SBZFSCompressionTypeNone )] )
+            explanation = [SBString stringWithFormat:"Unable to set collaboration ZFS compression state: %S", [zfsFilesystem utf16Characters]];
+        }
+        [collabFS release];
+      } else {
+        explanation = @"Unable to get filesystem for collaboration.";
       }
+    } else {
+      explanation = @"Unable to retrieve collaboration limits from the database.";
     }
+    if ( explanation )
+      return [SBError errorWithDomain:SHUEBoxErrorDomain code:kSHUEBoxCollaborationFilesystemError supportingData:
+                          [SBDictionary dictionaryWithObject:explanation forKey:SBErrorExplanationKey]
+                  ];
+    return nil;
   }
   
 //
@@ -14,6 +14,7 @@
 #import "SBMaintenanceTaskPrivate.h"
 
 #import "SBLogger.h"
+#import "SBMaintenanceWorkerPool.h"
 
 static SBString* SBMaintenanceTaskIdKey               = @"taskid";
 static SBString* SBMaintenanceTaskKeyKey              = @"key";
@@ -347,6 +348,31 @@ static SBMutableDictionary* __SBMaintenanceTaskKeyToClassMappings = nil;
     }
   }
 
+//
+
+  - (SBArray*) resultsOfWorkerSelector:(SEL)aSelector
+    objects:(SBArray*)objects
+  {
+    SBMaintenanceWorkerPool*  workerPool = [SBMaintenanceWorkerPool sharedWorkerPool];
+    
+    if ( workerPool )
+      return [workerPool resultsOfSelector:aSelector target:self objects:objects];
+    
+    //
+    // No task manager (e.g. a single task run from the command line), so work
+    // through the objects right here:
+    //
+    SBMutableArray*           results = [SBMutableArray array];
+    SBUInteger                i = 0, iMax = [objects count];
+    
+    while ( i < iMax ) {
+      id                      result = [self perform:aSelector with:[objects objectAtIndex:i++] with:_database];
+      
+      [results addObject:( result ? result : [SBNull null] )];
+    }
+    return results;
+  }
+
 @end
 
 //
@@ -12,11 +12,14 @@
 
 #import "SBMaintenanceTask.h"
 
+@class SBMaintenanceWorkerPool;
+
 @interface SBMaintenanceTaskManager : SBObject
 {
   SBMutableDictionary*      _tasksByKey;
   SBPostgresDatabase*       _database;
   SBLogger*									_logFile;
+  SBMaintenanceWorkerPool*  _workerPool;
   SBUInteger                _flags;
 }
 
@@ -25,6 +28,8 @@
 - (SBMaintenanceTask*) maintenanceTaskWithId:(int)taskId;
 - (SBMaintenanceTask*) maintenanceTaskWithKey:(SBString*)taskKey;
 
+- (SBMaintenanceWorkerPool*) workerPool;
+
 - (BOOL) isRunning;
 - (void) setIsRunning:(BOOL)isRunning;
 
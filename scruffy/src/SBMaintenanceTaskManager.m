@@ -11,6 +11,7 @@
 //
 
 #import "SBMaintenanceTaskManager.h"
+#import "SBMaintenanceWorkerPool.h"
 
 #import "SBString.h"
 #import "SBAutoreleasePool.h"
@@ -20,11 +21,20 @@
 #import "SBRunLoop.h"
 #import "SBLogger.h"
 
+#import "SHUEBoxDictionary.h"
+#import "SHUEBoxApacheManager.h"
+
 //
 
 static SBString* SBScruffyConfigChangeNotification = @"maintenanceTaskUpdate";
 static SBString* SBScruffyTerminateNotification = @"maintenanceShutdown";
 
+static SBString* SBScruffyWorkerCountKey = @"scruffy::worker-count";
+static SBUInteger SBScruffyDefaultWorkerCount = 4;
+
+static SBString* SBScruffyApacheRestartWindowKey = @"apache::restart-window";
+static SBUInteger SBScruffyDefaultApacheRestartWindow = 10;
+
 //
 
 enum {
@@ -41,6 +51,9 @@ enum {
 - (BOOL) stateOfFlag:(SBUInteger)flag;
 - (void) setState:(BOOL)state ofFlag:(SBUInteger)flag;
 
+- (void) updateWorkerPoolConfiguration;
+- (void) updateApacheRestartWindow;
+
 @end
 
 @implementation SBMaintenanceTaskManager(SBMaintenanceTaskManagerPrivate)
@@ -53,6 +66,11 @@ enum {
         _database = [database retain];
         _tasksByKey = [[SBMutableDictionary alloc] init];
         _flags = kSBMaintenanceTaskManagerRedoConfig;
+        
+        //  Per-collaboration work gets fanned-out to this pool; tasks find it
+        //  by way of the shared pool:
+        _workerPool = [[SBMaintenanceWorkerPool alloc] initWithDatabase:database maximumWorkers:SBScruffyDefaultWorkerCount];
+        [SBMaintenanceWorkerPool setSharedWorkerPool:_workerPool];
       } else {
         [self release];
         self = nil;
@@ -78,6 +96,52 @@ enum {
     else
       _flags &= ~flag;
   }
+  
+//
+
+  - (void) updateWorkerPoolConfiguration
+  {
+    SBString*     value = [_database stringForFullDictionaryKey:SBScruffyWorkerCountKey];
+    SBInteger     workerCount = SBScruffyDefaultWorkerCount;
+    
+    if ( value ) {
+      workerCount = [value intValue];
+      if ( (workerCount < 1) || (workerCount > SBMaintenanceWorkerPoolMaximumWorkers) )
+        workerCount = SBScruffyDefaultWorkerCount;
+    }
+    if ( (SBUInteger)workerCount != [_workerPool maximumWorkers] ) {
+      [_logFile writeFormatToLog:"Worker pool limited to " SBIntegerFormat " thread%s.",
+          workerCount,
+          ( workerCount != 1 ? "s" : "" )
+        ];
+      [_workerPool setMaximumWorkers:workerCount];
+    }
+  }
+  
+//
+
+  - (void) updateApacheRestartWindow
+  {
+    SBString*     value = [_database stringForFullDictionaryKey:SBScruffyApacheRestartWindowKey];
+    SBInteger     seconds = SBScruffyDefaultApacheRestartWindow;
+    
+    //
+    // Scruffy runs its runloop, so Apache restarts requested by a burst of task work
+    // can be coalesced into a single one; zero turns coalescing off:
+    //
+    if ( value ) {
+      seconds = [value intValue];
+      if ( (seconds < 0) || (seconds > 3600) )
+        seconds = SBScruffyDefaultApacheRestartWindow;
+    }
+    if ( (SBUInteger)seconds != [[SHUEBoxApacheManager shueboxApacheManager] restartCoalescingWindow] ) {
+      [_logFile writeFormatToLog:"Apache restarts coalesced over " SBIntegerFormat " second%s.",
+          seconds,
+          ( seconds != 1 ? "s" : "" )
+        ];
+      [[SHUEBoxApacheManager shueboxApacheManager] setRestartCoalescingWindow:seconds];
+    }
+  }
 
 @end
 
@@ -112,12 +176,21 @@ enum {
   {
     if ( _logFile )
       [_logFile writeFormatToLog:"Scruffy is shutting down."];
+    
+    // Don't leave a coalesced Apache restart waiting on a timer that will never fire:
+    [[SHUEBoxApacheManager shueboxApacheManager] performPendingRestart];
       
     if ( _tasksByKey ) {
       // Force all tasks to invalidate timer's they're holding:
       [_tasksByKey makeObjectsPerformSelector:@selector(invalidateTaskTimer)];
       [_tasksByKey release];
     }
+    if ( _workerPool ) {
+      [_workerPool shutdownWorkers];
+      if ( [SBMaintenanceWorkerPool sharedWorkerPool] == _workerPool )
+        [SBMaintenanceWorkerPool setSharedWorkerPool:nil];
+      [_workerPool release];
+    }
     if ( _database ) [_database release];
     
     if ( _logFile )
@@ -126,6 +199,13 @@ enum {
     [super dealloc];
   }
 
+//
+
+  - (SBMaintenanceWorkerPool*) workerPool
+  {
+    return _workerPool;
+  }
+
 //
 
   - (BOOL) isRunning
@@ -233,6 +313,8 @@ enum {
           rc = EINVAL;
           break;
         }
+        [self updateWorkerPoolConfiguration];
+        [self updateApacheRestartWindow];
         [self setRedoConfig:NO];
       }
       
@@ -57,4 +57,6 @@
 - (void) performMaintenanceTaskOnTimer:(id)aTimer;
 - (void) performMaintenanceTaskWrapper:(SBString*)payloadString;
 
+- (SBArray*) resultsOfWorkerSelector:(SEL)aSelector objects:(SBArray*)objects;
+
 @end
@@ -0,0 +1,73 @@
+//
+// scruffy : maintenance scheduler daemon for SHUEBox
+// SBMaintenanceWorkerPool.h
+//
+// Bounded pool of worker threads for per-collaboration maintenance work.
+//
+// Copyright (c) 2009
+// University of Delaware
+//
+// $Id$
+//
+
+#import "SBObject.h"
+
+@class SBString, SBArray, SBConditionLock, SBPostgresDatabase, SBPostgresConnectionPool;
+
+//
+// Hard limit on the number of worker threads a pool will run:
+//
+#define SBMaintenanceWorkerPoolMaximumWorkers   32
+
+@interface SBMaintenanceWorkerPool : SBObject
+{
+  SBPostgresDatabase*       _database;
+  SBPostgresConnectionPool* _connectionPool;
+  SBConditionLock*          _batchLock;
+  SBUInteger                _maximumWorkers;
+  SBUInteger                _workerCount;
+  BOOL                      _shutdown;
+  //
+  id                        _batchTarget;
+  SEL                       _batchSelector;
+  id*                       _batchObjects;
+  id*                       _batchResults;
+  SBUInteger                _batchCount;
+  SBUInteger                _batchNext;
+  SBUInteger                _batchPending;
+}
+
++ (SBMaintenanceWorkerPool*) sharedWorkerPool;
++ (void) setSharedWorkerPool:(SBMaintenanceWorkerPool*)workerPool;
+
+- (id) initWithDatabase:(SBPostgresDatabase*)database maximumWorkers:(SBUInteger)maximumWorkers;
+
+- (SBUInteger) maximumWorkers;
+- (void) setMaximumWorkers:(SBUInteger)maximumWorkers;
+
+//
+// Sends aSelector -- which must have the form
+//
+//   - (id) workOn:(id)anObject database:(SBPostgresDatabase*)database
+//
+// -- to target once per element of objects.  The elements are distributed across the
+// worker threads, each of which checks a connection to the database out of the pool's
+// SBPostgresConnectionPool for the duration of the item; the calling
+// thread blocks until all have been handled.  With a single object or a single allowed
+// worker the selector is simply invoked on the calling thread with the pool's database.
+// The returned array holds the results in the same order as objects (with SBNull standing
+// in for nil), so callers can log and summarize deterministically.
+//
+// The selector runs on a worker thread:  it must not touch the shared SHUEBox object
+// caches, singletons, loggers, or notification center.  Pass it plain values gathered
+// on the calling thread and hand anything worth reporting back as its result.
+//
+- (SBArray*) resultsOfSelector:(SEL)aSelector target:(id)target objects:(SBArray*)objects;
+
+//
+// Asks all worker threads to exit once they finish what they're working on.  The pool
+// cannot be handed another batch afterwards.
+//
+- (void) shutdownWorkers;
+
+@end
@@ -0,0 +1,254 @@
+//
+// scruffy : maintenance scheduler daemon for SHUEBox
+// SBMaintenanceWorkerPool.m
+//
+// Bounded pool of worker threads for per-collaboration maintenance work.
+//
+// Copyright (c) 2009
+// University of Delaware
+//
+// $Id$
+//
+
+#import "SBMaintenanceWorkerPool.h"
+
+#import "SBString.h"
+#import "SBArray.h"
+#import "SBAutoreleasePool.h"
+#import "SBThread.h"
+#import "SBLock.h"
+#import "SBPostgres.h"
+#import "SBPostgresConnectionPool.h"
+
+//
+
+static SBMaintenanceWorkerPool* __SBMaintenanceWorkerPoolShared = nil;
+
+//
+// Values of the batch lock's condition variable:
+//
+enum {
+  kSBMaintenanceWorkerPoolIdle = 0,     // no batch in progress
+  kSBMaintenanceWorkerPoolBusy,         // batch has unclaimed objects (or shutdown requested)
+  kSBMaintenanceWorkerPoolDraining,     // all objects claimed, some still being worked
+  kSBMaintenanceWorkerPoolDone          // all objects worked, results ready for pickup
+};
+
+//
+
+@interface SBMaintenanceWorkerPool(SBMaintenanceWorkerPoolPrivate)
+
+- (void) startWorkersForCount:(SBUInteger)count;
+- (void) workerMain:(id)unused;
+
+@end
+
+@implementation SBMaintenanceWorkerPool(SBMaintenanceWorkerPoolPrivate)
+
+  - (void) startWorkersForCount:(SBUInteger)count
+  {
+    if ( count > _maximumWorkers )
+      count = _maximumWorkers;
+    while ( _workerCount < count ) {
+      [SBThread detachNewThreadSelector:@selector(workerMain:) toTarget:self withObject:nil];
+      _workerCount++;
+    }
+  }
+
+//
+
+  - (void) workerMain:(id)unused
+  {
+    SBAutoreleasePool*      threadPool = [[SBAutoreleasePool alloc] init];
+
+    while ( 1 ) {
+      SBAutoreleasePool*    itemPool;
+      SBPostgresDatabase*   database;
+      SBUInteger            index;
+      id                    result;
+
+      [_batchLock lockOnConditionValue:kSBMaintenanceWorkerPoolBusy];
+      if ( _shutdown ) {
+        // Leave the condition as-is so the other workers wake and exit, too:
+        _workerCount--;
+        [_batchLock unlockWithConditionValue:kSBMaintenanceWorkerPoolBusy];
+        break;
+      }
+      index = _batchNext++;
+      [_batchLock unlockWithConditionValue:( (_batchNext < _batchCount) ? kSBMaintenanceWorkerPoolBusy : kSBMaintenanceWorkerPoolDraining )];
+
+      //
+      // The connection pool health-checks what it hands out; the work selector copes
+      // with a nil database if no connection could be had:
+      //
+      database = [_connectionPool checkoutDatabase];
+
+      itemPool = [[SBAutoreleasePool alloc] init];
+      if ( (result = [_batchTarget perform:_batchSelector with:_batchObjects[index] with:database]) )
+        [result retain];
+      [itemPool release];
+
+      if ( database )
+        [_connectionPool checkinDatabase:database];
+
+      [_batchLock lock];
+      _batchResults[index] = result;
+      _batchPending--;
+      [_batchLock unlockWithConditionValue:( _batchPending ? [_batchLock conditionValue] : kSBMaintenanceWorkerPoolDone )];
+    }
+    [threadPool release];
+  }
+
+@end
+
+//
+#pragma mark -
+//
+
+@implementation SBMaintenanceWorkerPool
+
+  + (SBMaintenanceWorkerPool*) sharedWorkerPool
+  {
+    return __SBMaintenanceWorkerPoolShared;
+  }
+
+//
+
+  + (void) setSharedWorkerPool:(SBMaintenanceWorkerPool*)workerPool
+  {
+    if ( workerPool ) workerPool = [workerPool retain];
+    if ( __SBMaintenanceWorkerPoolShared ) [__SBMaintenanceWorkerPoolShared release];
+    __SBMaintenanceWorkerPoolShared = workerPool;
+  }
+
+//
+
+  - (id) initWithDatabase:(SBPostgresDatabase*)database
+    maximumWorkers:(SBUInteger)maximumWorkers
+  {
+    if ( self = [super init] ) {
+      _database = [database retain];
+      _batchLock = [[SBConditionLock alloc] initWithConditionValue:kSBMaintenanceWorkerPoolIdle];
+      [self setMaximumWorkers:maximumWorkers];
+      //
+      // Connections are opened as workers need them; the pool is sized to the hard
+      // worker limit since the worker count can change on a config reload:
+      //
+      _connectionPool = [[SBPostgresConnectionPool alloc] initWithDatabase:database minimumConnections:0 maximumConnections:SBMaintenanceWorkerPoolMaximumWorkers];
+    }
+    return self;
+  }
+
+//
+
+  - (void) dealloc
+  {
+    //
+    // Workers retain the pool, so by now there are none left running.
+    //
+    if ( _batchLock ) [_batchLock release];
+    if ( _connectionPool ) [_connectionPool release];
+    if ( _database ) [_database release];
+    [super dealloc];
+  }
+
+//
+
+  - (SBUInteger) maximumWorkers
+  {
+    return _maximumWorkers;
+  }
+  - (void) setMaximumWorkers:(SBUInteger)maximumWorkers
+  {
+    if ( maximumWorkers < 1 )
+      maximumWorkers = 1;
+    else if ( maximumWorkers > SBMaintenanceWorkerPoolMaximumWorkers )
+      maximumWorkers = SBMaintenanceWorkerPoolMaximumWorkers;
+    //
+    // Lowering the limit does not stop threads that are already running; it only
+    // keeps more from being started:
+    //
+    _maximumWorkers = maximumWorkers;
+  }
+
+//
+
+  - (SBArray*) resultsOfSelector:(SEL)aSelector
+    target:(id)target
+    objects:(SBArray*)objects
+  {
+    SBUInteger          count = [objects count];
+    SBArray*            results = nil;
+    id*                 batch;
+    SBUInteger          i;
+
+    if ( count == 0 )
+      return [SBArray array];
+    if ( ! (batch = objc_calloc(2 * count, sizeof(id))) )
+      return nil;
+
+    for ( i = 0; i < count; i++ )
+      batch[i] = [objects objectAtIndex:i];
+
+    if ( (count == 1) || (_maximumWorkers == 1) ) {
+      //
+      // Not worth a thread hand-off:
+      //
+      for ( i = 0; i < count; i++ ) {
+        SBAutoreleasePool*    itemPool = [[SBAutoreleasePool alloc] init];
+        id                    result = [target perform:aSelector with:batch[i] with:_database];
+
+        if ( result ) batch[count + i] = [result retain];
+        [itemPool release];
+      }
+    } else {
+      [_batchLock lockOnConditionValue:kSBMaintenanceWorkerPoolIdle];
+      _batchTarget = target;
+      _batchSelector = aSelector;
+      _batchObjects = batch;
+      _batchResults = batch + count;
+      _batchCount = _batchPending = count;
+      _batchNext = 0;
+      [self startWorkersForCount:count];
+      [_batchLock unlockWithConditionValue:kSBMaintenanceWorkerPoolBusy];
+
+      [_batchLock lockOnConditionValue:kSBMaintenanceWorkerPoolDone];
+      _batchTarget = nil;
+      _batchSelector = NULL;
+      _batchObjects = _batchResults = NULL;
+      _batchCount = _batchNext = 0;
+      [_batchLock unlockWithConditionValue:kSBMaintenanceWorkerPoolIdle];
+
+      // Let go of connections left over from an earlier, larger batch:
+      [_connectionPool reapIdleConnections];
+    }
+
+    //
+    // Gather results in the order of the original objects:
+    //
+    for ( i = 0; i < count; i++ ) {
+      if ( ! batch[count + i] )
+        batch[count + i] = [[SBNull null] retain];
+    }
+    results = [SBArray arrayWithObjects:batch + count count:count];
+    for ( i = 0; i < count; i++ )
+      [batch[count + i] release];
+    objc_free(batch);
+
+    return results;
+  }
+
+//
+
+  - (void) shutdownWorkers
+  {
+    [_batchLock lockOnConditionValue:kSBMaintenanceWorkerPoolIdle];
+    if ( _workerCount ) {
+      _shutdown = YES;
+      [_batchLock unlockWithConditionValue:kSBMaintenanceWorkerPoolBusy];
+    } else {
+      [_batchLock unlockWithConditionValue:kSBMaintenanceWorkerPoolIdle];
+    }
+  }
+
+@end
@@ -32,6 +32,30 @@ static SBString* SBDefaultPIDFile = @RUN_DIR"/scruffy.pid";
 static SBMaintenanceTaskManager*  SBTaskManager = nil;
 static SBMaintenanceTask*         SBSingletonTask = nil;
 
+//
+// SIGUSR1 asks for the object allocator's statistics; the handler only notes the request and
+// the main runloop writes the report:
+//
+static volatile sig_atomic_t      SBAllocatorStatisticsRequested = 0;
+
+@interface SBScruffyStatisticsWatcher : SBObject
+
+- (void) checkForStatisticsRequest:(SBTimer*)aTimer;
+
+@end
+
+@implementation SBScruffyStatisticsWatcher
+
+  - (void) checkForStatisticsRequest:(SBTimer*)aTimer
+  {
+    if ( SBAllocatorStatisticsRequested ) {
+      SBAllocatorStatisticsRequested = 0;
+      SBObjectAllocatorWriteStatistics(stderr);
+    }
+  }
+
+@end
+
 //
 #pragma mark -
 //
@@ -71,6 +95,10 @@ __signalHandler(
         [SBTaskManager setIsRunning:NO];
       }
       break;
+    
+    case SIGUSR1:
+      SBAllocatorStatisticsRequested = 1;
+      break;
       
   }
 }
@@ -121,6 +149,8 @@ main(
   uid_t                   runAsUID = -1;
   gid_t                   runAsGID = -1;
   SBArray*                schemaList = nil;
+  SBScruffyStatisticsWatcher* statisticsWatcher = nil;
+  SBTimer*                statisticsTimer = nil;
   SBAutoreleasePool*      ourPool = [[SBAutoreleasePool alloc] init];
   int                     optCh;
 
@@ -223,6 +253,15 @@ main(
   
   signal(SIGINT, __signalHandler);
   signal(SIGHUP, __signalHandler);
+  signal(SIGUSR1, __signalHandler);
+  
+  statisticsWatcher = [[SBScruffyStatisticsWatcher alloc] init];
+  statisticsTimer = [[SBTimer scheduledTimerWithTimeInterval:[SBTimeInterval timeIntervalWithSeconds:1.0]
+                          target:statisticsWatcher
+                          selector:@selector(checkForStatisticsRequest:)
+                          userInfo:nil
+                          repeats:YES
+                        ] retain];
   
   //
   // Get the default SBMailer stuff setup:
@@ -240,6 +279,7 @@ main(
                   searchSchema:schemaList
                 ];
   if ( database ) {
+    [database setStatementCacheSize:SBPostgresDefaultStatementCacheSize];
     [database scheduleNotificationInRunLoop:[SBRunLoop currentRunLoop]];
     if ( taskKey ) {
       //
@@ -295,6 +335,10 @@ main(
   //
   SBDropPIDFile(SBDefaultPIDFile);
   
+  [statisticsTimer invalidate];
+  [statisticsTimer release];
+  [statisticsWatcher release];
+  
   //
   // One last chance to clear autoreleased junk:
   //